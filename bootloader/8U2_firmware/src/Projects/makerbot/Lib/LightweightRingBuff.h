@@ -146,6 +146,27 @@
 			return (RingBuffer_GetCount(Buffer) == 0);
 		}
 
+		/** Retrieves an element of the ring buffer without removing it.
+		 *
+		 *  \note Only the execution thread which removes from the buffer may look into it.
+		 *
+		 *  \param[in] Buffer  Pointer to a ring buffer structure to look into
+		 *  \param[in] Offset  Position of the element, counting from the next one to be removed;
+		 *                     must be less than the count of the buffer
+		 *
+		 *  \return Data element at the given position
+		 */
+		static inline RingBuff_Data_t RingBuffer_Peek(RingBuff_t* const Buffer,
+		                                              const RingBuff_Count_t Offset)
+		{
+			RingBuff_Data_t* Data = Buffer->Out + Offset;
+
+			if (Data >= &Buffer->Buffer[BUFFER_SIZE])
+			  Data -= BUFFER_SIZE;
+
+			return *Data;
+		}
+
 		/** Inserts an element into the ring buffer.
 		 *
 		 *  \note Only one execution thread (main program thread or an ISR) may insert into a single buffer
@@ -0,0 +1,101 @@
+/*
+  MODIFIED FOR USE WITH MAKERBOT 3D PRINTERS
+*/
+
+/** \file
+ *
+ *  Finds the ends of s3g packets in the bytes the bot sends, so that each reply can be
+ *  flushed to the host as soon as it is complete rather than when the flush timer runs
+ *  out. Only the framing is followed; the CRC is left to the host. Bytes which are not
+ *  framed as packets, such as those of the bootloader, are left to the flush timer.
+ *
+ *  Plain C with no hardware dependencies, so that the host side model of the bridge in
+ *  the firmware simulator can use it as it is.
+ */
+
+#ifndef _PACKET_TRACKER_H_
+#define _PACKET_TRACKER_H_
+
+	/* Includes: */
+		#include <stdint.h>
+		#include <stdbool.h>
+
+	/* Defines: */
+		/** Start bytes of the framings the bot sends; see Packet.hh of the bot firmware. */
+		#define PACKET_START_BYTE            0xD5
+		#define PACKET_TELEMETRY_START_BYTE  0xD6
+		#define PACKET_WINDOW_START_BYTE     0xD7
+
+		/** Bytes between a WINDOW_START_BYTE and the length: ack and credit. */
+		#define PACKET_WINDOW_HEADER_LENGTH  3
+
+	/* Enums: */
+		enum PacketTracker_State_t
+		{
+			PACKET_STATE_Start,
+			PACKET_STATE_Header,
+			PACKET_STATE_Length,
+			PACKET_STATE_Payload,
+			PACKET_STATE_CRC
+		};
+
+	/* Type Defines: */
+		typedef struct
+		{
+			uint8_t State; /**< One of \ref PacketTracker_State_t */
+			uint8_t Remaining; /**< Header or payload bytes still to come */
+		} PacketTracker_t;
+
+	/* Inline Functions: */
+		/** Starts looking for a start byte.
+		 *
+		 *  \param[out] Tracker  Pointer to the tracker to reset
+		 */
+		static inline void PacketTracker_Reset(PacketTracker_t* const Tracker)
+		{
+			Tracker->State     = PACKET_STATE_Start;
+			Tracker->Remaining = 0;
+		}
+
+		/** Follows one byte of the stream from the bot.
+		 *
+		 *  \param[in,out] Tracker  Pointer to the tracker
+		 *  \param[in]     Data     Next byte from the bot
+		 *
+		 *  \return Boolean true if the byte is the last of a packet
+		 */
+		static inline bool PacketTracker_Byte(PacketTracker_t* const Tracker,
+		                                      const uint8_t Data)
+		{
+			switch (Tracker->State)
+			{
+				case PACKET_STATE_Start:
+					if (Data == PACKET_WINDOW_START_BYTE)
+					{
+						Tracker->State     = PACKET_STATE_Header;
+						Tracker->Remaining = PACKET_WINDOW_HEADER_LENGTH;
+					}
+					else if ((Data == PACKET_START_BYTE) || (Data == PACKET_TELEMETRY_START_BYTE))
+					{
+						Tracker->State = PACKET_STATE_Length;
+					}
+					return false;
+				case PACKET_STATE_Header:
+					if (!(--Tracker->Remaining))
+					  Tracker->State = PACKET_STATE_Length;
+					return false;
+				case PACKET_STATE_Length:
+					Tracker->Remaining = Data;
+					Tracker->State     = Data ? PACKET_STATE_Payload : PACKET_STATE_CRC;
+					return false;
+				case PACKET_STATE_Payload:
+					if (!(--Tracker->Remaining))
+					  Tracker->State = PACKET_STATE_CRC;
+					return false;
+				default:
+					Tracker->State = PACKET_STATE_Start;
+					return true;
+			}
+		}
+
+#endif
@@ -46,6 +46,12 @@ RingBuff_t USBtoUSART_Buffer;
 /** Circular buffer to hold data from the serial port before it is sent to the host. */
 RingBuff_t USARTtoUSB_Buffer;
 
+/** Follows the packets in the data from the serial port, to send each one on once it is complete. */
+PacketTracker_t ReplyTracker;
+
+/** Number of bytes at the front of USARTtoUSB_Buffer which ReplyTracker has followed. */
+RingBuff_Count_t TrackedCount;
+
 /** Pulse generation counters to keep track of the number of milliseconds remaining for each pulse type */
 volatile struct
 {
@@ -123,6 +129,8 @@ int main(void)
 	
 	RingBuffer_InitBuffer(&USBtoUSART_Buffer);
 	RingBuffer_InitBuffer(&USARTtoUSB_Buffer);
+	PacketTracker_Reset(&ReplyTracker);
+	TrackedCount = 0;
 
 	sei();
 
@@ -150,21 +158,24 @@ int main(void)
 					RingBuffer_Insert(&USBtoUSART_Buffer, ReceivedByte);
 			}
 		
-			/* Check if the UART receive buffer flush timer has expired or the buffer is nearly full */
+			/* Send each reply from the bot on as soon as its last byte is in, rather than
+			   leaving it for up to a flush timer period */
 			RingBuff_Count_t BufferCount = RingBuffer_GetCount(&USARTtoUSB_Buffer);
+			RingBuff_Count_t SendCount   = 0;
+
+			while (TrackedCount < BufferCount)
+			{
+				if (PacketTracker_Byte(&ReplyTracker, RingBuffer_Peek(&USARTtoUSB_Buffer, TrackedCount++)))
+				  SendCount = TrackedCount;
+			}
+
+			/* Check if the UART receive buffer flush timer has expired or the buffer is nearly full */
 			if ((TIFR0 & (1 << TOV0)) || (BufferCount > BUFFER_NEARLY_FULL))
 			{
 				TIFR0 |= (1 << TOV0);
 
-				if (USARTtoUSB_Buffer.Count) {
-					LEDs_TurnOnLEDs(LEDMASK_TX);
-					PulseMSRemaining.TxLEDPulse = TX_RX_LED_PULSE_MS;
-				}
+				SendCount = BufferCount;
 
-				/* Read bytes from the USART receive buffer into the USB IN endpoint */
-				while (BufferCount--)
-					CDC_Device_SendByte(&VirtualSerial_CDC_Interface, RingBuffer_Remove(&USARTtoUSB_Buffer));
-			  
 				/* Turn off TX LED(s) once the TX pulse period has elapsed */
 				if (PulseMSRemaining.TxLEDPulse && !(--PulseMSRemaining.TxLEDPulse))
 				  LEDs_TurnOffLEDs(LEDMASK_TX);
@@ -173,6 +184,20 @@ int main(void)
 				if (PulseMSRemaining.RxLEDPulse && !(--PulseMSRemaining.RxLEDPulse))
 				  LEDs_TurnOffLEDs(LEDMASK_RX);
 			}
+
+			if (SendCount)
+			{
+				LEDs_TurnOnLEDs(LEDMASK_TX);
+				PulseMSRemaining.TxLEDPulse = TX_RX_LED_PULSE_MS;
+
+				/* Read bytes from the USART receive buffer into the USB IN endpoint, all in one
+				   transfer where they fit */
+				TrackedCount -= SendCount;
+				while (SendCount--)
+					CDC_Device_SendByte(&VirtualSerial_CDC_Interface, RingBuffer_Remove(&USARTtoUSB_Buffer));
+
+				CDC_Device_Flush(&VirtualSerial_CDC_Interface);
+			}
 		
 			/* Load the next byte from the USART transmit buffer into the USART */
 			if (!(RingBuffer_IsEmpty(&USBtoUSART_Buffer))) {
@@ -291,6 +316,11 @@ void EVENT_CDC_Device_LineEncodingChanged(USB_ClassInfo_CDC_Device_t* const CDCI
 	UCSR1C = ConfigMask;
 	UCSR1A = (CDCInterfaceInfo->State.LineEncoding.BaudRateBPS == 57600) ? 0 : (1 << U2X1);
 	UCSR1B = ((1 << RXCIE1) | (1 << TXEN1) | (1 << RXEN1));
+
+	/* A change of rate, such as to the faster rates the bot firmware can switch to
+	   (250000, 500000 and 1000000 baud, all exact in double speed mode), may leave part
+	   of a packet behind; any still to come will start afresh */
+	PacketTracker_Reset(&ReplyTracker);
 }
 
 /** ISR to manage the reception of data from the serial port, placing received bytes into a circular buffer
@@ -47,6 +47,7 @@
 		#include "Descriptors.h"
 
 		#include "Lib/LightweightRingBuff.h"
+		#include "Lib/PacketTracker.h"
 
 		#include <LUFA/Version.h>
 		#include <LUFA/Drivers/Board/LEDs.h>
@@ -10,4 +10,42 @@
 #define STEPPER_COUNT 5
 #endif
 
+// Need EXTRUDERS for StepperAxis.hh
+
+#ifndef EXTRUDERS
+#define EXTRUDERS 2
+#endif
+
+// The stepper pins of mighty_two, for the pin traits in StepperAxis.hh;
+// a test may define another board's first
+
+#ifndef X_STEPPER_STEP
+#define X_STEPPER_STEP          STEPPER_PORT(D,6)
+#define X_STEPPER_DIR           STEPPER_PORT(D,7)
+#define X_STEPPER_ENABLE        STEPPER_PORT(D,4)
+#define X_STEPPER_MIN           STEPPER_PORT(J,2)
+#define X_STEPPER_MAX           STEPPER_PORT(C,7)
+
+#define Y_STEPPER_STEP          STEPPER_PORT(L,5)
+#define Y_STEPPER_DIR           STEPPER_PORT(L,7)
+#define Y_STEPPER_ENABLE        STEPPER_PORT(L,4)
+#define Y_STEPPER_MIN           STEPPER_PORT(J,1)
+#define Y_STEPPER_MAX           STEPPER_PORT(C,6)
+
+#define Z_STEPPER_STEP          STEPPER_PORT(L,1)
+#define Z_STEPPER_DIR           STEPPER_PORT(L,2)
+#define Z_STEPPER_ENABLE        STEPPER_PORT(L,0)
+#define Z_STEPPER_MIN           STEPPER_PORT(C,5)
+#define Z_STEPPER_MAX           STEPPER_PORT(J,0)
+#define ENDSTOPS_PIN_CHANGE     1
+
+#define A_STEPPER_STEP          STEPPER_PORT(A,3)
+#define A_STEPPER_DIR           STEPPER_PORT(A,2)
+#define A_STEPPER_ENABLE        STEPPER_PORT(A,5)
+
+#define B_STEPPER_STEP          STEPPER_PORT(A,0)
+#define B_STEPPER_DIR           STEPPER_PORT(K,7)
+#define B_STEPPER_ENABLE        STEPPER_PORT(A,1)
+#endif
+
 #endif
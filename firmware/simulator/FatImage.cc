@@ -0,0 +1,141 @@
+// FatImage.cc
+// Builds a FAT16 "superfloppy" image in memory.
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "FatImage.hh"
+
+#define SECTOR_SIZE 512
+#define RESERVED_SECTORS 1
+#define FAT_COPIES 2
+#define ROOT_ENTRIES 512
+
+static void put16(uint8_t *p, uint16_t v)
+{
+     p[0] = v & 0xff;
+     p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+     put16(p, v & 0xffff);
+     put16(p + 2, v >> 16);
+}
+
+FatImage::FatImage(uint32_t sectors, uint8_t sectors_per_cluster) :
+     next_cluster(2),
+     root_entries_used(0),
+     last_runs(0)
+{
+     image_size = sectors * SECTOR_SIZE;
+     image = (uint8_t *)calloc(image_size, 1);
+     cluster_bytes = (uint32_t)sectors_per_cluster * SECTOR_SIZE;
+
+     uint32_t root_sectors = ROOT_ENTRIES * 32 / SECTOR_SIZE;
+     // size the FAT generously; lib_sd counts clusters the same way
+     uint32_t fat_sectors = ((sectors / sectors_per_cluster + 2) * 2 +
+			     SECTOR_SIZE - 1) / SECTOR_SIZE;
+     uint32_t data_sectors = sectors - RESERVED_SECTORS -
+	  FAT_COPIES * fat_sectors - root_sectors;
+     cluster_count = data_sectors / sectors_per_cluster;
+
+     fat_offset = RESERVED_SECTORS * SECTOR_SIZE;
+     fat_bytes = fat_sectors * SECTOR_SIZE;
+     root_offset = fat_offset + FAT_COPIES * fat_bytes;
+     data_offset = root_offset + root_sectors * SECTOR_SIZE;
+
+     // boot sector and BIOS parameter block
+     uint8_t *boot = image;
+     boot[0] = 0xeb;
+     boot[1] = 0x3c;
+     boot[2] = 0x90;
+     memcpy(boot + 3, "SDSIM   ", 8);
+     put16(boot + 0x0b, SECTOR_SIZE);
+     boot[0x0d] = sectors_per_cluster;
+     put16(boot + 0x0e, RESERVED_SECTORS);
+     boot[0x10] = FAT_COPIES;
+     put16(boot + 0x11, ROOT_ENTRIES);
+     if (sectors < 0x10000)
+	  put16(boot + 0x13, sectors);
+     else
+	  put32(boot + 0x20, sectors);
+     boot[0x15] = 0xf8;
+     put16(boot + 0x16, fat_sectors);
+     put16(boot + 0x18, 32);
+     put16(boot + 0x1a, 64);
+     boot[0x26] = 0x29;
+     memcpy(boot + 0x2b, "SDSIM      ", 11);
+     memcpy(boot + 0x36, "FAT16   ", 8);
+     boot[510] = 0x55;
+     boot[511] = 0xaa;
+
+     setFat(0, 0xfff8);
+     setFat(1, 0xffff);
+}
+
+FatImage::~FatImage()
+{
+     free(image);
+}
+
+void FatImage::setFat(uint16_t cluster, uint16_t value)
+{
+     for (uint8_t copy = 0; copy < FAT_COPIES; copy++)
+	  put16(image + fat_offset + copy * fat_bytes + cluster * 2, value);
+}
+
+bool FatImage::addFile(const char *name, const uint8_t *data, uint32_t length,
+		       uint16_t run_clusters, uint16_t gap_clusters)
+{
+     if (root_entries_used >= ROOT_ENTRIES)
+	  return false;
+
+     uint8_t *entry = image + root_offset + root_entries_used * 32;
+     memset(entry, ' ', 11);
+     const char *dot = strchr(name, '.');
+     uint8_t base = dot ? dot - name : strlen(name);
+     for (uint8_t i = 0; i < base && i < 8; i++)
+	  entry[i] = toupper(name[i]);
+     if (dot)
+	  for (uint8_t i = 0; dot[i + 1] && i < 3; i++)
+	       entry[8 + i] = toupper(dot[i + 1]);
+     entry[11] = 0x20;
+
+     uint16_t first = 0, previous = 0, in_run = 0;
+     uint32_t written = 0;
+     last_runs = 0;
+     while (written < length) {
+	  if (in_run == run_clusters) {
+	       next_cluster += gap_clusters;
+	       in_run = 0;
+	  }
+	  if (next_cluster >= cluster_count + 2)
+	       return false;
+
+	  uint16_t cluster = next_cluster++;
+	  if (previous)
+	       setFat(previous, cluster);
+	  else
+	       first = cluster;
+	  if (!previous || cluster != previous + 1)
+	       last_runs++;
+	  previous = cluster;
+	  in_run++;
+
+	  uint32_t n = length - written;
+	  if (n > cluster_bytes)
+	       n = cluster_bytes;
+	  memcpy(image + data_offset + (uint32_t)(cluster - 2) * cluster_bytes,
+		 data + written, n);
+	  written += n;
+     }
+     if (previous)
+	  setFat(previous, 0xffff);
+
+     put16(entry + 0x1a, first);
+     put32(entry + 0x1c, length);
+     root_entries_used++;
+     return true;
+}
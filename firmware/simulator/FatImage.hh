@@ -0,0 +1,53 @@
+// FatImage.hh
+// Builds a FAT16 "superfloppy" image in memory, for running lib_sd on the
+// host against SdCardSim.  Files can be laid out contiguously or split
+// into runs of clusters with gaps between them, to model a fragmented card.
+
+#ifndef FAT_IMAGE_HH_
+#define FAT_IMAGE_HH_
+
+#include <stdint.h>
+
+class FatImage {
+public:
+     // sectors: total size in 512 byte sectors; at least 4085 clusters
+     // are needed for lib_sd to accept the volume as FAT16
+     FatImage(uint32_t sectors, uint8_t sectors_per_cluster);
+     ~FatImage();
+
+     // Add a file to the root directory.  Its clusters are allocated in
+     // runs of run_clusters, leaving gap_clusters free after each run
+     // (gap_clusters 0 gives a contiguous file).  name is an 8.3 name in
+     // the "NAME.EXT" form.  Returns false if the volume is full.
+     bool addFile(const char *name, const uint8_t *data, uint32_t length,
+		  uint16_t run_clusters = 0xffff, uint16_t gap_clusters = 0);
+
+     // Number of separate cluster runs in the most recently added file
+     uint16_t lastFileRuns() const { return last_runs; }
+
+     uint8_t *data() { return image; }
+     uint32_t size() const { return image_size; }
+     uint32_t clusterSize() const { return cluster_bytes; }
+
+     // Byte offsets of the first FAT and of the data region
+     uint32_t fatOffset() const { return fat_offset; }
+     uint32_t fatBytes() const { return fat_bytes; }
+     uint32_t dataOffset() const { return data_offset; }
+
+private:
+     uint8_t *image;
+     uint32_t image_size;
+     uint32_t cluster_bytes;
+     uint32_t fat_offset;
+     uint32_t fat_bytes;
+     uint32_t root_offset;
+     uint32_t data_offset;
+     uint16_t cluster_count;
+     uint16_t next_cluster;
+     uint16_t root_entries_used;
+     uint16_t last_runs;
+
+     void setFat(uint16_t cluster, uint16_t value);
+};
+
+#endif
@@ -0,0 +1,427 @@
+// SdCardSim.cc
+// A simulated SD card in SPI mode, for running lib_sd on the host.
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "SdCardSim.hh"
+#include "sdsim/avr/io.h"
+#include "sdsim/Configuration.hh"
+
+// Clock the board runs at
+#define F_OSC 16000000.0
+
+// Time from a read command to its data, and between the blocks of a
+// multiple block read, in microseconds
+#define READ_ACCESS_US 300
+#define STREAM_ACCESS_US 40
+
+// Time the card stays busy after each block written, after each block of
+// a multiple block write, which it can program as a run, and after CMD12
+#define WRITE_BUSY_US 500
+#define STREAM_WRITE_BUSY_US 100
+#define STOP_BUSY_US 10
+
+// R1 response bits
+#define R1_IDLE       0x01
+#define R1_ILLEGAL    0x04
+#define R1_CRC_ERROR  0x08
+#define R1_ADDRESS    0x20
+#define R1_PARAMETER  0x40
+
+// Above the link speed, every this many bytes from the card is corrupted
+#define LINK_ERROR_INTERVAL 61
+
+SdCardSim *sd_card = 0;
+
+// Simulated SPI and port registers
+SpiDataRegister SPDR;
+uint8_t SPCR, SPSR, DDRB, PORTB;
+
+Pin SD_DETECT_PIN;
+Pin SD_WRITE_PIN;
+
+SpiDataRegister& SpiDataRegister::operator=(uint8_t b)
+{
+     static const uint8_t rate_dividers[4] = { 4, 16, 64, 128 };
+     uint8_t divider = rate_dividers[SPCR & 0x03];
+
+     if (SPSR & (1 << SPI2X))
+	  divider /= 2;
+     // the card is selected with PB0 low
+     received = sd_card ?
+	  sd_card->transfer(b, !(PORTB & (1 << PORTB0)), divider) : 0xff;
+     SPSR |= (1 << SPIF);
+     return *this;
+}
+
+uint8_t sdsim_crc7(const uint8_t *data, uint16_t length)
+{
+     uint8_t crc = 0;
+
+     for (uint16_t i = 0; i < length; i++) {
+	  uint8_t b = data[i];
+	  for (uint8_t bit = 0; bit < 8; bit++) {
+	       crc <<= 1;
+	       if ((b ^ crc) & 0x80)
+		    crc ^= 0x09;
+	       b <<= 1;
+	  }
+     }
+     return crc & 0x7f;
+}
+
+uint16_t sdsim_crc16(const uint8_t *data, uint16_t length)
+{
+     uint16_t crc = 0;
+
+     for (uint16_t i = 0; i < length; i++) {
+	  crc ^= (uint16_t)data[i] << 8;
+	  for (uint8_t bit = 0; bit < 8; bit++)
+	       crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+     }
+     return crc;
+}
+
+SdCardSim::SdCardSim(uint8_t *image_in, uint32_t size_in) :
+     watch_start(0),
+     watch_end(0),
+     link_max_hz(0xffffffff),
+     divider(128),
+     image(image_in),
+     size(size_in),
+     mode(MODE_COMMAND),
+     idle(false),
+     app_command(false),
+     crc_on(false),
+     init_polls(0),
+     command_length(0),
+     read_address(0),
+     write_address(0),
+     write_receiving(false),
+     write_length(0),
+     out_head(0),
+     out_length(0),
+     corrupt_blocks(0),
+     corrupt_writes(0),
+     link_error_count(0)
+{
+     resetCounters();
+}
+
+void SdCardSim::resetCounters()
+{
+     memset(commands, 0, sizeof(commands));
+     blocks_read = 0;
+     blocks_written = 0;
+     bytes = 0;
+     seconds = 0;
+     protocol_errors = 0;
+     crc_errors = 0;
+     watch_blocks = 0;
+}
+
+void SdCardSim::push(uint8_t b)
+{
+     if (out_length >= sizeof(out)) {
+	  fprintf(stderr, "SdCardSim: output queue overflow\n");
+	  exit(1);
+     }
+     out[(out_head + out_length) % sizeof(out)] = b;
+     out_length++;
+}
+
+// Hold the line at value for the given time at the current clock
+void SdCardSim::pushFill(uint16_t microseconds, uint8_t value)
+{
+     uint32_t n = (uint32_t)(microseconds * (F_OSC / divider) / 8.0 / 1000000.0);
+
+     if (n == 0)
+	  n = 1;
+     while (n--)
+	  push(value);
+}
+
+void SdCardSim::pushBlock(uint32_t address, uint16_t latency_us)
+{
+     uint8_t data[512];
+     uint16_t crc;
+
+     memcpy(data, image + address, 512);
+     crc = sdsim_crc16(data, 512);
+     if (corrupt_blocks) {
+	  corrupt_blocks--;
+	  data[(blocks_read * 37) % 512] ^= 0x04;
+     }
+
+     pushFill(latency_us, 0xff);
+     push(0xfe);
+     for (uint16_t i = 0; i < 512; i++)
+	  push(data[i]);
+     push(crc >> 8);
+     push(crc & 0xff);
+     blocks_read++;
+     if (address >= watch_start && address < watch_end)
+	  watch_blocks++;
+}
+
+void SdCardSim::pushRegister(const uint8_t *reg)
+{
+     uint16_t crc = sdsim_crc16(reg, 16);
+
+     pushFill(10, 0xff);
+     push(0xfe);
+     for (uint8_t i = 0; i < 16; i++)
+	  push(reg[i]);
+     push(crc >> 8);
+     push(crc & 0xff);
+}
+
+void SdCardSim::handleCommand()
+{
+     uint8_t index = command[0] & 0x3f;
+     uint32_t arg = ((uint32_t)command[1] << 24) | ((uint32_t)command[2] << 16) |
+	  ((uint32_t)command[3] << 8) | command[4];
+     uint8_t r1 = idle ? R1_IDLE : 0;
+     bool was_app_command = app_command;
+
+     commands[index]++;
+     app_command = false;
+
+     if (crc_on && (uint8_t)((sdsim_crc7(command, 5) << 1) | 1) != command[5]) {
+	  push(0xff);
+	  push(r1 | R1_CRC_ERROR);
+	  return;
+     }
+
+     // A new command in the middle of a multiple block read is a host bug
+     if (mode == MODE_READ_MULTIPLE && index != 12) {
+	  protocol_errors++;
+	  mode = MODE_COMMAND;
+	  out_length = 0;
+     }
+
+     switch (index) {
+     case 0:   // GO_IDLE_STATE
+	  idle = true;
+	  crc_on = false;
+	  init_polls = 0;
+	  mode = MODE_COMMAND;
+	  push(0xff);
+	  push(R1_IDLE);
+	  break;
+     case 55:  // APP_CMD
+	  app_command = true;
+	  push(0xff);
+	  push(r1);
+	  break;
+     case 1:   // SEND_OP_COND
+     case 41:  // SD_SEND_OP_COND
+	  if (index == 41 && !was_app_command) {
+	       push(0xff);
+	       push(r1 | R1_ILLEGAL);
+	       break;
+	  }
+	  if (++init_polls >= 2)
+	       idle = false;
+	  push(0xff);
+	  push(idle ? R1_IDLE : 0);
+	  break;
+     case 8:   // SEND_IF_COND: a version 1 card does not know it
+	  push(0xff);
+	  push(r1 | R1_ILLEGAL);
+	  break;
+     case 58:  // READ_OCR
+	  push(0xff);
+	  push(r1);
+	  push(0x80);
+	  push(0xff);
+	  push(0x80);
+	  push(0x00);
+	  break;
+     case 59:  // CRC_ON_OFF
+	  crc_on = arg & 1;
+	  push(0xff);
+	  push(r1);
+	  break;
+     case 16:  // SET_BLOCKLEN
+	  push(0xff);
+	  push(arg == 512 ? r1 : r1 | R1_PARAMETER);
+	  break;
+     case 9: { // SEND_CSD, version 1 layout
+	  uint8_t csd[16];
+	  uint16_t c_size = size / (512L * 512L) - 1;
+	  memset(csd, 0, sizeof(csd));
+	  csd[1] = 0x26;                       // TAAC
+	  csd[3] = 0x32;                       // TRAN_SPEED: 25MHz
+	  csd[4] = 0x5f;
+	  csd[5] = 0x59;                       // READ_BL_LEN: 512
+	  csd[6] = 0x80 | ((c_size >> 10) & 0x03);
+	  csd[7] = (c_size >> 2) & 0xff;
+	  csd[8] = (c_size & 0x03) << 6;
+	  csd[9] = 0x03;                       // C_SIZE_MULT: 7
+	  csd[10] = 0x80;
+	  csd[15] = (sdsim_crc7(csd, 15) << 1) | 1;
+	  push(0xff);
+	  push(r1);
+	  pushRegister(csd);
+	  break;
+     }
+     case 10: { // SEND_CID
+	  static const uint8_t cid[16] = {
+	       0x03, 'S', 'D', 'S', 'I', 'M', 'C', 'D', 0x10,
+	       0x12, 0x34, 0x56, 0x78, 0x00, 0xc5, 0x01 };
+	  push(0xff);
+	  push(r1);
+	  pushRegister(cid);
+	  break;
+     }
+     case 12:  // STOP_TRANSMISSION
+	  if (mode == MODE_READ_MULTIPLE) {
+	       mode = MODE_COMMAND;
+	       out_length = 0;
+	       // the card answers after a stuff byte, then signals busy
+	       push(0x3f);
+	       push(0x00);
+	       pushFill(STOP_BUSY_US, 0x00);
+	  }
+	  else {
+	       push(0xff);
+	       push(r1);
+	  }
+	  break;
+     case 17:  // READ_SINGLE_BLOCK
+     case 18:  // READ_MULTIPLE_BLOCK
+     case 24:  // WRITE_BLOCK
+     case 25:  // WRITE_MULTIPLE_BLOCK
+	  push(0xff);
+	  if (idle) {
+	       push(r1 | R1_ILLEGAL);
+	       break;
+	  }
+	  if ((arg & 0x1ff) || arg + 512 > size) {
+	       push(R1_ADDRESS);
+	       break;
+	  }
+	  push(0x00);
+	  if (index == 17) {
+	       pushBlock(arg, READ_ACCESS_US);
+	  }
+	  else if (index == 18) {
+	       pushBlock(arg, READ_ACCESS_US);
+	       read_address = arg + 512;
+	       mode = MODE_READ_MULTIPLE;
+	  }
+	  else {
+	       write_address = arg;
+	       write_receiving = false;
+	       mode = (index == 24) ? MODE_WRITE_SINGLE : MODE_WRITE_MULTIPLE;
+	  }
+	  break;
+     default:
+	  push(0xff);
+	  push(r1 | R1_ILLEGAL);
+	  break;
+     }
+}
+
+void SdCardSim::receiveWriteByte(uint8_t b)
+{
+     if (!write_receiving) {
+	  if ((mode == MODE_WRITE_SINGLE && b == 0xfe) ||
+	      (mode == MODE_WRITE_MULTIPLE && b == 0xfc)) {
+	       write_receiving = true;
+	       write_length = 0;
+	  }
+	  else if (mode == MODE_WRITE_MULTIPLE && b == 0xfd) {
+	       // stop token
+	       push(0xff);
+	       pushFill(WRITE_BUSY_US, 0x00);
+	       mode = MODE_COMMAND;
+	  }
+	  return;
+     }
+
+     write_data[write_length++] = b;
+     if (write_length < sizeof(write_data))
+	  return;
+
+     write_receiving = false;
+     if (corrupt_writes) {
+	  corrupt_writes--;
+	  write_data[(blocks_written * 41) % 512] ^= 0x20;
+     }
+     uint16_t crc = ((uint16_t)write_data[512] << 8) | write_data[513];
+     if (crc_on && crc != sdsim_crc16(write_data, 512)) {
+	  crc_errors++;
+	  push(0x0b);
+     }
+     else {
+	  memcpy(image + write_address, write_data, 512);
+	  blocks_written++;
+	  push(0x05);
+	  if (mode == MODE_WRITE_SINGLE)
+	       pushFill(WRITE_BUSY_US, 0x00);
+	  else {
+	       pushFill(STREAM_WRITE_BUSY_US, 0x00);
+	       write_address += 512;
+	  }
+     }
+     if (mode == MODE_WRITE_SINGLE)
+	  mode = MODE_COMMAND;
+}
+
+uint8_t SdCardSim::transfer(uint8_t mosi, bool selected, uint8_t divider_in)
+{
+     uint8_t result = 0xff;
+
+     divider = divider_in;
+     bytes++;
+     seconds += 8.0 * divider / F_OSC;
+
+     if (!selected) {
+	  // a card that is deselected part way through a single block read
+	  // abandons the rest of it
+	  command_length = 0;
+	  if (mode != MODE_READ_MULTIPLE)
+	       out_length = 0;
+	  return 0xff;
+     }
+
+     // output: a multiple block read keeps the card sending
+     if (out_length == 0 && mode == MODE_READ_MULTIPLE) {
+	  if (read_address + 512 <= size) {
+	       pushBlock(read_address, STREAM_ACCESS_US);
+	       read_address += 512;
+	  }
+	  else {
+	       push(0x08);   // error token: out of range
+	       mode = MODE_COMMAND;
+	  }
+     }
+     if (out_length) {
+	  result = out[out_head];
+	  out_head = (out_head + 1) % sizeof(out);
+	  out_length--;
+	  if (F_OSC / divider > link_max_hz &&
+	      ++link_error_count >= LINK_ERROR_INTERVAL) {
+	       link_error_count = 0;
+	       result ^= 0x10;
+	  }
+     }
+
+     // input
+     if ((mode == MODE_WRITE_SINGLE || mode == MODE_WRITE_MULTIPLE) &&
+	 command_length == 0) {
+	  receiveWriteByte(mosi);
+     }
+     else if (command_length > 0 || (mosi & 0xc0) == 0x40) {
+	  command[command_length++] = mosi;
+	  if (command_length == sizeof(command)) {
+	       command_length = 0;
+	       handleCommand();
+	  }
+     }
+     return result;
+}
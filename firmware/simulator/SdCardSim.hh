@@ -0,0 +1,104 @@
+// SdCardSim.hh
+// A simulated SD card in SPI mode, for running lib_sd on the host.
+//
+// The card holds an in-memory image and answers the commands sd_raw.c
+// uses.  It counts commands and bytes, and estimates the time spent on
+// the bus from the SPI clock setting, including the card's access latency,
+// which it presents as 0xff bytes before each data block the way a real
+// card does.  Faults can be injected into the data it sends.
+
+#ifndef SD_CARD_SIM_HH_
+#define SD_CARD_SIM_HH_
+
+#include <stdint.h>
+
+class SdCardSim {
+public:
+     SdCardSim(uint8_t *image, uint32_t size);
+
+     // Clock one byte through the card.  divider is the SPI clock divider
+     // (f_OSC / divider) in effect for the transfer.
+     uint8_t transfer(uint8_t mosi, bool selected, uint8_t divider);
+
+     // Clear the counters
+     void resetCounters();
+
+     // Counters
+     uint32_t commands[64];     // commands received, by index
+     uint32_t blocks_read;      // data blocks sent to the host
+     uint32_t blocks_written;   // data blocks written to the image
+     uint32_t bytes;            // bytes clocked
+     double   seconds;          // time on the bus
+     uint32_t protocol_errors;  // commands sent mid-transfer without CMD12
+     uint32_t crc_errors;       // written blocks rejected for a bad CRC
+
+     // Data blocks sent from the image between watch_start and watch_end
+     uint32_t watch_start, watch_end;
+     uint32_t watch_blocks;
+
+     // Fastest SPI clock the connection carries cleanly, in Hz.  Above
+     // this, bytes from the card are corrupted now and then.
+     uint32_t link_max_hz;
+
+     // SPI clock divider of the most recent transfer
+     uint8_t divider;
+
+     // Flip one bit in each of the next n data blocks sent
+     void corruptBlocks(uint16_t n) { corrupt_blocks = n; }
+
+     // Flip one bit in each of the next n data blocks received
+     void corruptWrites(uint16_t n) { corrupt_writes = n; }
+
+     bool crcEnabled() const { return crc_on; }
+
+private:
+     enum Mode {
+	  MODE_COMMAND,
+	  MODE_READ_MULTIPLE,
+	  MODE_WRITE_SINGLE,
+	  MODE_WRITE_MULTIPLE
+     };
+
+     uint8_t *image;
+     uint32_t size;
+
+     Mode mode;
+     bool idle;
+     bool app_command;
+     bool crc_on;
+     uint8_t init_polls;
+
+     uint8_t command[6];
+     uint8_t command_length;
+
+     uint32_t read_address;
+
+     uint32_t write_address;
+     bool write_receiving;
+     uint16_t write_length;
+     uint8_t write_data[514];
+
+     uint8_t out[1024];
+     uint16_t out_head;
+     uint16_t out_length;
+
+     uint16_t corrupt_blocks;
+     uint16_t corrupt_writes;
+     uint8_t link_error_count;
+
+     void push(uint8_t b);
+     void pushFill(uint16_t microseconds, uint8_t value);
+     void pushBlock(uint32_t address, uint16_t latency_us);
+     void pushRegister(const uint8_t *reg);
+     void handleCommand();
+     void receiveWriteByte(uint8_t b);
+};
+
+// The card the simulated SPI registers talk to
+extern SdCardSim *sd_card;
+
+// CRC helpers shared with the tests
+uint8_t sdsim_crc7(const uint8_t *data, uint16_t length);
+uint16_t sdsim_crc16(const uint8_t *data, uint16_t length);
+
+#endif
@@ -0,0 +1,155 @@
+// TwiBusSim.cc
+// A simulated TWI (I2C) bus with one peripheral, for running the TWI
+// driver on the host.
+
+#include <stdlib.h>
+
+#include "TwiBusSim.hh"
+#include "twisim/avr/io.h"
+#include "twisim/util/twi.h"
+
+TwiBusSim *twi_bus = 0;
+
+// Simulated TWI registers
+TwiControlRegister TWCR;
+uint8_t TWDR, TWSR, TWBR;
+
+TwiControlRegister& TwiControlRegister::operator=(uint8_t b)
+{
+     if (twi_bus)
+	  twi_bus->control(b);
+     return *this;
+}
+
+TwiControlRegister::operator uint8_t() const
+{
+     return twi_bus ? twi_bus->control() : 0;
+}
+
+TwiBusSim::TwiBusSim(uint8_t device_address) :
+     transfer_count(0), protocol_errors(0), reads(0), device(device_address),
+     twcr(0), twint(false), action(ACTION_NONE), byte(0), master(false),
+     addressed(false), nack_data(false), bus_error(false)
+{
+}
+
+void TwiBusSim::control(uint8_t b)
+{
+     twcr = b & (_BV(TWEA) | _BV(TWEN) | _BV(TWIE));
+
+     // writing TWINT clears it and starts the next action
+     if (!(b & _BV(TWINT)))
+	  return;
+     if (action != ACTION_NONE)
+	  protocol_errors++;
+     twint = false;
+     if ((b & _BV(TWSTO)) && (b & _BV(TWSTA)))
+	  action = ACTION_STOP_START;
+     else if (b & _BV(TWSTA))
+	  action = ACTION_START;
+     else if (b & _BV(TWSTO))
+	  action = ACTION_STOP;
+     else {
+	  action = ACTION_BYTE;
+	  byte = TWDR;
+     }
+}
+
+uint8_t TwiBusSim::control()
+{
+     reads++;
+     if (action != ACTION_NONE && rand() % 2)
+	  step();
+
+     uint8_t b = twcr;
+     if (twint)
+	  b |= _BV(TWINT);
+     if (action == ACTION_STOP || action == ACTION_STOP_START)
+	  b |= _BV(TWSTO);
+     return b;
+}
+
+bool TwiBusSim::interruptPending() const
+{
+     return twint && (twcr & _BV(TWIE)) && (twcr & _BV(TWEN));
+}
+
+void TwiBusSim::start()
+{
+     Transfer& t = transfers[transfer_count % TWI_BUS_SIM_TRANSFERS];
+
+     if (bus_error) {
+	  // the driver must send a stop to recover
+	  bus_error = false;
+	  master = true;
+	  addressed = false;
+	  t.address = 0;
+	  t.length = 0;
+	  t.result = RESULT_START;
+	  TWSR = TW_BUS_ERROR;
+     } else {
+	  TWSR = master ? TW_REP_START : TW_START;
+	  master = true;
+	  addressed = false;
+	  t.address = 0;
+	  t.length = 0;
+	  t.result = RESULT_OK;
+     }
+     twint = true;
+}
+
+void TwiBusSim::stop()
+{
+     if (master)
+	  transfer_count++;
+     master = false;
+}
+
+bool TwiBusSim::step()
+{
+     Action a = action;
+     Transfer& t = transfers[transfer_count % TWI_BUS_SIM_TRANSFERS];
+
+     action = ACTION_NONE;
+     switch (a) {
+     case ACTION_NONE:
+	  return false;
+     case ACTION_START:
+	  start();
+	  break;
+     case ACTION_STOP:
+	  stop();
+	  break;
+     case ACTION_STOP_START:
+	  stop();
+	  start();
+	  break;
+     case ACTION_BYTE:
+	  if (!master || t.result != RESULT_OK) {
+	       protocol_errors++;
+	       TWSR = TW_NO_INFO;
+	  } else if (!addressed) {
+	       addressed = true;
+	       t.address = byte;
+	       if ((byte & ~TW_READ) == device) {
+		    TWSR = TW_MT_SLA_ACK;
+	       } else {
+		    TWSR = TW_MT_SLA_NACK;
+		    t.result = RESULT_ADDRESS;
+	       }
+	  } else {
+	       if (t.length < TWI_BUS_SIM_BYTES)
+		    t.data[t.length++] = byte;
+	       if (nack_data) {
+		    nack_data = false;
+		    TWSR = TW_MT_DATA_NACK;
+		    t.result = RESULT_DATA;
+	       } else {
+		    TWSR = TW_MT_DATA_ACK;
+	       }
+	  }
+	  twint = true;
+	  break;
+     }
+     return true;
+}
@@ -0,0 +1,94 @@
+// TwiBusSim.hh
+// A simulated TWI (I2C) bus with one peripheral, for running the TWI
+// driver on the host.
+//
+// The bus carries out what the driver writes to TWCR -- a start, a stop,
+// a stop and then a start, or a byte -- when step() is called, or, with
+// even odds, when the driver reads TWCR, as time passes while it waits.
+// It sets TWSR and TWINT as the hardware does, and asks for the TWI
+// interrupt when TWIE is set.  Every transfer is logged with its bytes and
+// how it ended.  Faults can be injected: a byte not acknowledged, or a bus
+// error in place of a start.
+
+#ifndef TWI_BUS_SIM_HH_
+#define TWI_BUS_SIM_HH_
+
+#include <stdint.h>
+
+#define TWI_BUS_SIM_TRANSFERS 8192
+#define TWI_BUS_SIM_BYTES     8
+
+class TwiBusSim {
+public:
+     // How a transfer ended, numbered as TWI.hh numbers its results
+     enum Result {
+	  RESULT_OK,
+	  RESULT_START,     // a bus error in place of the start
+	  RESULT_ADDRESS,   // the address was not acknowledged
+	  RESULT_DATA       // a data byte was not acknowledged
+     };
+
+     struct Transfer {
+	  uint8_t address;  // with the read/write bit
+	  uint8_t length;
+	  uint8_t data[TWI_BUS_SIM_BYTES];
+	  Result  result;
+     };
+
+     // The peripheral answers to the given address, without the read/write
+     // bit
+     TwiBusSim(uint8_t device_address);
+
+     // The driver writes or reads TWCR
+     void control(uint8_t twcr);
+     uint8_t control();
+
+     // Carry out the action the driver asked for; false if there was none
+     bool step();
+
+     // True when the driver's TWI interrupt should run
+     bool interruptPending() const;
+
+     // True when the bus is released and there is nothing to carry out
+     bool idle() const { return action == ACTION_NONE && !master; }
+
+     // Do not acknowledge the next data byte, or give a bus error for the
+     // next start
+     void nackData() { nack_data = true; }
+     void busError() { bus_error = true; }
+
+     Transfer transfers[TWI_BUS_SIM_TRANSFERS];
+     uint32_t transfer_count;
+
+     // Actions written while the last was still being carried out, and
+     // bytes sent without holding the bus
+     uint32_t protocol_errors;
+
+     // Reads of TWCR
+     uint32_t reads;
+
+private:
+     enum Action {
+	  ACTION_NONE,
+	  ACTION_START,
+	  ACTION_STOP,
+	  ACTION_STOP_START,
+	  ACTION_BYTE
+     };
+
+     void start();
+     void stop();
+
+     uint8_t device;
+     uint8_t twcr;      // TWEA, TWEN and TWIE as last written
+     bool twint;
+     Action action;
+     uint8_t byte;      // TWDR when the byte was started
+     bool master;       // holding the bus, from a start to a stop
+     bool addressed;    // the address of the transfer has been sent
+     bool nack_data, bus_error;
+};
+
+extern TwiBusSim *twi_bus;
+
+#endif
@@ -0,0 +1,208 @@
+// bridge_latency.c
+// Model of the round trip of a query through the USB to serial bridge, to
+// compare the flush timer alone with flushing each reply once it is
+// complete, at each of the rates the host link can run at.
+//
+// The bridge side of the model is the bridge firmware's own ring buffer
+// and packet tracker, driven the way its main loop drives them.  Around it:
+//
+//   - the host's request goes out at the start of the next 1 ms USB frame,
+//     and the bridge sends it on to the bot byte after byte
+//   - the bot answers once its host slice comes round, up to
+//     SLICE_US later
+//   - the bridge's flush timer overflows every FLUSH_TIMER_US
+//   - the host picks up whatever has been flushed at the start of the next
+//     USB frame
+//
+// Prints the spread of round trip times for each case, and checks the
+// tracker against packets of each framing with noise between them.
+// Exits non-zero on failure.
+//
+// Usage: bridge_latency
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+#include "LightweightRingBuff.h"
+#include "PacketTracker.h"
+
+#define TRANSACTIONS   10000
+
+#define USB_FRAME_US   1000.0
+#define FLUSH_TIMER_US (256.0 * 256.0 / 16.0)  // Timer0 at clk/256
+#define SLICE_US       500.0
+#define PROCESS_US     50.0
+
+// GET_BUFFER_SIZE and its reply
+#define REQUEST_LENGTH (1 + 1 + 1 + 1)
+#define REPLY_LENGTH   (1 + 1 + 5 + 1)
+
+static int failures = 0;
+
+static void check(int ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(int ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+typedef struct {
+     RingBuff_t       ring;          // USARTtoUSB_Buffer
+     PacketTracker_t  tracker;
+     RingBuff_Count_t tracked;
+     int              track_packets;
+     unsigned         flushed;       // bytes sent on to the host
+     double           flushed_at;
+} bridge_t;
+
+// One pass of the bridge's main loop, as far as the bytes from the bot go
+static void bridge_loop(bridge_t *b, double now, int timer_overflow)
+{
+     RingBuff_Count_t count = RingBuffer_GetCount(&b->ring);
+     RingBuff_Count_t send = 0;
+
+     if (b->track_packets) {
+	  while (b->tracked < count) {
+	       if (PacketTracker_Byte(&b->tracker, RingBuffer_Peek(&b->ring, b->tracked++)))
+		    send = b->tracked;
+	  }
+     }
+     if (timer_overflow || count > BUFFER_NEARLY_FULL)
+	  send = count;
+     if (send) {
+	  b->tracked = send < b->tracked ? b->tracked - send : 0;
+	  while (send--) {
+	       RingBuffer_Remove(&b->ring);
+	       b->flushed++;
+	  }
+	  b->flushed_at = now;
+     }
+}
+
+static double next_frame(double t)
+{
+     return ceil(t / USB_FRAME_US) * USB_FRAME_US;
+}
+
+static double uniform(double range)
+{
+     return range * rand() / ((double)RAND_MAX + 1);
+}
+
+// Time from the host sending a query to having all of the reply
+static double round_trip(bridge_t *b, double baud)
+{
+     double byte_us = 10e6 / baud;
+     double t0 = uniform(1e6);
+     double timer_phase = uniform(FLUSH_TIMER_US);
+     double overflow = timer_phase + ceil((t0 - timer_phase) / FLUSH_TIMER_US) * FLUSH_TIMER_US;
+     double at_bot = next_frame(t0) + REQUEST_LENGTH * byte_us;
+     double reply = at_bot + uniform(SLICE_US) + PROCESS_US;
+     unsigned start = b->flushed;
+     int i;
+
+     for (i = 0; i < REPLY_LENGTH; i++) {
+	  static const uint8_t bytes[REPLY_LENGTH] = { 0xD5, 5, 0x81, 0x00, 0x02, 0, 0, 0x5A };
+	  double arrives = reply + (i + 1) * byte_us;
+	  for (; overflow <= arrives; overflow += FLUSH_TIMER_US)
+	       bridge_loop(b, overflow, 1);
+	  RingBuffer_Insert(&b->ring, bytes[i]);
+	  bridge_loop(b, arrives, 0);
+     }
+     for (; b->flushed - start < REPLY_LENGTH; overflow += FLUSH_TIMER_US)
+	  bridge_loop(b, overflow, 1);
+     return next_frame(b->flushed_at) - t0;
+}
+
+static int compare(const void *a, const void *b)
+{
+     double x = *(const double *)a, y = *(const double *)b;
+     return (x > y) - (x < y);
+}
+
+// Median round trip, after printing the spread
+static double spread(double baud, int track_packets)
+{
+     static double rtt[TRANSACTIONS];
+     static bridge_t b;
+     int i;
+
+     memset(&b, 0, sizeof(b));
+     RingBuffer_InitBuffer(&b.ring);
+     PacketTracker_Reset(&b.tracker);
+     b.track_packets = track_packets;
+     for (i = 0; i < TRANSACTIONS; i++)
+	  rtt[i] = round_trip(&b, baud);
+     qsort(rtt, TRANSACTIONS, sizeof(rtt[0]), compare);
+     printf("%8.0f  %-6s %7.2f %7.2f %7.2f %7.2f %7.2f\n", baud,
+	    track_packets ? "packet" : "timer",
+	    rtt[0] / 1000, rtt[TRANSACTIONS / 2] / 1000, rtt[TRANSACTIONS * 9 / 10] / 1000,
+	    rtt[TRANSACTIONS * 99 / 100] / 1000, rtt[TRANSACTIONS - 1] / 1000);
+     return rtt[TRANSACTIONS / 2];
+}
+
+// Packets of each framing, with bytes which are not start bytes between
+// them; the tracker must find the end of each
+static void check_tracker(void)
+{
+     PacketTracker_t tracker;
+     int packets = 0, found = 0, misplaced = 0, i;
+
+     PacketTracker_Reset(&tracker);
+     for (i = 0; i < 2000; i++) {
+	  uint8_t start = 0xD5 + rand() % 3;
+	  uint8_t header = start == PACKET_WINDOW_START_BYTE ? PACKET_WINDOW_HEADER_LENGTH : 0;
+	  uint8_t length = rand() % 4 ? rand() % 33 : rand() % 256;
+	  int total = 1 + header + 1 + length + 1, n;
+
+	  while (rand() % 4 == 0)
+	       PacketTracker_Byte(&tracker, rand() % 0xD5);
+	  for (n = 0; n < total; n++) {
+	       uint8_t byte = n == 0 ? start : n == 1 + header ? length : rand();
+	       if (PacketTracker_Byte(&tracker, byte)) {
+		    found++;
+		    if (n != total - 1)
+			 misplaced++;
+	       }
+	  }
+	  packets++;
+     }
+     check(found == packets && misplaced == 0, "tracker found the ends of %d of %d packets",
+	   found - misplaced, packets);
+}
+
+int main(void)
+{
+     static const double rates[] = { 115200, 250000, 500000, 1000000 };
+     double timer_median[4], packet_median[4];
+     int i, faster = 1;
+
+     srand(40);
+     check_tracker();
+
+     printf("    baud  flush  round trip, ms: min  median    p90     p99     max\n");
+     for (i = 0; i < 4; i++) {
+	  timer_median[i] = spread(rates[i], 0);
+	  packet_median[i] = spread(rates[i], 1);
+	  if (packet_median[i] >= timer_median[i])
+	       faster = 0;
+     }
+     check(faster, "flushing replies once complete is faster at every rate");
+     check(packet_median[3] < timer_median[0] / 2,
+	   "median round trip %.2f ms at 1000000 baud against %.2f ms before",
+	   packet_median[3] / 1000, timer_median[0] / 1000);
+
+     return(failures ? 1 : 0);
+}
@@ -0,0 +1,174 @@
+// button_debounce.cc
+// Run the ButtonDebounce.hh state machine against a model keypad, ticked
+// every BUTTON_TICK_MICROS as the timebase interrupt does, whose contacts
+// bounce for up to BOUNCE_TICKS after each press and release.  Every press
+// must be reported exactly once, soon after it starts, and nothing on the
+// release; a held button must repeat after the slow delay and then every
+// fast delay; holding the hold button must report the hold event once
+// after the hold delay; and the keypad must go idle once released, so the
+// scan can stop.
+//
+// Prints the worst latency from a press to its report.
+// Exits non-zero on failure.
+//
+// Usage: button_debounce
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "ButtonDebounce.hh"
+
+// the buttons of the Replicator 2 keypad, by their bit on the ports
+#define CENTER 2
+#define RIGHT  3
+#define DOWN   4
+#define UP     5
+#define LEFT   6
+#define EGG    0
+
+#define SLOW_MICROS 500000
+#define FAST_MICROS 100000
+#define HOLD_MICROS 10000000
+
+#define PRESSES 20000
+
+// contacts bounce for up to 16ms
+#define BOUNCE_TICKS 4
+
+static const uint8_t keys[] = { CENTER, RIGHT, DOWN, UP, LEFT };
+
+static ButtonDebounce debounce(RIGHT, EGG, SLOW_MICROS, FAST_MICROS, HOLD_MICROS);
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+// The events of a run of ticks, and the tick of the first
+struct Events {
+     unsigned presses, repeats, holds, others;
+     long first_press, first_repeat, last_repeat, hold;
+};
+
+static void count(Events *e, uint8_t event, uint8_t button, long tick)
+{
+     if (event == BUTTON_NONE)
+	  return;
+     if (event == button) {
+	  if (!e->presses++)
+	       e->first_press = tick;
+     } else if (event == (button | BUTTON_REPEAT)) {
+	  if (!e->repeats++)
+	       e->first_repeat = tick;
+	  e->last_repeat = tick;
+     } else if (event == EGG) {
+	  e->holds++;
+	  e->hold = tick;
+     } else {
+	  e->others++;
+     }
+}
+
+// Ticks a button from up, through a bouncing press, held for the given
+// ticks, and a bouncing release until idle; the press starts at tick 0
+static void press(uint8_t button, long held, Events *e, bool *idle)
+{
+     long bounce_press = rand() % (BOUNCE_TICKS + 1), bounce_release = rand() % (BOUNCE_TICKS + 1), tick;
+
+     e->presses = e->repeats = e->holds = e->others = 0;
+     e->first_press = e->first_repeat = e->last_repeat = e->hold = -1;
+
+     for (tick = 0; tick < held; tick++) {
+	  uint8_t down = tick < bounce_press && rand() % 2 ? 0 : 1 << button;
+	  count(e, debounce.tick(down), button, tick);
+     }
+     for (tick = held; tick < held + bounce_release + BUTTON_DEBOUNCE_TICKS + 1; tick++) {
+	  uint8_t down = tick < held + bounce_release && rand() % 2 ? 1 << button : 0;
+	  count(e, debounce.tick(down), button, tick);
+     }
+     *idle = debounce.isIdle();
+}
+
+int main(void)
+{
+     long latency = 0, slow = BUTTON_TICKS(SLOW_MICROS), fast = BUTTON_TICKS(FAST_MICROS);
+     unsigned bad = 0, not_idle = 0, i;
+     Events e;
+     bool idle;
+
+     srand(47);
+
+     // taps, short of the slow delay
+     for (i = 0; i < PRESSES; i++) {
+	  press(keys[rand() % sizeof(keys)], BOUNCE_TICKS + BUTTON_DEBOUNCE_TICKS + 1 + rand() % (slow - 8), &e, &idle);
+	  if (e.presses != 1 || e.repeats || e.holds || e.others)
+	       bad++;
+	  if (e.first_press > latency)
+	       latency = e.first_press;
+	  if (!idle)
+	       not_idle++;
+     }
+     check(bad == 0, "taps: %u of %u not reported exactly once", bad, PRESSES);
+     check(not_idle == 0, "taps: %u of %u not idle once released", not_idle, PRESSES);
+     check(latency <= BOUNCE_TICKS + BUTTON_DEBOUNCE_TICKS,
+	   "taps: reported within %ld ticks of the press", latency);
+
+     // held for two seconds: a press, a repeat after the slow delay, then
+     // one every fast delay
+     press(UP, BUTTON_TICKS(2000000), &e, &idle);
+     check(e.presses == 1 && e.holds == 0 && e.others == 0, "held: one press");
+     check(e.first_repeat == e.first_press + slow,
+	   "held: first repeat %ld ticks after the press, want %ld",
+	   e.first_repeat - e.first_press, slow);
+     check(e.repeats > 1 && e.last_repeat - e.first_repeat == (long)(e.repeats - 1) * fast,
+	   "held: %u repeats, every %ld ticks", e.repeats,
+	   e.repeats > 1 ? (e.last_repeat - e.first_repeat) / (e.repeats - 1) : 0);
+     check(idle, "held: idle once released");
+
+     // holding RIGHT past the hold delay gives the hold event, once
+     press(RIGHT, BUTTON_TICKS(HOLD_MICROS) + BUTTON_TICKS(3000000), &e, &idle);
+     check(e.holds == 1, "hold: %u hold events", e.holds);
+     check(e.hold >= BUTTON_TICKS(HOLD_MICROS) &&
+	   e.hold <= BUTTON_TICKS(HOLD_MICROS) + BOUNCE_TICKS + BUTTON_DEBOUNCE_TICKS,
+	   "hold: hold event at %ld ticks, hold delay %d", e.hold, BUTTON_TICKS(HOLD_MICROS));
+
+     // holding another button as long does not
+     press(LEFT, BUTTON_TICKS(HOLD_MICROS) + BUTTON_TICKS(1000000), &e, &idle);
+     check(e.holds == 0 && e.others == 0, "hold: no hold event for another button");
+
+     // a clear reports the button still down again; a delay holds off the
+     // next repeat
+     for (i = 0; i < 10; i++)
+	  debounce.tick(1 << DOWN);
+     debounce.clear();
+     for (i = 0, e.presses = 0; i < 5; i++)
+	  count(&e, debounce.tick(1 << DOWN), DOWN, i);
+     check(e.presses == 1, "clear: a button still down is pressed again");
+     debounce.delayRepeat(SLOW_MICROS * 2);
+     for (i = 0, e.repeats = 0; i < (unsigned)slow + 5; i++)
+	  count(&e, debounce.tick(1 << DOWN), DOWN, i);
+     check(e.repeats == 0, "delay: no repeat within the delay");
+     for (i = 0; i < 10; i++)
+	  debounce.tick(0);
+     check(debounce.isIdle(), "idle once released");
+
+     printf("worst press latency %.1f ms, whatever the main loop is doing\n",
+	    latency * BUTTON_TICK_MICROS / 1000.0);
+
+     return(failures ? 1 : 0);
+}
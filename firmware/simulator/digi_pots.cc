@@ -0,0 +1,306 @@
+// digi_pots.cc
+// Run the digipot writes of SoftI2cManager, clocked a tick at a time as
+// the Timer 2 interrupt clocks them, against models of the MCP4018 pots
+// on the bus: one on the data line of each axis, all on one clock line.
+// A model main loop queues values for random axes between runs of ticks.
+// Each pot must end up with the last value queued for it, every transfer
+// must be well formed for every pot -- data changing only while the clock
+// is low, except at a start or a stop -- and nothing may drive a data
+// line against a pot acknowledging.  A pot which does not answer must be
+// counted as an error without holding up the others.
+//
+// Then run the motor current policy of MotorCurrent.hh through a move:
+// boosted as soon as it accelerates, down to the cruise current only
+// after the hold time, and to idle only after standing still.
+//
+// Prints the ticks a value takes on the bus, against the main loop time
+// the blocking writes took.
+// Exits non-zero on failure.
+//
+// Usage: digi_pots
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "SoftI2cManager.hh"
+#include "MotorCurrent.hh"
+
+#define PASSES 20000
+#define POTS   STEPPER_COUNT
+#define SCL    5
+
+// An MCP4018 on one data line
+struct Pot {
+     bool present;
+     enum { IDLE, ADDRESS, DATA, IGNORE } state;
+     uint8_t bits;       // clocks of the byte so far; 9 with the acknowledge
+     uint8_t byte;
+     bool ack;           // pulling the data line low
+     uint8_t value;      // the wiper
+     unsigned writes;
+     unsigned protocol_errors;
+};
+
+static Pot pots[POTS];
+
+// what the master drives
+static bool line_out[POTS + 1], line_value[POTS + 1];
+static bool scl = true, sda[POTS];
+static unsigned contention;
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static bool level(uint8_t i)
+{
+     if (pots[i].ack)
+	  return false;
+     // the pins have pull ups
+     return line_out[i] ? line_value[i] : true;
+}
+
+// The data line of a pot changed
+static void data_edge(uint8_t i, bool high)
+{
+     Pot& p = pots[i];
+
+     if (!scl)
+	  return;
+     if (!high) {
+	  // start; one in the middle of a transfer is an error here
+	  if (p.state != Pot::IDLE && p.state != Pot::IGNORE)
+	       p.protocol_errors++;
+	  p.state = Pot::ADDRESS;
+	  p.bits = 0;
+	  p.byte = 0;
+     } else {
+	  // stop, which should come in the first clock after the value
+	  if (p.state != Pot::IDLE && p.state != Pot::IGNORE &&
+	      (p.state == Pot::ADDRESS || p.bits > 1))
+	       p.protocol_errors++;
+	  p.state = Pot::IDLE;
+     }
+}
+
+// The clock changed
+static void clock_edge(uint8_t i, bool high)
+{
+     Pot& p = pots[i];
+
+     if (p.state == Pot::IDLE || p.state == Pot::IGNORE)
+	  return;
+     if (high) {
+	  if (p.bits < 8)
+	       p.byte = (p.byte << 1) | (sda[i] ? 1 : 0);
+	  if (p.bits < 8 || p.ack)
+	       p.bits++;
+     } else if (p.bits == 8 && !p.ack) {
+	  // the eighth bit is in: acknowledge it, or leave the bus
+	  if (p.state == Pot::ADDRESS) {
+	       if (p.present && p.byte == (DIGI_POT_I2C_ADDRESS | I2C_WRITE))
+		    p.ack = true;
+	       else
+		    p.state = Pot::IGNORE;
+	  } else {
+	       p.ack = true;
+	       p.value = p.byte;
+	       p.writes++;
+	  }
+     } else if (p.bits == 9) {
+	  // end of the acknowledge
+	  p.ack = false;
+	  p.bits = 0;
+	  p.byte = 0;
+	  p.state = Pot::DATA;
+     }
+}
+
+// Settles the lines after a change, giving the pots their edges
+static void settle(void)
+{
+     uint8_t i;
+
+     for (i = 0; i < POTS; i++) {
+	  bool now = level(i);
+	  if (now != sda[i]) {
+	       sda[i] = now;
+	       data_edge(i, now);
+	  }
+     }
+     bool clock = line_value[SCL];
+     if (clock != scl) {
+	  scl = clock;
+	  for (i = 0; i < POTS; i++)
+	       clock_edge(i, clock);
+	  for (i = 0; i < POTS; i++)
+	       sda[i] = level(i);
+     }
+     // the master must not drive high against an acknowledge while it is read
+     for (i = 0; i < POTS; i++)
+	  if (scl && pots[i].ack && line_out[i] && line_value[i])
+	       contention++;
+}
+
+void potsim_set(uint8_t line, bool out, bool value)
+{
+     line_out[line] = out;
+     line_value[line] = value;
+     settle();
+}
+
+bool potsim_get(uint8_t line)
+{
+     return line == SCL ? scl : sda[line];
+}
+
+static void reset_pots(void)
+{
+     uint8_t i;
+
+     for (i = 0; i < POTS; i++) {
+	  pots[i].present = true;
+	  pots[i].state = Pot::IDLE;
+	  pots[i].bits = pots[i].byte = 0;
+	  pots[i].ack = false;
+	  pots[i].value = 0;
+	  sda[i] = true;
+	  pots[i].writes = pots[i].protocol_errors = 0;
+     }
+}
+
+// Ticks until the writes are out; returns the ticks
+static unsigned long drain(SoftI2cManager& bus)
+{
+     unsigned long ticks = 0;
+
+     while (bus.isBusy() && ticks < 1000000) {
+	  bus.doInterrupt();
+	  ticks++;
+     }
+     return ticks;
+}
+
+static void check_policy(void)
+{
+     MotorCurrentPolicy policy;
+     micros_t t = 5000000;
+     bool ok = true;
+     unsigned i;
+
+     // a move: accelerate, cruise, decelerate, stop
+     ok = ok && policy.update(MOTION_ACCEL, t) == MOTOR_CURRENT_BOOST;
+     for (i = 0; i < 10; i++) {
+	  t += 10000;
+	  ok = ok && policy.update(MOTION_CRUISE, t) == MOTOR_CURRENT_BOOST;
+     }
+     check(ok, "policy: boosted from the acceleration on, through the hold");
+     t += MOTOR_CURRENT_HOLD_MICROS;
+     check(policy.update(MOTION_CRUISE, t) == MOTOR_CURRENT_CRUISE,
+	   "policy: cruise current once the hold is over");
+     check(policy.update(MOTION_ACCEL, t + 1000) == MOTOR_CURRENT_BOOST,
+	   "policy: boosted again as soon as it decelerates");
+     t += 1000;
+
+     // standing still: the boost drops after the hold, idle only after a while
+     ok = true;
+     for (i = 1; i * 10000 < MOTOR_CURRENT_IDLE_MICROS; i++) {
+	  uint8_t want = i * 10000 < MOTOR_CURRENT_HOLD_MICROS ? MOTOR_CURRENT_BOOST :
+	       MOTOR_CURRENT_CRUISE;
+	  ok = ok && policy.update(MOTION_IDLE, t + i * 10000) == want;
+     }
+     check(ok, "policy: not idle until standing still for the idle time");
+     check(policy.update(MOTION_IDLE, t + MOTOR_CURRENT_IDLE_MICROS) == MOTOR_CURRENT_IDLE,
+	   "policy: idle current once standing still");
+     check(policy.update(MOTION_ACCEL, t + MOTOR_CURRENT_IDLE_MICROS + 10) == MOTOR_CURRENT_BOOST,
+	   "policy: boosted straight from idle");
+}
+
+int main(void)
+{
+     SoftI2cManager& bus = SoftI2cManager::getI2cManager();
+     uint8_t last[POTS];
+     unsigned long ticks = 0, transfers = 0, values = 0;
+     unsigned bad, errors, pass, i;
+
+     srand(49);
+     bus.init();
+     // setting the pins up may look like a start and a stop to the pots
+     reset_pots();
+
+     for (i = 0; i < POTS; i++) {
+	  last[i] = rand() % 128;
+	  bus.queueWrite(i, last[i]);
+	  values++;
+     }
+     for (pass = 0; pass < PASSES; pass++) {
+	  unsigned n = rand() % 3, t = rand() % 80;
+
+	  while (n-- > 0) {
+	       i = rand() % POTS;
+	       last[i] = rand() % 128;
+	       bus.queueWrite(i, last[i]);
+	       values++;
+	  }
+	  while (t-- > 0) {
+	       bool busy = bus.isBusy();
+	       bus.doInterrupt();
+	       if (busy)
+		    ticks++;
+	  }
+     }
+     ticks += drain(bus);
+     for (i = 0, bad = 0, errors = 0; i < POTS; i++) {
+	  if (pots[i].value != last[i])
+	       bad++;
+	  errors += pots[i].protocol_errors;
+	  transfers += pots[i].writes;
+     }
+     check(bad == 0, "%u of %u pots without the last value queued", bad, POTS);
+     check(errors == 0, "%u malformed transfers", errors);
+     check(contention == 0, "%u times driving against an acknowledge", contention);
+     check(bus.getErrorCount() == 0, "%u writes not acknowledged", bus.getErrorCount());
+     check(transfers <= values, "%lu values queued, %lu written", values, transfers);
+
+     // a missing pot is counted and does not hold up the rest
+     pots[4].present = false;
+     for (i = 0; i < POTS; i++) {
+	  last[i] = 100 + i;
+	  bus.queueWrite(i, last[i]);
+     }
+     drain(bus);
+     for (i = 0, bad = 0, errors = 0; i < 4; i++) {
+	  if (pots[i].value != last[i])
+	       bad++;
+	  errors += pots[i].protocol_errors;
+     }
+     check(bad == 0 && errors == 0 && pots[4].value != last[4],
+	   "missing pot: the others written, %u malformed", errors);
+     check(bus.getErrorCount() == 1, "missing pot: %u writes not acknowledged",
+	   bus.getErrorCount());
+     check(!bus.isBusy() && scl && sda[0] && sda[4], "missing pot: the bus is left idle");
+
+     check_policy();
+
+     printf("bus ticks a pot value: %.1f (100us each, from the interrupt), "
+	    "main loop: 0, against 88us or more a pot blocking\n",
+	    (double)ticks / transfers);
+
+     return(failures ? 1 : 0);
+}
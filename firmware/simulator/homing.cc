@@ -0,0 +1,429 @@
+// homing.cc
+// Run the homing of Homing.hh through models of the axes of a Replicator 2
+// and their minimum endstops: each is a switch which closes where the axis
+// reaches it, is read closed a random time of up to LATENCY_S later, and
+// opens again once the axis has moved HYSTERESIS_MM back off it.  The moves
+// of each phase are modelled as Steppers.cc plans them and StepperAccel.cc
+// steps them: the approach accelerates at the planner's acceleration and
+// decelerates at it once an endstop is read closed; seek and probe step at
+// a steady rate, each axis stopping on the step its endstop reads closed;
+// the backoff steps at a steady rate.
+//
+// Homes from positions all along the axes, and from on the switches, and
+// checks that every axis ends where its switch is, to within what the
+// probe travels in LATENCY_S, that the approach stops within the
+// overtravel of the switches, that the backoff clears them, that axes
+// homed together are all found by approaches, and that axes an approach
+// does not reach are sought the old way, each to its own switch.  Without
+// acceleration homing is one seek.
+//
+// Prints the time homing takes and how repeatable it is, against one seek
+// at the speed asked for, as it was.
+// Exits non-zero on failure.
+//
+// Usage: homing
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "Homing.hh"
+
+#define AXES		3
+#define RUNS		300
+
+// The switches
+#define LATENCY_S	0.001
+#define HYSTERESIS_MM	0.5
+
+// The planner, from the defaults of EepromMap.hh
+#define P_ACCELERATION	2000.0	// mm/s^2
+#define JERK_MM_S	10.0	// max_speed_change
+
+struct Axis {
+     const char *name;
+     double spm;		// steps/mm
+     double accel;		// mm/s^2
+     double length;		// mm
+     double speed;		// homing speed asked for, mm/s
+     long pos;			// steps from the switch, which is at 0
+     bool closed;
+     double closed_at, latency;
+     long overtravel;		// most steps past the switch in an approach
+};
+
+static Axis axes[AXES] = {
+     { "X", 88.573186, 1000, 285, 2500.0 / 60 },
+     { "Y", 88.573186, 1000, 150, 2500.0 / 60 },
+     { "Z", 400.0,      150, 160, 1100.0 / 60 },
+};
+
+static double now;
+static int failures = 0;
+
+// The switches which end a move, as st_homing_approach() sets them
+static uint8_t approach_endstops = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static void step_axis(Axis& a, int dir)
+{
+     a.pos += dir;
+     if (!a.closed && a.pos <= 0) {
+	  a.closed = true;
+	  a.closed_at = now;
+	  a.latency = LATENCY_S * rand() / RAND_MAX;
+     } else if (a.closed && a.pos > HYSTERESIS_MM * a.spm) {
+	  a.closed = false;
+     }
+}
+
+static bool reads_closed(const Axis& a)
+{
+     return a.closed && now >= a.closed_at + a.latency;
+}
+
+// us per step asked for, along the first of mask as Command.cc passes it
+static uint32_t us_per_step(uint8_t mask)
+{
+     uint8_t i = 0;
+
+     while (!(mask & (1 << i)))
+	  i++;
+     return (uint32_t)(1000000.0 / (axes[i].speed * axes[i].spm));
+}
+
+// The speed asked for, in mm/s, as Steppers.cc works it out
+static double host_speed(uint8_t mask, uint32_t us)
+{
+     uint8_t i = 0;
+
+     while (!(mask & (1 << i)))
+	  i++;
+     return 1000000.0 / ((double)us * axes[i].spm);
+}
+
+static double min_accel(uint8_t mask)
+{
+     double a = P_ACCELERATION;
+
+     for (uint8_t i = 0; i < AXES; i++)
+	  if ((mask & (1 << i)) && axes[i].accel < a)
+	       a = axes[i].accel;
+     return a;
+}
+
+// An accelerated move of steps[] towards the switches, as the planner plans it,
+// cut short when one reads closed.  Returns the axes whose switches did.
+static uint8_t approach(uint8_t mask, uint32_t us)
+{
+     long steps[AXES], counter[AXES], master = 0, n = 0;
+     double d2 = 0;
+     uint8_t i, triggered = 0;
+
+     for (i = 0; i < AXES; i++) {
+	  steps[i] = 0;
+	  if (mask & (1 << i)) {
+	       steps[i] = homingApproachSteps((long)(axes[i].length * axes[i].spm));
+	       d2 += (steps[i] / axes[i].spm) * (steps[i] / axes[i].spm);
+	       axes[i].overtravel = 0;
+	  }
+	  if (steps[i] > master)
+	       master = steps[i];
+     }
+     double distance = sqrt(d2);
+     double speed = homingApproachSpeed(host_speed(mask, us), min_accel(mask));
+     double nominal = speed * master / distance;
+     double accel = P_ACCELERATION * master / distance;
+     for (i = 0; i < AXES; i++)
+	  if (steps[i] && accel * steps[i] / master > axes[i].accel * axes[i].spm)
+	       accel = axes[i].accel * axes[i].spm * master / steps[i];
+     double initial = JERK_MM_S * master / distance;
+     if (initial > nominal)
+	  initial = nominal;
+
+     long total = master;
+     long decel_after = total - homingStopSteps((uint32_t)nominal, (uint32_t)initial, (uint32_t)accel);
+     bool decel = false;
+     long n0 = 0;
+     double r0 = 0, rate = initial;
+
+     for (i = 0; i < AXES; i++)
+	  counter[i] = -master / 2;
+     while (n < total) {
+	  for (i = 0; i < AXES; i++) {
+	       counter[i] += steps[i];
+	       if (counter[i] > 0) {
+		    counter[i] -= master;
+		    step_axis(axes[i], -1);
+	       }
+	  }
+	  n++;
+	  now += 1.0 / rate;
+	  for (i = 0; i < AXES; i++) {
+	       if (!(mask & (1 << i)) || !reads_closed(axes[i]))
+		    continue;
+	       if (!triggered) {
+		    long stop = n + homingStopSteps((uint32_t)rate, (uint32_t)initial, (uint32_t)accel);
+		    if (stop < total)
+			 total = stop;
+		    if (!decel) {
+			 decel = true;
+			 n0 = n;
+			 r0 = rate;
+		    }
+	       }
+	       triggered |= 1 << i;
+	  }
+	  if (!decel && n >= decel_after) {
+	       decel = true;
+	       n0 = n;
+	       r0 = rate;
+	  }
+	  if (decel) {
+	       double r2 = r0 * r0 - 2 * accel * (n - n0);
+	       rate = r2 > initial * initial ? sqrt(r2) : initial;
+	  } else {
+	       rate = sqrt(initial * initial + 2 * accel * n);
+	       if (rate > nominal)
+		    rate = nominal;
+	  }
+     }
+     for (i = 0; i < AXES; i++)
+	  if ((mask & (1 << i)) && -axes[i].pos > axes[i].overtravel)
+	       axes[i].overtravel = -axes[i].pos;
+     return triggered;
+}
+
+// Seek or probe: a steady rate, each axis stopping on the step its switch
+// reads closed; a switch left in approach_endstops stops them all
+static void probe(uint8_t mask, uint32_t us)
+{
+     uint8_t i, running = mask;
+
+     while (running) {
+	  for (i = 0; i < AXES; i++) {
+	       if (!(running & (1 << i)))
+		    continue;
+	       if (reads_closed(axes[i]) && (approach_endstops & (1 << i)))
+		    running = 0;
+	       else if (reads_closed(axes[i]))
+		    running &= ~(1 << i);
+	       else
+		    step_axis(axes[i], -1);
+	  }
+	  now += us / 1000000.0;
+     }
+}
+
+static void backoff(uint8_t mask, uint32_t us)
+{
+     long steps[AXES], counter[AXES], master = 0, n;
+     uint8_t i;
+
+     for (i = 0; i < AXES; i++) {
+	  steps[i] = (mask & (1 << i)) ? (long)(HOMING_BACKOFF_MM * axes[i].spm) : 0;
+	  if (steps[i] > master)
+	       master = steps[i];
+     }
+     for (i = 0; i < AXES; i++)
+	  counter[i] = -master / 2;
+     for (n = 0; n < master; n++) {
+	  for (i = 0; i < AXES; i++) {
+	       counter[i] += steps[i];
+	       if (counter[i] > 0) {
+		    counter[i] -= master;
+		    step_axis(axes[i], 1);
+	       }
+	  }
+	  now += us / 1000000.0;
+     }
+}
+
+struct Result {
+     double time;
+     uint8_t phases;		// bits of the phases run
+     bool cleared;		// every backoff left the switches open
+     bool sought;		// every seek reached the switches
+};
+
+static Result home(uint8_t mask, bool acceleration)
+{
+     HomingSequence sequence;
+     uint32_t us = us_per_step(mask);
+     Result r = { 0, 0, true, true };
+     double start = now;
+
+     bool accelerated = acceleration &&
+	  homingApproachSpeed(host_speed(mask, us), min_accel(mask)) > host_speed(mask, us);
+     uint8_t phase = sequence.start(mask, accelerated);
+
+     while (phase != HOMING_IDLE) {
+	  uint8_t moving = sequence.moving(), triggered = 0;
+
+	  r.phases |= 1 << phase;
+	  // as Steppers.cc startHomingPhase()
+	  approach_endstops = (phase == HOMING_APPROACH) ? moving : 0;
+	  switch (phase) {
+	  case HOMING_APPROACH:
+	       triggered = approach(moving, us);
+	       break;
+	  case HOMING_SEEK:
+	       probe(moving, us);
+	       for (uint8_t i = 0; i < AXES; i++)
+		    if ((moving & (1 << i)) && !axes[i].closed)
+			 r.sought = false;
+	       break;
+	  case HOMING_BACKOFF:
+	       backoff(moving, us);
+	       for (uint8_t i = 0; i < AXES; i++)
+		    if ((moving & (1 << i)) && axes[i].closed)
+			 r.cleared = false;
+	       break;
+	  case HOMING_PROBE:
+	       probe(moving, us * HOMING_PROBE_DIVISOR);
+	       break;
+	  }
+	  phase = sequence.next(triggered);
+     }
+     r.time = now - start;
+     return r;
+}
+
+static void place(Axis& a, double mm)
+{
+     a.pos = (long)(mm * a.spm);
+     a.closed = a.pos <= 0;
+     a.closed_at = -1;
+     a.latency = 0;
+}
+
+// Homes each axis alone from all along it, with and without the new homing
+static void check_axis(uint8_t axis)
+{
+     Axis& a = axes[axis];
+     double t_new = 0, t_old = 0;
+     long lo_new = 1000000, hi_new = -1000000, lo_old = 1000000, hi_old = -1000000;
+     long overtravel = 0;
+     bool cleared = true, probed = true;
+     int run;
+
+     for (run = 0; run < RUNS; run++) {
+	  // a few start on the switch
+	  double start = (run % 10 == 0) ? -HOMING_OVERTRAVEL_MM * rand() / RAND_MAX :
+	       a.length * rand() / RAND_MAX;
+
+	  place(a, start);
+	  Result r = home(1 << axis, true);
+	  t_new += r.time;
+	  cleared = cleared && r.cleared;
+	  probed = probed && (r.phases & (1 << HOMING_PROBE));
+	  if (a.pos < lo_new) lo_new = a.pos;
+	  if (a.pos > hi_new) hi_new = a.pos;
+	  if (a.overtravel > overtravel)
+	       overtravel = a.overtravel;
+
+	  place(a, start);
+	  r = home(1 << axis, false);
+	  t_old += r.time;
+	  if (a.pos < lo_old) lo_old = a.pos;
+	  if (a.pos > hi_old) hi_old = a.pos;
+     }
+
+     uint32_t us = us_per_step(1 << axis);
+     double probe_steps = LATENCY_S * 1000000.0 / (us * HOMING_PROBE_DIVISOR);
+     double approach = homingApproachSpeed(a.speed, a.accel);
+     double latency_steps = LATENCY_S * approach * a.spm;
+
+     check(probed, "%s: backed off and probed every time", a.name);
+     check(hi_new <= 0 && lo_new >= -(long)ceil(probe_steps),
+	   "%s: ends %ld to %ld steps from the switch, within %.1f", a.name,
+	   lo_new, hi_new, probe_steps);
+     check(overtravel <= HOMING_OVERTRAVEL_MM * a.spm + latency_steps + 2,
+	   "%s: approach at %.1f mm/s overtravels %.2f mm, at most %d mm and the latency",
+	   a.name, approach, overtravel / a.spm, HOMING_OVERTRAVEL_MM);
+     check(cleared, "%s: the backoff clears the switch", a.name);
+     check(t_new < t_old, "%s: %.2f s to home, against %.2f s seeking at %.1f mm/s",
+	   a.name, t_new / RUNS, t_old / RUNS, a.speed);
+     printf("%s: repeatable to %ld steps, against %ld seeking\n", a.name,
+	    hi_new - lo_new, hi_old - lo_old);
+}
+
+int main(void)
+{
+     int run;
+     bool ok;
+
+     srand(50);
+
+     check_axis(0);
+     check_axis(1);
+     check_axis(2);
+
+     // X and Y together, from anywhere: both found, however far apart, each
+     // by an approach
+     double t_new = 0, t_old = 0;
+     ok = true;
+     for (run = 0; run < RUNS; run++) {
+	  double x = axes[0].length * rand() / RAND_MAX, y = axes[1].length * rand() / RAND_MAX;
+	  place(axes[0], x);
+	  place(axes[1], y);
+	  t_old += home(3, false).time;
+	  place(axes[0], x);
+	  place(axes[1], y);
+	  Result r = home(3, true);
+	  t_new += r.time;
+	  long tolerance = 1 + (long)(LATENCY_S * 1000000.0 / (us_per_step(3) * HOMING_PROBE_DIVISOR));
+	  ok = ok && r.cleared && (r.phases & (1 << HOMING_PROBE)) &&
+	       axes[0].pos <= 0 && axes[0].pos >= -tolerance &&
+	       axes[1].pos <= 0 && axes[1].pos >= -tolerance;
+     }
+     check(ok, "XY: both found and probed from %d starts", RUNS);
+     check(t_new < t_old, "XY: %.2f s to home, against %.2f s seeking",
+	   t_new / RUNS, t_old / RUNS);
+
+     // Z from further than an accelerated block reaches: sought the old way
+     place(axes[2], (HOMING_APPROACH_MAX_STEPS + 4000) / axes[2].spm);
+     Result r = home(4, true);
+     check((r.phases & (1 << HOMING_SEEK)) && (r.phases & (1 << HOMING_PROBE)) &&
+	   axes[2].pos <= 0 && axes[2].pos > -4,
+	   "Z: out of reach of the approach, sought, then probed, ends at %ld", axes[2].pos);
+
+     // X and Y both beyond what the approach covers, at different distances:
+     // the seek carries on for X once Y's switch closes
+     place(axes[0], axes[0].length * 1.125 + 60);
+     place(axes[1], axes[1].length * 1.125 + 20);
+     r = home(3, true);
+     long tolerance = 1 + (long)(LATENCY_S * 1000000.0 / (us_per_step(3) * HOMING_PROBE_DIVISOR));
+     check((r.phases & (1 << HOMING_SEEK)) && r.sought && (r.phases & (1 << HOMING_PROBE)) &&
+	   axes[0].pos <= 0 && axes[0].pos >= -tolerance &&
+	   axes[1].pos <= 0 && axes[1].pos >= -tolerance,
+	   "XY: out of reach of the approach, both sought, then probed, end at %ld and %ld",
+	   axes[0].pos, axes[1].pos);
+
+     // Without acceleration, one seek as before
+     place(axes[0], 100);
+     r = home(1, false);
+     check(r.phases == (1 << HOMING_SEEK), "without acceleration: only the seek");
+
+     // Slower than asked for the approach is not worth it
+     check(homingApproachSpeed(100, 1000) < 100, "approach no faster than it can stop");
+
+     return(failures ? 1 : 0);
+}
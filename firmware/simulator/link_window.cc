@@ -0,0 +1,535 @@
+// link_window.cc
+// Send a build over a pseudo terminal to an emulated bot, one packet at a
+// time and then with the windowed link protocol, and check that the bot
+// queues exactly the commands of the build, in order, once each.
+//
+// The bot is the firmware's own packet code and LinkWindow, answering
+// packets the way host::runHostSlice() does, with a command buffer which
+// drains at a set rate.  Its responses reach the host a few milliseconds
+// late, as they do through the USB to serial bridge.  The windowed run is
+// then repeated with bytes dropped and damaged on the way to the bot,
+// responses lost on the way back, and a slowly draining command buffer.
+// That run is in one thread on a simulated clock, with the bot given the
+// sender's bytes straight away and the losses drawn from the bot's own
+// random numbers, so that each seed goes the same way every time.
+//
+// Last, the build is sent in packets of up to MAX_PACKET_PAYLOAD bytes and
+// then of up to MAX_IN_PACKET_PAYLOAD bytes, several commands to a packet,
+// as fast as the pseudo terminal goes and at 115200 baud, and the bytes a
+// second of each are compared.
+// Exits non-zero on failure.
+//
+// Usage: link_window [s3g-file]
+//
+//   s3g-file defaults to box.s3g
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <termios.h>
+#include <pthread.h>
+#include <time.h>
+#include <deque>
+#include <vector>
+
+#include "Packet.hh"
+#include "Commands.hh"
+#include "LinkWindow.hh"
+#include "s3g.h"
+#include "s3g_window.h"
+
+// Commands of the build to send
+#define COMMANDS 1000
+
+// Round trip through the USB to serial bridge
+#define LATENCY_US 4000
+
+// Runs of the lossy line, each with its own seed
+#define LOSSY_SEEDS 20
+
+// Bytes of a build a second at 115200 baud, with no packets at all
+#define LINE_RATE (115200 / 10)
+
+// As in Host.cc and Command.cc
+#define PACKET_TIMEOUT_US 200000
+#define COMMAND_BUFFER_SIZE 512
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static uint64_t now_us(void)
+{
+     struct timespec ts;
+
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+typedef struct {
+     uint64_t             due;
+     std::vector<uint8_t> bytes;
+} response_t;
+
+typedef struct {
+     // how the bot behaves
+     int      fd;
+     bool     windowed;          // knows HOST_CMD_LINK_VERSION
+     unsigned drain_per_ms;      // command bytes executed a millisecond
+     unsigned drop_in;           // 1 in n bytes to the bot lost, or 0
+     unsigned flip_in;           // 1 in n bytes to the bot damaged, or 0
+     unsigned drop_out;          // 1 in n responses lost, or 0
+     unsigned baud;              // speed of the line to the bot, or 0
+     bool     simulated;         // on the simulated clock, not the pty
+     uint32_t random;            // state of its random numbers
+     volatile int stop;
+
+     // what it did
+     InPacket             in;
+     LinkWindow           window;
+     std::vector<uint8_t> queued;     // every command byte pushed
+     unsigned             buffered;   // of those, not yet executed
+     std::deque<response_t> responses;
+     uint64_t             now;        // the simulated clock
+     uint64_t             started;    // when the packet being read started
+     uint64_t             drained;    // when the command buffer last drained
+     uint32_t             packet_errors;
+     uint32_t             overflows;
+     uint32_t             repeats;
+     uint32_t             bad_crcs;
+} bot_t;
+
+static uint64_t bot_now(const bot_t *bot)
+{
+     return bot->simulated ? bot->now : now_us();
+}
+
+// xorshift32, advanced for each byte and response the bot sees
+static uint32_t bot_random(bot_t *bot)
+{
+     uint32_t x = bot->random;
+
+     x ^= x << 13;
+     x ^= x >> 17;
+     x ^= x << 5;
+     return bot->random = x;
+}
+
+static bool one_in(bot_t *bot, unsigned n)
+{
+     return n != 0 && bot_random(bot) % n == 0;
+}
+
+// As host::runHostSlice() and processCommandPacket()
+static void answer(bot_t *bot)
+{
+     InPacket& in = bot->in;
+     OutPacket out;
+     LinkWindow::Verdict verdict = LinkWindow::NEW;
+     uint8_t command = in.read8(0);
+
+     out.reset();
+     if (in.isWindowed())
+	  verdict = bot->window.classify(in.getSequence());
+     if (verdict == LinkWindow::OUT_OF_WINDOW) {
+	  out.append8(RC_PACKET_ERROR);
+	  bot->packet_errors++;
+     } else if (verdict == LinkWindow::REPEAT && (command & 0x80) != 0) {
+	  out.append8(RC_OK);
+	  bot->repeats++;
+     } else if ((command & 0x80) != 0) {
+	  if (COMMAND_BUFFER_SIZE - bot->buffered >= in.getLength()) {
+	       for (uint8_t i = 0; i < in.getLength(); i++)
+		    bot->queued.push_back(in.read8(i));
+	       bot->buffered += in.getLength();
+	       out.append8(RC_OK);
+	  } else {
+	       out.append8(RC_BUFFER_OVERFLOW);
+	       bot->overflows++;
+	  }
+     } else if (command == HOST_CMD_GET_BUFFER_SIZE) {
+	  out.append8(RC_OK);
+	  out.append32(COMMAND_BUFFER_SIZE - bot->buffered);
+     } else if (command == HOST_CMD_LINK_VERSION && bot->windowed) {
+	  // as host::handleLinkVersion()
+	  uint8_t version = in.getLength() > 1 ? in.read8(1) : LINK_VERSION_BASIC;
+	  if (version > LINK_VERSION_WINDOWED)
+	       version = LINK_VERSION_WINDOWED;
+	  bot->window.reset();
+	  out.append8(RC_OK);
+	  out.append8(version);
+	  out.append8(LINK_WINDOW_SIZE);
+	  out.append16(COMMAND_BUFFER_SIZE - bot->buffered);
+	  uint8_t max_payload = in.getLength() > 2 ? in.read8(2) : MAX_PACKET_PAYLOAD;
+	  in.setMaxLength(max_payload < MAX_PACKET_PAYLOAD ? MAX_PACKET_PAYLOAD : max_payload);
+	  out.append8(in.getMaxLength());
+     } else
+	  out.append8(RC_CMD_UNSUPPORTED);
+
+     if (in.isWindowed()) {
+	  if (verdict == LinkWindow::NEW && out.read8(0) != RC_BUFFER_OVERFLOW)
+	       bot->window.accept();
+	  out.setAck(bot->window.ackFor(verdict, in.getSequence()),
+		     COMMAND_BUFFER_SIZE - bot->buffered);
+     }
+     in.reset();
+
+     if (one_in(bot, bot->drop_out))
+	  return;
+     response_t r;
+     r.due = bot_now(bot) + LATENCY_US;
+     while (!out.isFinished())
+	  r.bytes.push_back(out.getNextByteToSend());
+     bot->responses.push_back(r);
+}
+
+// A byte off the line, which may be lost or damaged on the way
+static void bot_receive(bot_t *bot, uint8_t byte)
+{
+     if (one_in(bot, bot->drop_in))
+	  return;
+     if (one_in(bot, bot->flip_in))
+	  byte ^= 1 << (bot_random(bot) % 8);
+     if (!bot->in.isStarted())
+	  bot->started = bot_now(bot);
+     bot->in.processByte(byte);
+     if (bot->in.hasError()) {
+	  if (bot->in.getErrorCode() == PacketError::BAD_CRC)
+	       bot->bad_crcs++;
+	  bot->in.reset();
+     } else if (bot->in.isFinished())
+	  answer(bot);
+}
+
+// Time passing: a packet cut short times out, and the command buffer drains
+static void bot_tick(bot_t *bot)
+{
+     uint64_t now = bot_now(bot);
+
+     if (bot->in.isStarted() && !bot->in.isFinished() &&
+	 now - bot->started > PACKET_TIMEOUT_US)
+	  bot->in.reset();
+
+     unsigned done = (unsigned)((now - bot->drained) / 1000) * bot->drain_per_ms;
+     if (done > 0) {
+	  bot->buffered = done < bot->buffered ? bot->buffered - done : 0;
+	  bot->drained = now - (now - bot->drained) % 1000;
+     }
+}
+
+static void *run_bot(void *arg)
+{
+     bot_t *bot = (bot_t *)arg;
+     uint64_t line_free = 0;
+
+     bot->in.reset();
+     bot->drained = now_us();
+     while (!bot->stop) {
+	  uint8_t buf[64];
+	  struct pollfd pfd = { bot->fd, POLLIN, 0 };
+	  uint64_t now;
+	  ssize_t n;
+
+	  // bytes take this long to come in over the line
+	  n = 0;
+	  if (!bot->baud || line_free <= now_us()) {
+	       n = poll(&pfd, 1, 1);
+	       n = n > 0 ? read(bot->fd, buf, bot->baud ? 8 : sizeof(buf)) : 0;
+	  } else
+	       usleep(50);
+	  if (bot->baud && n > 0)
+	       line_free = now_us() + n * 10000000ULL / bot->baud;
+	  for (ssize_t i = 0; i < n; i++)
+	       bot_receive(bot, buf[i]);
+
+	  now = now_us();
+	  while (!bot->responses.empty() && bot->responses.front().due <= now) {
+	       std::vector<uint8_t>& bytes = bot->responses.front().bytes;
+	       if (write(bot->fd, &bytes[0], bytes.size()) < 0)
+		    perror("write");
+	       bot->responses.pop_front();
+	  }
+	  bot_tick(bot);
+     }
+     return NULL;
+}
+
+// The sender's io for a simulated bot: what the sender writes reaches the
+// bot at once, and reading moves the clock on to the next response due
+static uint64_t sim_now_us(void *ctx)
+{
+     return ((bot_t *)ctx)->now;
+}
+
+static int sim_write(void *ctx, const uint8_t *buf, size_t len)
+{
+     bot_t *bot = (bot_t *)ctx;
+
+     for (size_t i = 0; i < len; i++)
+	  bot_receive(bot, buf[i]);
+     return 0;
+}
+
+static int sim_read(void *ctx, uint8_t *buf, size_t len, int timeout_ms)
+{
+     bot_t *bot = (bot_t *)ctx;
+     uint64_t until = bot->now + (uint64_t)timeout_ms * 1000;
+     size_t n = 0;
+
+     if (bot->responses.empty() || bot->responses.front().due > until) {
+	  bot->now = until;
+	  bot_tick(bot);
+	  return 0;
+     }
+     if (bot->responses.front().due > bot->now)
+	  bot->now = bot->responses.front().due;
+     bot_tick(bot);
+     while (n < len && !bot->responses.empty() && bot->responses.front().due <= bot->now) {
+	  std::vector<uint8_t>& bytes = bot->responses.front().bytes;
+	  size_t take = bytes.size() < len - n ? bytes.size() : len - n;
+	  memcpy(buf + n, &bytes[0], take);
+	  bytes.erase(bytes.begin(), bytes.begin() + take);
+	  n += take;
+	  if (bytes.empty())
+	       bot->responses.pop_front();
+     }
+     return (int)n;
+}
+
+static void sim_sleep_ms(void *ctx, int ms)
+{
+     bot_t *bot = (bot_t *)ctx;
+
+     bot->now += (uint64_t)ms * 1000;
+     bot_tick(bot);
+}
+
+static void make_raw(int fd)
+{
+     struct termios tio;
+
+     tcgetattr(fd, &tio);
+     cfmakeraw(&tio);
+     tcsetattr(fd, TCSANOW, &tio);
+}
+
+// Send the build to a bot over a pseudo terminal
+// Returns the bytes sent a second, or 0 on failure
+static void setup(bot_t *bot, bool windowed, unsigned drain_per_ms, unsigned baud)
+{
+     bot->windowed = windowed;
+     bot->drain_per_ms = drain_per_ms;
+     bot->baud = baud;
+     bot->drop_in = bot->flip_in = bot->drop_out = 0;
+     bot->simulated = false;
+     bot->random = 1;
+     bot->in.setMaxLength(MAX_PACKET_PAYLOAD);
+}
+
+static void clear_counts(bot_t *bot)
+{
+     bot->queued.clear();
+     bot->buffered = 0;
+     bot->responses.clear();
+     bot->packet_errors = bot->overflows = bot->repeats = bot->bad_crcs = 0;
+}
+
+static double send_build(const std::vector<std::vector<uint8_t> >& build, bot_t *bot,
+			 s3g_window_t *win, uint8_t max_payload)
+{
+     int master, slave;
+     pthread_t thread;
+     double rate = 0;
+
+     master = posix_openpt(O_RDWR | O_NOCTTY);
+     if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0 ||
+	 (slave = open(ptsname(master), O_RDWR | O_NOCTTY)) < 0) {
+	  perror("pseudo terminal");
+	  return 0;
+     }
+     make_raw(master);
+     make_raw(slave);
+
+     bot->fd = master;
+     bot->stop = 0;
+     clear_counts(bot);
+     pthread_create(&thread, NULL, run_bot, bot);
+
+     if (s3g_window_open(win, slave, max_payload, 1000) == 0) {
+	  uint64_t start = now_us();
+	  size_t bytes = 0;
+	  bool ok = true;
+	  for (size_t i = 0; ok && i < build.size(); i++) {
+	       ok = s3g_window_send(win, &build[i][0], build[i].size()) == 0;
+	       bytes += build[i].size();
+	  }
+	  if (ok && s3g_window_flush(win, 10000) == 0)
+	       rate = bytes * 1e6 / (now_us() - start);
+     }
+
+     bot->stop = 1;
+     pthread_join(thread, NULL);
+     close(slave);
+     close(master);
+     return rate;
+}
+
+// Send the build to a simulated bot, seeding its random numbers with seed
+// Returns the bytes sent a second of simulated time, or 0 on failure
+static double send_build_simulated(const std::vector<std::vector<uint8_t> >& build, bot_t *bot,
+				   s3g_window_t *win, uint8_t max_payload, uint32_t seed)
+{
+     s3g_window_io_t io = { bot, sim_now_us, sim_write, sim_read, sim_sleep_ms };
+     double rate = 0;
+
+     bot->simulated = true;
+     bot->random = seed;
+     bot->now = bot->started = bot->drained = 0;
+     bot->in.reset();
+     clear_counts(bot);
+
+     if (s3g_window_open_io(win, &io, max_payload, 1000) == 0) {
+	  uint64_t start = bot->now;
+	  size_t bytes = 0;
+	  bool ok = true;
+	  for (size_t i = 0; ok && i < build.size(); i++) {
+	       ok = s3g_window_send(win, &build[i][0], build[i].size()) == 0;
+	       bytes += build[i].size();
+	  }
+	  if (ok && s3g_window_flush(win, 10000) == 0 && bot->now > start)
+	       rate = bytes * 1e6 / (bot->now - start);
+     }
+     return rate;
+}
+
+static bool same_stream(const std::vector<std::vector<uint8_t> >& build, const bot_t *bot)
+{
+     std::vector<uint8_t> sent;
+
+     for (size_t i = 0; i < build.size(); i++)
+	  sent.insert(sent.end(), build[i].begin(), build[i].end());
+     return sent == bot->queued;
+}
+
+int main(int argc, const char *argv[])
+{
+     const char *filename = argc > 1 ? argv[1] : "box.s3g";
+     std::vector<std::vector<uint8_t> > build;
+     unsigned char raw[1024];
+     size_t len;
+
+     s3g_context_t *ctx = s3g_open(0, (void *)filename);
+     if (!ctx)
+	  return(1);
+     while (build.size() < COMMANDS &&
+	    s3g_command_read_ext(ctx, NULL, raw, sizeof(raw), &len) == 0) {
+	  // the few tool commands too long for one packet are not the point
+	  if (len > 0 && len <= MAX_PACKET_PAYLOAD)
+	       build.push_back(std::vector<uint8_t>(raw, raw + len));
+     }
+     s3g_close(ctx);
+     check(build.size() > 100, "%u commands read from %s", (unsigned)build.size(), filename);
+
+     check(S3G_LINK_WINDOW_START_BYTE == WINDOW_START_BYTE && S3G_LINK_RC_OK == RC_OK &&
+	   S3G_LINK_RC_PACKET_ERROR == RC_PACKET_ERROR &&
+	   S3G_LINK_RC_BUFFER_OVERFLOW == RC_BUFFER_OVERFLOW &&
+	   S3G_LINK_RC_CRC_MISMATCH == RC_CRC_MISMATCH,
+	   "sender constants match Packet.hh");
+
+     static s3g_window_t win;
+     double basic, windowed;
+     {
+	  // firmware from before the windowed protocol
+	  bot_t bot;
+	  setup(&bot, false, COMMAND_BUFFER_SIZE, 0);
+	  basic = send_build(build, &bot, &win, MAX_PACKET_PAYLOAD);
+	  check(!win.windowed, "old firmware is sent packets one at a time");
+	  check(basic > 0 && same_stream(build, &bot), "one at a time: stream intact, %.0f bytes/s",
+		basic);
+     }
+     {
+	  bot_t bot;
+	  setup(&bot, true, COMMAND_BUFFER_SIZE, 0);
+	  windowed = send_build(build, &bot, &win, MAX_PACKET_PAYLOAD);
+	  check(win.windowed && win.window == LINK_WINDOW_SIZE, "window of %u packets agreed",
+		win.window);
+	  check(windowed > 0 && same_stream(build, &bot), "windowed: stream intact, %.0f bytes/s",
+		windowed);
+	  check(win.retransmits == 0, "no packets sent again on a clean line (%u)",
+		win.retransmits);
+	  check(windowed > 2 * basic, "windowed is %.1f times as fast", windowed / basic);
+     }
+     {
+	  bot_t bot;
+	  unsigned intact = 0, retransmits = 0, repeats = 0, bad_crcs = 0, overflows = 0;
+	  double slowest = 0;
+	  for (uint32_t seed = 1; seed <= LOSSY_SEEDS; seed++) {
+	       setup(&bot, true, 8, 0);
+	       bot.drop_in = 3000;
+	       bot.flip_in = 3000;
+	       bot.drop_out = 100;
+	       double rate = send_build_simulated(build, &bot, &win, MAX_IN_PACKET_PAYLOAD, seed);
+	       if (rate > 0 && same_stream(build, &bot))
+		    intact++;
+	       if (slowest == 0 || rate < slowest)
+		    slowest = rate;
+	       retransmits += win.retransmits;
+	       repeats += bot.repeats;
+	       bad_crcs += bot.bad_crcs;
+	       overflows += bot.overflows;
+	  }
+	  check(intact == LOSSY_SEEDS, "lossy line, slow bot: stream intact for %u of %u seeds, "
+		"%.0f bytes/s at the slowest", intact, LOSSY_SEEDS, slowest);
+	  printf("     %u packets sent again, %u repeats, %u packets failed their CRC\n",
+		 retransmits, repeats, bad_crcs);
+	  check(retransmits > 0 && repeats > 0 && bad_crcs > 0, "losses were recovered from");
+	  check(overflows == 0, "credit kept the command buffer from overflowing");
+     }
+     {
+	  bot_t bot;
+	  setup(&bot, true, COMMAND_BUFFER_SIZE, 0);
+	  double packed = send_build(build, &bot, &win, MAX_IN_PACKET_PAYLOAD);
+	  check(win.max_payload == MAX_IN_PACKET_PAYLOAD, "%u byte payloads agreed",
+		win.max_payload);
+	  check(packed > 0 && same_stream(build, &bot),
+		"%u commands in %u packets: stream intact, %.0f bytes/s",
+		win.commands, win.packets, packed);
+	  check(packed > windowed, "%.1f times as fast as %u byte payloads", packed / windowed,
+		MAX_PACKET_PAYLOAD);
+     }
+     {
+	  bot_t bot;
+	  setup(&bot, true, COMMAND_BUFFER_SIZE, 115200);
+	  double small = send_build(build, &bot, &win, MAX_PACKET_PAYLOAD);
+	  check(small > 0 && same_stream(build, &bot),
+		"115200 baud, %u byte payloads: %.0f bytes/s, %.0f%% of the line",
+		MAX_PACKET_PAYLOAD, small, 100 * small / LINE_RATE);
+	  setup(&bot, true, COMMAND_BUFFER_SIZE, 115200);
+	  double large = send_build(build, &bot, &win, MAX_IN_PACKET_PAYLOAD);
+	  check(large > 0 && same_stream(build, &bot),
+		"115200 baud, %u byte payloads: %.0f bytes/s, %.0f%% of the line",
+		MAX_IN_PACKET_PAYLOAD, large, 100 * large / LINE_RATE);
+	  check(large > small, "less of the line spent on framing");
+     }
+
+     return(failures ? 1 : 0);
+}
@@ -0,0 +1,20 @@
+// Configuration.hh
+// The digipot bus for running SoftI2cManager on the host: the data lines
+// of the five axes, and the clock line they share.
+
+#ifndef POTSIM_CONFIGURATION_HH_
+#define POTSIM_CONFIGURATION_HH_
+
+#include "Pin.hh"
+
+#define STEPPER_COUNT 5
+#define MAX_STEPPERS  5
+
+#define X_POT_PIN Pin(0)
+#define Y_POT_PIN Pin(1)
+#define Z_POT_PIN Pin(2)
+#define A_POT_PIN Pin(3)
+#define B_POT_PIN Pin(4)
+#define POTS_SCL  Pin(5)
+
+#endif
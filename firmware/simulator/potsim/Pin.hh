@@ -0,0 +1,26 @@
+// Pin.hh
+// Stand-in for the pins of the digipot bus, so that SoftI2cManager can be
+// run on the host.  Each pin is a line of the simulated bus in
+// digi_pots.cc, which sees every change.
+
+#ifndef POTSIM_PIN_HH_
+#define POTSIM_PIN_HH_
+
+#include <stdint.h>
+
+void potsim_set(uint8_t line, bool out, bool value);
+bool potsim_get(uint8_t line);
+
+class Pin {
+public:
+     Pin() : line(0xff), out(false), value(false) {}
+     explicit Pin(uint8_t line_in) : line(line_in), out(false), value(false) {}
+     void setDirection(bool out_in) const { out = out_in; potsim_set(line, out, value); }
+     void setValue(bool value_in) const { value = value_in; potsim_set(line, out, value); }
+     bool getValue() const { return potsim_get(line); }
+private:
+     uint8_t line;
+     mutable bool out, value;
+};
+
+#endif
@@ -0,0 +1,507 @@
+// print_resume.cc
+// Check that an SD build can be resumed after a power loss, running the
+// checkpoint code against a simulated EEPROM and planner.  The build is
+// fed through the planner the way Command.cc feeds it, with blocks
+// finishing at random, and the power is cut at random points, including
+// part way through writing a record.  The latest checkpoint must sit on a
+// command boundary, must not be ahead of any move that was not made, and
+// must carry the state of the build at that boundary; playing the file on
+// from there must give the rest of the build.  Also checks a second power
+// loss after resuming, cancelled and finished builds, and EEPROM wear.
+// Exits non-zero on failure.
+//
+// Usage: print_resume [file.s3g]     (defaults to box.s3g)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <vector>
+
+#include "s3g_private.h"
+#include "s3g.h"
+#include "Checkpoint.hh"
+#include "EepromMap.hh"
+#include <avr/eeprom.h>
+
+#define BUILD_NAME "BOX.S3G"
+#define BLOCKS 16
+#define TRIALS 100
+
+uint8_t sdsim_eeprom[E2END + 1];
+uint32_t sdsim_eeprom_writes[E2END + 1];
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+// Build state as Command.cc keeps it
+typedef struct {
+     int32_t  position[STEPPER_COUNT];
+     uint8_t  tool;
+     uint16_t extruder_temp[2];
+     uint16_t platform_temp;
+     bool     fan;
+} state_t;
+
+typedef struct {
+     uint32_t offset;   // file offset of the command
+     bool     move;
+     state_t  after;    // state once the command is done
+} command_t;
+
+static std::vector<command_t> commands;
+static const uint8_t *file_data;
+static uint32_t file_size;
+
+// s3g file driver reading from memory
+typedef struct {
+     const uint8_t *data;
+     size_t         length;
+     size_t         offset;
+} memfile_t;
+
+static ssize_t memfile_read(void *ctx, unsigned char *buf, size_t maxbuf,
+			    size_t nbytes)
+{
+     memfile_t *f = (memfile_t *)ctx;
+
+     if (nbytes > maxbuf)
+	  nbytes = maxbuf;
+     if (nbytes > f->length - f->offset)
+	  nbytes = f->length - f->offset;
+     memcpy(buf, f->data + f->offset, nbytes);
+     f->offset += nbytes;
+     return((ssize_t)nbytes);
+}
+
+// Apply a command to the build state; returns true for a move
+static bool apply(state_t *st, const s3g_command_t *cmd)
+{
+     const int32_t *p;
+
+     switch (cmd->cmd_id)
+     {
+     case HOST_CMD_QUEUE_POINT_EXT :
+	  p = &cmd->t.queue_point_ext.x;
+	  for (int i = 0; i < STEPPER_COUNT; i++)
+	       st->position[i] = p[i];
+	  return(true);
+
+     case HOST_CMD_QUEUE_POINT_NEW :
+     case HOST_CMD_QUEUE_POINT_NEW_EXT :
+	  p = &cmd->t.queue_point_new.x;
+	  for (int i = 0; i < STEPPER_COUNT; i++)
+	       st->position[i] = (cmd->t.queue_point_new.rel & (1 << i)) ?
+		    st->position[i] + p[i] : p[i];
+	  return(true);
+
+     case HOST_CMD_SET_POSITION_EXT :
+	  p = &cmd->t.set_position_ext.x;
+	  for (int i = 0; i < STEPPER_COUNT; i++)
+	       st->position[i] = p[i];
+	  break;
+
+     case HOST_CMD_CHANGE_TOOL :
+	  st->tool = cmd->t.change_tool.index;
+	  break;
+
+     case HOST_CMD_TOOL_COMMAND :
+	  switch (cmd->t.tool.subcmd_id)
+	  {
+	  case SLAVE_CMD_SET_TEMP :
+	       st->extruder_temp[cmd->t.tool.index & 1] = cmd->t.tool.subcmd_value;
+	       break;
+	  case SLAVE_CMD_SET_PLATFORM_TEMP :
+	       st->platform_temp = cmd->t.tool.subcmd_value;
+	       break;
+	  case SLAVE_CMD_TOGGLE_FAN :
+	       st->fan = (cmd->t.tool.subcmd_value & 1) != 0;
+	       break;
+	  }
+	  break;
+     }
+     return(false);
+}
+
+// Offset of the command after commands[i]: where a build carries on
+static uint32_t next_offset(size_t i)
+{
+     return(i + 1 < commands.size() ? commands[i + 1].offset : file_size);
+}
+
+static bool parse(const uint8_t *data, size_t length)
+{
+     memfile_t f = { data, length, 0 };
+     s3g_context_t ctx;
+     s3g_command_t cmd;
+     state_t st;
+
+     memset(&ctx, 0, sizeof(ctx));
+     ctx.read  = memfile_read;
+     ctx.r_ctx = &f;
+     memset(&st, 0, sizeof(st));
+
+     for (;;)
+     {
+	  command_t c;
+
+	  c.offset = f.offset;
+	  int r = s3g_command_read(&ctx, &cmd);
+	  if (r == 1)
+	       break;
+	  if (r != 0)
+	       return(false);
+	  c.move  = apply(&st, &cmd);
+	  c.after = st;
+	  commands.push_back(c);
+     }
+     file_size = f.offset;
+     return(true);
+}
+
+static bool same_state(const state_t& a, const state_t& b)
+{
+     return(memcmp(a.position, b.position, sizeof(a.position)) == 0 &&
+	    a.tool == b.tool && a.extruder_temp[0] == b.extruder_temp[0] &&
+	    a.extruder_temp[1] == b.extruder_temp[1] &&
+	    a.platform_temp == b.platform_temp && a.fan == b.fan);
+}
+
+// A build in progress: commands are fed to a planner of BLOCKS blocks and
+// checkpointed as Command.cc does, while the steppers finish blocks at
+// random.
+typedef struct {
+     size_t   next;           // index of the next command
+     state_t  st;
+     uint8_t  queued;         // blocks in the planner, the running one included
+     uint8_t  done;           // blocks finished since the last sample
+     size_t   moves_issued;
+     size_t   moves_made;
+     size_t   takes;
+     bool     finished;       // the whole file has been read
+     bool     mid_record;     // the last slice wrote part of a record
+
+     // The latest checkpoint taken, and the one before it that must have
+     // been written out by now
+     uint32_t taken_offset;
+     size_t   taken_moves;    // moves to be made before it is written
+     long     taken_drained;  // slice the moves were made in, or -1
+     uint32_t durable_offset;
+} build_t;
+
+static void build_init(build_t *b, size_t next, const state_t& st)
+{
+     memset(b, 0, sizeof(*b));
+     b->next = next;
+     b->st   = st;
+     b->taken_drained = -1;
+}
+
+// Run the build for at most slices command slices; returns true once
+// the file has been read and every move made
+static bool build_run(build_t *b, long slices)
+{
+     for (long slice = 0; slice < slices; slice++)
+     {
+	  // steppers
+	  for (int n = rand() % 3; n > 0 && b->queued > 0; n--)
+	  {
+	       b->queued--;
+	       b->done++;
+	       b->moves_made++;
+	  }
+
+	  // a record is written within a call to update() a byte of it
+	  // once its moves are made
+	  if (b->taken_offset)
+	  {
+	       if (b->taken_drained < 0 && b->moves_made >= b->taken_moves)
+		    b->taken_drained = slice;
+	       if (b->taken_drained >= 0 &&
+		   slice - b->taken_drained >= CHECKPOINT_SLOT_SIZE)
+		    b->durable_offset = b->taken_offset;
+	  }
+
+	  // command slice
+	  uint32_t writes = 0;
+	  for (int i = 0; i <= E2END; i++)
+	       writes += sdsim_eeprom_writes[i];
+	  checkpoint::update(b->queued == 0 ? 0xFF : b->done);
+	  b->done = 0;
+	  uint32_t after = 0;
+	  for (int i = 0; i <= E2END; i++)
+	       after += sdsim_eeprom_writes[i];
+	  b->mid_record = after != writes;
+
+	  if (b->next == commands.size())
+	  {
+	       if (b->queued == 0)
+		    return(true);
+	       continue;
+	  }
+	  for (int n = 0; n < 4 && b->next < commands.size() &&
+		    b->queued < BLOCKS; n++)
+	  {
+	       size_t i = b->next++;
+	       b->st = commands[i].after;
+	       if (!commands[i].move)
+		    continue;
+	       b->queued++;
+	       b->moves_issued++;
+	       if (checkpoint::due(b->st.position[2]))
+	       {
+		    checkpoint::Checkpoint cp;
+
+		    cp.offset = next_offset(i);
+		    memcpy(cp.position, b->st.position, sizeof(cp.position));
+		    cp.extruder_temp[0] = b->st.extruder_temp[0];
+		    cp.extruder_temp[1] = b->st.extruder_temp[1];
+		    cp.platform_temp    = b->st.platform_temp;
+		    cp.tool             = b->st.tool;
+		    cp.flags            = b->st.fan ? CHECKPOINT_FLAG_FAN : 0;
+		    b->done = 0;
+		    checkpoint::take(cp, b->queued);
+		    b->takes++;
+		    b->taken_offset  = cp.offset;
+		    b->taken_moves   = b->moves_issued;
+		    b->taken_drained = -1;
+	       }
+	  }
+	  if (b->next == commands.size())
+	  {
+	       checkpoint::finish();
+	       b->finished = true;
+	  }
+     }
+     return(false);
+}
+
+// Index of the command at a file offset, or commands.size()
+static size_t command_at(uint32_t offset)
+{
+     for (size_t i = 0; i < commands.size(); i++)
+	  if (commands[i].offset == offset)
+	       return(i);
+     return(commands.size());
+}
+
+static size_t moves_between(size_t from, size_t to)
+{
+     size_t n = 0;
+     for (size_t i = from; i < to; i++)
+	  if (commands[i].move)
+	       n++;
+     return(n);
+}
+
+// Check what is left after the power to a build, started at command start
+// from a checkpoint at least as far on as floor, is cut.  Returns the
+// command to resume from, or commands.size() if the build can not be
+// resumed.
+static size_t check_power_loss(const build_t *b, size_t start,
+			       uint32_t floor, checkpoint::Checkpoint *cp,
+			       bool report)
+{
+     char name[CHECKPOINT_NAME_LEN];
+     int32_t z;
+
+     if (!checkpoint::load(*cp, name, z))
+     {
+	  bool ok = b->finished || (floor == 0 && b->durable_offset == 0);
+	  if (!ok || report)
+	       check(ok, "no checkpoint to resume from after %lu moves",
+		     (unsigned long)b->moves_made);
+	  return(commands.size());
+     }
+     if (b->finished)
+     {
+	  check(false, "build that was read to the end can not be resumed");
+	  return(commands.size());
+     }
+
+     size_t k = command_at(cp->offset);
+     bool ok = k < commands.size() && k >= start && k > 0 &&
+	  strcmp(name, BUILD_NAME) == 0;
+     if (!ok || report)
+	  check(ok, "checkpoint of %s on a command boundary", name);
+     if (!ok)
+	  return(commands.size());
+
+     ok = cp->offset >= floor && cp->offset >= b->durable_offset;
+     if (!ok || report)
+	  check(ok, "latest checkpoint found: offset %lu, at least %lu",
+		(unsigned long)cp->offset,
+		(unsigned long)(floor > b->durable_offset ?
+				floor : b->durable_offset));
+
+     ok = moves_between(start, k) <= b->moves_made;
+     if (!ok || report)
+	  check(ok, "no move lost: %lu before the checkpoint, %lu made",
+		(unsigned long)moves_between(start, k),
+		(unsigned long)b->moves_made);
+
+     const state_t& ref = commands[k - 1].after;
+     state_t st;
+     memcpy(st.position, cp->position, sizeof(st.position));
+     st.tool             = cp->tool;
+     st.extruder_temp[0] = cp->extruder_temp[0];
+     st.extruder_temp[1] = cp->extruder_temp[1];
+     st.platform_temp    = cp->platform_temp;
+     st.fan              = (cp->flags & CHECKPOINT_FLAG_FAN) != 0;
+     ok = same_state(st, ref) && z == cp->position[2];
+     if (!ok || report)
+	  check(ok, "checkpoint state matches the build at offset %lu",
+		(unsigned long)cp->offset);
+     return(ok ? k : commands.size());
+}
+
+// Resume at command k from a checkpoint, as command::resume() does, and
+// check that playing on gives the rest of the build
+static bool resume_matches(size_t k, const checkpoint::Checkpoint& cp)
+{
+     memfile_t f;
+     s3g_context_t ctx;
+     s3g_command_t cmd;
+     state_t st = commands[k - 1].after;
+
+     memcpy(st.position, cp.position, sizeof(st.position));
+     f.data   = file_data;
+     f.length = file_size;
+     f.offset = cp.offset;
+     memset(&ctx, 0, sizeof(ctx));
+     ctx.read  = memfile_read;
+     ctx.r_ctx = &f;
+
+     for (size_t i = k; i < commands.size(); i++)
+     {
+	  if (f.offset != commands[i].offset ||
+	      s3g_command_read(&ctx, &cmd) != 0)
+	       return(false);
+	  apply(&st, &cmd);
+	  if (!same_state(st, commands[i].after))
+	       return(false);
+     }
+     return(f.offset == file_size);
+}
+
+int main(int argc, const char *argv[])
+{
+     const char *path = argc > 1 ? argv[1] : "box.s3g";
+     FILE *fp = fopen(path, "rb");
+     if (!fp)
+     {
+	  fprintf(stderr, "Unable to open %s\n", path);
+	  return(1);
+     }
+     static uint8_t data[1024 * 1024];
+     size_t length = fread(data, 1, sizeof(data), fp);
+     fclose(fp);
+     file_data = data;
+
+     if (!parse(data, length))
+     {
+	  fprintf(stderr, "Unable to parse %s\n", path);
+	  return(1);
+     }
+     size_t total_moves = moves_between(0, commands.size());
+     printf("%s: %lu commands, %lu moves\n", path,
+	    (unsigned long)commands.size(), (unsigned long)total_moves);
+
+     memset(sdsim_eeprom, 0xff, sizeof(sdsim_eeprom));
+     srand(1);
+
+     state_t initial;
+     memset(&initial, 0, sizeof(initial));
+     build_t b;
+
+     // A whole build, for its length and the wear
+     checkpoint::start(BUILD_NAME);
+     memset(sdsim_eeprom_writes, 0, sizeof(sdsim_eeprom_writes));
+     build_init(&b, 0, initial);
+     long slices;
+     for (slices = 0; !build_run(&b, 1); slices++)
+	  ;
+     uint32_t most = 0;
+     for (int i = 0; i <= E2END; i++)
+	  if (sdsim_eeprom_writes[i] > most)
+	       most = sdsim_eeprom_writes[i];
+     check(b.moves_made == total_moves, "whole build: %lu moves made in %ld "
+	   "slices", (unsigned long)b.moves_made, slices);
+     check(most <= b.takes / CHECKPOINT_SLOTS + 2,
+	   "wear: %lu checkpoints, at most %lu writes to a byte",
+	   (unsigned long)b.takes, (unsigned long)most);
+
+     checkpoint::Checkpoint cp, cp2;
+     char name[CHECKPOINT_NAME_LEN];
+     int32_t z;
+     check(!checkpoint::load(cp, name, z), "finished build can not be resumed");
+
+     // Power losses at random points, each resumed and followed by a
+     // second power loss
+     unsigned long lost = 0, torn = 0, resumed = 0;
+     for (int t = 0; t < TRIALS; t++)
+     {
+	  bool report = t == 0;
+
+	  checkpoint::start(BUILD_NAME);
+	  build_init(&b, 0, initial);
+	  build_run(&b, slices / 4 + rand() % slices);
+	  if (b.mid_record)
+	       torn++;
+
+	  size_t k = check_power_loss(&b, 0, 0, &cp, report);
+	  if (k == commands.size())
+	       continue;
+	  resumed++;
+	  lost += b.moves_made - moves_between(0, k);
+	  bool ok = resume_matches(k, cp);
+	  if (!ok || report)
+	       check(ok, "playing on from offset %lu gives the rest of the build",
+		     (unsigned long)cp.offset);
+
+	  checkpoint::restart();
+	  build_init(&b, k, commands[k - 1].after);
+	  memcpy(b.st.position, cp.position, sizeof(cp.position));
+	  build_run(&b, rand() % slices);
+	  k = check_power_loss(&b, k, cp.offset, &cp2, report);
+	  if (k < commands.size())
+	  {
+	       ok = resume_matches(k, cp2);
+	       if (!ok || report)
+		    check(ok, "second power loss resumes from offset %lu",
+			  (unsigned long)cp2.offset);
+	  }
+     }
+     check(resumed >= TRIALS / 2, "%lu of %d power losses resumed", resumed,
+	   TRIALS);
+     check(torn > 0, "%lu power losses part way through a record", torn);
+     printf("%.1f moves made again on average after a power loss\n",
+	    resumed ? (double)lost / resumed : 0.0);
+
+     // A cancel, which parks the platform
+     checkpoint::start(BUILD_NAME);
+     build_init(&b, 0, initial);
+     build_run(&b, slices / 2);
+     checkpoint::stop(150000);
+     bool ok = checkpoint::load(cp, name, z) && z == 150000 &&
+	  command_at(cp.offset) < commands.size();
+     check(ok, "cancelled build resumes with the platform parked at %ld",
+	   (long)z);
+
+     return(failures ? 1 : 0);
+}
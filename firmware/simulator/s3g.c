@@ -58,6 +58,7 @@ static const s3g_command_info_t command_table_raw[] = {
      /*  23 */  {HOST_CMD_BOARD_STATUS, 0, "get board status"},
      /*  24 */  {HOST_CMD_GET_BUILD_STATS, 0, "get build statistics"},
      /*  27 */  {HOST_CMD_ADVANCED_VERSION, 0, "advanced version"},
+     /*  30 */  {HOST_CMD_GET_STATUS, 0, "get status snapshot"},
      /* 112 */  {HOST_CMD_DEBUG_ECHO, 0, "debug echo"},
      /* 131 */  {HOST_CMD_FIND_AXES_MINIMUM, 7, "find axes minimum"},
      /* 132 */  {HOST_CMD_FIND_AXES_MAXIMUM, 7, "find axes maximum"},
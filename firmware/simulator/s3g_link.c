@@ -0,0 +1,202 @@
+#include <string.h>
+
+#include "Commands.hh"
+#include "s3g_link.h"
+
+enum {
+     LINK_START,
+     LINK_HEADER,
+     LINK_LENGTH,
+     LINK_PAYLOAD,
+     LINK_CRC,
+     LINK_CRC_HIGH
+};
+
+uint8_t s3g_link_crc(uint8_t crc, uint8_t data)
+{
+     int i;
+
+     crc ^= data;
+     for (i = 0; i < 8; i++) {
+	  if (crc & 1)
+	       crc = (crc >> 1) ^ 0x8C;
+	  else
+	       crc >>= 1;
+     }
+     return crc;
+}
+
+uint16_t s3g_link_crc16(uint16_t crc, uint8_t data)
+{
+     int i;
+
+     crc ^= data;
+     for (i = 0; i < 8; i++) {
+	  if (crc & 1)
+	       crc = (crc >> 1) ^ 0xA001;
+	  else
+	       crc >>= 1;
+     }
+     return crc;
+}
+
+// Add a byte to the CRC of the packet being read
+static void update_crc(s3g_link_t *link, uint8_t byte)
+{
+     if (link->start == S3G_LINK_WINDOW_START_BYTE)
+	  link->crc = s3g_link_crc16(link->crc, byte);
+     else
+	  link->crc = s3g_link_crc((uint8_t)link->crc, byte);
+}
+
+void s3g_link_init(s3g_link_t *link)
+{
+     memset(link, 0, sizeof(s3g_link_t));
+     link->state = LINK_START;
+}
+
+// A packet or frame has been read whole
+static int finished(s3g_link_t *link)
+{
+     if (link->start == S3G_LINK_TELEMETRY_START_BYTE) {
+	  link->frames++;
+	  return S3G_LINK_TELEMETRY;
+     }
+     if (link->start == S3G_LINK_WINDOW_START_BYTE) {
+	  link->ack    = link->header[0];
+	  link->credit = (uint16_t)(link->header[1] | (link->header[2] << 8));
+     }
+     link->responses++;
+     return S3G_LINK_RESPONSE;
+}
+
+int s3g_link_byte(s3g_link_t *link, uint8_t byte)
+{
+     switch (link->state) {
+
+     case LINK_START :
+	  if (byte == S3G_LINK_START_BYTE || byte == S3G_LINK_TELEMETRY_START_BYTE ||
+	      byte == S3G_LINK_WINDOW_START_BYTE) {
+	       link->start       = byte;
+	       link->crc         = (byte == S3G_LINK_WINDOW_START_BYTE) ? 0xFFFF : 0;
+	       link->header_read = 0;
+	       link->state = (byte == S3G_LINK_WINDOW_START_BYTE) ? LINK_HEADER : LINK_LENGTH;
+	  }
+	  else
+	       link->noise++;
+	  return S3G_LINK_NONE;
+
+     case LINK_HEADER :
+	  link->header[link->header_read++] = byte;
+	  update_crc(link, byte);
+	  if (link->header_read >= sizeof(link->header))
+	       link->state = LINK_LENGTH;
+	  return S3G_LINK_NONE;
+
+     case LINK_LENGTH :
+	  // only windowed packets have the length in their CRC
+	  if (link->start == S3G_LINK_WINDOW_START_BYTE)
+	       update_crc(link, byte);
+	  link->length   = byte;
+	  link->received = 0;
+	  link->state    = byte ? LINK_PAYLOAD : LINK_CRC;
+	  return S3G_LINK_NONE;
+
+     case LINK_PAYLOAD :
+	  link->payload[link->received++] = byte;
+	  update_crc(link, byte);
+	  if (link->received >= link->length)
+	       link->state = LINK_CRC;
+	  return S3G_LINK_NONE;
+
+     case LINK_CRC :
+	  if (link->start == S3G_LINK_WINDOW_START_BYTE && byte == (uint8_t)link->crc) {
+	       link->state = LINK_CRC_HIGH;
+	       return S3G_LINK_NONE;
+	  }
+	  link->state = LINK_START;
+	  if (link->start == S3G_LINK_WINDOW_START_BYTE || byte != (uint8_t)link->crc) {
+	       link->errors++;
+	       return S3G_LINK_ERROR;
+	  }
+	  return(finished(link));
+
+     case LINK_CRC_HIGH :
+     default :
+	  link->state = LINK_START;
+	  if (byte != (uint8_t)(link->crc >> 8)) {
+	       link->errors++;
+	       return S3G_LINK_ERROR;
+	  }
+	  return(finished(link));
+     }
+}
+
+size_t s3g_link_frame(uint8_t *frame, int sequence, const uint8_t *payload,
+		      size_t length)
+{
+     size_t n = 0, i;
+     uint8_t crc = 0;
+     uint16_t crc16 = 0xFFFF;
+
+     if (length > 255)
+	  length = 255;
+     if (sequence < 0) {
+	  frame[n++] = S3G_LINK_START_BYTE;
+	  frame[n++] = (uint8_t)length;
+	  for (i = 0; i < length; i++) {
+	       frame[n++] = payload[i];
+	       crc = s3g_link_crc(crc, payload[i]);
+	  }
+	  frame[n++] = crc;
+	  return(n);
+     }
+
+     frame[n++] = S3G_LINK_WINDOW_START_BYTE;
+     frame[n++] = (uint8_t)sequence;
+     frame[n++] = (uint8_t)length;
+     for (i = 1; i < n; i++)
+	  crc16 = s3g_link_crc16(crc16, frame[i]);
+     for (i = 0; i < length; i++) {
+	  frame[n++] = payload[i];
+	  crc16 = s3g_link_crc16(crc16, payload[i]);
+     }
+     frame[n++] = (uint8_t)crc16;
+     frame[n++] = (uint8_t)(crc16 >> 8);
+     return(n);
+}
+
+static uint16_t get16(const uint8_t *p)
+{
+     return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+     return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	  ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int s3g_link_telemetry_status(const s3g_link_t *link, s3g_telemetry_status_t *status)
+{
+     const uint8_t *p = link->payload;
+     int i;
+
+     if (link->length < TELEMETRY_STATUS_LENGTH || p[0] != TELEMETRY_FRAME_STATUS)
+	  return(-1);
+
+     status->sequence        = p[1];
+     status->tool_temp[0]    = (int16_t)get16(p + 2);
+     status->tool_temp[1]    = (int16_t)get16(p + 4);
+     status->platform_temp   = (int16_t)get16(p + 6);
+     status->tool_output[0]  = p[8];
+     status->tool_output[1]  = p[9];
+     status->platform_output = p[10];
+     status->command_free    = get16(p + 11);
+     status->planner_blocks  = p[13];
+     status->line            = get32(p + 14);
+     for (i = 0; i < 3; i++)
+	  status->position[i] = (int32_t)get32(p + 18 + 4 * i);
+
+     return(0);
+}
@@ -0,0 +1,96 @@
+// s3g_link.h
+// Host side of the serial link to the bot: splits the bytes read from the
+// bot into response packets and telemetry frames, decodes telemetry, and
+// frames packets to send to the bot.
+
+#ifndef S3G_LINK_H_
+
+#define S3G_LINK_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// START_BYTE, TELEMETRY_START_BYTE and WINDOW_START_BYTE of Packet.hh,
+// which is C++
+#define S3G_LINK_START_BYTE           0xD5
+#define S3G_LINK_TELEMETRY_START_BYTE 0xD6
+#define S3G_LINK_WINDOW_START_BYTE    0xD7
+
+// ResponseCode of Packet.hh, the first byte of a response
+#define S3G_LINK_RC_PACKET_ERROR      0x80
+#define S3G_LINK_RC_OK                0x81
+#define S3G_LINK_RC_BUFFER_OVERFLOW   0x82
+#define S3G_LINK_RC_CRC_MISMATCH      0x83
+
+// Longest packet on the wire: start, sequence or header, length, CRC
+#define S3G_LINK_MAX_FRAME            (255 + 7)
+
+// What s3g_link_byte() found
+#define S3G_LINK_NONE      0  // nothing yet
+#define S3G_LINK_RESPONSE  1  // a response packet is in the decoder
+#define S3G_LINK_TELEMETRY 2  // a telemetry frame is in the decoder
+#define S3G_LINK_ERROR     3  // a packet or frame failed its CRC and was dropped
+
+typedef struct {
+     int       state;
+     uint8_t   start;          // start byte of the packet being read
+     uint8_t   header[3];      // ack and credit of a windowed response
+     uint8_t   header_read;
+     uint8_t   ack;            // of the last windowed response
+     uint16_t  credit;
+     uint8_t   length;         // its payload length
+     uint8_t   received;       // payload bytes read so far
+     uint16_t  crc;            // CRC of the bytes read; 16 bits for windowed packets
+     uint8_t   payload[255];
+     uint32_t  responses;      // counts of what has been read
+     uint32_t  frames;
+     uint32_t  errors;
+     uint32_t  noise;          // bytes outside any packet
+} s3g_link_t;
+
+// A TELEMETRY_FRAME_STATUS frame; see Commands.hh
+typedef struct {
+     uint8_t  sequence;
+     int16_t  tool_temp[2];
+     int16_t  platform_temp;
+     uint8_t  tool_output[2];
+     uint8_t  platform_output;
+     uint16_t command_free;
+     uint8_t  planner_blocks;
+     uint32_t line;
+     int32_t  position[3];
+} s3g_telemetry_status_t;
+
+// CRC of the packet protocol, as _crc_ibutton_update() computes it
+uint8_t s3g_link_crc(uint8_t crc, uint8_t data);
+
+// CRC of windowed packets and their responses, from 0xFFFF, as
+// _crc16_update() computes it
+uint16_t s3g_link_crc16(uint16_t crc, uint8_t data);
+
+void s3g_link_init(s3g_link_t *link);
+
+// Feed one byte read from the bot to the decoder.  When it returns
+// S3G_LINK_RESPONSE or S3G_LINK_TELEMETRY, the payload and length fields
+// hold the packet until the next call; for the response to a windowed
+// packet, start is S3G_LINK_WINDOW_START_BYTE and ack and credit are set.
+int s3g_link_byte(s3g_link_t *link, uint8_t byte);
+
+// Frame a packet for the bot, windowed if sequence is not negative
+// Returns the number of bytes put in frame, at most S3G_LINK_MAX_FRAME
+size_t s3g_link_frame(uint8_t *frame, int sequence, const uint8_t *payload,
+		      size_t length);
+
+// Decode the telemetry frame in the decoder
+// Returns 0 on success, -1 if it is not a well formed status frame
+int s3g_link_telemetry_status(const s3g_link_t *link, s3g_telemetry_status_t *status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,354 @@
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#include "Commands.hh"
+#include "s3g_window.h"
+
+// Give up on a bot which has not answered a basic packet this many times
+#define BASIC_TRIES 100
+
+// MAX_PACKET_PAYLOAD of Packet.hh, which every bot takes
+#define BASIC_MAX_PAYLOAD 32
+
+// The io of a file descriptor, whose ctx is the s3g_window_t
+static uint64_t fd_now_us(void *ctx)
+{
+     struct timespec ts;
+
+     (void)ctx;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int fd_write(void *ctx, const uint8_t *buf, size_t len)
+{
+     int fd = ((s3g_window_t *)ctx)->fd;
+
+     while (len > 0) {
+	  ssize_t n = write(fd, buf, len);
+	  if (n < 0) {
+	       if (errno == EINTR || errno == EAGAIN)
+		    continue;
+	       return(-1);
+	  }
+	  buf += n;
+	  len -= (size_t)n;
+     }
+     return(0);
+}
+
+static int fd_read(void *ctx, uint8_t *buf, size_t len, int timeout_ms)
+{
+     struct pollfd pfd;
+     ssize_t n;
+
+     pfd.fd = ((s3g_window_t *)ctx)->fd;
+     pfd.events = POLLIN;
+     n = poll(&pfd, 1, timeout_ms);
+     if (n < 0)
+	  return(errno == EINTR ? 0 : -1);
+     if (n == 0)
+	  return(0);
+     n = read(pfd.fd, buf, len);
+     if (n < 0)
+	  return(errno == EINTR || errno == EAGAIN ? 0 : -1);
+     return((int)n);
+}
+
+static void fd_sleep_ms(void *ctx, int ms)
+{
+     (void)ctx;
+     usleep((useconds_t)ms * 1000);
+}
+
+static uint64_t now_us(const s3g_window_t *win)
+{
+     return(win->io.now_us(win->io.ctx));
+}
+
+static int write_packet(s3g_window_t *win, int sequence, const uint8_t *payload,
+			size_t length)
+{
+     uint8_t frame[S3G_LINK_MAX_FRAME];
+
+     return(win->io.write(win->io.ctx, frame,
+			  s3g_link_frame(frame, sequence, payload, length)));
+}
+
+// Read until a response is in the decoder
+// Returns 1 if there is one, 0 if there was none in timeout_ms, -1 on error
+static int next_response(s3g_window_t *win, int timeout_ms)
+{
+     uint64_t until = now_us(win) + (uint64_t)timeout_ms * 1000;
+
+     for (;;) {
+	  uint64_t now;
+	  int n;
+
+	  while (win->rx_used < win->rx_have)
+	       if (s3g_link_byte(&win->link, win->rx[win->rx_used++]) == S3G_LINK_RESPONSE)
+		    return(1);
+
+	  now = now_us(win);
+	  if (now >= until)
+	       return(0);
+	  n = win->io.read(win->io.ctx, win->rx, sizeof(win->rx),
+			   (int)((until - now + 999) / 1000));
+	  if (n < 0)
+	       return(-1);
+	  win->rx_have = (size_t)n;
+	  win->rx_used = 0;
+     }
+}
+
+int s3g_window_transact(s3g_window_t *win, const uint8_t *payload, size_t length,
+			int timeout_ms)
+{
+     uint64_t until = now_us(win) + (uint64_t)timeout_ms * 1000;
+
+     if (write_packet(win, -1, payload, length) < 0)
+	  return(-1);
+     for (;;) {
+	  uint64_t now = now_us(win);
+	  int r;
+
+	  if (now >= until)
+	       return(-1);
+	  r = next_response(win, (int)((until - now + 999) / 1000));
+	  if (r <= 0)
+	       return(-1);
+	  // anything else is a late response to a windowed packet
+	  if (win->link.start == S3G_LINK_START_BYTE)
+	       return(win->link.length ? win->link.payload[0] : -1);
+     }
+}
+
+// Agree on the link protocol, once win->io is set up
+static int open_link(s3g_window_t *win, uint8_t max_payload, int timeout_ms)
+{
+     uint8_t query[3] = { HOST_CMD_LINK_VERSION, LINK_VERSION_WINDOWED, max_payload };
+     uint64_t until = now_us(win) + (uint64_t)timeout_ms * 1000;
+     const uint8_t *reply;
+     int rc;
+
+     win->max_payload = BASIC_MAX_PAYLOAD;
+     s3g_link_init(&win->link);
+
+     // the query or its answer may be lost
+     do {
+	  uint64_t left_ms = (until - now_us(win) + 999) / 1000;
+	  rc = s3g_window_transact(win, query, sizeof(query),
+				   left_ms < S3G_WINDOW_QUIET_MS ? (int)left_ms : S3G_WINDOW_QUIET_MS);
+     } while (rc < 0 && now_us(win) < until);
+     if (rc < 0)
+	  return(-1);
+     reply = win->link.payload;
+     if (rc == S3G_LINK_RC_OK && win->link.length >= 5 &&
+	 reply[1] == LINK_VERSION_WINDOWED && reply[2] > 0) {
+	  win->windowed = 1;
+	  win->window = reply[2] < S3G_WINDOW_MAX ? reply[2] : S3G_WINDOW_MAX;
+	  win->credit = (uint16_t)(reply[3] | (reply[4] << 8));
+     }
+     // bots from before larger payloads do not say
+     if (rc == S3G_LINK_RC_OK && win->link.length >= 6 && reply[5] > BASIC_MAX_PAYLOAD)
+	  win->max_payload = reply[5] < max_payload ? reply[5] : max_payload;
+     return(0);
+}
+
+int s3g_window_open(s3g_window_t *win, int fd, uint8_t max_payload, int timeout_ms)
+{
+     memset(win, 0, sizeof(s3g_window_t));
+     win->fd          = fd;
+     win->io.ctx      = win;
+     win->io.now_us   = fd_now_us;
+     win->io.write    = fd_write;
+     win->io.read     = fd_read;
+     win->io.sleep_ms = fd_sleep_ms;
+     return(open_link(win, max_payload, timeout_ms));
+}
+
+int s3g_window_open_io(s3g_window_t *win, const s3g_window_io_t *io, uint8_t max_payload,
+		       int timeout_ms)
+{
+     memset(win, 0, sizeof(s3g_window_t));
+     win->fd = -1;
+     win->io = *io;
+     return(open_link(win, max_payload, timeout_ms));
+}
+
+// Command buffer space a queued packet takes; queries take none
+static unsigned cost(const s3g_window_t *win, int i)
+{
+     return (win->queue[i][0] & 0x80) ? win->length[i] : 0;
+}
+
+// Send the queued packets which the window and the credit allow
+static int transmit(s3g_window_t *win)
+{
+     unsigned used = 0;
+     int i;
+
+     for (i = 0; i < win->sent; i++)
+	  used += cost(win, i);
+     if (win->sent == 0)
+	  win->progress_us = now_us(win);
+     while (win->sent < win->count && win->sent < win->window &&
+	    used + cost(win, win->sent) <= win->credit) {
+	  if (write_packet(win, (uint8_t)(win->base + win->sent),
+			   win->queue[win->sent], win->length[win->sent]) < 0)
+	       return(-1);
+	  used += cost(win, win->sent);
+	  win->sent++;
+     }
+     return(0);
+}
+
+// Send again from the first packet without a response
+static void rewind_window(s3g_window_t *win)
+{
+     win->retransmits += win->sent;
+     win->sent = 0;
+     win->rewound = 1;
+}
+
+static void release(s3g_window_t *win, int done)
+{
+     memmove(win->queue[0], win->queue[done], (size_t)(win->count - done) * sizeof(win->queue[0]));
+     memmove(win->length, win->length + done, (size_t)(win->count - done));
+     win->count -= done;
+     win->sent -= done;
+     win->base += done;
+}
+
+// Handle a response, or the lack of one
+static int pump(s3g_window_t *win, int wait_ms)
+{
+     s3g_link_t *link = &win->link;
+     int r = next_response(win, wait_ms);
+     uint8_t code;
+
+     if (r < 0)
+	  return(-1);
+     if (r == 0) {
+	  int wait_ms = win->stalled ? S3G_WINDOW_QUIET_MS : S3G_WINDOW_TIMEOUT_MS;
+	  if (win->sent > 0 && now_us(win) - win->progress_us >= (uint64_t)wait_ms * 1000) {
+	       win->timeouts++;
+	       win->stalled = 1;
+	       rewind_window(win);
+	  }
+	  return(0);
+     }
+
+     code = link->length ? link->payload[0] : 0;
+     if (link->start == S3G_LINK_WINDOW_START_BYTE) {
+	  // acks are cumulative; older ones are from before a rewind
+	  int done = (uint8_t)(link->ack + 1 - win->base);
+	  if (done <= win->sent) {
+	       release(win, done);
+	       win->credit = link->credit;
+	       if (done > 0) {
+		    win->rewound = win->stalled = 0;
+		    win->progress_us = win->alive_us = now_us(win);
+	       }
+	  }
+     }
+     else if (code == S3G_LINK_RC_OK && link->length >= 5) {
+	  // a buffer size query, sent while there was no room
+	  uint32_t room = link->payload[1] | (link->payload[2] << 8) |
+	       ((uint32_t)link->payload[3] << 16) | ((uint32_t)link->payload[4] << 24);
+	  win->credit = room > 0xFFFF ? 0xFFFF : (uint16_t)room;
+	  win->alive_us = now_us(win);
+     }
+
+     // the responses to the rest of the packets sent before a rewind will
+     // be errors too
+     if ((code == S3G_LINK_RC_PACKET_ERROR || code == S3G_LINK_RC_BUFFER_OVERFLOW ||
+	  code == S3G_LINK_RC_CRC_MISMATCH) && win->sent > 0 && !win->rewound)
+	  rewind_window(win);
+     return(0);
+}
+
+static int service(s3g_window_t *win)
+{
+     // a bot which has reset its window, say, answers every packet with an
+     // error from then on
+     if (now_us(win) - win->alive_us >= S3G_WINDOW_GIVE_UP_MS * 1000)
+	  return(-1);
+     if (transmit(win) < 0)
+	  return(-1);
+     if (win->sent == 0 && win->count > 0) {
+	  // no room for the next packet, and no response coming to say when
+	  // there is
+	  uint64_t now = now_us(win);
+	  if (now - win->probe_us >= S3G_WINDOW_PROBE_MS * 1000) {
+	       uint8_t query = HOST_CMD_GET_BUFFER_SIZE;
+	       if (write_packet(win, -1, &query, 1) < 0)
+		    return(-1);
+	       win->probe_us = now;
+	       win->probes++;
+	  }
+     }
+     return(pump(win, S3G_WINDOW_PROBE_MS));
+}
+
+int s3g_window_send(s3g_window_t *win, const uint8_t *payload, size_t length)
+{
+     if (length == 0 || length > win->max_payload)
+	  return(-1);
+     win->commands++;
+
+     if (!win->windowed) {
+	  int tries;
+	  win->packets++;
+	  for (tries = 0; tries < BASIC_TRIES; tries++) {
+	       int rc = s3g_window_transact(win, payload, length, S3G_WINDOW_TIMEOUT_MS);
+	       if (rc == S3G_LINK_RC_BUFFER_OVERFLOW) {
+		    win->io.sleep_ms(win->io.ctx, S3G_WINDOW_PROBE_MS);
+		    tries = 0;
+	       }
+	       else if (rc < 0 || rc == S3G_LINK_RC_PACKET_ERROR ||
+			rc == S3G_LINK_RC_CRC_MISMATCH)
+		    win->timeouts++;
+	       else
+		    return(0);
+	       win->retransmits++;
+	  }
+	  return(-1);
+     }
+
+     // an action command can go on the end of the last packet, if that
+     // is an action packet still waiting to be sent
+     if ((payload[0] & 0x80) && win->count > win->sent) {
+	  int last = win->count - 1;
+	  if ((win->queue[last][0] & 0x80) && win->length[last] + length <= win->max_payload) {
+	       memcpy(win->queue[last] + win->length[last], payload, length);
+	       win->length[last] += (uint8_t)length;
+	       return(transmit(win));
+	  }
+     }
+
+     if (win->count == 0)
+	  win->alive_us = now_us(win);
+     while (win->count == S3G_WINDOW_MAX)
+	  if (service(win) < 0)
+	       return(-1);
+     win->packets++;
+     memcpy(win->queue[win->count], payload, length);
+     win->length[win->count] = (uint8_t)length;
+     win->count++;
+     return(transmit(win));
+}
+
+int s3g_window_flush(s3g_window_t *win, int timeout_ms)
+{
+     uint64_t until = now_us(win) + (uint64_t)timeout_ms * 1000;
+
+     while (win->count > 0) {
+	  if (now_us(win) >= until || service(win) < 0)
+	       return(-1);
+     }
+     return(0);
+}
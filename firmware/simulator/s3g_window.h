@@ -0,0 +1,121 @@
+// s3g_window.h
+// Host side sender for the windowed link protocol (LINK_VERSION_WINDOWED in
+// Commands.hh).  Up to the window size of packets are sent ahead of the
+// responses, as long as the commands in them fit the free space the bot
+// last reported in its command buffer.  A packet or response lost on the
+// line is found from an error response, or from no responses at all, and
+// everything from the first packet without a response is sent again; the
+// bot acts on each packet once, whatever is sent again.
+//
+// Action commands waiting for room in the window are packed together into
+// packets as long as the bot agreed to take.
+//
+// Packets are sent for their effect: responses to them are only checked
+// for their response code and ack.  Telemetry frames read while sending
+// are decoded and counted by the link decoder but otherwise dropped.
+
+#ifndef S3G_WINDOW_H_
+
+#define S3G_WINDOW_H_
+
+#include "s3g_link.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Most packets in flight the sender can keep track of
+#define S3G_WINDOW_MAX 16
+
+// Time without a response before packets in flight are sent again
+#define S3G_WINDOW_TIMEOUT_MS 50
+
+// Time without a response before they are sent again once more have gone
+// unanswered, and before the link version query is asked again.  Longer
+// than the bot's 200 ms packet timeout, so that a packet it took part of,
+// from a start byte in a damaged one say, is dropped before they arrive
+#define S3G_WINDOW_QUIET_MS 250
+
+// Time between buffer size queries while the bot has no room for the next
+// packet and nothing is in flight
+#define S3G_WINDOW_PROBE_MS 10
+
+// Time without a packet acknowledged, or an answer to a buffer size query,
+// before the sender gives up on the bot
+#define S3G_WINDOW_GIVE_UP_MS 5000
+
+// How the sender reaches the bot and tells the time.  s3g_window_open()
+// uses a file descriptor and the monotonic clock; a test can give its own
+// to s3g_window_open_io(), with a bot of its own on a simulated clock.
+typedef struct {
+     void     *ctx;
+     uint64_t (*now_us)(void *ctx);
+     // Write all of buf; returns 0, or -1 on error
+     int      (*write)(void *ctx, const uint8_t *buf, size_t len);
+     // Read what has come in, up to len bytes, waiting up to timeout_ms for
+     // it; returns the bytes read, 0 if none came, or -1 on error
+     int      (*read)(void *ctx, uint8_t *buf, size_t len, int timeout_ms);
+     void     (*sleep_ms)(void *ctx, int ms);
+} s3g_window_io_t;
+
+typedef struct {
+     int        fd;
+     s3g_window_io_t io;
+     s3g_link_t link;
+     uint8_t    rx[64];        // bytes read and not yet decoded
+     size_t     rx_have;
+     size_t     rx_used;
+     int        windowed;      // the bot speaks the windowed protocol
+     uint8_t    window;        // packets to keep in flight
+     uint8_t    max_payload;   // longest packet the bot takes
+     uint8_t    base;          // sequence number of queue[0]
+     uint8_t    count;         // packets queued, oldest first
+     uint8_t    sent;          // of those, how many have been sent
+     uint8_t    length[S3G_WINDOW_MAX];
+     uint8_t    queue[S3G_WINDOW_MAX][255];
+     uint16_t   credit;        // free command buffer after the last ack
+     int        rewound;       // sent again, and no ack since
+     int        stalled;       // timed out, and no ack since
+     uint64_t   progress_us;   // when the last ack came, or when last sent again
+     uint64_t   probe_us;      // when the last buffer size query went out
+     uint64_t   alive_us;      // when the bot last acked a packet or told its room
+     uint32_t   commands;      // counts of what has been done
+     uint32_t   packets;
+     uint32_t   retransmits;
+     uint32_t   timeouts;
+     uint32_t   probes;
+} s3g_window_t;
+
+// Agree on the link protocol with the bot on fd, which is open for reading
+// and writing, asking for packets of up to max_payload bytes.  Bots which
+// do not know HOST_CMD_LINK_VERSION are sent packets one at a time, and
+// packets of MAX_PACKET_PAYLOAD bytes are all any bot is sure to take.
+// Returns 0 on success, -1 if the bot did not respond in timeout_ms
+int s3g_window_open(s3g_window_t *win, int fd, uint8_t max_payload, int timeout_ms);
+
+// As s3g_window_open(), through io
+int s3g_window_open_io(s3g_window_t *win, const s3g_window_io_t *io, uint8_t max_payload,
+		       int timeout_ms);
+
+// Send a packet and wait for its response, as the basic protocol does
+// Returns the response code, or -1 if there was no response in timeout_ms
+int s3g_window_transact(s3g_window_t *win, const uint8_t *payload, size_t length,
+			int timeout_ms);
+
+// Queue a packet and send what the window and the bot's command buffer
+// allow, waiting for room in the queue if need be.  Without the windowed
+// protocol, this sends the packet and waits for its response, sending it
+// again for as long as the command buffer is full.
+// Returns 0 on success, -1 on an I/O error or if the bot stopped acking
+// packets for S3G_WINDOW_GIVE_UP_MS
+int s3g_window_send(s3g_window_t *win, const uint8_t *payload, size_t length);
+
+// Wait until every queued packet has had its response
+// Returns 0 on success, -1 on an I/O error or if timeout_ms passed
+int s3g_window_flush(s3g_window_t *win, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,260 @@
+// sd_capture.cc
+// Benchmark capturing an upload to a FAT16 card the way SDCard.cc does,
+// a packet at a time, and report the rate the card takes it at.  With a
+// size hint the file should be allocated in one run up front and written
+// as one multiple block stream, each block once, with no block read back
+// and the FAT left alone until the capture ends.  Also checks that the
+// file reads back, that unused space is given back, and that nothing
+// else on the card is disturbed.  Exits non-zero on failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "SdCardSim.hh"
+#include "FatImage.hh"
+#include "lib_sd/sd_raw.h"
+#include "lib_sd/partition.h"
+#include "lib_sd/fat.h"
+
+#define IMAGE_SECTORS 32768
+#define SECTORS_PER_CLUSTER 4
+
+// A file in short runs, which leaves the first free space in holes
+#define HOLES_NAME "HOLES.S3G"
+#define HOLES_SIZE (40 * 1024L)
+
+#define UPLOAD_SIZE (200 * 1024L)
+
+// Payload sizes of the captured packets
+#define PACKET_MIN 20
+#define PACKET_MAX 32
+
+#define CMD_WRITE_BLOCK 24
+#define CMD_WRITE_MULTIPLE_BLOCK 25
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static struct partition_struct *partition;
+static struct fat_fs_struct *fs;
+static SdCardSim *card;
+static FatImage *image;
+
+static bool mount()
+{
+     if (!sd_raw_init())
+	  return false;
+     partition = partition_open(sd_raw_read, sd_raw_read_interval,
+				sd_raw_write, sd_raw_write_interval, -1);
+     if (!partition)
+	  return false;
+     fs = fat_open(partition);
+     return fs != 0;
+}
+
+static void unmount()
+{
+     fat_close(fs);
+     partition_close(partition);
+     fs = 0;
+     partition = 0;
+}
+
+static bool find_entry(const char *name, struct fat_dir_entry_struct *entry)
+{
+     fat_get_dir_entry_of_path(fs, "/", entry);
+     struct fat_dir_struct *dd = fat_open_dir(fs, entry);
+     bool found = false;
+
+     if (!dd)
+	  return false;
+     while (!found && fat_read_dir(dd, entry))
+	  found = strcasecmp(entry->long_name, name) == 0;
+     fat_close_dir(dd);
+     return found;
+}
+
+// Check a file on a freshly mounted card against what should be in it
+static bool verify(const char *name, const uint8_t *contents, long size)
+{
+     struct fat_dir_entry_struct entry;
+     uint8_t buffer[512];
+     long offset = 0;
+     intptr_t n;
+
+     unmount();
+     if (!mount() || !find_entry(name, &entry) || entry.file_size != size)
+	  return false;
+     struct fat_file_struct *fd = fat_open_file(fs, &entry);
+     if (!fd)
+	  return false;
+     while ((n = fat_read_file(fd, buffer, sizeof(buffer))) > 0 &&
+	    memcmp(buffer, contents + offset, n) == 0)
+	  offset += n;
+     fat_close_file(fd);
+     return offset == size;
+}
+
+// Number of runs of consecutive clusters in a file's chain, read from
+// the image
+static uint16_t count_runs(const char *name)
+{
+     struct fat_dir_entry_struct entry;
+     const uint8_t *fat = image->data() + image->fatOffset();
+     uint16_t runs = 0;
+
+     if (!find_entry(name, &entry))
+	  return 0;
+     for (uint16_t cluster = entry.cluster, prev = 0;
+	  cluster >= 2 && cluster < 0xfff8;
+	  prev = cluster, cluster = fat[cluster * 2] | (fat[cluster * 2 + 1] << 8)) {
+	  if (cluster != prev + 1)
+	       runs++;
+     }
+     return runs;
+}
+
+// Capture data to a new file as SDCard.cc does: reserve space for the
+// hint, stream, write each packet as it comes, then trim and close
+static bool capture(const char *name, const uint8_t *data, long length,
+		    uint32_t hint, bool stream)
+{
+     struct fat_dir_entry_struct entry;
+     fat_get_dir_entry_of_path(fs, "/", &entry);
+     struct fat_dir_struct *dd = fat_open_dir(fs, &entry);
+     bool ok = dd && fat_create_file(dd, name, &entry);
+
+     if (dd)
+	  fat_close_dir(dd);
+     struct fat_file_struct *fd = ok ? fat_open_file(fs, &entry) : 0;
+     if (!fd)
+	  return false;
+
+     // forget the cached block, so only the capture is counted
+     sd_raw_sync();
+     uint8_t b;
+     sd_raw_read(0, &b, 1);
+     card->resetCounters();
+
+     if (hint)
+	  fat_reserve_file(fd, hint);
+     sd_raw_stream_enable(stream);
+
+     srand(5);
+     for (long written = 0; ok && written < length; ) {
+	  long n = PACKET_MIN + rand() % (PACKET_MAX - PACKET_MIN + 1);
+	  if (n > length - written)
+	       n = length - written;
+	  ok = fat_write_file(fd, data + written, n) == n;
+	  written += n;
+     }
+
+     ok = ok && fat_resize_file(fd, fat_get_file_size(fd));
+     fat_close_file(fd);
+     ok = ok && sd_raw_sync();
+     sd_raw_stream_enable(0);
+     return ok;
+}
+
+static void bench(const char *name, const uint8_t *contents, long size,
+		  uint32_t hint, bool stream, double *rate)
+{
+     uint32_t free_before = fat_get_fs_free(fs);
+     uint32_t blocks = (size + 511) / 512;
+
+     printf("--- %s: %ld bytes, hint %u, %s\n", name, size, hint,
+	    stream ? "streaming" : "single blocks");
+     check(capture(name, contents, size, hint, stream), "%s captured", name);
+     *rate = size / 1024.0 / card->seconds;
+     printf("      %.1f KB/s: %u blocks written for %u, %u read, "
+	    "%u CMD24, %u CMD25, %u data blocks read, %.1f ms on the bus\n",
+	    *rate, card->blocks_written, blocks, card->blocks_read,
+	    card->commands[CMD_WRITE_BLOCK],
+	    card->commands[CMD_WRITE_MULTIPLE_BLOCK], card->watch_blocks,
+	    card->seconds * 1000);
+
+     check(card->watch_blocks == 0, "%s no data block read back", name);
+     uint16_t runs = count_runs(name);
+     printf("      %u cluster runs\n", runs);
+     if (hint >= size) {
+	  // data blocks, plus the FAT and directory blocks touched once
+	  check(card->blocks_written <= blocks + 8,
+		"%s each block written once", name);
+	  check(runs == 1, "%s allocated in one run", name);
+     }
+     if (hint >= size && stream)
+	  check(card->commands[CMD_WRITE_BLOCK] +
+		card->commands[CMD_WRITE_MULTIPLE_BLOCK] <= 8,
+		"%s streamed in a few commands", name);
+
+     check(verify(name, contents, size), "%s reads back", name);
+     uint32_t used = free_before - fat_get_fs_free(fs);
+     uint32_t clusters = (size + image->clusterSize() - 1) / image->clusterSize();
+     check(used == clusters * image->clusterSize(),
+	   "%s holds %u clusters, as many as it needs", name,
+	   used / image->clusterSize());
+}
+
+int main(int argc, const char *argv[])
+{
+     image = new FatImage(IMAGE_SECTORS, SECTORS_PER_CLUSTER);
+     uint8_t *contents = (uint8_t *)malloc(UPLOAD_SIZE);
+     double rate_plain, rate_hint, rate_stream, rate;
+
+     srand(1);
+     for (long i = 0; i < UPLOAD_SIZE; i++)
+	  contents[i] = rand();
+     image->addFile(HOLES_NAME, contents, HOLES_SIZE, 2, 1);
+
+     SdCardSim sim(image->data(), image->size());
+     card = sd_card = &sim;
+     card->watch_start = image->dataOffset();
+     card->watch_end = image->size();
+
+     check(mount(), "mount image");
+     if (!fs)
+	  return 1;
+
+     bench("PLAIN.S3G", contents, UPLOAD_SIZE, 0, false, &rate_plain);
+     bench("HINT.S3G", contents, UPLOAD_SIZE, UPLOAD_SIZE, false, &rate_hint);
+     bench("STREAM.S3G", contents, UPLOAD_SIZE, UPLOAD_SIZE, true, &rate_stream);
+     check(rate_stream > 2 * rate_plain,
+	   "streaming a reserved file beats allocating as it grows (%.1f vs %.1f KB/s)",
+	   rate_stream, rate_plain);
+
+     // a hint too large gives the spare space back, one too small grows
+     bench("OVER.S3G", contents, UPLOAD_SIZE / 2, UPLOAD_SIZE, true, &rate);
+     bench("UNDER.S3G", contents, UPLOAD_SIZE, UPLOAD_SIZE / 3, true, &rate);
+
+     // a block the card receives corrupted is sent again mid-stream
+     card->corruptWrites(1);
+     bench("CRC.S3G", contents, UPLOAD_SIZE / 4, UPLOAD_SIZE / 4, true, &rate);
+     card->corruptWrites(0);
+
+     check(verify(HOLES_NAME, contents, HOLES_SIZE),
+	   "%s undisturbed", HOLES_NAME);
+
+     unmount();
+     delete image;
+     free(contents);
+     if (failures)
+	  printf("%d check(s) failed\n", failures);
+     return(failures ? 1 : 0);
+}
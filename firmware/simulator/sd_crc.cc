@@ -0,0 +1,176 @@
+// sd_crc.cc
+// Check lib_sd's crc verification against a simulated card that corrupts
+// blocks in flight: corrupted reads are retried and return the right
+// data, corruption beyond the retry limit is reported rather than passed
+// on, and blocks the card receives corrupted are sent again.
+// Exits non-zero on failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "SdCardSim.hh"
+#include "FatImage.hh"
+#include "lib_sd/sd_raw.h"
+#include "lib_sd/partition.h"
+#include "lib_sd/fat.h"
+
+#define IMAGE_SECTORS 32768
+#define SECTORS_PER_CLUSTER 4
+#define FILE_NAME "TEST.S3G"
+#define FILE_SIZE (100 * 1024L)
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static SdCardSim *card;
+static uint8_t *contents;
+static struct fat_fs_struct *fs;
+static struct fat_file_struct *fd;
+
+static bool open_file()
+{
+     struct partition_struct *partition;
+     struct fat_dir_entry_struct entry;
+
+     if (!sd_raw_init())
+	  return false;
+     partition = partition_open(sd_raw_read, sd_raw_read_interval,
+				sd_raw_write, sd_raw_write_interval, -1);
+     if (!partition || !(fs = fat_open(partition)))
+	  return false;
+
+     fat_get_dir_entry_of_path(fs, "/", &entry);
+     struct fat_dir_struct *dd = fat_open_dir(fs, &entry);
+     bool found = false;
+     while (dd && !found && fat_read_dir(dd, &entry))
+	  found = strcasecmp(entry.long_name, FILE_NAME) == 0;
+     if (dd)
+	  fat_close_dir(dd);
+     return found && (fd = fat_open_file(fs, &entry)) != 0;
+}
+
+// Read the file front to back, corrupting `count` blocks in flight every
+// `interval` bytes.  Returns the number of bytes read correctly.
+static long read_corrupted(bool stream, long interval, uint16_t count)
+{
+     int32_t offset = 0;
+     uint8_t buffer[64];
+
+     fat_seek_file(fd, &offset, FAT_SEEK_SET);
+     sd_raw_stream_enable(stream);
+     while (offset < FILE_SIZE) {
+	  if (offset % interval == 0)
+	       card->corruptBlocks(count);
+	  intptr_t n = fat_read_file(fd, buffer, sizeof(buffer));
+	  if (n <= 0 || memcmp(buffer, contents + offset, n) != 0)
+	       break;
+	  offset += n;
+     }
+     card->corruptBlocks(0);
+     sd_raw_stream_enable(0);
+     return offset;
+}
+
+static void test_reads(bool stream)
+{
+     const char *mode = stream ? "streaming" : "single block";
+     uint32_t blocks = FILE_SIZE / 512;
+
+     // every 8KB a block arrives corrupted, and is read again
+     card->resetCounters();
+     long matched = read_corrupted(stream, 8192, 1);
+     check(matched == FILE_SIZE, "%s: read %ld of %ld bytes through corruption",
+	   mode, matched, FILE_SIZE);
+     printf("      %u blocks sent for %u\n", card->blocks_read, blocks);
+     check(card->blocks_read <= blocks + 2 * (FILE_SIZE / 8192) + 2,
+	   "%s: only corrupted blocks are read again", mode);
+
+     // a block corrupted more times than it is retried is an error, not
+     // bad data, and the next read starts afresh
+     long failed_at = read_corrupted(stream, FILE_SIZE * 2,
+				     SD_RAW_READ_RETRIES + 1);
+     check(failed_at < FILE_SIZE, "%s: persistent corruption is reported (at %ld)",
+	   mode, failed_at);
+     matched = read_corrupted(stream, FILE_SIZE * 2, 0);
+     check(matched == FILE_SIZE, "%s: reads recover after the error", mode);
+}
+
+static void test_writes()
+{
+     uint8_t block[512];
+     uint8_t check_block[512];
+     offset_t address = (offset_t)(IMAGE_SECTORS - 8) * 512;
+
+     for (uint16_t i = 0; i < sizeof(block); i++)
+	  block[i] = i * 7;
+
+     // the card rejects the corrupted copy and lib_sd sends it again
+     card->resetCounters();
+     card->corruptWrites(2);
+     bool ok = sd_raw_write(address, block, sizeof(block)) && sd_raw_sync();
+     check(ok, "write retried through corruption");
+     check(card->crc_errors == 2 && card->blocks_written == 1,
+	   "card rejected %u corrupted copies, wrote %u", card->crc_errors,
+	   card->blocks_written);
+
+     // reading it back from the card, not the cache
+     sd_raw_read(0, check_block, 1);
+     ok = sd_raw_read(address, check_block, sizeof(check_block)) &&
+	  memcmp(block, check_block, sizeof(block)) == 0;
+     check(ok, "written block reads back");
+
+     // past the retry limit the write fails
+     card->corruptWrites(SD_RAW_READ_RETRIES + 1);
+     block[0] ^= 0xff;
+     ok = sd_raw_write(address + 512, block, sizeof(block)) && sd_raw_sync();
+     check(!ok, "persistent write corruption is reported");
+     card->corruptWrites(0);
+}
+
+int main(int argc, const char *argv[])
+{
+     FatImage image(IMAGE_SECTORS, SECTORS_PER_CLUSTER);
+
+     contents = (uint8_t *)malloc(FILE_SIZE);
+     srand(3);
+     for (long i = 0; i < FILE_SIZE; i++)
+	  contents[i] = rand();
+     image.addFile(FILE_NAME, contents, FILE_SIZE);
+
+     SdCardSim sim(image.data(), image.size());
+     card = sd_card = &sim;
+
+     check(open_file(), "mount and open %s", FILE_NAME);
+     if (!fd)
+	  return 1;
+     check(card->crcEnabled(), "card checks crc (CMD59)");
+
+     printf("--- reads\n");
+     test_reads(false);
+     test_reads(true);
+
+     printf("--- writes\n");
+     test_writes();
+
+     free(contents);
+     if (failures)
+	  printf("%d check(s) failed\n", failures);
+     return(failures ? 1 : 0);
+}
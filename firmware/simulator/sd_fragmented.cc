@@ -0,0 +1,290 @@
+// sd_fragmented.cc
+// Benchmark file reads and seeks on a fragmented FAT16 card, counting the
+// blocks lib_sd reads from the FAT and from the file data.  Once a file is
+// open its cluster chain should not need the FAT again while it fits the
+// extent map, seeks should cost one data block, and FAT lookups beyond
+// the map should not evict the data block being read.  Also checks that
+// a file written, grown and truncated reads back correctly.
+// Exits non-zero on failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "SdCardSim.hh"
+#include "FatImage.hh"
+#include "lib_sd/sd_raw.h"
+#include "lib_sd/partition.h"
+#include "lib_sd/fat.h"
+
+#define IMAGE_SECTORS 32768
+#define SECTORS_PER_CLUSTER 4
+
+// A file in a few runs, which fits the extent map
+#define RUNS_NAME "RUNS.S3G"
+#define RUNS_SIZE (400 * 1024L)
+#define RUNS_CLUSTERS 25
+
+// A file in many short runs, which does not
+#define SCATTER_NAME "SCATTER.S3G"
+#define SCATTER_SIZE (300 * 1024L)
+#define SCATTER_CLUSTERS 2
+
+#define WRITE_NAME "CAPTURE.S3G"
+#define WRITE_SIZE (100 * 1024L)
+
+#define SEEK_COUNT 50
+
+// FAT16 entries in a window of the FAT cache
+#define FAT_CACHE_ENTRIES (FAT_CACHE_SIZE / 2)
+
+#define CMD_READ_SINGLE_BLOCK 17
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static struct partition_struct *partition;
+static struct fat_fs_struct *fs;
+static SdCardSim *card;
+static FatImage *image;
+
+static bool mount()
+{
+     if (!sd_raw_init())
+	  return false;
+     partition = partition_open(sd_raw_read, sd_raw_read_interval,
+				sd_raw_write, sd_raw_write_interval, -1);
+     if (!partition)
+	  return false;
+     fs = fat_open(partition);
+     return fs != 0;
+}
+
+static bool find_entry(const char *name, struct fat_dir_entry_struct *entry)
+{
+     fat_get_dir_entry_of_path(fs, "/", entry);
+     struct fat_dir_struct *dd = fat_open_dir(fs, entry);
+     bool found = false;
+
+     if (!dd)
+	  return false;
+     while (!found && fat_read_dir(dd, entry))
+	  found = strcasecmp(entry->long_name, name) == 0;
+     fat_close_dir(dd);
+     return found;
+}
+
+static struct fat_file_struct *open_file(const char *name)
+{
+     struct fat_dir_entry_struct entry;
+
+     if (!find_entry(name, &entry))
+	  return 0;
+     return fat_open_file(fs, &entry);
+}
+
+static void reset_counts()
+{
+     // forget the cached block, so every test starts from the card
+     uint8_t b;
+     sd_raw_read(0, &b, 1);
+     card->resetCounters();
+}
+
+static uint32_t data_blocks()
+{
+     return card->blocks_read - card->watch_blocks;
+}
+
+// Read a file front to back a byte at a time, as SD playback does
+static void bench_sequential(const char *name, const uint8_t *contents,
+			     long size, uint32_t fat_blocks_allowed)
+{
+     reset_counts();
+     struct fat_file_struct *fd = open_file(name);
+
+     check(fd != 0, "open %s", name);
+     if (!fd)
+	  return;
+     uint32_t open_fat = card->watch_blocks;
+
+     reset_counts();
+     long offset = 0;
+     uint8_t b;
+     while (fat_read_file(fd, &b, 1) == 1 && offset < size &&
+	    b == contents[offset])
+	  offset++;
+
+     uint32_t blocks = (size + 511) / 512;
+     printf("      open: %u FAT blocks; read: %u FAT blocks, %u data blocks, %u read commands\n",
+	    open_fat, card->watch_blocks, data_blocks(),
+	    card->commands[CMD_READ_SINGLE_BLOCK]);
+     check(offset == size, "%s read %ld of %ld bytes correctly",
+	   name, offset, size);
+     check(data_blocks() == blocks, "%s data read once (%u blocks for %u)",
+	   name, data_blocks(), blocks);
+     check(card->watch_blocks <= fat_blocks_allowed,
+	   "%s FAT blocks read while reading: %u (at most %u)", name,
+	   card->watch_blocks, fat_blocks_allowed);
+     fat_close_file(fd);
+}
+
+// Seek to random positions and read a little at each, as a rewind does
+static void bench_seeks(const char *name, const uint8_t *contents,
+			long size, uint32_t fat_blocks_allowed)
+{
+     struct fat_file_struct *fd = open_file(name);
+     uint8_t buffer[16];
+     bool ok = true;
+
+     check(fd != 0, "open %s", name);
+     if (!fd)
+	  return;
+
+     reset_counts();
+     srand(7);
+     for (int i = 0; i < SEEK_COUNT; i++) {
+	  int32_t pos = rand() % (size - sizeof(buffer));
+	  int32_t offset = pos;
+	  // keep clear of block boundaries, so each seek costs one block
+	  if ((pos & 511) > 512 - (int32_t)sizeof(buffer))
+	       offset = pos = pos & ~511;
+	  if (!fat_seek_file(fd, &offset, FAT_SEEK_SET) ||
+	      fat_read_file(fd, buffer, sizeof(buffer)) != sizeof(buffer) ||
+	      memcmp(buffer, contents + pos, sizeof(buffer)) != 0)
+	       ok = false;
+     }
+     printf("      %d seeks: %u FAT blocks, %u data blocks\n", SEEK_COUNT,
+	    card->watch_blocks, data_blocks());
+     check(ok, "%s reads after seeks return the right data", name);
+     check(data_blocks() <= SEEK_COUNT, "%s one data block per seek", name);
+     check(card->watch_blocks <= fat_blocks_allowed,
+	   "%s FAT blocks read while seeking: %u (at most %u)", name,
+	   card->watch_blocks, fat_blocks_allowed);
+     fat_close_file(fd);
+}
+
+// Write a new file in odd sized pieces, then check it reads back, and
+// still does after growing and truncating it
+static void test_write(const uint8_t *contents)
+{
+     struct fat_dir_entry_struct entry;
+     fat_get_dir_entry_of_path(fs, "/", &entry);
+     struct fat_dir_struct *dd = fat_open_dir(fs, &entry);
+
+     check(dd && fat_create_file(dd, WRITE_NAME, &entry),
+	   "create %s", WRITE_NAME);
+     if (dd)
+	  fat_close_dir(dd);
+     struct fat_file_struct *fd = fat_open_file(fs, &entry);
+     if (!fd)
+	  return;
+
+     bool ok = true;
+     for (long written = 0; written < WRITE_SIZE; ) {
+	  long n = WRITE_SIZE - written < 700 ? WRITE_SIZE - written : 700;
+	  if (fat_write_file(fd, contents + written, n) != n) {
+	       ok = false;
+	       break;
+	  }
+	  written += n;
+     }
+     check(ok, "wrote %ld bytes", WRITE_SIZE);
+
+     uint8_t buffer[1000];
+     static const int32_t offsets[] = { 0, 5000, 60000, 99000 };
+     for (uint8_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+	  int32_t offset = offsets[i];
+	  if (!fat_seek_file(fd, &offset, FAT_SEEK_SET) ||
+	      fat_read_file(fd, buffer, sizeof(buffer)) != sizeof(buffer) ||
+	      memcmp(buffer, contents + offsets[i], sizeof(buffer)) != 0)
+	       ok = false;
+     }
+     check(ok, "written file reads back");
+
+     // truncate into the middle of a cluster, then grow past the old end
+     ok = fat_resize_file(fd, 30000) && fat_resize_file(fd, WRITE_SIZE + 5000);
+     int32_t offset = 29000;
+     ok = ok && fat_seek_file(fd, &offset, FAT_SEEK_SET) &&
+	  fat_read_file(fd, buffer, sizeof(buffer)) == sizeof(buffer) &&
+	  memcmp(buffer, contents + 29000, sizeof(buffer)) == 0;
+     offset = WRITE_SIZE + 4000;
+     ok = ok && fat_seek_file(fd, &offset, FAT_SEEK_SET) &&
+	  fat_read_file(fd, buffer, sizeof(buffer)) == sizeof(buffer);
+     check(ok, "file reads after truncating and growing");
+     fat_close_file(fd);
+     sd_raw_sync();
+
+     // and from a fresh open, which maps the chain from the FAT
+     fd = open_file(WRITE_NAME);
+     offset = 20000;
+     ok = fd && fat_seek_file(fd, &offset, FAT_SEEK_SET) &&
+	  fat_read_file(fd, buffer, sizeof(buffer)) == sizeof(buffer) &&
+	  memcmp(buffer, contents + 20000, sizeof(buffer)) == 0;
+     check(ok, "written file reads back after reopening");
+     if (fd)
+	  fat_close_file(fd);
+}
+
+int main(int argc, const char *argv[])
+{
+     image = new FatImage(IMAGE_SECTORS, SECTORS_PER_CLUSTER);
+     uint8_t *contents = (uint8_t *)malloc(RUNS_SIZE);
+
+     srand(1);
+     for (long i = 0; i < RUNS_SIZE; i++)
+	  contents[i] = rand();
+     image->addFile(RUNS_NAME, contents, RUNS_SIZE, RUNS_CLUSTERS, 3);
+     uint16_t runs = image->lastFileRuns();
+     image->addFile(SCATTER_NAME, contents, SCATTER_SIZE, SCATTER_CLUSTERS, 1);
+     uint16_t scatter_runs = image->lastFileRuns();
+     uint32_t scatter_span = (SCATTER_SIZE / image->clusterSize()) *
+	  (SCATTER_CLUSTERS + 1) / SCATTER_CLUSTERS;
+
+     SdCardSim sim(image->data(), image->size());
+     card = sd_card = &sim;
+     card->watch_start = image->fatOffset();
+     card->watch_end = image->fatOffset() + image->fatBytes();
+
+     check(mount(), "mount image");
+     if (!fs)
+	  return 1;
+
+     printf("--- %s, %u runs\n", RUNS_NAME, runs);
+     bench_sequential(RUNS_NAME, contents, RUNS_SIZE, 0);
+     bench_seeks(RUNS_NAME, contents, RUNS_SIZE, 0);
+
+     // beyond the extent map the FAT is followed, a cache window at a time
+     printf("--- %s, %u runs\n", SCATTER_NAME, scatter_runs);
+     bench_sequential(SCATTER_NAME, contents, SCATTER_SIZE,
+		      scatter_span / FAT_CACHE_ENTRIES + 2);
+     bench_seeks(SCATTER_NAME, contents, SCATTER_SIZE,
+		 SEEK_COUNT * (scatter_span / FAT_CACHE_ENTRIES + 2));
+
+     printf("--- writing\n");
+     test_write(contents);
+
+     fat_close(fs);
+     partition_close(partition);
+     delete image;
+     free(contents);
+     if (failures)
+	  printf("%d check(s) failed\n", failures);
+     return(failures ? 1 : 0);
+}
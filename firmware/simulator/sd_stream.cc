@@ -0,0 +1,237 @@
+// sd_stream.cc
+// Run lib_sd against a simulated card and check that a file read front to
+// back the way SD playback reads it is streamed with multiple block reads,
+// that seeking still returns the right data, and that the SPI clock is
+// negotiated down when the connection can't carry the fastest rate.
+// Exits non-zero on failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "SdCardSim.hh"
+#include "FatImage.hh"
+#include "lib_sd/sd_raw.h"
+#include "lib_sd/partition.h"
+#include "lib_sd/fat.h"
+
+#define IMAGE_SECTORS 69632
+#define SECTORS_PER_CLUSTER 16
+#define FILE_NAME "TEST.S3G"
+#define FILE_SIZE (200 * 1024L)
+
+// SD command indices
+#define CMD_READ_SINGLE_BLOCK 17
+#define CMD_READ_MULTIPLE_BLOCK 18
+#define CMD_STOP_TRANSMISSION 12
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+typedef struct {
+     struct partition_struct *partition;
+     struct fat_fs_struct *fs;
+     struct fat_file_struct *file;
+} volume_t;
+
+// Mount the card and open the test file, following sdcard::initCard()
+// and sdcard::startPlayback()
+static bool open_volume(volume_t *v)
+{
+     memset(v, 0, sizeof(*v));
+     if (!sd_raw_init())
+	  return false;
+     v->partition = partition_open(sd_raw_read, sd_raw_read_interval,
+				   sd_raw_write, sd_raw_write_interval, 0);
+     if (!v->partition)
+	  v->partition = partition_open(sd_raw_read, sd_raw_read_interval,
+					sd_raw_write, sd_raw_write_interval, -1);
+     if (!v->partition)
+	  return false;
+     v->fs = fat_open(v->partition);
+     if (!v->fs)
+	  return false;
+
+     struct fat_dir_entry_struct entry;
+     fat_get_dir_entry_of_path(v->fs, "/", &entry);
+     struct fat_dir_struct *dd = fat_open_dir(v->fs, &entry);
+     if (!dd)
+	  return false;
+     bool found = false;
+     while (!found && fat_read_dir(dd, &entry))
+	  found = strcmp(entry.long_name, FILE_NAME) == 0 ||
+	       strcasecmp(entry.long_name, FILE_NAME) == 0;
+     fat_close_dir(dd);
+     if (!found)
+	  return false;
+     v->file = fat_open_file(v->fs, &entry);
+     return v->file != 0;
+}
+
+static void close_volume(volume_t *v)
+{
+     if (v->file)
+	  fat_close_file(v->file);
+     if (v->fs)
+	  fat_close(v->fs);
+     if (v->partition)
+	  partition_close(v->partition);
+}
+
+// Read the whole file a byte at a time, as SD playback does, and compare
+// it with the expected contents.  Returns the number of bytes that matched.
+static long read_file(volume_t *v, const uint8_t *expected)
+{
+     long offset = 0;
+     uint8_t b;
+
+     while (fat_read_file(v->file, &b, 1) == 1) {
+	  if (offset >= FILE_SIZE || b != expected[offset])
+	       break;
+	  offset++;
+     }
+     return offset;
+}
+
+// Read the file with streaming on or off; returns the time on the bus
+static double timed_read(const uint8_t *contents, bool stream)
+{
+     volume_t v;
+     double seconds = 0;
+
+     check(open_volume(&v), "mount and open %s (streaming %s)",
+	   FILE_NAME, stream ? "on" : "off");
+     if (!v.file) {
+	  close_volume(&v);
+	  return 0;
+     }
+
+     sd_raw_stream_enable(stream);
+     sd_card->resetCounters();
+     long matched = read_file(&v, contents);
+     sd_raw_stream_enable(0);
+     seconds = sd_card->seconds;
+
+     uint32_t file_blocks = (FILE_SIZE + 511) / 512;
+     check(matched == FILE_SIZE, "read %ld of %ld bytes correctly",
+	   matched, FILE_SIZE);
+     check(sd_card->protocol_errors == 0, "no protocol errors (%u)",
+	   sd_card->protocol_errors);
+     printf("      %u blocks sent, %u CMD17, %u CMD18, %u CMD12, %.1f ms on the bus\n",
+	    sd_card->blocks_read,
+	    sd_card->commands[CMD_READ_SINGLE_BLOCK],
+	    sd_card->commands[CMD_READ_MULTIPLE_BLOCK],
+	    sd_card->commands[CMD_STOP_TRANSMISSION],
+	    seconds * 1000.0);
+     if (stream) {
+	  // the data blocks come in a handful of streams, broken only when
+	  // the FAT has to be read to find the next cluster
+	  check(sd_card->commands[CMD_READ_SINGLE_BLOCK] +
+		sd_card->commands[CMD_READ_MULTIPLE_BLOCK] < file_blocks / 4,
+		"streamed %u blocks with %u read commands", file_blocks,
+		sd_card->commands[CMD_READ_SINGLE_BLOCK] +
+		sd_card->commands[CMD_READ_MULTIPLE_BLOCK]);
+     }
+     else {
+	  check(sd_card->commands[CMD_READ_MULTIPLE_BLOCK] == 0,
+		"no multiple block reads with streaming off");
+     }
+
+     close_volume(&v);
+     return seconds;
+}
+
+static void test_seek(const uint8_t *contents)
+{
+     volume_t v;
+     uint8_t buffer[700];
+
+     check(open_volume(&v), "mount and open %s for seeking", FILE_NAME);
+     if (!v.file) {
+	  close_volume(&v);
+	  return;
+     }
+     sd_raw_stream_enable(1);
+
+     // read across a block boundary, rewind into the previous block, then
+     // jump well ahead and back to the start
+     static const int32_t offsets[] = { 300, 100, 90000, 0, 150000, 149000 };
+     bool ok = true;
+     for (uint8_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+	  int32_t offset = offsets[i];
+	  if (!fat_seek_file(v.file, &offset, FAT_SEEK_SET) ||
+	      fat_read_file(v.file, buffer, sizeof(buffer)) != sizeof(buffer) ||
+	      memcmp(buffer, contents + offsets[i], sizeof(buffer)) != 0) {
+	       printf("      mismatch reading at %d\n", offsets[i]);
+	       ok = false;
+	  }
+     }
+     check(ok, "reads after seeks return the right data");
+     check(sd_card->protocol_errors == 0, "no protocol errors (%u)",
+	   sd_card->protocol_errors);
+
+     sd_raw_stream_enable(0);
+     close_volume(&v);
+}
+
+static void test_clock(uint32_t link_max_hz, uint8_t expected_divider)
+{
+     sd_card->link_max_hz = link_max_hz;
+     check(sd_raw_init(), "init with link limit %u Hz", link_max_hz);
+     // the clock in effect is seen on the next read from the card
+     uint8_t buffer[16];
+     sd_raw_read(4096, buffer, sizeof(buffer));
+     check(sd_card->divider == expected_divider,
+	   "link limit %u Hz runs at f/%u (expected f/%u)", link_max_hz,
+	   sd_card->divider, expected_divider);
+     sd_card->link_max_hz = 0xffffffff;
+}
+
+int main(int argc, const char *argv[])
+{
+     FatImage image(IMAGE_SECTORS, SECTORS_PER_CLUSTER);
+     uint8_t *contents = (uint8_t *)malloc(FILE_SIZE);
+
+     srand(1);
+     for (long i = 0; i < FILE_SIZE; i++)
+	  contents[i] = rand();
+     image.addFile(FILE_NAME, contents, FILE_SIZE);
+
+     SdCardSim card(image.data(), image.size());
+     sd_card = &card;
+
+     printf("--- sequential read\n");
+     double plain = timed_read(contents, false);
+     double streamed = timed_read(contents, true);
+     check(streamed < plain, "streaming takes %.1f ms against %.1f ms",
+	   streamed * 1000.0, plain * 1000.0);
+
+     printf("--- seeking\n");
+     test_seek(contents);
+
+     printf("--- clock negotiation\n");
+     test_clock(0xffffffff, 2);
+     test_clock(4000000, 4);
+     test_clock(2000000, 8);
+
+     free(contents);
+     if (failures)
+	  printf("%d check(s) failed\n", failures);
+     return(failures ? 1 : 0);
+}
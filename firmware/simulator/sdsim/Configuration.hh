@@ -0,0 +1,17 @@
+// Configuration.hh
+// Minimal board configuration for running lib_sd and the checkpoint
+// code on the host.
+
+#ifndef SDSIM_CONFIGURATION_HH_
+#define SDSIM_CONFIGURATION_HH_
+
+#include "Pin.hh"
+
+// Both pins low: a card is present and it is not write protected
+extern Pin SD_DETECT_PIN;
+extern Pin SD_WRITE_PIN;
+
+// Need STEPPER_COUNT for Checkpoint.hh
+#define STEPPER_COUNT 5
+
+#endif
@@ -0,0 +1,17 @@
+// Pin.hh
+// Card detect and write protect pins for the simulated card.
+
+#ifndef SDSIM_PIN_HH_
+#define SDSIM_PIN_HH_
+
+class Pin {
+public:
+     Pin() : value(false) {}
+     void setDirection(bool out) {}
+     bool getValue() { return value; }
+     void setValue(bool on) { value = on; }
+private:
+     bool value;
+};
+
+#endif
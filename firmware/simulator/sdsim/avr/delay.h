@@ -0,0 +1,10 @@
+// avr/delay.h
+// Busy waits take no time on the simulated card.
+
+#ifndef SDSIM_AVR_DELAY_H_
+#define SDSIM_AVR_DELAY_H_
+
+#define _delay_us(us) ((void)0)
+#define _delay_ms(ms) ((void)0)
+
+#endif
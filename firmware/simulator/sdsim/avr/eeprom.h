@@ -0,0 +1,38 @@
+// avr/eeprom.h
+// Stand-in for the AVR EEPROM access used by the checkpoint code.  The
+// EEPROM is an array in memory, and each byte written is counted so that
+// tests can look at the wear.
+
+#ifndef SDSIM_AVR_EEPROM_H_
+#define SDSIM_AVR_EEPROM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define E2END 0x0FFF
+
+extern uint8_t sdsim_eeprom[E2END + 1];
+extern uint32_t sdsim_eeprom_writes[E2END + 1];
+
+inline uint8_t eeprom_read_byte(const uint8_t *p)
+{
+     return sdsim_eeprom[(uintptr_t)p];
+}
+
+inline void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+     memcpy(dst, sdsim_eeprom + (uintptr_t)src, n);
+}
+
+inline void eeprom_write_byte(uint8_t *p, uint8_t value)
+{
+     sdsim_eeprom[(uintptr_t)p] = value;
+     sdsim_eeprom_writes[(uintptr_t)p]++;
+}
+
+// Writes complete at once
+#define eeprom_is_ready() 1
+#define eeprom_busy_wait() do {} while (0)
+
+#endif
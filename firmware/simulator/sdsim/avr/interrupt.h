@@ -0,0 +1,11 @@
+// avr/interrupt.h
+// Stand-in for the AVR interrupt control; there are no interrupts on the
+// host.
+
+#ifndef SDSIM_AVR_INTERRUPT_H_
+#define SDSIM_AVR_INTERRUPT_H_
+
+#define cli() do {} while (0)
+#define sei() do {} while (0)
+
+#endif
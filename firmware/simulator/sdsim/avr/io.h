@@ -0,0 +1,42 @@
+// avr/io.h
+// Stand-in for the AVR register definitions used by lib_sd, so that
+// sd_raw.c can be run on the host against the simulated card in
+// SdCardSim.  Writing SPDR clocks a byte through the card.
+
+#ifndef SDSIM_AVR_IO_H_
+#define SDSIM_AVR_IO_H_
+
+#include <stdint.h>
+
+class SpiDataRegister {
+public:
+     SpiDataRegister& operator=(uint8_t b);
+     operator uint8_t() const { return received; }
+     uint8_t received;
+};
+
+extern SpiDataRegister SPDR;
+extern uint8_t SPCR, SPSR, DDRB, PORTB;
+
+// SPCR
+#define SPIE  7
+#define SPE   6
+#define DORD  5
+#define MSTR  4
+#define CPOL  3
+#define CPHA  2
+#define SPR1  1
+#define SPR0  0
+
+// SPSR
+#define SPIF  7
+#define WCOL  6
+#define SPI2X 0
+
+#define DDB0 0
+#define DDB1 1
+#define DDB2 2
+#define DDB3 3
+#define PORTB0 0
+
+#endif
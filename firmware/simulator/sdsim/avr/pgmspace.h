@@ -0,0 +1,14 @@
+// avr/pgmspace.h
+// Stand-in for the AVR program memory access used by lib_sd; on the
+// host, program memory is ordinary memory.
+
+#ifndef SDSIM_AVR_PGMSPACE_H_
+#define SDSIM_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(a) (*(const uint8_t *)(a))
+#define pgm_read_word(a) (*(const uint16_t *)(a))
+
+#endif
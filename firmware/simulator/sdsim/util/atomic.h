@@ -0,0 +1,14 @@
+// util/atomic.h
+// Stand-in for the avr-libc atomic blocks; there are no interrupts on the
+// host, so the block just runs once.
+
+#ifndef SDSIM_UTIL_ATOMIC_H_
+#define SDSIM_UTIL_ATOMIC_H_
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 0
+
+#define ATOMIC_BLOCK(type) \
+     for (int atomic_once_ = 1; atomic_once_; atomic_once_ = 0)
+
+#endif
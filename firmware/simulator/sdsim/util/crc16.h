@@ -0,0 +1,34 @@
+// util/crc16.h
+// Stand-in for the avr-libc CRC routines used by the settings and packet
+// code; these are the C equivalents given in the avr-libc documentation.
+
+#ifndef SDSIM_UTIL_CRC16_H_
+#define SDSIM_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+inline uint16_t _crc16_update(uint16_t crc, uint8_t a)
+{
+     crc ^= a;
+     for (int i = 0; i < 8; ++i) {
+	  if (crc & 1)
+	       crc = (crc >> 1) ^ 0xA001;
+	  else
+	       crc = (crc >> 1);
+     }
+     return crc;
+}
+
+inline uint8_t _crc_ibutton_update(uint8_t crc, uint8_t data)
+{
+     crc = crc ^ data;
+     for (int i = 0; i < 8; i++) {
+	  if (crc & 0x01)
+	       crc = (crc >> 1) ^ 0x8C;
+	  else
+	       crc >>= 1;
+     }
+     return crc;
+}
+
+#endif
@@ -0,0 +1,249 @@
+// settings_layout.cc
+// Check the settings kept in SRAM against the EEPROM map.  Each field of
+// each block must sit at the offset the map gives it, byte for byte, and
+// no block may run into the next entry of the map.  Then, against a
+// simulated EEPROM: loading must copy each block exactly, reads must be
+// served from SRAM only when they fall in one block, changes must be
+// written back to the bytes that changed and no others, and a copy in
+// SRAM that has been written over must be reloaded rather than written
+// back.  Exits non-zero on failure.
+//
+// Usage: settings_layout
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "Settings.hh"
+#include <avr/eeprom.h>
+
+uint8_t sdsim_eeprom[E2END + 1];
+uint32_t sdsim_eeprom_writes[E2END + 1];
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+// Offset of a field in the EEPROM, going by the settings layout
+#define AT(block, field) \
+     (block##_offset + offsetof(__typeof__(settings::values.block), field))
+
+#define FIELD(block, field, expected) \
+     check(AT(block, field) == (expected), \
+	   "%s.%s at 0x%04X, map has 0x%04X", #block, #field, \
+	   (unsigned)AT(block, field), (unsigned)(expected))
+
+using namespace eeprom_offsets;
+
+// EEPROM offset of each block, from the same list the code uses
+#define BLOCK_OFFSET(type, name, offset) \
+     static const uint16_t name##_offset = offset;
+SETTINGS_BLOCKS(BLOCK_OFFSET)
+#undef BLOCK_OFFSET
+
+static void check_fields(void)
+{
+     FIELD(axes, axis_inversion, AXIS_INVERSION);
+     FIELD(axes, endstop_inversion, ENDSTOP_INVERSION);
+     FIELD(axes, digi_pots, DIGI_POT_SETTINGS);
+     FIELD(axes, home_direction, AXIS_HOME_DIRECTION);
+
+     FIELD(t0_extruder_pid, p_term, T0_DATA_BASE +
+	   toolhead_eeprom_offsets::EXTRUDER_PID_BASE + pid_eeprom_offsets::P_TERM);
+     FIELD(t0_extruder_pid, i_term, T0_DATA_BASE +
+	   toolhead_eeprom_offsets::EXTRUDER_PID_BASE + pid_eeprom_offsets::I_TERM);
+     FIELD(t0_extruder_pid, d_term, T0_DATA_BASE +
+	   toolhead_eeprom_offsets::EXTRUDER_PID_BASE + pid_eeprom_offsets::D_TERM);
+     FIELD(t0_hbp_pid, d_term, T0_DATA_BASE +
+	   toolhead_eeprom_offsets::HBP_PID_BASE + pid_eeprom_offsets::D_TERM);
+     FIELD(t1_extruder_pid, d_term, T1_DATA_BASE +
+	   toolhead_eeprom_offsets::EXTRUDER_PID_BASE + pid_eeprom_offsets::D_TERM);
+
+     FIELD(led, basic_color, LED_STRIP_SETTINGS + blink_eeprom_offsets::BASIC_COLOR);
+     FIELD(led, led_heat_on, LED_STRIP_SETTINGS + blink_eeprom_offsets::LED_HEAT_ON);
+     FIELD(led, custom_color, LED_STRIP_SETTINGS + blink_eeprom_offsets::CUSTOM_COLOR);
+
+     FIELD(acceleration, acceleration_active, ACCELERATION_SETTINGS +
+	   acceleration_eeprom_offsets::ACCELERATION_ACTIVE);
+     FIELD(acceleration, max_acceleration_normal_move, ACCELERATION_SETTINGS +
+	   acceleration_eeprom_offsets::MAX_ACCELERATION_NORMAL_MOVE);
+     FIELD(acceleration, max_acceleration_axis, ACCELERATION_SETTINGS +
+	   acceleration_eeprom_offsets::MAX_ACCELERATION_AXIS);
+     FIELD(acceleration, max_speed_change, ACCELERATION_SETTINGS +
+	   acceleration_eeprom_offsets::MAX_SPEED_CHANGE);
+     FIELD(acceleration, max_acceleration_extruder_move, ACCELERATION_SETTINGS +
+	   acceleration_eeprom_offsets::MAX_ACCELERATION_EXTRUDER_MOVE);
+     FIELD(acceleration, defaults_flag, ACCELERATION_SETTINGS +
+	   acceleration_eeprom_offsets::DEFAULTS_FLAG);
+
+     FIELD(acceleration2, jkn_advance_k, ACCELERATION2_SETTINGS +
+	   acceleration2_eeprom_offsets::JKN_ADVANCE_K);
+     FIELD(acceleration2, jkn_advance_k2, ACCELERATION2_SETTINGS +
+	   acceleration2_eeprom_offsets::JKN_ADVANCE_K2);
+     FIELD(acceleration2, extruder_deprime_steps, ACCELERATION2_SETTINGS +
+	   acceleration2_eeprom_offsets::EXTRUDER_DEPRIME_STEPS);
+     FIELD(acceleration2, slowdown_flag, ACCELERATION2_SETTINGS +
+	   acceleration2_eeprom_offsets::SLOWDOWN_FLAG);
+
+     FIELD(toolhead_offsets, offset_um, TOOLHEAD_OFFSET_SETTINGS_MM);
+}
+
+// Each block must end before the next entry of the map
+static void check_extents(void)
+{
+     static const struct {
+	  const char *name;
+	  uint16_t    start;
+	  uint16_t    size;
+	  uint16_t    limit;
+     } extents[] = {
+	  { "axes", axes_offset, sizeof(settings::values.axes), AXIS_HOME_POSITIONS_STEPS },
+	  { "hbp_present", hbp_present_offset, 1, T0_DATA_BASE },
+	  { "t0_extruder_pid", t0_extruder_pid_offset, sizeof(settings::PidSettings),
+	    T0_DATA_BASE + toolhead_eeprom_offsets::HBP_PID_BASE },
+	  { "t0_hbp_pid", t0_hbp_pid_offset, sizeof(settings::PidSettings),
+	    T0_DATA_BASE + toolhead_eeprom_offsets::EXTRA_FEATURES },
+	  { "t1_extruder_pid", t1_extruder_pid_offset, sizeof(settings::PidSettings),
+	    T1_DATA_BASE + toolhead_eeprom_offsets::HBP_PID_BASE },
+	  { "led", led_offset, sizeof(settings::BlinkSettings), BUZZ_SETTINGS },
+	  { "sound_on", sound_on_offset, 1, BUZZ_SETTINGS + buzz_eeprom_offsets::ERROR_BUZZ },
+	  { "acceleration", acceleration_offset, sizeof(settings::AccelerationSettings),
+	    BOT_STATUS_BYTES },
+	  { "acceleration2", acceleration2_offset, sizeof(settings::Acceleration2Settings),
+	    ACCELERATION2_SETTINGS + acceleration2_eeprom_offsets::FUTURE_USE },
+	  { "heater_calibration", heater_calibration_offset,
+	    sizeof(settings::CalibrationSettings), VERSION7_UPDATE_FLAG },
+	  { "toolhead_offsets", toolhead_offsets_offset,
+	    sizeof(settings::ToolheadOffsetSettings), HEATER_TIMEOUT_ON_CANCEL },
+	  { "heater_timeout", heater_timeout_offset, 1, AXIS_MAX_FEEDRATES },
+	  { "stop_height", stop_height_offset, 1, PRINT_CHECKPOINT },
+     };
+
+     for (size_t i = 0; i < sizeof(extents) / sizeof(extents[0]); i++)
+	  check(extents[i].start + extents[i].size <= extents[i].limit,
+		"%s ends at 0x%04X, next entry at 0x%04X", extents[i].name,
+		(unsigned)(extents[i].start + extents[i].size),
+		(unsigned)extents[i].limit);
+
+     check(sizeof(settings::Settings) <= 128, "%u bytes of SRAM",
+	   (unsigned)sizeof(settings::Settings));
+}
+
+static bool block_matches(uint16_t eeprom, const void *ram, size_t size)
+{
+     return memcmp(sdsim_eeprom + eeprom, ram, size) == 0;
+}
+
+static void check_load(void)
+{
+     for (size_t i = 0; i <= E2END; i++)
+	  sdsim_eeprom[i] = (uint8_t)(i * 7 + 3);
+     settings::load();
+
+     bool ok = true;
+#define BLOCK_MATCHES(type, name, offset) \
+     ok = ok && block_matches(offset, &settings::values.name, sizeof(settings::values.name));
+     SETTINGS_BLOCKS(BLOCK_MATCHES)
+#undef BLOCK_MATCHES
+     check(ok, "loaded blocks match the EEPROM");
+
+     uint16_t word;
+     check(settings::read(ACCELERATION_SETTINGS +
+			  acceleration_eeprom_offsets::MAX_SPEED_CHANGE + 2, 2, &word) &&
+	   memcmp(&word, sdsim_eeprom + ACCELERATION_SETTINGS +
+		  acceleration_eeprom_offsets::MAX_SPEED_CHANGE + 2, 2) == 0,
+	   "read from a block");
+     check(!settings::read(MACHINE_NAME, 1, &word), "read outside the blocks refused");
+     check(!settings::read(STOP_HEIGHT_VALUE, 2, &word), "read off the end of a block refused");
+     check(!settings::read(HEATER_TIMEOUT_ON_CANCEL - 1, 2, &word),
+	   "read across the start of a block refused");
+}
+
+static void check_write_back(void)
+{
+     uint8_t before[E2END + 1];
+     uint32_t unchanged;
+
+     settings::load();
+     memcpy(before, sdsim_eeprom, sizeof(before));
+     memset(sdsim_eeprom_writes, 0, sizeof(sdsim_eeprom_writes));
+
+     uint8_t sound = sdsim_eeprom[BUZZ_SETTINGS] ^ 1;
+     int32_t offset = -1234;
+     uint8_t same = sdsim_eeprom[STOP_HEIGHT_VALUE];
+     uint8_t name = 'R';
+     settings::write(BUZZ_SETTINGS, &sound, 1);
+     settings::write(TOOLHEAD_OFFSET_SETTINGS_MM + 4, &offset, 4);
+     settings::write(STOP_HEIGHT_VALUE, &same, 1);
+     settings::write(MACHINE_NAME, &name, 1);
+
+     check(sdsim_eeprom[BUZZ_SETTINGS] == before[BUZZ_SETTINGS],
+	   "change held back until written back");
+     check(sdsim_eeprom[MACHINE_NAME] == 'R', "byte outside the blocks written at once");
+     uint8_t got;
+     check(settings::read(BUZZ_SETTINGS, 1, &got) && got == sound,
+	   "change read back before it is written back");
+
+     settings::update();
+     check(sdsim_eeprom_writes[BUZZ_SETTINGS] + sdsim_eeprom_writes[TOOLHEAD_OFFSET_SETTINGS_MM + 4] <= 1,
+	   "one byte written back a call");
+     settings::flush();
+
+     check(sdsim_eeprom[BUZZ_SETTINGS] == sound, "sound setting written back");
+     check(memcmp(sdsim_eeprom + TOOLHEAD_OFFSET_SETTINGS_MM + 4, &offset, 4) == 0,
+	   "toolhead offset written back");
+
+     unchanged = 0;
+     for (size_t i = 0; i <= E2END; i++)
+	  if (sdsim_eeprom[i] == before[i] && sdsim_eeprom_writes[i] != 0)
+	       unchanged++;
+     check(unchanged == 0, "%u unchanged bytes written", (unsigned)unchanged);
+     check(sdsim_eeprom_writes[STOP_HEIGHT_VALUE] == 0, "setting to the same value writes nothing");
+}
+
+static void check_corruption(void)
+{
+     settings::load();
+     memset(sdsim_eeprom_writes, 0, sizeof(sdsim_eeprom_writes));
+
+     uint8_t height = sdsim_eeprom[STOP_HEIGHT_VALUE] + 1;
+     settings::write(STOP_HEIGHT_VALUE, &height, 1);
+     // as a stack overrun would
+     memset(&settings::values.acceleration, 0, sizeof(settings::values.acceleration));
+     settings::flush();
+
+     uint32_t writes = 0;
+     for (size_t i = 0; i <= E2END; i++)
+	  writes += sdsim_eeprom_writes[i];
+     check(writes == 0, "damaged settings not written back (%u writes)", (unsigned)writes);
+     check(block_matches(ACCELERATION_SETTINGS, &settings::values.acceleration,
+			 sizeof(settings::values.acceleration)),
+	   "damaged settings reloaded");
+}
+
+int main(void)
+{
+     check_fields();
+     check_extents();
+     check_load();
+     check_write_back();
+     check_corruption();
+
+     return(failures ? 1 : 0);
+}
@@ -0,0 +1,201 @@
+// step_kernel.cc
+// Time the step events of StepperAxis.hh on the host: the one which runs
+// the dda of every axis, checking each for being enabled, against the
+// kernel stepperAxisSelectStepKernel() picks for the axes a block moves.
+// Each set of axes is run through the same block both ways, and the
+// positions reached and the steps made must agree.
+//
+// The times are host cycles (nanoseconds where there is no cycle
+// counter), so only the ratios carry over to the AVR.
+// Exits non-zero on failure.
+//
+// Usage: step_kernel [events]
+//
+//   events defaults to 2000000 per set of axes and way
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static void port_write(uint8_t port, uint8_t bits, bool set);
+
+#define STEPPER_SIM_WRITE(PORT, BITS, SET) port_write(PORT, BITS, SET)
+
+// The pins of mighty_two, from Configuration.hh
+#include "StepperAxis.hh"
+
+struct StepperAxis stepperAxis[STEPPER_COUNT];
+
+volatile int32_t dda_position[STEPPER_COUNT];
+volatile bool    axis_homing[STEPPER_COUNT];
+volatile int16_t e_steps[EXTRUDERS];
+volatile uint8_t axesEnabled;
+volatile uint8_t axesHardwareEnabled;
+volatile uint8_t endstops_triggered;
+
+// Stands in for the port registers, so that the writes are not optimized
+// away
+static volatile uint8_t ports[128];
+static unsigned rises[STEPPER_COUNT];
+static bool counting;
+
+static const uint8_t step_port[STEPPER_COUNT] = {
+     StepperAxisPins<X_AXIS>::Step::port_id, StepperAxisPins<Y_AXIS>::Step::port_id,
+     StepperAxisPins<Z_AXIS>::Step::port_id, StepperAxisPins<A_AXIS>::Step::port_id,
+     StepperAxisPins<B_AXIS>::Step::port_id
+};
+
+static const uint8_t step_bit[STEPPER_COUNT] = {
+     StepperAxisPins<X_AXIS>::Step::bit, StepperAxisPins<Y_AXIS>::Step::bit,
+     StepperAxisPins<Z_AXIS>::Step::bit, StepperAxisPins<A_AXIS>::Step::bit,
+     StepperAxisPins<B_AXIS>::Step::bit
+};
+
+typedef struct {
+     const char *name;
+     uint8_t axes;
+} mask_t;
+
+static const mask_t masks[] = {
+     { "xy",    STEP_KERNEL_XY },
+     { "xya",   STEP_KERNEL_XYA },
+     { "xyb",   STEP_KERNEL_XYB },
+     { "z",     STEP_KERNEL_Z },
+     { "a",     STEP_KERNEL_A },
+     { "b",     STEP_KERNEL_B },
+     { "xyza",  STEP_KERNEL_XYA | _BV(Z_AXIS) },
+};
+
+// Steps of each axis, for the axes a block moves; X is the master
+static const int32_t ratio[STEPPER_COUNT] = { 1000, -731, 517, 211, -167 };
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static void port_write(uint8_t port, uint8_t bits, bool set)
+{
+     uint8_t was = ports[port];
+     int i;
+
+     ports[port] = set ? (was | bits) : (was & ~bits);
+     if (!counting)
+	  return;
+     for (i = 0; i < STEPPER_COUNT; i++)
+	  if (step_port[i] == port && set && (bits & ~was & step_bit[i]))
+	       rises[i]++;
+}
+
+static uint64_t ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+     return __rdtsc();
+#else
+     struct timespec ts;
+
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+// Sets the dda's up for a block of the given axes, scaled to events step
+// events, the way setup_next_block() does
+static void reset_block(uint8_t axes, int32_t events)
+{
+     int i;
+
+     for (i = 0; i < STEPPER_COUNT; i++) {
+	  int32_t steps = (axes & _BV(i)) ? ratio[i] * (int64_t)events / ratio[0] : 0;
+	  // the first axis of the block is the master
+	  if (axes & _BV(i) && !(axes & (_BV(i) - 1)))
+	       steps = events;
+	  dda_position[i] = 0;
+	  rises[i] = 0;
+	  stepperAxis_dda_reset((uint8_t)i, false, events, steps < 0, labs(steps));
+     }
+}
+
+// Runs a block through a step event, best of a few, and returns the ticks
+// per event; positions[] gets where the axes ended up
+static double run(StepperAxisStepKernel kernel, uint8_t axes, int32_t events,
+		  int32_t positions[STEPPER_COUNT], unsigned steps[STEPPER_COUNT])
+{
+     double best = 0;
+     int pass, i;
+
+     for (pass = 0; pass < 3; pass++) {
+	  uint64_t start;
+	  int32_t e;
+
+	  reset_block(axes, events);
+	  counting = pass == 0;
+	  start = ticks();
+	  for (e = 0; e < events; e++)
+	       kernel();
+	  double per_event = (double)(ticks() - start) / events;
+	  if (pass == 0 || per_event < best)
+	       best = per_event;
+	  if (pass == 0)
+	       for (i = 0; i < STEPPER_COUNT; i++) {
+		    positions[i] = dda_position[i];
+		    steps[i] = rises[i];
+	       }
+     }
+     counting = false;
+     return best;
+}
+
+int main(int argc, const char *argv[])
+{
+     int32_t events = argc > 1 ? atol(argv[1]) : 2000000;
+     unsigned m;
+
+     if (events <= 0) {
+	  fprintf(stderr, "Usage: %s [events]\n", argv[0]);
+	  return(1);
+     }
+
+     printf("axes   every axis  kernel   ratio\n");
+     for (m = 0; m < sizeof(masks) / sizeof(masks[0]); m++) {
+	  int32_t any_pos[STEPPER_COUNT], kernel_pos[STEPPER_COUNT];
+	  unsigned any_steps[STEPPER_COUNT], kernel_steps[STEPPER_COUNT];
+	  StepperAxisStepKernel kernel = stepperAxisSelectStepKernel(masks[m].axes, false);
+	  double any = run(stepperAxis_dda_step_kernel_any, masks[m].axes, events,
+			   any_pos, any_steps);
+	  double own = run(kernel, masks[m].axes, events, kernel_pos, kernel_steps);
+	  bool moved = true;
+	  int i;
+
+	  for (i = 0; i < STEPPER_COUNT; i++)
+	       if ((masks[m].axes & _BV(i)) && (kernel_pos[i] == 0 ||
+						(unsigned)labs(kernel_pos[i]) != kernel_steps[i]))
+		    moved = false;
+	  printf("%-5s %9.1f %9.1f %7.2f%s\n", masks[m].name, any, own, own / any,
+		 kernel == stepperAxis_dda_step_kernel_any ? "  (fallback)" : "");
+	  check(memcmp(any_pos, kernel_pos, sizeof(any_pos)) == 0 &&
+		memcmp(any_steps, kernel_steps, sizeof(any_steps)) == 0 && moved,
+		"%s: kernel makes the same steps as stepping every axis", masks[m].name);
+     }
+
+     return(failures ? 1 : 0);
+}
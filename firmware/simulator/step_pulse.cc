@@ -0,0 +1,318 @@
+// step_pulse.cc
+// Run the stepper dda's from StepperAxis.hh through a few blocks, against
+// the step and direction pins of a board, with every port write counted.
+// Checks that each axis gets exactly its steps, that the step pins are all
+// low again after each step event, that the direction pins are set when
+// the block is set up and not touched while it steps, that step pins which
+// share a port are pulsed with one write per edge, that each step pin is
+// held high for at least the 1us the drivers need, counting a port write
+// as the one cycle of the quickest at 16MHz, and that a triggered
+// endstop stops an axis, inverted or not: read before every step when
+// homing, and latched, with no pin read per step, otherwise.
+//
+// Prints the port writes per step event, against the three writes per
+// axis step (direction, step high, step low) of stepping each axis by
+// itself.
+//
+// Built for the pins of mighty_two from Configuration.hh, and as
+// step_pulse_one for those of mighty_one.
+// Exits non-zero on failure.
+//
+// Usage: step_pulse
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+
+static void port_write(uint8_t port, uint8_t bits, bool set);
+static uint8_t ports[128];
+static unsigned reads;
+
+// A clock in cycles at 16MHz, which the port writes and delays advance
+#define CYCLES_PER_US	16
+static unsigned long cycles;
+
+#define STEPPER_SIM_WRITE(PORT, BITS, SET) port_write(PORT, BITS, SET)
+#define STEPPER_SIM_READ(PORT) (reads++, ports[PORT])
+#define STEPPER_SIM_DELAY_US(MICROS) (cycles += (unsigned long)((MICROS) * CYCLES_PER_US))
+
+#include "StepperAxis.hh"
+
+#ifndef STEP_PULSE_BOARD
+#define STEP_PULSE_BOARD "mighty_two"
+#endif
+
+struct StepperAxis stepperAxis[STEPPER_COUNT];
+
+volatile int32_t dda_position[STEPPER_COUNT];
+volatile bool    axis_homing[STEPPER_COUNT];
+volatile int16_t e_steps[EXTRUDERS];
+volatile uint8_t axesEnabled;
+volatile uint8_t axesHardwareEnabled;
+volatile uint8_t endstops_triggered;
+
+typedef struct {
+     uint8_t port;
+     uint8_t bit;
+} pin_t;
+
+#define PIN_OF(AXIS, PIN) \
+     { StepperAxisPins<AXIS>::PIN::port_id, StepperAxisPins<AXIS>::PIN::bit }
+
+static const pin_t step_pins[STEPPER_COUNT] = {
+     PIN_OF(X_AXIS, Step), PIN_OF(Y_AXIS, Step), PIN_OF(Z_AXIS, Step),
+     PIN_OF(A_AXIS, Step), PIN_OF(B_AXIS, Step)
+};
+
+static const pin_t dir_pins[STEPPER_COUNT] = {
+     PIN_OF(X_AXIS, Dir), PIN_OF(Y_AXIS, Dir), PIN_OF(Z_AXIS, Dir),
+     PIN_OF(A_AXIS, Dir), PIN_OF(B_AXIS, Dir)
+};
+
+static const pin_t x_max = PIN_OF(X_AXIS, Maximum);
+
+// In endstop bit order, minimum then maximum of each axis
+static const pin_t endstop_pins[6] = {
+     PIN_OF(X_AXIS, Minimum), PIN_OF(X_AXIS, Maximum), PIN_OF(Y_AXIS, Minimum),
+     PIN_OF(Y_AXIS, Maximum), PIN_OF(Z_AXIS, Minimum), PIN_OF(Z_AXIS, Maximum)
+};
+
+// Axes which name their step group; one per port with step pins on it
+#define NAMES_GROUP(AXIS) ((int)StepperStepGroup<AXIS>::value == (int)AXIS)
+
+static const unsigned step_groups =
+     NAMES_GROUP(X_AXIS) + NAMES_GROUP(Y_AXIS) + NAMES_GROUP(Z_AXIS) +
+     NAMES_GROUP(A_AXIS) + NAMES_GROUP(B_AXIS);
+
+typedef struct {
+     const char *name;
+     int32_t steps[STEPPER_COUNT];   // negative steps run backwards
+} block_t;
+
+static const block_t blocks[] = {
+     { "x",          { 1000, 0, 0, 0, 0 } },
+     { "z",          { 0, 0, -500, 0, 0 } },
+     { "xy, a",      { 1200, -800, 0, 400, 0 } },
+     { "xyz, a, b",  { 900, 900, -300, 250, -250 } },
+};
+
+static unsigned writes;
+static unsigned dir_writes;
+static unsigned rises[STEPPER_COUNT];
+static unsigned long risen_at[STEPPER_COUNT];
+static unsigned long shortest_high;
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static void port_write(uint8_t port, uint8_t bits, bool set)
+{
+     uint8_t was = ports[port];
+     int i;
+
+     ports[port] = set ? (was | bits) : (was & ~bits);
+     writes++;
+     cycles++;
+     for (i = 0; i < STEPPER_COUNT; i++) {
+	  if (step_pins[i].port == port && (ports[port] & ~was & step_pins[i].bit)) {
+	       rises[i]++;
+	       risen_at[i] = cycles;
+	  }
+	  if (step_pins[i].port == port && (was & ~ports[port] & step_pins[i].bit) &&
+	      cycles - risen_at[i] < shortest_high)
+	       shortest_high = cycles - risen_at[i];
+	  if (dir_pins[i].port == port && (bits & dir_pins[i].bit))
+	       dir_writes++;
+     }
+}
+
+static bool pin_high(const pin_t *p)
+{
+     return (ports[p->port] & p->bit) != 0;
+}
+
+// Sets the dda's up for a block, as setup_next_block() does, and returns
+// the number of step events in it
+static int32_t reset_block(const block_t *block)
+{
+     int32_t master = 0;
+     uint8_t master_axis = 0;
+     int i;
+
+     for (i = 0; i < STEPPER_COUNT; i++) {
+	  int32_t n = labs(block->steps[i]);
+	  if (n > master) {
+	       master = n;
+	       master_axis = (uint8_t)i;
+	  }
+	  dda_position[i] = 0;
+	  rises[i] = 0;
+     }
+     for (i = 0; i < STEPPER_COUNT; i++)
+	  stepperAxis_dda_reset((uint8_t)i, i == master_axis, master,
+				block->steps[i] < 0, labs(block->steps[i]));
+     return master;
+}
+
+static void run_block(const block_t *block)
+{
+     unsigned total = 0, setup_dir_writes, events, i;
+     bool dirs_ok = true, steps_ok = true, low_ok = true;
+     uint8_t groups_used = 0;
+     int32_t master;
+
+     for (i = 0; i < STEPPER_COUNT; i++)
+	  total += (unsigned)labs(block->steps[i]);
+
+     writes = dir_writes = 0;
+     master = reset_block(block);
+     setup_dir_writes = dir_writes;
+     for (i = 0; i < STEPPER_COUNT; i++) {
+	  bool forward = block->steps[i] > 0;
+	  if (block->steps[i] &&
+	      pin_high(&dir_pins[i]) != (forward != stepperAxis[i].invert_axis))
+	       dirs_ok = false;
+     }
+
+     writes = dir_writes = 0;
+     shortest_high = ~0UL;
+     for (events = 0; events < (unsigned)master; events++) {
+	  stepperAxis_dda_step_event<false>();
+	  for (i = 0; i < STEPPER_COUNT; i++)
+	       if (pin_high(&step_pins[i]))
+		    low_ok = false;
+     }
+     for (i = 0; i < STEPPER_COUNT; i++) {
+	  if (rises[i] != (unsigned)labs(block->steps[i]) ||
+	      dda_position[i] != block->steps[i])
+	       steps_ok = false;
+	  if (block->steps[i]) {
+	       unsigned g;
+	       for (g = 0; g < STEPPER_COUNT; g++)
+		    if (step_pins[g].port == step_pins[i].port)
+			 break;
+	       groups_used |= (uint8_t)_BV(g);
+	  }
+     }
+
+     printf("%-10s %-10s %6u %6u %9.2f %9.2f\n", STEP_PULSE_BOARD, block->name,
+	    events, total, 3.0 * total / events, (double)writes / events);
+
+     check(dirs_ok && setup_dir_writes > 0 && dir_writes == 0,
+	   "%s: direction pins set once, at block setup", block->name);
+     check(steps_ok, "%s: every axis made its steps", block->name);
+     check(low_ok, "%s: step pins low after every event", block->name);
+     check(writes <= 2 * events * (unsigned)__builtin_popcount(groups_used),
+	   "%s: %u port writes, at most two per port per event", block->name, writes);
+     check(shortest_high >= STEPPER_STEP_HIGH_MICROS * CYCLES_PER_US,
+	   "%s: step pins high for at least %lu cycles, %u needed", block->name,
+	   shortest_high, STEPPER_STEP_HIGH_MICROS * CYCLES_PER_US);
+}
+
+// X runs towards its maximum endstop with the endstop pin high, which is
+// triggered unless the endstops are inverted.  Homing reads the endstop
+// before every step.
+static void check_homing(uint8_t endstop_xor)
+{
+     static const block_t block = { "x to max", { 200, 0, 0, 0, 0 } };
+     int32_t master, e;
+
+     stepperAxis[X_AXIS].endstop_xor = endstop_xor;
+     ports[x_max.port] |= x_max.bit;
+     axis_homing[X_AXIS] = true;
+     master = reset_block(&block);
+     for (e = 0; e < master; e++)
+	  stepperAxis_dda_step_kernel_homing();
+     if (endstop_xor)
+	  check(rises[X_AXIS] == 200 && axis_homing[X_AXIS],
+		"homing, inverted endstop high: x made %u of 200 steps", rises[X_AXIS]);
+     else
+	  check(rises[X_AXIS] == 0 && !axis_homing[X_AXIS],
+		"homing, endstop high: x made %u of 200 steps, homing ended", rises[X_AXIS]);
+     ports[x_max.port] &= ~x_max.bit;
+     stepperAxis[X_AXIS].endstop_xor = 0;
+     axis_homing[X_AXIS] = false;
+}
+
+// Outside homing the step events read no endstop pin; an endstop latched
+// part way through a block stops the axes running into it from then on,
+// and no others
+static void check_latched(void)
+{
+     static const block_t block = { "xy", { 300, -300, 0, 0, 0 } };
+     StepperAxisStepKernel kernel = stepperAxisSelectStepKernel(STEP_KERNEL_XY, false);
+     int32_t master, e;
+
+     endstops_triggered = 0;
+     master = reset_block(&block);
+     reads = 0;
+     for (e = 0; e < master; e++) {
+	  if (e == 100)
+	       endstops_triggered = ENDSTOP_MAX(X_AXIS) | ENDSTOP_MAX(Y_AXIS);
+	  kernel();
+     }
+     check(reads == 0, "printing: %u endstop reads in %d step events", reads, master);
+     check(rises[X_AXIS] == 100 && rises[Y_AXIS] == 300 && dda_position[X_AXIS] == 300,
+	   "printing, x max latched after 100 events: x made %u of 300 steps, y (moving "
+	   "to min) %u", rises[X_AXIS], rises[Y_AXIS]);
+     endstops_triggered = 0;
+}
+
+// Each endstop is either on the pin change interrupt or polled
+static void check_endstop_sources(void)
+{
+     uint8_t e;
+
+     for (e = 0; e < 6; e++) {
+	  const pin_t *pin = &endstop_pins[e];
+	  bool polled = (ENDSTOPS_POLLED & _BV(e)) != 0;
+	  bool pin_change = pin->port == 'J' && (ENDSTOPS_PCMSK & (pin->bit << 1));
+	  uint8_t latched;
+
+	  endstops_triggered = 0;
+	  ports[pin->port] |= pin->bit;
+	  stepperAxisPollEndstops();
+	  latched = endstops_triggered;
+	  ports[pin->port] &= ~pin->bit;
+	  check(latched == (polled ? _BV(e) : 0) && polled != pin_change,
+		"%s endstop %u on port %c: %s", STEP_PULSE_BOARD, e, pin->port,
+		polled ? "polled" : "pin change interrupt");
+     }
+     endstops_triggered = 0;
+}
+
+int main(void)
+{
+     unsigned k;
+
+     // one inverted axis, as the AXIS_INVERSION setting allows
+     stepperAxis[Y_AXIS].invert_axis = true;
+
+     check(step_groups == 3, "%s: step pins on %u ports", STEP_PULSE_BOARD, step_groups);
+     printf("board      block      events  steps  old w/ev  new w/ev\n");
+     for (k = 0; k < sizeof(blocks) / sizeof(blocks[0]); k++)
+	  run_block(&blocks[k]);
+     check_homing(0);
+     check_homing(0xFF);
+     check_latched();
+     check_endstop_sources();
+
+     return(failures ? 1 : 0);
+}
@@ -0,0 +1,34 @@
+// step_pulse_one.cc
+// step_pulse against the stepper pins of mighty_one.
+//
+// Usage: step_pulse_one
+
+#define STEP_PULSE_BOARD "mighty_one"
+
+#define X_STEPPER_STEP          STEPPER_PORT(F,1)
+#define X_STEPPER_DIR           STEPPER_PORT(F,0)
+#define X_STEPPER_ENABLE        STEPPER_PORT(F,2)
+#define X_STEPPER_MIN           STEPPER_PORT(L,0)
+#define X_STEPPER_MAX           STEPPER_PORT(L,1)
+
+#define Y_STEPPER_STEP          STEPPER_PORT(F,5)
+#define Y_STEPPER_DIR           STEPPER_PORT(F,4)
+#define Y_STEPPER_ENABLE        STEPPER_PORT(F,6)
+#define Y_STEPPER_MIN           STEPPER_PORT(L,2)
+#define Y_STEPPER_MAX           STEPPER_PORT(L,3)
+
+#define Z_STEPPER_STEP          STEPPER_PORT(K,1)
+#define Z_STEPPER_DIR           STEPPER_PORT(K,0)
+#define Z_STEPPER_ENABLE        STEPPER_PORT(K,2)
+#define Z_STEPPER_MIN           STEPPER_PORT(L,6)
+#define Z_STEPPER_MAX           STEPPER_PORT(L,7)
+
+#define A_STEPPER_STEP          STEPPER_PORT(A,3)
+#define A_STEPPER_DIR           STEPPER_PORT(A,2)
+#define A_STEPPER_ENABLE        STEPPER_PORT(A,4)
+
+#define B_STEPPER_STEP          STEPPER_PORT(A,7)
+#define B_STEPPER_DIR           STEPPER_PORT(A,6)
+#define B_STEPPER_ENABLE        STEPPER_PORT(G,2)
+
+#include "step_pulse.cc"
@@ -0,0 +1,113 @@
+// Print the telemetry frames in a stream read from the bot, either from
+// its serial port or from a capture of one
+//
+//     telemetry_decode /dev/ttyACM0
+//
+// or
+//
+//     telemetry_decode < capture
+//
+// Telemetry is started with HOST_CMD_SET_TELEMETRY; the responses to the
+// host's packets which are interleaved with it are counted but not shown.
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <termios.h>
+
+#include "s3g_link.h"
+
+static void usage(FILE *f, const char *prog)
+{
+     if (f == NULL)
+	  f = stderr;
+
+     fprintf(f,
+"Usage: %s -h [file]\n"
+"   file  -- Serial port or capture to read.  If not supplied then stdin is read\n"
+"  ?, -h  -- This help message\n",
+	     prog ? prog : "telemetry_decode");
+}
+
+// Put a serial port into raw mode at 115200 baud; leave anything else be
+static void raw_mode(int fd)
+{
+     struct termios tio;
+
+     if (!isatty(fd) || tcgetattr(fd, &tio) != 0)
+	  return;
+     cfmakeraw(&tio);
+     cfsetispeed(&tio, B115200);
+     cfsetospeed(&tio, B115200);
+     tcsetattr(fd, TCSANOW, &tio);
+}
+
+static void print_status(const s3g_telemetry_status_t *st)
+{
+     static int first = 1;
+
+     if (first) {
+	  printf("seq  tool0 tool1  hbp  out0 out1 hbp  cmdfree blocks     line"
+		 "          x          y          z\n");
+	  first = 0;
+     }
+     printf("%3u  %5d %5d %4d  %4u %4u %3u  %7u %6u %8u %10d %10d %10d\n",
+	    st->sequence, st->tool_temp[0], st->tool_temp[1], st->platform_temp,
+	    st->tool_output[0], st->tool_output[1], st->platform_output,
+	    st->command_free, st->planner_blocks, st->line,
+	    st->position[0], st->position[1], st->position[2]);
+     fflush(stdout);
+}
+
+int main(int argc, const char *argv[])
+{
+     unsigned char buf[256];
+     s3g_link_t link;
+     int fd = 0;
+     ssize_t n;
+     int c;
+
+     while ((c = getopt(argc, (char **)argv, ":h?")) != -1)
+     {
+	  switch(c)
+	  {
+	  case 'h' :
+	  case '?' :
+	  default :
+	       usage(stdout, argv[0]);
+	       return(1);
+	  }
+     }
+     argc -= optind;
+     argv += optind;
+
+     if (argc > 0) {
+	  fd = open(argv[0], O_RDONLY | O_NOCTTY);
+	  if (fd < 0) {
+	       fprintf(stderr, "Unable to open \"%s\"; %s (%d)\n",
+		       argv[0], strerror(errno), errno);
+	       return(1);
+	  }
+	  raw_mode(fd);
+     }
+
+     s3g_link_init(&link);
+     while ((n = read(fd, buf, sizeof(buf))) > 0) {
+	  ssize_t i;
+	  for (i = 0; i < n; i++) {
+	       s3g_telemetry_status_t st;
+	       if (s3g_link_byte(&link, buf[i]) == S3G_LINK_TELEMETRY &&
+		   s3g_link_telemetry_status(&link, &st) == 0)
+		    print_status(&st);
+	  }
+     }
+
+     fprintf(stderr, "%u telemetry frames, %u responses, %u CRC errors, "
+	     "%u noise bytes\n", link.frames, link.responses, link.errors,
+	     link.noise);
+     if (fd != 0)
+	  close(fd);
+     return(0);
+}
@@ -0,0 +1,176 @@
+// telemetry_stream.cc
+// Check the host side telemetry decoder against frames built by the
+// firmware's own packet code.  Telemetry frames are laid out the way
+// host::sendTelemetry() lays them out, and sent between response packets
+// with noise on the line and the odd corrupted byte.  Every good frame and
+// response must come out of the decoder, with the values that went in;
+// corrupted ones must be counted as errors without losing the ones after.
+// Exits non-zero on failure.
+//
+// Usage: telemetry_stream
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <vector>
+
+#include "Packet.hh"
+#include "Commands.hh"
+#include "s3g_link.h"
+
+#define FRAMES 500
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static void random_status(s3g_telemetry_status_t *st, uint8_t sequence)
+{
+     st->sequence = sequence;
+     st->tool_temp[0] = rand() % 300;
+     st->tool_temp[1] = rand() % 300 - 20;
+     st->platform_temp = rand() % 130;
+     st->tool_output[0] = rand();
+     st->tool_output[1] = rand();
+     st->platform_output = rand();
+     st->command_free = rand() % 513;
+     st->planner_blocks = rand() % 16;
+     st->line = rand();
+     for (int i = 0; i < 3; i++)
+	  st->position[i] = rand() - RAND_MAX / 2;
+}
+
+// As host::sendTelemetry()
+static void build_status(OutPacket& out, const s3g_telemetry_status_t *st)
+{
+     out.reset();
+     out.setStartByte(TELEMETRY_START_BYTE);
+     out.append8(TELEMETRY_FRAME_STATUS);
+     out.append8(st->sequence);
+     out.append16(st->tool_temp[0]);
+     out.append16(st->tool_temp[1]);
+     out.append16(st->platform_temp);
+     out.append8(st->tool_output[0]);
+     out.append8(st->tool_output[1]);
+     out.append8(st->platform_output);
+     out.append16(st->command_free);
+     out.append8(st->planner_blocks);
+     out.append32(st->line);
+     for (int i = 0; i < 3; i++)
+	  out.append32(st->position[i]);
+}
+
+static void build_response(OutPacket& out)
+{
+     out.reset();
+     out.append8(RC_OK);
+     uint8_t n = rand() % 8;
+     for (uint8_t i = 0; i < n; i++)
+	  out.append8(rand());
+}
+
+static void send(OutPacket& out, std::vector<uint8_t>& line)
+{
+     while (!out.isFinished())
+	  line.push_back(out.getNextByteToSend());
+}
+
+static bool same_status(const s3g_telemetry_status_t *a, const s3g_telemetry_status_t *b)
+{
+     return a->sequence == b->sequence &&
+	  a->tool_temp[0] == b->tool_temp[0] && a->tool_temp[1] == b->tool_temp[1] &&
+	  a->platform_temp == b->platform_temp &&
+	  a->tool_output[0] == b->tool_output[0] && a->tool_output[1] == b->tool_output[1] &&
+	  a->platform_output == b->platform_output &&
+	  a->command_free == b->command_free && a->planner_blocks == b->planner_blocks &&
+	  a->line == b->line &&
+	  a->position[0] == b->position[0] && a->position[1] == b->position[1] &&
+	  a->position[2] == b->position[2];
+}
+
+int main(void)
+{
+     std::vector<s3g_telemetry_status_t> sent;
+     std::vector<uint8_t> line;
+     uint32_t responses = 0, corrupted = 0;
+     OutPacket out;
+
+     srand(37);
+
+     check(S3G_LINK_START_BYTE == START_BYTE &&
+	   S3G_LINK_TELEMETRY_START_BYTE == TELEMETRY_START_BYTE,
+	   "decoder start bytes match Packet.hh");
+
+     s3g_telemetry_status_t st;
+     random_status(&st, 0);
+     build_status(out, &st);
+     check(out.getLength() == TELEMETRY_STATUS_LENGTH, "status frame is %u bytes",
+	   out.getLength());
+     check(out.getLength() <= MAX_PACKET_PAYLOAD, "status frame fits a packet");
+
+     for (int i = 0; i < FRAMES; i++) {
+	  // responses to the host, then a frame between them
+	  uint8_t n = rand() % 3;
+	  for (uint8_t r = 0; r < n; r++) {
+	       build_response(out);
+	       send(out, line);
+	       responses++;
+	  }
+	  if (rand() % 10 == 0)
+	       line.push_back(0x00); // noise
+	  random_status(&st, (uint8_t)i);
+	  build_status(out, &st);
+	  size_t at = line.size();
+	  send(out, line);
+	  if (rand() % 25 == 0) {
+	       // flip a payload bit, keeping the start and length bytes
+	       line[at + 2 + rand() % TELEMETRY_STATUS_LENGTH] ^= 0x10;
+	       corrupted++;
+	  } else
+	       sent.push_back(st);
+     }
+
+     s3g_link_t link;
+     s3g_link_init(&link);
+     size_t next = 0;
+     bool in_order = true;
+     for (size_t i = 0; i < line.size(); i++) {
+	  if (s3g_link_byte(&link, line[i]) != S3G_LINK_TELEMETRY)
+	       continue;
+	  s3g_telemetry_status_t got;
+	  if (s3g_link_telemetry_status(&link, &got) != 0 || next >= sent.size() ||
+	      !same_status(&got, &sent[next]))
+	       in_order = false;
+	  next++;
+     }
+
+     check(in_order, "decoded frames match the frames sent");
+     check(next == sent.size(), "%u of %u good frames decoded", (unsigned)next,
+	   (unsigned)sent.size());
+     check(link.responses == responses, "%u of %u responses found", link.responses,
+	   responses);
+     check(link.errors == corrupted, "%u of %u corrupted frames rejected", link.errors,
+	   corrupted);
+
+     // a frame of another type is not taken for a status frame
+     link.length = TELEMETRY_STATUS_LENGTH;
+     link.payload[0] = TELEMETRY_FRAME_STATUS + 1;
+     check(s3g_link_telemetry_status(&link, &st) != 0, "unknown frame type refused");
+
+     return(failures ? 1 : 0);
+}
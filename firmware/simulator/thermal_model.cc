@@ -0,0 +1,220 @@
+// thermal_model.cc
+// Exercise ThermalModel and PID against a simulated heater.  The plant is a
+// heater block with first order losses followed by a lagging sensor, sampled
+// and quantized the way the firmware sees it.  Exits non-zero on failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <math.h>
+
+#include "PID.hh"
+#include "ThermalModel.hh"
+
+// Sample interval of the heater loop, in seconds
+#define SAMPLE_SECONDS 0.5
+
+// Same bypass band as Heater.cc
+#define PID_BYPASS_DELTA 10
+
+typedef struct {
+     const char *name;
+     float gain;      // steady state rise at full output
+     float tau;       // block time constant, seconds
+     float lag;       // sensor time constant, seconds
+     float ambient;
+     float block;     // block temperature
+     float sensor;    // sensor temperature
+} plant_t;
+
+typedef struct {
+     PID pid;
+     ThermalModel model;
+     bool use_ff;
+     bool bypassing;
+     uint8_t output;
+} controller_t;
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static void plant_init(plant_t *p)
+{
+     p->block = p->ambient;
+     p->sensor = p->ambient;
+}
+
+// Advance the plant by one sample and return the quantized sensor reading
+static int16_t plant_step(plant_t *p, uint8_t output)
+{
+     const int substeps = 10;
+     float dt = SAMPLE_SECONDS / substeps;
+     float u = output / 255.0;
+
+     for (int i = 0; i < substeps; i++) {
+	  p->block += dt * (p->gain * u - (p->block - p->ambient)) / p->tau;
+	  p->sensor += dt * (p->block - p->sensor) / p->lag;
+     }
+     return (int16_t)floor(p->sensor);
+}
+
+static void controller_init(controller_t *c, bool use_ff)
+{
+     c->pid.reset();
+     c->pid.setPGain(9.0);
+     c->pid.setIGain(0.25);
+     c->pid.setDGain(10.0);
+     c->model.reset();
+     c->use_ff = use_ff;
+     c->bypassing = false;
+     c->output = 0;
+}
+
+// One pass of the heater loop, following Heater::manage_temperature()
+static void controller_step(controller_t *c, int16_t temp)
+{
+     c->model.update(temp, c->output, SAMPLE_SECONDS);
+
+     int delta = c->pid.getTarget() - temp;
+     if (c->bypassing && delta < PID_BYPASS_DELTA) {
+	  c->bypassing = false;
+	  c->pid.reset_state();
+     }
+     else if (!c->bypassing && delta > PID_BYPASS_DELTA) {
+	  c->bypassing = true;
+     }
+
+     if (c->bypassing) {
+	  c->output = 255;
+	  return;
+     }
+
+     int mv = c->pid.calculate(temp);
+     if (c->use_ff)
+	  mv += c->model.feedForward(c->pid.getTarget());
+     if (mv < 0)
+	  mv = 0;
+     if (mv > 255)
+	  mv = 255;
+     if (c->pid.getTarget() == 0)
+	  mv = 0;
+     c->output = mv;
+}
+
+// Run the loop at a set point until the sensor has stayed within +/-2C for
+// 30 seconds or the time limit is hit.  Returns the settle time in seconds,
+// measured to the start of the final in-band stretch.
+static float run_to_setpoint(plant_t *p, controller_t *c, int16_t target,
+			     float limit)
+{
+     float t = 0, in_band_since = -1;
+     int16_t temp = (int16_t)floor(p->sensor);
+
+     c->pid.setTarget(target);
+     while (t < limit) {
+	  controller_step(c, temp);
+	  temp = plant_step(p, c->output);
+	  t += SAMPLE_SECONDS;
+	  if (abs(temp - target) <= 2) {
+	       if (in_band_since < 0)
+		    in_band_since = t;
+	       if (t - in_band_since >= 30)
+		    return in_band_since;
+	  }
+	  else
+	       in_band_since = -1;
+     }
+     return limit;
+}
+
+// Time a full-on heat from the current temperature to target
+static float time_full_on(plant_t *p, controller_t *c, int16_t target)
+{
+     float t = 0;
+     int16_t temp = (int16_t)floor(p->sensor);
+
+     c->output = 255;
+     while (temp < target && t < 3600) {
+	  c->model.update(temp, c->output, SAMPLE_SECONDS);
+	  temp = plant_step(p, c->output);
+	  t += SAMPLE_SECONDS;
+     }
+     return t;
+}
+
+static void test_plant(plant_t proto, int16_t hold, int16_t step_to,
+		       float limit)
+{
+     plant_t p = proto;
+     controller_t c;
+
+     printf("--- %s\n", p.name);
+
+     // Heat up and hold with the model learning as it goes
+     plant_init(&p);
+     controller_init(&c, true);
+     run_to_setpoint(&p, &c, hold, limit);
+
+     check(c.model.isValid(), "%s model valid after heat up", p.name);
+     printf("      fitted gain %.1f (plant %.1f), tau %.1f (plant %.1f), ambient %.1f\n",
+	    c.model.getGain(), p.gain, c.model.getTau(), p.tau,
+	    c.model.getAmbient());
+
+     // Feed forward should match the steady state output of the plant
+     float ff_true = 255.0 * (hold - p.ambient) / p.gain;
+     float ff = c.model.feedForward(hold);
+     check(fabs(ff - ff_true) <= 0.15 * ff_true,
+	   "%s feed forward %.0f vs plant %.0f", p.name, ff, ff_true);
+
+     // Predicted time to target for a full-on step, compared with the plant
+     int16_t from = (int16_t)floor(p.sensor);
+     uint16_t predicted = c.model.secondsToTarget(from, step_to);
+     float actual = time_full_on(&p, &c, step_to);
+     check(predicted != MODEL_TIME_UNKNOWN &&
+	   fabs(predicted - actual) <= 0.25 * actual + 2,
+	   "%s predicted %uC->%uC in %us, plant took %.1fs",
+	   p.name, from, step_to, predicted, actual);
+
+     // A set point step settles at least as fast with feed forward as without
+     plant_t p_ff = proto, p_plain = proto;
+     controller_t c_ff, c_plain;
+     plant_init(&p_ff);
+     plant_init(&p_plain);
+     controller_init(&c_ff, true);
+     controller_init(&c_plain, false);
+     run_to_setpoint(&p_ff, &c_ff, hold, limit);
+     run_to_setpoint(&p_plain, &c_plain, hold, limit);
+     float settle_ff = run_to_setpoint(&p_ff, &c_ff, step_to, limit);
+     float settle_plain = run_to_setpoint(&p_plain, &c_plain, step_to, limit);
+     check(settle_ff <= settle_plain,
+	   "%s settle %uC->%uC: %.1fs with feed forward, %.1fs without",
+	   p.name, hold, step_to, settle_ff, settle_plain);
+}
+
+int main(int argc, const char *argv[])
+{
+     plant_t extruder = { "extruder", 330.0, 110.0, 4.0, 22.0, 0, 0 };
+     plant_t platform = { "platform", 140.0, 420.0, 8.0, 22.0, 0, 0 };
+
+     test_plant(extruder, 230, 245, 900);
+     test_plant(platform, 100, 110, 3600);
+
+     if (failures)
+	  printf("%d check(s) failed\n", failures);
+     return(failures ? 1 : 0);
+}
@@ -0,0 +1,173 @@
+// timebase.cc
+// Read the clock of Timebase.hh against a model of its timer: a 16 bit
+// counter at two counts a microsecond, whose overflow interrupt runs at
+// any point of a read, or not until after it when interrupts are off.
+// Every read must fall within the time the read took, including reads
+// across the wrap of the 32 bit microseconds, and successive reads must
+// never go backwards.
+//
+// Prints the clock interrupts per second and the resolution, against the
+// 10KHz Timer2 tick which kept micros before.
+// Exits non-zero on failure.
+//
+// Usage: timebase
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "Timebase.hh"
+
+#define READS 2000000
+
+static uint64_t counts;          // timer counts since the timer started
+static uint64_t overflows_taken; // overflows the interrupt has run for
+static volatile micros_t overflow_micros;
+static bool interrupts_on;
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static bool overflow_pending(void)
+{
+     return (counts >> 16) > overflows_taken;
+}
+
+static void overflow_isr(void)
+{
+     overflow_micros += TIMEBASE_OVERFLOW_MICROS;
+     overflows_taken++;
+}
+
+// Time passes between the accesses of a read, and a pending overflow
+// interrupt may run there if interrupts are on
+static void between_accesses(void)
+{
+     counts += rand() % 8;
+     if (interrupts_on && overflow_pending() && rand() % 2)
+	  overflow_isr();
+}
+
+struct ModelTimer {
+     static uint16_t count()
+     {
+	  uint16_t c;
+
+	  between_accesses();
+	  c = (uint16_t)counts;
+	  between_accesses();
+	  return c;
+     }
+
+     static bool overflowPending()
+     {
+	  bool pending = overflow_pending();
+
+	  between_accesses();
+	  return pending;
+     }
+};
+
+static micros_t true_micros(void)
+{
+     return (micros_t)(counts / TIMEBASE_COUNTS_PER_MICRO);
+}
+
+// Starts the model at micros, with the interrupt up to date
+static void start_at(micros_t micros)
+{
+     counts = (uint64_t)micros * TIMEBASE_COUNTS_PER_MICRO;
+     overflows_taken = counts >> 16;
+     overflow_micros = (micros_t)(overflows_taken * TIMEBASE_OVERFLOW_MICROS);
+}
+
+// Reads the clock READS times, with interrupts on or off for the reads;
+// returns the number of reads outside the time they took, and counts
+// those which went backwards
+static unsigned run(micros_t from, bool interrupts, unsigned *backwards)
+{
+     unsigned bad = 0, i;
+     micros_t last;
+
+     start_at(from);
+     last = true_micros();
+     *backwards = 0;
+     for (i = 0; i < READS; i++) {
+	  micros_t before, after, read;
+
+	  counts += rand() % 300;
+	  interrupts_on = true;
+	  if (overflow_pending())
+	       overflow_isr();
+	  interrupts_on = interrupts;
+	  // with interrupts off, the overflow may have become due just before
+	  counts += rand() % 4;
+	  before = true_micros();
+	  read = timebaseRead<ModelTimer>(overflow_micros);
+	  after = true_micros();
+	  if ((micros_t)(read - before) > (micros_t)(after - before))
+	       bad++;
+	  if ((int32_t)(read - last) < 0)
+	       (*backwards)++;
+	  last = read;
+     }
+     interrupts_on = true;
+     return bad;
+}
+
+int main(void)
+{
+     static const struct {
+	  const char *name;
+	  micros_t from;
+     } starts[] = {
+	  { "from boot", 0 },
+	  { "across the 32 bit wrap", 0xFFFFFFFFUL - 150000000UL },
+     };
+     unsigned s, k;
+
+     srand(45);
+     for (s = 0; s < sizeof(starts) / sizeof(starts[0]); s++) {
+	  for (k = 0; k < 2; k++) {
+	       unsigned backwards, bad = run(starts[s].from, k == 0, &backwards);
+	       check(bad == 0 && backwards == 0,
+		     "%s, interrupts %s: %u of %u reads outside the read, %u backwards",
+		     starts[s].name, k == 0 ? "on" : "off", bad, READS, backwards);
+	  }
+     }
+
+     // the exact value at every count around an overflow, pending or taken
+     for (k = 0, s = 0; k < 0x10000; k++) {
+	  micros_t base = 7 * TIMEBASE_OVERFLOW_MICROS;
+	  micros_t want = base + k / TIMEBASE_COUNTS_PER_MICRO;
+	  if (k < 0x8000 && timebaseMicros(base - TIMEBASE_OVERFLOW_MICROS, k, true) != want)
+	       s++;
+	  if (timebaseMicros(base, k, false) != want)
+	       s++;
+	  if (k >= 0x8000 && timebaseMicros(base, k, true) != want)
+	       s++;
+     }
+     check(s == 0, "every counter value composes to its microsecond, %u wrong", s);
+
+     printf("clock                 interrupts/s  resolution, us\n");
+     printf("Timer2 tick           %12.1f  %14.1f\n", 10000.0, 100.0);
+     printf("free running counter  %12.1f  %14.1f\n", 1e6 / TIMEBASE_OVERFLOW_MICROS, 1.0);
+
+     return(failures ? 1 : 0);
+}
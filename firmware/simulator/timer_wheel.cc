@@ -0,0 +1,243 @@
+// timer_wheel.cc
+// Run the timeouts of TimerWheel.hh against polled Timeouts.  Each timeout
+// is a pair, one polled and one on the wheel, given the same starts,
+// aborts, clears and checks by a model of the main loop: each pass advances
+// the wheel, checks some timeouts, then some time later starts, aborts or
+// clears others.  Every check must give the same answer from both, and the
+// same isActive() before and after it, for durations from none to past
+// 2**31 microseconds, with passes from microseconds to a minute apart and
+// the clock wrapping.  The time the wheel gives until the next timeout is
+// due must never be later than the timeout.
+//
+// Prints the clock reads a pass of the polled timeouts take, against the
+// one read a pass of the wheel.
+// Exits non-zero on failure.
+//
+// Usage: timer_wheel
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+#include "TimerWheel.hh"
+
+#define PASSES   500000
+#define TIMEOUTS 24
+
+static micros_t clock_micros;
+static unsigned long clock_reads;
+
+micros_t simulatorMicros()
+{
+     clock_reads++;
+     return clock_micros;
+}
+
+static Timeout polled[TIMEOUTS];
+static ScheduledTimeout scheduled[TIMEOUTS];
+static micros_t durations[TIMEOUTS];
+static micros_t start_micros[TIMEOUTS];
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static uint32_t random32(void)
+{
+     return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+// Durations of the main loop's timeouts and beyond: none, within a tick,
+// within each level of the wheel, past its reach and past 2**31
+static micros_t random_duration(void)
+{
+     switch (rand() % 8) {
+     case 0:  return rand() % 4 ? random32() % 1024 : 0;
+     case 1:  return random32() % 8192;
+     case 2:  return random32() % 65536;
+     case 3:  return random32() % 524288;
+     case 4:  return random32() % 4194304;
+     case 5:  return random32() % 60000000;
+     case 6:  return 1800000000UL;
+     default: return rand() % 16 ? random32() % 400000 : 2200000000UL + random32() % 1000000;
+     }
+}
+
+// Time from one pass to the next: mostly a millisecond or so, sometimes a
+// slow pass, now and then a stall of up to a minute
+static micros_t random_pass(void)
+{
+     if (rand() % 2000 == 0)
+	  return random32() % 60000000;
+     if (rand() % 50 == 0)
+	  return random32() % 40000;
+     return 20 + random32() % 2000;
+}
+
+// Checks timeout i both ways, adding the clock reads of the polled check
+// to polled_reads; returns false if they disagree, or the check on the
+// wheel read the clock
+static bool check_pair(unsigned i, unsigned long *polled_reads)
+{
+     bool polled_active = polled[i].isActive(), scheduled_active = scheduled[i].isActive();
+     unsigned long reads = clock_reads;
+     bool polled_elapsed = polled[i].hasElapsed();
+     *polled_reads += clock_reads - reads;
+     reads = clock_reads;
+     bool scheduled_elapsed = scheduled[i].hasElapsed();
+
+     return polled_active == scheduled_active && polled_elapsed == scheduled_elapsed &&
+	  polled[i].isActive() == scheduled[i].isActive() && clock_reads == reads;
+}
+
+// The time until the earliest running timeout which is not yet due, which
+// the wheel must not give as later; 0xFFFFFFFF for none
+static micros_t earliest_due(void)
+{
+     micros_t earliest = 0xFFFFFFFF;
+     unsigned i;
+
+     for (i = 0; i < TIMEOUTS; i++) {
+	  micros_t run;
+	  if (!polled[i].isActive())
+	       continue;
+	  run = clock_micros - start_micros[i];
+	  if (run < durations[i] && durations[i] - run < earliest)
+	       earliest = durations[i] - run;
+     }
+     return earliest;
+}
+
+// Runs the model main loop from the given time; returns the checks which
+// disagreed, and counts the checks, the clock reads of the polled checks
+// and the times until the next timeout given later than it
+static unsigned run(micros_t from, unsigned long *checks, unsigned long *polled_reads,
+		    unsigned *late)
+{
+     TimerWheel& wheel = TimerWheel::getWheel();
+     unsigned bad = 0, pass, i;
+
+     clock_micros = from;
+     wheel.reset(clock_micros);
+     for (i = 0; i < TIMEOUTS; i++) {
+	  polled[i].abort();
+	  polled[i].clear();
+	  scheduled[i].abort();
+	  scheduled[i].clear();
+     }
+     *checks = *polled_reads = 0;
+     *late = 0;
+
+     for (pass = 0; pass < PASSES; pass++) {
+	  bool fresh[TIMEOUTS];
+	  micros_t until;
+
+	  clock_micros += random_pass();
+	  wheel.advance(clock_micros);
+	  until = wheel.untilNextDue();
+	  if (until > earliest_due())
+	       (*late)++;
+
+	  // the slices check their timeouts
+	  for (i = 0; i < TIMEOUTS; i++) {
+	       if (rand() % 3 == 0)
+		    continue;
+	       (*checks)++;
+	       if (!check_pair(i, polled_reads))
+		    bad++;
+	  }
+
+	  // and later in the pass start, abort or clear some
+	  clock_micros += random32() % 500;
+	  for (i = 0; i < TIMEOUTS; i++) {
+	       fresh[i] = false;
+	       switch (rand() % 64) {
+	       case 0:
+	       case 1:
+		    durations[i] = random_duration();
+		    polled[i].start(durations[i]);
+		    scheduled[i].start(durations[i]);
+		    start_micros[i] = clock_micros;
+		    fresh[i] = true;
+		    break;
+	       case 2:
+		    polled[i].abort();
+		    scheduled[i].abort();
+		    break;
+	       case 3:
+		    polled[i].clear();
+		    scheduled[i].clear();
+		    break;
+	       }
+	  }
+	  // a timeout of no time has elapsed as soon as it starts
+	  for (i = 0; i < TIMEOUTS; i++) {
+	       if (fresh[i]) {
+		    (*checks)++;
+		    if (!check_pair(i, polled_reads))
+			 bad++;
+	       }
+	  }
+     }
+     return bad;
+}
+
+int main(void)
+{
+     static const struct {
+	  const char *name;
+	  micros_t from;
+     } starts[] = {
+	  { "from boot", 0 },
+	  { "across the 32 bit wrap", 0xFFFFFFFFUL - 600000000UL },
+     };
+     unsigned long checks, polled_reads = 0;
+     unsigned s, i, late;
+
+     srand(46);
+     for (s = 0; s < sizeof(starts) / sizeof(starts[0]); s++) {
+	  unsigned bad = run(starts[s].from, &checks, &polled_reads, &late);
+	  check(bad == 0, "%s: %u of %lu checks differ from polling", starts[s].name, bad, checks);
+	  check(late == 0, "%s: time to the next timeout later than it on %u of %u passes",
+		starts[s].name, late, PASSES);
+     }
+
+     // The clock going back, as Motherboard::reset() sets it, elapses a polled
+     // timeout started before, as it does those on the reset wheel
+     for (i = 0; i < TIMEOUTS; i++) {
+	  polled[i].start(5000000);
+	  scheduled[i].start(5000000);
+     }
+     clock_micros = 12;
+     TimerWheel::getWheel().reset(clock_micros);
+     for (i = 0, s = 0; i < TIMEOUTS; i++)
+	  if (!check_pair(i, &polled_reads) || !scheduled[i].hasElapsed())
+	       s++;
+     check(s == 0, "clock reset: %u of %u timeouts differ from polling", s, TIMEOUTS);
+
+     for (i = 0; i < TIMEOUTS; i++)
+	  scheduled[i].abort();
+     TimerWheel::getWheel().advance(clock_micros);
+     check(TimerWheel::getWheel().untilNextDue() == 0xFFFFFFFFUL,
+	   "an empty wheel has no next timeout");
+
+     printf("clock reads a pass, %u timeouts checked: polled %.1f, wheel 1\n", TIMEOUTS,
+	    (double)polled_reads / checks * TIMEOUTS);
+
+     return(failures ? 1 : 0);
+}
@@ -0,0 +1,177 @@
+// twi_queue.cc
+// Run the queued TWI writes of TWI.cc against a simulated bus with one
+// peripheral.  A model main loop queues bursts of writes, some longer than
+// the queue and some to an address nobody answers, while the bus moves on
+// at random between them and the TWI interrupt runs when it asks; at the
+// start interrupts are off, as they are when the RGB LED is set up.  Now
+// and then a data byte is not acknowledged or a start is lost to a bus
+// error.  Every write must go out on the bus once, in order, with its
+// bytes; its callback must be called once, in order, with how the bus says
+// it ended; the counters must agree; the driver must never start an
+// action while the last is still going; and a flush must leave the bus
+// released.
+//
+// Prints the main loop's reads of TWCR a write, against the blocking
+// driver, which waited on TWCR for every byte.
+// Exits non-zero on failure.
+//
+// Usage: twi_queue
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#include "TWI.hh"
+#include "TwiBusSim.hh"
+
+#define LED_ADDRESS 0xC4
+#define NOBODY      0x20
+
+#define WRITES TWI_BUS_SIM_TRANSFERS
+
+struct Queued {
+     uint8_t address;
+     uint8_t length;
+     uint8_t data[TWI_WRITE_MAX];
+};
+
+static Queued queued[WRITES];
+static unsigned queued_count;
+static uint8_t callback_errors[WRITES];
+static unsigned callback_count;
+static bool interrupts_on;
+
+static int failures = 0;
+
+static void check(bool ok, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+
+static void check(bool ok, const char *fmt, ...)
+{
+     va_list ap;
+
+     va_start(ap, fmt);
+     printf("%s: ", ok ? "PASS" : "FAIL");
+     vprintf(fmt, ap);
+     printf("\n");
+     va_end(ap);
+     if (!ok)
+	  failures++;
+}
+
+static void written(uint8_t error)
+{
+     if (callback_count < WRITES)
+	  callback_errors[callback_count] = error;
+     callback_count++;
+}
+
+// The bus moves on, and the interrupt runs if it is on and asked for
+static void bus_moves(void)
+{
+     twi_bus->step();
+     if (interrupts_on && twi_bus->interruptPending())
+	  TWI_vect();
+}
+
+static void queue_write(void)
+{
+     Queued& q = queued[queued_count++];
+     unsigned i;
+
+     q.address = rand() % 16 ? LED_ADDRESS : NOBODY;
+     q.length = 1 + rand() % TWI_WRITE_MAX;
+     for (i = 0; i < q.length; i++)
+	  q.data[i] = rand();
+     if (rand() % 40 == 0)
+	  twi_bus->nackData();
+     if (rand() % 60 == 0)
+	  twi_bus->busError();
+     TWI_queue_write(q.address, q.data, q.length, written);
+}
+
+int main(void)
+{
+     TwiBusSim bus(LED_ADDRESS);
+     unsigned long loop_reads = 0, reads;
+     unsigned order = 0, bytes = 0, tally[4] = { 0, 0, 0, 0 }, i;
+     TWI_counters counters;
+
+     srand(48);
+     twi_bus = &bus;
+     TWI_init();
+
+     // interrupts are off for the first writes, and on from a few bursts in
+     interrupts_on = false;
+     while (queued_count + 2 * TWI_QUEUE_SIZE < WRITES) {
+	  unsigned burst = rand() % 8 ? 1 + rand() % 6 : TWI_QUEUE_SIZE + rand() % TWI_QUEUE_SIZE;
+
+	  reads = bus.reads;
+	  for (i = 0; i < burst; i++)
+	       queue_write();
+	  loop_reads += bus.reads - reads;
+	  if (queued_count > 3 * TWI_QUEUE_SIZE)
+	       interrupts_on = true;
+
+	  for (i = rand() % 200; i > 0; i--)
+	       bus_moves();
+     }
+     TWI_flush();
+     while (bus.step())
+	  ;
+
+     check(bus.transfer_count == queued_count, "%u writes queued, %u sent", queued_count,
+	   bus.transfer_count);
+     check(callback_count == queued_count, "%u callbacks", callback_count);
+     for (i = 0; i < queued_count && i < bus.transfer_count && i < callback_count; i++) {
+	  const TwiBusSim::Transfer& t = bus.transfers[i];
+	  const Queued& q = queued[i];
+	  bool same;
+
+	  switch (t.result) {
+	  case TwiBusSim::RESULT_OK:
+	       same = t.address == q.address && t.length == q.length &&
+		    memcmp(t.data, q.data, q.length) == 0;
+	       bytes += q.length;
+	       break;
+	  case TwiBusSim::RESULT_DATA:
+	       same = t.address == q.address && t.length <= q.length &&
+		    memcmp(t.data, q.data, t.length) == 0;
+	       break;
+	  case TwiBusSim::RESULT_ADDRESS:
+	       same = t.address == q.address;
+	       break;
+	  default:
+	       same = true;
+	       break;
+	  }
+	  if (!same || (uint8_t)t.result != callback_errors[i])
+	       order++;
+	  tally[t.result]++;
+     }
+     check(order == 0, "%u writes sent out of order, or with the wrong bytes or result", order);
+
+     counters = TWI_get_counters();
+     check(counters.written == tally[TwiBusSim::RESULT_OK] &&
+	   counters.start_errors == tally[TwiBusSim::RESULT_START] &&
+	   counters.address_errors == tally[TwiBusSim::RESULT_ADDRESS] &&
+	   counters.data_errors == tally[TwiBusSim::RESULT_DATA],
+	   "counters: %u written, %u start, %u address and %u data errors",
+	   counters.written, counters.start_errors, counters.address_errors,
+	   counters.data_errors);
+     check(tally[TwiBusSim::RESULT_START] && tally[TwiBusSim::RESULT_ADDRESS] &&
+	   tally[TwiBusSim::RESULT_DATA], "every fault was injected and recovered from");
+     check(bus.protocol_errors == 0, "%u actions started while the bus was busy",
+	   bus.protocol_errors);
+     check(bus.idle(), "the bus is released after a flush");
+
+     printf("main loop reads of TWCR a write: queued %.2f (%u writes waited for room), "
+	    "blocking %.2f or more\n", (double)loop_reads / queued_count, counters.waits,
+	    (double)(bytes + 2 * tally[TwiBusSim::RESULT_OK]) / tally[TwiBusSim::RESULT_OK]);
+
+     return(failures ? 1 : 0);
+}
@@ -0,0 +1,13 @@
+// avr/interrupt.h
+// Stand-in for the AVR interrupt control; an interrupt handler is a plain
+// function, called by the test when the simulated bus asks for it.
+
+#ifndef TWISIM_AVR_INTERRUPT_H_
+#define TWISIM_AVR_INTERRUPT_H_
+
+#define ISR(vector) void vector(void)
+
+#define cli() do {} while (0)
+#define sei() do {} while (0)
+
+#endif
@@ -0,0 +1,36 @@
+// avr/io.h
+// Stand-in for the AVR register definitions used by TWI.cc, so that the
+// TWI driver can be run on the host against the simulated bus in
+// TwiBusSim.  Writing TWCR starts the bus on what it asks for; reading it
+// gives the bus a chance to finish.
+
+#ifndef TWISIM_AVR_IO_H_
+#define TWISIM_AVR_IO_H_
+
+#include <stdint.h>
+
+class TwiControlRegister {
+public:
+     TwiControlRegister& operator=(uint8_t b);
+     operator uint8_t() const;
+};
+
+extern TwiControlRegister TWCR;
+extern uint8_t TWDR, TWSR, TWBR;
+
+#define _BV(bit) (1 << (bit))
+
+// TWCR
+#define TWINT 7
+#define TWEA  6
+#define TWSTA 5
+#define TWSTO 4
+#define TWWC  3
+#define TWEN  2
+#define TWIE  0
+
+// The TWI interrupt is a function TwiBusSim's user calls
+#define TWI_vect twisim_interrupt
+void TWI_vect(void);
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "Checkpoint.hh"
+#include "EepromMap.hh"
+#include <avr/eeprom.h>
+#include <util/atomic.h>
+#include <string.h>
+
+namespace checkpoint {
+
+/// A checkpoint is taken on the first move at a new Z height once this many
+/// moves have been made since the last one, or after CHECKPOINT_MAX_MOVES
+/// moves on one height.  With one record a layer, each slot of the ring is
+/// written once every CHECKPOINT_SLOTS layers.
+#define CHECKPOINT_MIN_MOVES 50
+#define CHECKPOINT_MAX_MOVES 2000
+
+/// Layout of a slot
+#define SLOT_BUILD_ID 0
+#define SLOT_SEQUENCE 1
+#define SLOT_CHECKPOINT 2
+#define SLOT_CHECK (SLOT_CHECKPOINT + sizeof(Checkpoint))
+
+/// Fails to compile unless a record fills its slot exactly; the slots are
+/// fixed in the EEPROM map, so a change to #Checkpoint must not move them.
+typedef char slot_size_check[(SLOT_CHECK + 2 == CHECKPOINT_SLOT_SIZE) ? 1 : -1];
+
+#define BASE eeprom_offsets::PRINT_CHECKPOINT
+
+enum {
+	IDLE,           ///< Nothing to write
+	DRAINING,       ///< Waiting for the moves ahead of the record to finish
+	WRITING         ///< Writing the record out
+} state = IDLE;
+
+/// The record being written, laid out as it is in its slot
+uint8_t record[CHECKPOINT_SLOT_SIZE];
+uint8_t write_index;
+uint8_t blocks_left;
+
+bool active = false;
+uint8_t build_id;
+uint8_t sequence;
+uint16_t moves;
+int32_t last_z;
+
+static uint16_t slotAddress(uint8_t seq) {
+	return BASE + checkpoint_eeprom_offsets::SLOTS +
+		(uint16_t)(seq % CHECKPOINT_SLOTS) * CHECKPOINT_SLOT_SIZE;
+}
+
+/// Check bytes of a record, which do not match an erased or zeroed slot
+static uint16_t checkOf(const uint8_t* bytes) {
+	uint8_t a = 0x5A, b = 0xA5;
+	for (uint8_t i = 0; i < SLOT_CHECK; i++) {
+		a += bytes[i];
+		b += a;
+	}
+	return ((uint16_t)b << 8) | a;
+}
+
+/// Write a byte if it has changed, waiting for any write in progress
+static void updateByte(uint16_t address, uint8_t value) {
+	if (eeprom_read_byte((uint8_t*)address) != value) {
+		eeprom_busy_wait();
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			eeprom_write_byte((uint8_t*)address, value);
+		}
+	}
+}
+
+static void updateZ(int32_t z) {
+	for (uint8_t i = 0; i < 4; i++) {
+		updateByte(BASE + checkpoint_eeprom_offsets::PARKED_Z + i, (uint8_t)(z >> (8 * i)));
+	}
+}
+
+/// Read the record in a slot, and check that it is one of the given build
+static bool readSlot(uint8_t slot, uint8_t id, uint8_t* bytes) {
+	eeprom_read_block(bytes, (void*)slotAddress(slot), CHECKPOINT_SLOT_SIZE);
+	uint16_t check = checkOf(bytes);
+	return bytes[SLOT_BUILD_ID] == id &&
+		bytes[SLOT_CHECK] == (uint8_t)check &&
+		bytes[SLOT_CHECK + 1] == (uint8_t)(check >> 8);
+}
+
+/// Find the latest record of a build
+/// \return True if there is one; it is left in bytes
+static bool findLatest(uint8_t id, uint8_t* bytes) {
+	int8_t latest = -1;
+	uint8_t latest_sequence = 0;
+
+	for (uint8_t slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+		if (readSlot(slot, id, bytes) && (latest < 0 ||
+				(int8_t)(bytes[SLOT_SEQUENCE] - latest_sequence) > 0)) {
+			latest = slot;
+			latest_sequence = bytes[SLOT_SEQUENCE];
+		}
+	}
+	return latest >= 0 && readSlot(latest, id, bytes);
+}
+
+void start(const char* filename) {
+	uint8_t i;
+	for (i = 0; i < CHECKPOINT_NAME_LEN - 1 && filename[i] != 0; i++) {
+		updateByte(BASE + checkpoint_eeprom_offsets::FILE_NAME + i, filename[i]);
+	}
+	updateByte(BASE + checkpoint_eeprom_offsets::FILE_NAME + i, 0);
+	updateZ(CHECKPOINT_Z_UNKNOWN);
+
+	build_id = eeprom_read_byte((uint8_t*)(BASE + checkpoint_eeprom_offsets::BUILD_ID)) + 1;
+	updateByte(BASE + checkpoint_eeprom_offsets::BUILD_ID, build_id);
+
+	// start where the last build left off, to spread the wear over the ring
+	sequence = build_id - 1;
+	state = IDLE;
+	moves = 0;
+	last_z = CHECKPOINT_Z_UNKNOWN;
+	active = true;
+}
+
+void restart() {
+	build_id = eeprom_read_byte((uint8_t*)(BASE + checkpoint_eeprom_offsets::BUILD_ID));
+	if (findLatest(build_id, record)) {
+		sequence = record[SLOT_SEQUENCE];
+	}
+	updateZ(CHECKPOINT_Z_UNKNOWN);
+	state = IDLE;
+	moves = 0;
+	last_z = CHECKPOINT_Z_UNKNOWN;
+	active = true;
+}
+
+void stop(int32_t parked_z) {
+	if (!active) {
+		return;
+	}
+	// a record still waiting on its moves never will be complete
+	active = false;
+	if (state == DRAINING) {
+		state = IDLE;
+	}
+	while (state == WRITING) {
+		update(0);
+	}
+	updateZ(parked_z);
+}
+
+void finish() {
+	if (!active) {
+		return;
+	}
+	active = false;
+	state = IDLE;
+	updateByte(BASE + checkpoint_eeprom_offsets::FILE_NAME, 0);
+}
+
+bool due(int32_t z) {
+	if (!active) {
+		return false;
+	}
+	if (moves < CHECKPOINT_MAX_MOVES) {
+		moves++;
+	}
+	if (state != IDLE || moves < CHECKPOINT_MIN_MOVES ||
+			(z == last_z && moves < CHECKPOINT_MAX_MOVES)) {
+		return false;
+	}
+	last_z = z;
+	moves = 0;
+	return true;
+}
+
+void take(const Checkpoint& cp, uint8_t blocks_ahead) {
+	sequence++;
+	record[SLOT_BUILD_ID] = build_id;
+	record[SLOT_SEQUENCE] = sequence;
+	memcpy(record + SLOT_CHECKPOINT, &cp, sizeof(Checkpoint));
+	uint16_t check = checkOf(record);
+	record[SLOT_CHECK] = (uint8_t)check;
+	record[SLOT_CHECK + 1] = (uint8_t)(check >> 8);
+
+	write_index = 0;
+	blocks_left = blocks_ahead;
+	state = blocks_ahead > 0 ? DRAINING : WRITING;
+}
+
+void update(uint8_t blocks_done) {
+	if (state == DRAINING) {
+		if (blocks_done < blocks_left) {
+			blocks_left -= blocks_done;
+			return;
+		}
+		state = WRITING;
+	}
+	if (state != WRITING || !eeprom_is_ready()) {
+		return;
+	}
+
+	// one byte a call, so the command slice never waits on the EEPROM;
+	// the check bytes are last, so the record only counts once complete
+	uint16_t address = slotAddress(record[SLOT_SEQUENCE]) + write_index;
+	while (write_index < CHECKPOINT_SLOT_SIZE &&
+			eeprom_read_byte((uint8_t*)address) == record[write_index]) {
+		write_index++;
+		address++;
+	}
+	if (write_index == CHECKPOINT_SLOT_SIZE) {
+		state = IDLE;
+		return;
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		eeprom_write_byte((uint8_t*)address, record[write_index++]);
+	}
+}
+
+bool load(Checkpoint& cp, char* filename, int32_t& z) {
+	uint8_t bytes[CHECKPOINT_SLOT_SIZE];
+
+	eeprom_read_block(filename, (void*)(BASE + checkpoint_eeprom_offsets::FILE_NAME),
+		CHECKPOINT_NAME_LEN);
+	filename[CHECKPOINT_NAME_LEN - 1] = 0;
+	uint8_t id = eeprom_read_byte((uint8_t*)(BASE + checkpoint_eeprom_offsets::BUILD_ID));
+	if (filename[0] == 0 || !findLatest(id, bytes)) {
+		return false;
+	}
+	memcpy(&cp, bytes + SLOT_CHECKPOINT, sizeof(Checkpoint));
+
+	eeprom_read_block(&z, (void*)(BASE + checkpoint_eeprom_offsets::PARKED_Z), 4);
+	if (z == CHECKPOINT_Z_UNKNOWN) {
+		z = cp.position[2]; // Z_AXIS
+	}
+	return true;
+}
+
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef CHECKPOINT_HH_
+#define CHECKPOINT_HH_
+
+#include <stdint.h>
+#include "Configuration.hh"
+
+/// Number of records in the EEPROM ring, and the size of each: build id,
+/// sequence number, #checkpoint::Checkpoint and a 16 bit check.
+#define CHECKPOINT_SLOTS 16
+#define CHECKPOINT_SLOT_SIZE 36
+
+/// Length of the file name kept with the checkpoints, including the NUL
+#define CHECKPOINT_NAME_LEN 32
+
+/// Checkpoint flags
+#define CHECKPOINT_FLAG_FAN 0x01
+
+/// Platform position passed to #checkpoint::stop() when the platform was
+/// left where the build stopped it
+#define CHECKPOINT_Z_UNKNOWN 0x7FFFFFFF
+
+/// The checkpoint module records how far an SD build has got, so that a
+/// build stopped by a power loss or a cancel can be resumed from the card
+/// rather than scrapped.
+///
+/// A checkpoint is taken at a command boundary, right after a move has been
+/// queued, but it is only written once the steppers have finished every move
+/// queued up to that point; a resumed build never skips a move that was not
+/// made.  Records go round a ring of EEPROM slots a byte per call to
+/// #update(), skipping bytes that have not changed, and the check bytes go
+/// last, so a record torn by a power loss is ignored in favour of the one
+/// before it.  Checkpoints are taken once a layer, and no more often than
+/// every #CHECKPOINT_MIN_MOVES moves, to keep EEPROM wear down.
+namespace checkpoint {
+
+/// State needed to carry on with a build from a point in its file
+struct Checkpoint {
+	uint32_t offset;                  ///< File offset of the next command
+	int32_t position[STEPPER_COUNT];  ///< Planner position after the last move, in steps
+	uint16_t extruder_temp[2];        ///< Extruder set points
+	uint16_t platform_temp;           ///< Platform set point
+	uint8_t tool;                     ///< Current tool index
+	uint8_t flags;                    ///< CHECKPOINT_FLAG_* bits
+} __attribute__ ((__packed__));
+
+/// Start checkpointing a new build, forgetting the checkpoints of any
+/// earlier build.
+/// \param[in] filename Name of the file being built
+void start(const char* filename);
+
+/// Carry on checkpointing a resumed build after its last checkpoint.
+void restart();
+
+/// Stop checkpointing a build that was cancelled or failed, keeping its
+/// last checkpoint so that it can be resumed.
+/// \param[in] parked_z Z position the platform is being moved to, in
+///            steps, or #CHECKPOINT_Z_UNKNOWN if it is left where it is
+void stop(int32_t parked_z);
+
+/// Stop checkpointing; the build finished and can not be resumed.
+void finish();
+
+/// Check whether a checkpoint should be taken.  Call this at a command
+/// boundary, after each move has been queued.
+/// \param[in] z Z position of the planner, in steps
+/// \return True if #take() should be called now
+bool due(int32_t z);
+
+/// Take a checkpoint.  It is written once the moves ahead of it are done.
+/// \param[in] cp State at the command boundary
+/// \param[in] blocks_ahead Number of planner blocks queued, including the
+///            one that is running
+void take(const Checkpoint& cp, uint8_t blocks_ahead);
+
+/// Write out pending checkpoints a little at a time.  Call this
+/// periodically while building.
+/// \param[in] blocks_done Number of planner blocks finished since the last
+///            call, or 0xFF if the planner is empty
+void update(uint8_t blocks_done);
+
+/// Find the latest checkpoint of the last build.
+/// \param[out] cp Latest checkpoint, if there is one
+/// \param[out] filename Name of the file being built, #CHECKPOINT_NAME_LEN bytes
+/// \param[out] z Where the platform is now, in steps.  Unless the build
+///             parked it, it is assumed not to have moved since the checkpoint.
+/// \return True if the last build can be resumed
+bool load(Checkpoint& cp, char* filename, int32_t& z);
+
+}
+
+#endif // CHECKPOINT_HH_
@@ -32,6 +32,9 @@
 #include "RGB_LED.hh"
 #include "Interface.hh"
 #include "UtilityScripts.hh"
+#include "HeatPlanner.hh"
+#include "Checkpoint.hh"
+#include "Settings.hh"
 #include "stdio.h"
 #include "Menu_locales.hh"
 #include "Version.hh"
@@ -41,6 +44,10 @@
 namespace command {
 
 #define COMMAND_BUFFER_SIZE 512
+
+/// A tool wait ends this many seconds before the heater is predicted to reach
+/// its target; the remaining few degrees come up during the first moves.
+#define TOOL_WAIT_LEAD_SECONDS 3
 uint8_t buffer_data[COMMAND_BUFFER_SIZE];
 CircularBuffer command_buffer(COMMAND_BUFFER_SIZE, buffer_data);
 uint8_t currentToolIndex = 0;
@@ -184,23 +191,34 @@ enum SleepStates{
 	SLEEP_HEATING_P,
 	SLEEP_HEATING_A,
 	SLEEP_RETURN,
-	SLEEP_FINISHED
+	SLEEP_FINISHED,
+	SLEEP_RESUME,
+	SLEEP_RESUME_HOME,
+	SLEEP_RESUME_HOMED
 } sleep_mode = SLEEP_NONE;
 
 const static int16_t z_mm_per_second_18 = 140;
 const static int16_t xy_mm_per_second_80 = 130;
 const static int16_t ab_mm_per_second_20 = 520;
 
+/// When resuming a build, the platform is lowered this far before X and Y
+/// are homed, so the nozzle clears the part
+#define RESUME_LIFT_MM 5
+#define RESUME_HOME_MM_PER_SECOND 40
+#define RESUME_HOME_TIMEOUT_SECONDS 60
+
 uint16_t extruder_temp[2];
 uint16_t platform_temp;
 Point sleep_position;
 bool fan_state = false;
+uint8_t sleep_tool;
 
 void startSleep(){
 
 	// record current position
 	sleep_position = steppers::getStepperPosition();
 	fan_state = EX_FAN.getValue();
+	sleep_tool = currentToolIndex;
 	Motherboard &board = Motherboard::getBoard();
 	
 	// retract
@@ -246,6 +264,8 @@ void stopSleep(){
 	steppers::setTarget(sleep_position, xy_mm_per_second_80);
 
 	Motherboard::getBoard().setExtra(fan_state);	
+	// waiting on the heaters changed the tool index
+	currentToolIndex = sleep_tool;
 }
 
 void sleepReheat(){
@@ -305,6 +325,78 @@ void ActivePause(bool on, SleepType type){
 	}	
 }
 
+/// Planner tail when checkpoint::update() was last told how many blocks were done
+uint8_t checkpoint_tail;
+
+/// Checkpoint an SD build at the command boundary after a move
+static void checkpointMove() {
+	if (!sdcard::isPlaying()) {
+		return;
+	}
+	Point position = steppers::getPlannerPosition();
+	if (!checkpoint::due(position[Z_AXIS])) {
+		return;
+	}
+
+	checkpoint::Checkpoint cp;
+	Motherboard &board = Motherboard::getBoard();
+	cp.offset = sd_count - command_buffer.getLength();
+	for (uint8_t i = 0; i < STEPPER_COUNT; i++) {
+		cp.position[i] = position[i];
+	}
+	cp.extruder_temp[0] = board.getExtruderBoard(0).getExtruderHeater().get_set_temperature();
+	cp.extruder_temp[1] = board.getExtruderBoard(1).getExtruderHeater().get_set_temperature();
+	cp.platform_temp = board.getPlatformHeater().get_set_temperature();
+	cp.tool = currentToolIndex;
+	cp.flags = EX_FAN.getValue() ? CHECKPOINT_FLAG_FAN : 0;
+
+	// count the blocks ahead from the same tail that later updates count from
+	uint8_t tail = block_buffer_tail;
+	checkpoint_tail = tail;
+	checkpoint::take(cp, (block_buffer_head - tail) & (BLOCK_BUFFER_SIZE - 1));
+}
+
+/// Define the given axes to be at their home positions stored in the EEPROM
+static void recallHomePosition(uint8_t axes) {
+	Point newPoint = steppers::getStepperPosition();
+
+	for (uint8_t i = 0; i < STEPPER_COUNT; i++) {
+		if ( axes & (1 << i) ) {
+			uint16_t offset = eeprom_offsets::AXIS_HOME_POSITIONS_MM + 4*i;
+			cli();
+			eeprom_read_block(&(newPoint[i]), (void*) offset, 4);
+			sei();
+			// convert new point to steps
+			newPoint[i]  = stepperAxisMMToSteps(newPoint[i], i);
+		}
+	}
+
+	steppers::defineHomePosition(newPoint);
+}
+
+void resume(const checkpoint::Checkpoint& cp, int32_t z) {
+	sd_count = cp.offset;
+
+	// the build carries on from the checkpoint as if returning from a sleep
+	sleep_position = Point(cp.position[X_AXIS], cp.position[Y_AXIS], cp.position[Z_AXIS],
+		cp.position[A_AXIS], cp.position[B_AXIS]);
+	extruder_temp[0] = cp.extruder_temp[0];
+	extruder_temp[1] = cp.extruder_temp[1];
+	platform_temp = cp.platform_temp;
+	fan_state = (cp.flags & CHECKPOINT_FLAG_FAN) != 0;
+	sleep_tool = cp.tool;
+	currentToolIndex = cp.tool;
+	steppers::changeToolIndex(cp.tool);
+
+	// X and Y are homed; the platform and filament are where the build left them
+	steppers::definePosition(Point(0, 0, z, cp.position[A_AXIS], cp.position[B_AXIS]));
+	sleepReheat();
+
+	sleep_type = SLEEP_TYPE_NONE;
+	sleep_mode = SLEEP_RESUME;
+	active_paused = true;
+}
+
 static void handleMovementCommand(const uint8_t &command) {
 
 	if (command == HOST_CMD_QUEUE_POINT_EXT) {
@@ -324,6 +416,7 @@ static void handleMovementCommand(const uint8_t &command) {
 			line_number++;
 		
 			steppers::setTarget(Point(x,y,z,a,b), dda);
+			checkpointMove();
 		}
 	}
 	else if (command == HOST_CMD_QUEUE_POINT_NEW) {
@@ -344,6 +437,7 @@ static void handleMovementCommand(const uint8_t &command) {
 			line_number++;
 			
 			steppers::setTargetNew(Point(x,y,z,a,b), us, relative);
+			checkpointMove();
 		}
 	}else if (command == HOST_CMD_QUEUE_POINT_NEW_EXT ) {
 	        // check for completion
@@ -366,6 +460,7 @@ static void handleMovementCommand(const uint8_t &command) {
 			line_number++;
 	            
 			steppers::setTargetNewExt(Point(x,y,z,a,b), dda_rate, relative, *distance, feedrateMult64);
+			checkpointMove();
 		}  
 	}
 }
@@ -485,6 +580,9 @@ void runCommandSlice() {
 			sd_count++;
 			command_buffer.push(sdcard::playbackNext());
 		}
+		uint8_t tail = block_buffer_tail;
+		checkpoint::update(st_empty() ? 0xFF : (tail - checkpoint_tail) & (BLOCK_BUFFER_SIZE - 1));
+		checkpoint_tail = tail;
 		if(!sdcard::playbackHasNext() && (sd_count < sdcard::getFileSize()) && !sdcard_reset){
 			
 		sd_fail_count++;
@@ -492,7 +590,7 @@ void runCommandSlice() {
 			Motherboard::getBoard().getInterfaceBoard().resetLCD();
 			Motherboard::getBoard().errorResponse(STATICFAIL_MSG);
 			sdcard_reset = true;
-			/// temporary behavior until we get a method to restart the build
+			/// the build can be resumed from its last checkpoint once the card is back
 			steppers::abort();
 			command_buffer.reset();
 
@@ -506,18 +604,12 @@ void runCommandSlice() {
 			target[2] = 150L*stepperAxisStepsPerMM(Z_AXIS);
 			command::pause(false);
 			steppers::setTarget(target, 150);
+			checkpoint::stop(target[2]);
 			sdcard::finishPlayback();
 			sd_fail_count = 0;
-			
-			/// do the sd card initialization files
-			//command_buffer.reset();
-			//sdcard::startPlayback(host::getBuildName());
-			//uint32_t count;
-			//while(count < sd_count){
-			//	sdcard::playbackNext();
-			//}
 			}
 		}else if(!sdcard::playbackHasNext() && command_buffer.isEmpty() && isReady()){
+			checkpoint::finish();
 			sdcard::finishPlayback();
 		}
 	}
@@ -531,14 +623,12 @@ void runCommandSlice() {
 		}
 	}
 	
-	// if printer is not waiting for tool or platform to heat, we need to make
-	// sure the extruders are not in a paused state.  this is relevant when 
-	// heating using the control panel in desktop software
+	// extruders paused while the platform heats are started by the heat
+	// planner so that they come up to temperature along with the platform.
+	// this also unpauses them when heating using the control panel in
+	// desktop software, where the printer never waits on the tool
 	if(check_temp_state){
-		if (Motherboard::getBoard().getPlatformHeater().has_reached_target_temperature()){
-			// unpause extruder heaters in case they are paused
-    		Motherboard::getBoard().getExtruderBoard(0).getExtruderHeater().Pause(false);
-	  		Motherboard::getBoard().getExtruderBoard(1).getExtruderHeater().Pause(false);
+		if (heat_planner::update()){
 	  		check_temp_state = false;
 	 	}
 	}
@@ -572,6 +662,11 @@ void runCommandSlice() {
 			!Motherboard::getBoard().getExtruderBoard(currentToolIndex).getExtruderHeater().isPaused()){
 			Piezo::playTune(TUNE_PRINT_START);
 			mode = READY;
+		}else if(Motherboard::getBoard().getExtruderBoard(currentToolIndex).getExtruderHeater().will_reach_target_within(TOOL_WAIT_LEAD_SECONDS)){
+			// the heater model says we will be at temperature before the first
+			// moves of the build get going, so start now
+			Piezo::playTune(TUNE_PRINT_START);
+			mode = READY;
 		}else if(!Motherboard::getBoard().getExtruderBoard(currentToolIndex).getExtruderHeater().isHeating() && 
 			!Motherboard::getBoard().getExtruderBoard(currentToolIndex).getExtruderHeater().isPaused()){
 			mode = READY;
@@ -732,6 +827,32 @@ void runCommandSlice() {
 				Motherboard::getBoard().getInterfaceBoard().popToOnboardStart();
 				sleep_mode = SLEEP_NONE;
 				active_paused = false;
+			// resuming a build from a checkpoint: lower the platform clear of the part
+			}else if(sleep_mode == SLEEP_RESUME){
+				Motherboard::getBoard().getInterfaceBoard().errorMessage(RESTARTING_MSG);
+				Point lift = steppers::getPlannerPosition();
+				lift[Z_AXIS] += RESUME_LIFT_MM * stepperAxisStepsPerMM(Z_AXIS);
+				steppers::setTarget(lift, z_mm_per_second_18);
+				mode = MOVING;
+				sleep_mode = SLEEP_RESUME_HOME;
+			// then find X and Y, which may have been moved while the power was off
+			}else if(sleep_mode == SLEEP_RESUME_HOME){
+				uint8_t home_direction = settings::valueOr(settings::values.axes.home_direction, (uint8_t)0);
+				mode = HOMING;
+				command_buffer_timeout.start(RESUME_HOME_TIMEOUT_SECONDS * 1000L * 1000L);
+				steppers::startHoming((home_direction & _BV(X_AXIS)) != 0,
+						_BV(X_AXIS) | _BV(Y_AXIS),
+						1000000.0 / (RESUME_HOME_MM_PER_SECOND * stepperAxisStepsPerMM(X_AXIS)));
+				sleep_mode = SLEEP_RESUME_HOMED;
+			// and heat up and return to the build as after a sleep
+			}else if(sleep_mode == SLEEP_RESUME_HOMED){
+				recallHomePosition(_BV(X_AXIS) | _BV(Y_AXIS));
+				currentToolIndex = 0;
+				mode = WAIT_ON_PLATFORM;
+				/// set timeout to 30 minutes
+				command_buffer_timeout.start(USER_INPUT_TIMEOUT);
+				sleep_mode = SLEEP_HEATING_P;
+				Motherboard::getBoard().StartProgressBar(3,0,20);
 			}
 			return;
 
@@ -986,20 +1107,7 @@ void runCommandSlice() {
 					uint8_t axes = pop8();
 					line_number++;
 
-					Point newPoint = steppers::getStepperPosition();
-
-					for (uint8_t i = 0; i < STEPPER_COUNT; i++) {
-						if ( axes & (1 << i) ) {
-							uint16_t offset = eeprom_offsets::AXIS_HOME_POSITIONS_MM + 4*i;
-							cli();
-							eeprom_read_block(&(newPoint[i]), (void*) offset, 4);
-							sei();
-							// convert new point to steps
-							newPoint[i]  = stepperAxisMMToSteps(newPoint[i], i);
-						}
-					}
-
-					steppers::defineHomePosition(newPoint);
+					recallHomePosition(axes);
 				}
 
 			} else if (command == HOST_CMD_SET_POT_VALUE){
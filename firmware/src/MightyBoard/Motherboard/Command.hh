@@ -20,6 +20,10 @@
 
 #include <stdint.h>
 
+namespace checkpoint {
+struct Checkpoint;
+}
+
 /// The command namespace contains functions that handle the incoming command
 /// queue, for both SD and serial jobs.
 namespace command {
@@ -76,6 +80,13 @@ void ActivePause(bool on, SleepType type);
 /// returns true if build is active paused, false if no
 bool isActivePaused();
 
+/// Carry on with an SD build from a checkpoint.  Playback must already be
+/// at the checkpoint's offset in the file.  The heaters are brought back up
+/// and X and Y homed before the build continues.
+/// \param[in] cp Checkpoint to resume from
+/// \param[in] z Where the platform is now, in steps
+void resume(const checkpoint::Checkpoint& cp, int32_t z);
+
 /// return line number of current build
 uint32_t getLineNumber();
 
@@ -17,6 +17,7 @@
 
 #include "EepromMap.hh"
 #include "Eeprom.hh"
+#include "Settings.hh"
 #include <avr/eeprom.h>
 #include <util/delay.h>
 
@@ -149,6 +150,7 @@ void setCustomColor(uint8_t red, uint8_t green, uint8_t blue){
 	colors.red=red; colors.green = green; colors.blue =blue;
 	eeprom_write_block((void*)&colors,(uint8_t*)(eeprom_offsets::LED_STRIP_SETTINGS + blink_eeprom_offsets::CUSTOM_COLOR),sizeof(colors));
 }
+  settings::load();
 }
 
     /**
@@ -218,6 +220,7 @@ void setDefaultsAcceleration()
     eeprom_write_byte((uint8_t *) (eeprom_offsets::ACCELERATION2_SETTINGS + acceleration2_eeprom_offsets::SLOWDOWN_FLAG), DEFAULT_SLOWDOWN_FLAG);
  
     eeprom_write_byte((uint8_t *) (eeprom_offsets::ACCELERATION_SETTINGS + acceleration_eeprom_offsets::DEFAULTS_FLAG), _BV(ACCELERATION_INIT_BIT));
+    settings::load();
 }  
 
 /// Writes to EEPROM the default toolhead 'home' values to idicate toolhead offset
@@ -298,6 +301,7 @@ ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
   // startup script flag is cleared
   eeprom_write_byte((uint8_t*)eeprom_offsets::FIRST_BOOT_FLAG, 0);
 }
+  settings::load();
 }
 
 void setDefaultMachineName(){
@@ -389,6 +393,7 @@ void setDefaultSettings(){
     eeprom_write_byte((uint8_t*)eeprom_offsets::HBP_PRESENT, 0);
   #endif
 }
+  settings::load();
 }
 
 //
@@ -409,6 +414,7 @@ void storeToolheadToleranceDefaults(){
 	eeprom_write_block((uint8_t*)&(offsets[0]),(uint8_t*)(eeprom_offsets::TOOLHEAD_OFFSET_SETTINGS_MM), 12 );
 }
 	
+  settings::load();
 }
 
 void updateBuildTime(uint8_t new_hours, uint8_t new_minutes){
@@ -469,6 +475,7 @@ void fullResetEEPROM() {
   eeprom_write_byte((uint8_t*)(eeprom_offsets::VERSION7_UPDATE_FLAG), VERSION7_FLAG);
  
  }
+  settings::load();
 }
 // we changed the way things are stored in EEPROM.  we need to make sure bots update accordingly
 void eepromResetv7(){
@@ -516,6 +523,7 @@ void eepromResetv7(){
     eeprom_write_block((uint8_t*)&(x_nozzle_offset),(uint8_t*)(eeprom_offsets::TOOLHEAD_OFFSET_SETTINGS_MM), 4 );
   }
         
+  settings::load();
 }
 
 
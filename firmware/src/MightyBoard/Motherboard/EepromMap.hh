@@ -327,8 +327,13 @@ const static uint16_t AXIS_MAX_FEEDRATES     = 0x0246;
 //$BEGIN_ENTRY
 //$type:B $contraints:m,0,30 $units:minutes
 const static uint16_t STOP_HEIGHT_VALUE = 0x0250;
+/// Checkpoints of the current SD build, for resuming it: 614 bytes,
+/// see checkpoint_eeprom_offsets
+//$BEGIN_ENTRY
+//$type:B $mult:614 $ignore:True $constraints:a
+const static uint16_t PRINT_CHECKPOINT = 0x0252;
 /// start of free space
-const static uint16_t FREE_EEPROM_STARTS        = 0x0252;
+const static uint16_t FREE_EEPROM_STARTS        = 0x04B8;
 
 } 
 
@@ -398,6 +403,18 @@ namespace acceleration2_eeprom_offsets{
     //0x1C is end of acceleration2 settings (28 bytes long)
 }
 
+/** checkpoint EEPROM offsets for resuming an SD build */
+namespace checkpoint_eeprom_offsets{
+/// name of the file being built, 32 bytes
+const static uint16_t FILE_NAME = 0x00;
+/// incremented on each new build; records of other builds are stale
+const static uint16_t BUILD_ID = 0x20;
+/// int32_t Z position the platform was parked at when the build stopped
+const static uint16_t PARKED_Z = 0x22;
+/// ring of CHECKPOINT_SLOTS records of CHECKPOINT_SLOT_SIZE bytes
+const static uint16_t SLOTS = 0x26;
+}
+
 namespace build_time_offsets{
 //$BEGIN_ENTRY
 //$type:H $ignore:True $constraints:a
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "HeatPlanner.hh"
+#include "Motherboard.hh"
+
+namespace heat_planner {
+
+// The heaters that are running full on at the same time must fit in
+// HEATER_BUDGET_WATTS; the board's Configuration.hh has the heater powers.
+
+/// Heat up time assumed for an extruder whose model is not valid yet
+#define DEFAULT_EXTRUDER_SECONDS 120
+
+/// Start extruders this much earlier than planned to cover model error;
+/// finishing a little before the platform is better than after it.
+#define START_MARGIN_SECONDS 10
+
+/// Time an extruder needs to heat, with margin
+static uint16_t extruderSeconds(Heater& heater) {
+	uint16_t seconds = heater.get_seconds_to_target();
+	if (seconds == MODEL_TIME_UNKNOWN) {
+		seconds = DEFAULT_EXTRUDER_SECONDS;
+	}
+	return seconds + START_MARGIN_SECONDS;
+}
+
+bool update() {
+	Motherboard& board = Motherboard::getBoard();
+	Heater& platform = board.getPlatformHeater();
+
+	Heater* waiting[2];
+	uint8_t waiting_count = 0;
+	uint16_t watts = 0;
+
+	for (uint8_t i = 0; i < 2; i++) {
+		Heater& heater = board.getExtruderBoard(i).getExtruderHeater();
+		if (heater.isPaused()) {
+			waiting[waiting_count++] = &heater;
+		} else if (heater.isHeating()) {
+			watts += EXTRUDER_HEATER_WATTS;
+		}
+	}
+
+	// once the platform is at temperature there is nothing left to coordinate
+	if (platform.has_reached_target_temperature() || !platform.isHeating()) {
+		for (uint8_t i = 0; i < waiting_count; i++) {
+			waiting[i]->Pause(false);
+		}
+		return true;
+	}
+	watts += PLATFORM_HEATER_WATTS;
+
+	// until the platform model is valid, heat serially as before
+	uint16_t platform_seconds = platform.get_seconds_to_target();
+	if (platform_seconds == MODEL_TIME_UNKNOWN) {
+		return waiting_count == 0;
+	}
+
+	// plan the slowest extruder first
+	if (waiting_count == 2 &&
+			extruderSeconds(*waiting[1]) > extruderSeconds(*waiting[0])) {
+		Heater* swap = waiting[0];
+		waiting[0] = waiting[1];
+		waiting[1] = swap;
+	}
+
+	// If the budget can't take every waiting extruder at once, they heat one
+	// after the other and the first has to start early enough for both.
+	bool serial = watts + waiting_count * EXTRUDER_HEATER_WATTS > HEATER_BUDGET_WATTS;
+	uint16_t lead = 0;
+	if (serial) {
+		for (uint8_t i = 0; i < waiting_count; i++) {
+			lead += extruderSeconds(*waiting[i]);
+		}
+	}
+
+	uint8_t started = 0;
+	for (uint8_t i = 0; i < waiting_count; i++) {
+		uint16_t needed = serial ? lead : extruderSeconds(*waiting[i]);
+		if (platform_seconds <= needed &&
+				watts + EXTRUDER_HEATER_WATTS <= HEATER_BUDGET_WATTS) {
+			waiting[i]->Pause(false);
+			watts += EXTRUDER_HEATER_WATTS;
+			started++;
+		}
+		// the rest wait for this one to finish
+		if (serial) {
+			break;
+		}
+	}
+
+	return started == waiting_count;
+}
+
+}
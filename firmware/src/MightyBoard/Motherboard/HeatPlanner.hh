@@ -0,0 +1,38 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef HEAT_PLANNER_HH_
+#define HEAT_PLANNER_HH_
+
+#include "Types.hh"
+
+/// The heat planner decides when extruder heaters that are paused while the
+/// build platform heats should start, so that they reach temperature at about
+/// the same time as the platform instead of after it (or long before it,
+/// sitting at temperature and oozing).  Start times come from each heater's
+/// fitted #ThermalModel, and are held back when starting another heater
+/// would exceed the heater power budget.
+namespace heat_planner {
+
+/// Unpause any waiting extruder heaters that are due to start.  Call this
+/// periodically while extruders are paused for the platform.
+/// \return True once no extruder heater is left waiting
+bool update();
+
+}
+
+#endif // HEAT_PLANNER_HH_
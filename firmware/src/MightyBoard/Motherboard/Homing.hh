@@ -0,0 +1,140 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef HOMING_HH_
+#define HOMING_HH_
+
+#include <stdint.h>
+// math.h clashes with the fixed point types of the simulator's planner build
+#ifndef SIMULATOR
+#include <math.h>
+#endif
+
+/// Phases of homing
+#define HOMING_IDLE	0	///< Not homing
+#define HOMING_APPROACH	1	///< Accelerated towards the endstops, decelerating once one triggers
+#define HOMING_SEEK	2	///< At the speed asked for, stopping on the step an endstop triggers
+#define HOMING_BACKOFF	3	///< Away from the endstops, clear of them
+#define HOMING_PROBE	4	///< Slowly back onto the endstops, stopping on the step they trigger
+
+/// The approach is this many times the speed asked for
+#define HOMING_APPROACH_FACTOR	3
+/// The approach stops within this distance past an endstop.  The endstops must take
+/// this much travel once triggered.
+#define HOMING_OVERTRAVEL_MM	2
+/// Distance the axes back off from their endstops, which must be more than the
+/// overtravel and the travel an endstop takes to release
+#define HOMING_BACKOFF_MM	4
+/// The probe is this many times slower than the speed asked for
+#define HOMING_PROBE_DIVISOR	4
+/// Steps of an approach are limited to those of an accelerated block
+#define HOMING_APPROACH_MAX_STEPS	0xffffL
+
+/// Speed of the approach, in mm/s, from the speed asked for, in mm/s, and the
+/// acceleration of the axes, in mm/s^2: as fast as it can stop from within
+/// HOMING_OVERTRAVEL_MM, up to HOMING_APPROACH_FACTOR times the speed asked for
+inline float homingApproachSpeed(float speed, float acceleration) {
+	float stop = sqrt(2.0 * acceleration * HOMING_OVERTRAVEL_MM);
+	speed *= HOMING_APPROACH_FACTOR;
+	return ( speed < stop ) ? speed : stop;
+}
+
+/// Steps of an approach along an axis of length steps: a little more than its
+/// length, so that it reaches the endstop from anywhere on it
+inline int32_t homingApproachSteps(int32_t length) {
+	length += length >> 3;
+	return ( length < HOMING_APPROACH_MAX_STEPS ) ? length : HOMING_APPROACH_MAX_STEPS;
+}
+
+/// Steps to decelerate from rate to final_rate, in steps/s, at acceleration, in steps/s^2.
+/// Rates are below 65536 steps/s.
+inline uint32_t homingStopSteps(uint32_t rate, uint32_t final_rate, uint32_t acceleration) {
+	if (( rate <= final_rate ) || ( acceleration == 0 ))	return 0;
+	return (rate * rate - final_rate * final_rate) / (acceleration << 1) + 1;
+}
+
+/// Runs homing through its phases.  The axes approach their endstops fast, with
+/// acceleration, and decelerate past them once they trigger; the approach is repeated
+/// for those which have not triggered yet.  Then all back off, and probe slowly, so
+/// that each stops on the step its endstop triggers, approached the same way every
+/// time.  Axes whose endstop an approach does not reach, seek it at the speed asked
+/// for before backing off.  Without acceleration the axes only seek, as they always
+/// have.
+/// \ingroup SoftwareLibraries
+class HomingSequence {
+private:
+	uint8_t phase;
+	uint8_t axes;			///< Axes being homed
+	uint8_t found;			///< Axes whose endstops have triggered
+	bool accelerated;
+public:
+	HomingSequence() : phase(HOMING_IDLE), axes(0), found(0), accelerated(false) {}
+
+	/// \param [in] axes_in Axes to home.
+	/// \param [in] accelerated_in True to approach the endstops with acceleration.
+	/// \return The first phase.
+	uint8_t start(uint8_t axes_in, bool accelerated_in) {
+		axes = axes_in;
+		found = 0;
+		accelerated = accelerated_in;
+		phase = accelerated ? HOMING_APPROACH : HOMING_SEEK;
+		return phase;
+	}
+
+	/// Ends the phase.
+	/// \param [in] triggered Axes whose endstops triggered in an approach.
+	/// \return The next phase, HOMING_IDLE when homing is done.
+	uint8_t next(uint8_t triggered) {
+		switch ( phase ) {
+		case HOMING_APPROACH:
+			triggered &= axes & ~found;
+			found |= triggered;
+			if ( found == axes )	phase = HOMING_BACKOFF;
+			else if ( ! triggered )	phase = HOMING_SEEK;
+			break;
+		case HOMING_SEEK:
+			found = axes;
+			phase = accelerated ? HOMING_BACKOFF : HOMING_IDLE;
+			break;
+		case HOMING_BACKOFF:
+			phase = HOMING_PROBE;
+			break;
+		default:
+			phase = HOMING_IDLE;
+			break;
+		}
+		return phase;
+	}
+
+	/// Stops homing, as when it is aborted
+	void stop() {
+		phase = HOMING_IDLE;
+	}
+
+	uint8_t getPhase() const {
+		return phase;
+	}
+
+	/// \return The axes the phase moves.
+	uint8_t moving() const {
+		if (( phase == HOMING_APPROACH ) || ( phase == HOMING_SEEK ))
+			return axes & ~found;
+		return axes;
+	}
+};
+
+#endif // HOMING_HH_
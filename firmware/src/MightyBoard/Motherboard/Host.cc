@@ -39,6 +39,9 @@
 #include "stdio.h"
 #include "Menu_locales.hh"
 #include "StepperAccelPlanner.hh"
+#include "Checkpoint.hh"
+#include "Settings.hh"
+#include "LinkWindow.hh"
 
 namespace host {
 
@@ -93,6 +96,21 @@ bool do_host_reset = false;
 bool hard_reset = false;
 bool cancelBuild = false;
 
+/// Interval between telemetry frames, or 0 if telemetry is off
+micros_t telemetry_interval = 0;
+Timeout telemetry_timeout;
+uint8_t telemetry_sequence = 0;
+
+void sendTelemetry(OutPacket& to_host);
+
+/// Sequence numbers of windowed packets
+LinkWindow link_window;
+
+/// Runs from a change of speed of the host UART until a packet comes in at
+/// the new speed; if none does, the host never followed, so go back
+Timeout baud_confirm_timeout;
+#define HOST_BAUD_CONFIRM_MICROS (1000L*1000L)
+
 void runHostSlice() {
 	InPacket& in = UART::getHostUART().in;
 	OutPacket& out = UART::getHostUART().out;
@@ -124,6 +142,9 @@ void runHostSlice() {
 		machineName[0] = 0;
 		buildName[0] = 0;
 		currentState = HOST_STATE_READY;
+		telemetry_interval = 0;
+		link_window.reset();
+		in.setMaxLength(MAX_PACKET_PAYLOAD);
 
 		return;
 	}
@@ -159,13 +180,27 @@ void runHostSlice() {
 		}
 		*/  	
 		in.reset();
+		UART::getHostUART().processPending();
 		//UART::getHostUART().beginSend();
 		//Motherboard::getBoard().indicateError(ERR_HOST_PACKET_MISC);
 		
 	}
 	if (in.isFinished()) {
 		packet_in_timeout.abort();
+		baud_confirm_timeout.abort();
 		out.reset();
+		LinkWindow::Verdict verdict = LinkWindow::NEW;
+		if (in.isWindowed()) {
+			verdict = link_window.classify(in.getSequence());
+		}
+		if (verdict == LinkWindow::OUT_OF_WINDOW) {
+			// a packet before this one was lost; the host will send again
+			// from the one after the ack
+			out.append8(RC_PACKET_ERROR);
+		} else if (verdict == LinkWindow::REPEAT && (in.read8(0) & 0x80) != 0) {
+			// the response was lost, but the command is queued already
+			out.append8(RC_OK);
+		} else
 	  // do not respond to commands if the bot has had a heater failure
 		if(currentState == HOST_STATE_HEAT_SHUTDOWN){
 			if(cancelBuild){
@@ -192,7 +227,27 @@ void runHostSlice() {
 			// Unrecognized command
 			out.append8(RC_CMD_UNSUPPORTED);
 		}
+		if (in.isWindowed()) {
+			// a command that did not fit is sent again once there is room
+			if (verdict == LinkWindow::NEW && !rcCompare(out.read8(0), RC_BUFFER_OVERFLOW)) {
+				link_window.accept();
+			}
+			out.setAck(link_window.ackFor(verdict, in.getSequence()),
+					command::getRemainingCapacity());
+		}
 		in.reset();
+		UART::getHostUART().processPending();
+		UART::getHostUART().beginSend();
+	}
+	if (baud_confirm_timeout.hasElapsed()) {
+		baud_confirm_timeout.clear();
+		UART::getHostUART().setBaudRate(HOST_DEFAULT_BAUD_RATE, out.isSending());
+	}
+	// telemetry goes out between responses, while no packet is coming in
+	if (telemetry_interval != 0 && telemetry_timeout.hasElapsed()
+			&& !in.isStarted() && !out.isSending()) {
+		telemetry_timeout.start(telemetry_interval);
+		sendTelemetry(out);
 		UART::getHostUART().beginSend();
 	}
     /// mark new state as ready if done building from SD
@@ -323,10 +378,9 @@ void handleGetPosition(const InPacket& from_host, OutPacket& to_host) {
 	}
 }
 
-void handleGetPositionExt(const InPacket& from_host, OutPacket& to_host) {
+void appendPositionExt(OutPacket& to_host) {
 	ATOMIC_BLOCK(ATOMIC_FORCEON) {
 		const Point p = steppers::getStepperPosition();
-		to_host.append8(RC_OK);
 		to_host.append32(p[0]);
 		to_host.append32(p[1]);
 		to_host.append32(p[2]);
@@ -344,11 +398,22 @@ void handleGetPositionExt(const InPacket& from_host, OutPacket& to_host) {
 	}
 }
 
+void handleGetPositionExt(const InPacket& from_host, OutPacket& to_host) {
+	to_host.append8(RC_OK);
+	appendPositionExt(to_host);
+}
+
     // capture to SD
 void handleCaptureToFile(const InPacket& from_host, OutPacket& to_host) {
 	char *p = (char*)from_host.getData() + 1;
+	// the filename may be followed by the expected file size
+	uint8_t hint_index = 1 + strlen(p) + 1;
+	uint32_t size_hint = 0;
+	if (from_host.getLength() >= hint_index + 4) {
+		size_hint = from_host.read32(hint_index);
+	}
 	to_host.append8(RC_OK);
-	to_host.append8(sdcard::startCapture(p));
+	to_host.append8(sdcard::startCapture(p, size_hint));
 }
     // stop capture to SD
 void handleEndCapture(const InPacket& from_host, OutPacket& to_host) {
@@ -447,9 +512,11 @@ void handleWriteEeprom(const InPacket& from_host, OutPacket& to_host) {
 	for (int i = 0; i < length; i++) {
 		data[i] = from_host.read8(i + 4);
 	}
+	settings::flush();
 	ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
 		eeprom_write_block(data, (void*) offset, length);
 	}
+	settings::load();
 	to_host.append8(RC_OK);
 	to_host.append8(length);
 }
@@ -505,6 +572,7 @@ void handleBuildStartNotification(CircularBuffer& buf) {
     // set build state to ready
 void handleBuildStopNotification(uint8_t stopFlags) {
 	uint8_t flags = stopFlags;
+	checkpoint::finish();
 	Motherboard::getBoard().getInterfaceBoard().queueScreen(InterfaceBoard::BUILD_FINISHED);
 	stopPrintTime();
 	last_print_line = command::getLineNumber();
@@ -518,10 +586,7 @@ void handleBuildStopNotification(uint8_t stopFlags) {
 	EX_FAN.setValue(false);
 }
 
-/// get current print stats if printing, or last print stats if not printing
-void handleGetBuildStats(OutPacket& to_host) {
-	to_host.append8(RC_OK);
- 
+void appendBuildStats(OutPacket& to_host) {
 	uint8_t hours;
 	uint8_t minutes;
 		
@@ -535,6 +600,12 @@ void handleGetBuildStats(OutPacket& to_host) {
 	} else {
 		to_host.append32(last_print_line);
 	}
+}
+
+/// get current print stats if printing, or last print stats if not printing
+void handleGetBuildStats(OutPacket& to_host) {
+	to_host.append8(RC_OK);
+	appendBuildStats(to_host);
 	to_host.append32(0);// open spot for filament detect info
 }
 /// get current print stats if printing, or last print stats if not printing
@@ -545,6 +616,155 @@ void handleGetBoardStatus(OutPacket& to_host) {
 	to_host.append8(board.GetBoardStatus());
 }
 
+/// SLAVE_CMD_GET_TOOL_STATUS byte of a tool
+uint8_t getToolStatus(uint8_t id) {
+	Motherboard& board = Motherboard::getBoard();
+	return (board.getExtruderBoard(id).getExtruderHeater().has_failed()?128:0)
+		| (board.getPlatformHeater().has_failed()?64:0)
+		| (board.getExtruderBoard(id).getExtruderHeater().GetFailMode())
+		| (board.getExtruderBoard(id).getExtruderHeater().has_reached_target_temperature()?1:0);
+}
+
+/// Size of each STATUS_GROUP_* in a HOST_CMD_GET_STATUS reply
+static const uint8_t status_group_sizes[STATUS_GROUP_COUNT] PROGMEM = {
+	12, 2, 22, 4, 1, 7
+};
+
+/// get the status groups asked for, as many as fit in the reply,
+/// so that a host polling the bot needs one packet instead of several
+void handleGetStatus(const InPacket& from_host, OutPacket& to_host) {
+	Motherboard& board = Motherboard::getBoard();
+	uint8_t requested = from_host.getLength() > 1 ? from_host.read8(1) : 0xFF;
+	uint8_t groups = 0;
+	uint8_t length = 2;
+
+	for (uint8_t i = 0; i < STATUS_GROUP_COUNT; i++) {
+		uint8_t size = pgm_read_byte(&status_group_sizes[i]);
+		if ((requested & (1 << i)) && length + size <= MAX_PACKET_PAYLOAD) {
+			groups |= 1 << i;
+			length += size;
+		}
+	}
+
+	to_host.append8(RC_OK);
+	to_host.append8(groups);
+	if (groups & STATUS_GROUP_TEMPERATURES) {
+		for (uint8_t id = 0; id < 2; id++) {
+			to_host.append16(board.getExtruderBoard(id).getExtruderHeater().get_current_temperature());
+			to_host.append16(board.getExtruderBoard(id).getExtruderHeater().get_set_temperature());
+		}
+		to_host.append16(board.getPlatformHeater().get_current_temperature());
+		to_host.append16(board.getPlatformHeater().get_set_temperature());
+	}
+	if (groups & STATUS_GROUP_TOOL_STATUS) {
+		to_host.append8(getToolStatus(0));
+		to_host.append8(getToolStatus(1));
+	}
+	if (groups & STATUS_GROUP_POSITION) {
+		appendPositionExt(to_host);
+	}
+	if (groups & STATUS_GROUP_BUFFER_SIZE) {
+		to_host.append32(command::getRemainingCapacity());
+	}
+	if (groups & STATUS_GROUP_BOARD_STATUS) {
+		to_host.append8(board.GetBoardStatus());
+	}
+	if (groups & STATUS_GROUP_BUILD_STATS) {
+		appendBuildStats(to_host);
+	}
+}
+
+/// agree on the link protocol with the host
+void handleLinkVersion(const InPacket& from_host, OutPacket& to_host) {
+	uint8_t version = from_host.getLength() > 1 ? from_host.read8(1) : LINK_VERSION_BASIC;
+	if (version > LINK_VERSION_WINDOWED) {
+		version = LINK_VERSION_WINDOWED;
+	}
+	uint8_t max_payload = from_host.getLength() > 2 ? from_host.read8(2) : MAX_PACKET_PAYLOAD;
+	if (max_payload < MAX_PACKET_PAYLOAD) {
+		max_payload = MAX_PACKET_PAYLOAD;
+	}
+	// from the next packet on
+	UART::getHostUART().in.setMaxLength(max_payload);
+
+	link_window.reset();
+	to_host.append8(RC_OK);
+	to_host.append8(version);
+	to_host.append8(LINK_WINDOW_SIZE);
+	to_host.append16(command::getRemainingCapacity());
+	to_host.append8(UART::getHostUART().in.getMaxLength());
+}
+
+/// change the speed of the link once the response has gone
+void handleSetBaudRate(const InPacket& from_host, OutPacket& to_host) {
+	if (from_host.getLength() < 5) {
+		to_host.append8(RC_PACKET_ERROR);
+		return;
+	}
+	UART& uart = UART::getHostUART();
+	uint32_t baud = from_host.read32(1);
+	if (baud != uart.getBaudRate() && uart.setBaudRate(baud, true)) {
+		baud_confirm_timeout.start(HOST_BAUD_CONFIRM_MICROS);
+	}
+	to_host.append8(RC_OK);
+	to_host.append32(uart.getBaudRate());
+}
+
+/// start or stop sending telemetry frames
+void handleSetTelemetry(const InPacket& from_host, OutPacket& to_host) {
+	if (from_host.getLength() < 3) {
+		to_host.append8(RC_PACKET_LENGTH);
+		return;
+	}
+	uint16_t interval = from_host.read16(1);
+	if (interval == 0) {
+		telemetry_interval = 0;
+		telemetry_timeout.abort();
+	} else {
+		if (interval < TELEMETRY_MIN_INTERVAL) {
+			interval = TELEMETRY_MIN_INTERVAL;
+		}
+		telemetry_interval = interval * 1000L;
+		telemetry_timeout.start(telemetry_interval);
+	}
+	to_host.append8(RC_OK);
+}
+
+/// Heater output as sent in telemetry
+static uint8_t heaterOutput(Heater& heater) {
+	int16_t output = heater.getPIDLastOutput();
+	if (output < 0) {
+		return 0;
+	}
+	return output > 255 ? 255 : output;
+}
+
+/// Fill in a TELEMETRY_FRAME_STATUS frame; see Commands.hh for the layout
+void sendTelemetry(OutPacket& to_host) {
+	Motherboard& board = Motherboard::getBoard();
+	Point p;
+
+	to_host.reset();
+	to_host.setStartByte(TELEMETRY_START_BYTE);
+	to_host.append8(TELEMETRY_FRAME_STATUS);
+	to_host.append8(telemetry_sequence++);
+	to_host.append16(board.getExtruderBoard(0).getExtruderHeater().get_current_temperature());
+	to_host.append16(board.getExtruderBoard(1).getExtruderHeater().get_current_temperature());
+	to_host.append16(board.getPlatformHeater().get_current_temperature());
+	to_host.append8(heaterOutput(board.getExtruderBoard(0).getExtruderHeater()));
+	to_host.append8(heaterOutput(board.getExtruderBoard(1).getExtruderHeater()));
+	to_host.append8(heaterOutput(board.getPlatformHeater()));
+	to_host.append16(command::getRemainingCapacity());
+	to_host.append8(movesplanned());
+	to_host.append32(command::getLineNumber());
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		p = steppers::getStepperPosition();
+	}
+	to_host.append32(p[0]);
+	to_host.append32(p[1]);
+	to_host.append32(p[2]);
+}
+
 // query packets (non action, not queued)
 bool processQueryPacket(const InPacket& from_host, OutPacket& to_host) {
 	if (from_host.getLength() >= 1) {
@@ -623,6 +843,18 @@ bool processQueryPacket(const InPacket& from_host, OutPacket& to_host) {
 			case HOST_CMD_GET_BUILD_STATS:
 				handleGetBuildStats(to_host);
 				return true;
+			case HOST_CMD_GET_STATUS:
+				handleGetStatus(from_host, to_host);
+				return true;
+			case HOST_CMD_SET_TELEMETRY:
+				handleSetTelemetry(from_host, to_host);
+				return true;
+			case HOST_CMD_SET_BAUD_RATE:
+				handleSetBaudRate(from_host, to_host);
+				return true;
+			case HOST_CMD_LINK_VERSION:
+				handleLinkVersion(from_host, to_host);
+				return true;
 			case HOST_CMD_ADVANCED_VERSION:
 				handleGetAdvancedVersion(from_host, to_host);
 				return true;
@@ -681,10 +913,55 @@ sdcard::SdErrorCode startBuildFromSD() {
 	steppers::abort();
 	steppers::reset();
 	Motherboard::getBoard().state_reset(false);
+	checkpoint::start(buildName);
 
 	currentState = HOST_STATE_BUILDING_FROM_SD;
 	return e;
 }
+
+bool canResumeBuild() {
+	checkpoint::Checkpoint cp;
+	char name[CHECKPOINT_NAME_LEN];
+	int32_t z;
+
+	return checkpoint::load(cp, name, z) && strcmp(name, buildName) == 0;
+}
+
+sdcard::SdErrorCode resumeBuildFromSD() {
+	sdcard::SdErrorCode e;
+	checkpoint::Checkpoint cp;
+	char name[CHECKPOINT_NAME_LEN];
+	int32_t z;
+
+	if (!checkpoint::load(cp, name, z)) {
+		return sdcard::SD_ERR_GENERIC;
+	}
+	strncpy(buildName, name, MAX_FILE_LEN);
+	buildName[MAX_FILE_LEN-1] = '\0';
+
+	Motherboard::getBoard().getInterfaceBoard().RecordSDStartIdx();
+	e = sdcard::startPlayback(buildName);
+	if (e != sdcard::SD_SUCCESS) {
+		return e;
+	}
+	if (!sdcard::playbackSeek(cp.offset)) {
+		sdcard::finishPlayback();
+		return sdcard::SD_ERR_GENERIC;
+	}
+
+	command::reset();
+	steppers::abort();
+	steppers::reset();
+	Motherboard::getBoard().state_reset(false);
+	checkpoint::restart();
+	command::resume(cp, z);
+
+	// the build start notification is behind us in the file
+	startPrintTime();
+	buildState = BUILD_RUNNING;
+	currentState = HOST_STATE_BUILDING_FROM_SD;
+	return e;
+}
     // start build from utility script
 void startOnboardBuild(uint8_t  build){
 	
@@ -721,17 +998,21 @@ void stopBuild() {
 		/// lower the z stage if a build is canceled
 		/// ensure that we have homed all axes before attempting this
 		uint8_t z_home = steppers::isZHomed();   
+		int32_t parked_z = CHECKPOINT_Z_UNKNOWN;
 		if(z_home > 0){
 			Point target = steppers::getPlannerPosition();
 			if(z_home == 1) {target[2] = 145L*stepperAxisStepsPerMM(Z_AXIS);}
 			else {target[2] = 150L*stepperAxisStepsPerMM(Z_AXIS);}
 			command::pause(false);
 			steppers::setTarget(target, 150);
+			parked_z = target[2];
 			InterfaceBoard& ib = Motherboard::getBoard().getInterfaceBoard();
 			ib.errorMessage(CANCEL_PLATE_MSG);
 			ib.lock();
 			z_stage_timeout.start(10000000);  //10 seconds
 		}
+		// a cancelled SD build can be resumed from its last checkpoint
+		checkpoint::stop(parked_z);
 		Motherboard::getBoard().resetHeatHoldTimeout();
 	}
 
@@ -865,10 +1146,7 @@ bool processExtruderQueryPacket(const InPacket& from_host, OutPacket& to_host) {
 			return true;
 		case SLAVE_CMD_GET_TOOL_STATUS:
 			to_host.append8(RC_OK);
-			to_host.append8((board.getExtruderBoard(id).getExtruderHeater().has_failed()?128:0)
-							| (board.getPlatformHeater().has_failed()?64:0)
-							| (board.getExtruderBoard(id).getExtruderHeater().GetFailMode())
-							| (board.getExtruderBoard(id).getExtruderHeater().has_reached_target_temperature()?1:0));
+			to_host.append8(getToolStatus(id));
 			return true;
 		case SLAVE_CMD_GET_PID_STATE:
 			to_host.append8(RC_OK);
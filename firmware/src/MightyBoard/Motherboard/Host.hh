@@ -73,6 +73,16 @@ HostState getHostState();
 /// \return True if build started successfully.
 sdcard::SdErrorCode startBuildFromSD();
 
+/// Check whether the last SD build was of the file named by #getBuildName()
+/// and was stopped part way, so that it can be resumed.
+/// \return True if the build can be resumed
+bool canResumeBuild();
+
+/// Resume the last SD build from its latest checkpoint.  The build name is
+/// set to the name of its file.
+/// \return SD_SUCCESS if the build was resumed
+sdcard::SdErrorCode resumeBuildFromSD();
+
 /// start build from onboard script 
 /// no error check here yet, should not have read errors
 void startOnboardBuild(uint8_t  build);
@@ -22,11 +22,13 @@
 #include <util/atomic.h>
 #include <avr/wdt.h>
 #include "Timeout.hh"
+#include "TimerWheel.hh"
 #include "Steppers.hh"
 #include "Motherboard.hh"
 #include "SDCard.hh"
 #include "Eeprom.hh"
 #include "EepromMap.hh"
+#include "Settings.hh"
 #include "TemperatureTable.hh"
 #include <util/delay.h>
 #include "UtilityScripts.hh"
@@ -120,7 +122,9 @@ void reset(bool hard_reset) {
     Piezo::reset();
 		utility::reset();
 		command::reset();
+		settings::flush();
 		eeprom::init();
+		settings::load();
     steppers::init();
 		steppers::abort();
 		steppers::reset();
@@ -146,13 +150,26 @@ int main() {
 	reset(true);
 	sei();
 	    
+	TimerWheel& wheel = TimerWheel::getWheel();
 	while (1) {
+		// Mark the timeouts which have elapsed since the last pass, for the slices
+		micros_t now = board.getCurrentMicros();
+		wheel.advance(now);
 		// Host interaction thread.
 		host::runHostSlice();	
 		// Command handling thread.
 		command::runCommandSlice();
 		// Motherboard slice
 		board.runMotherboardSlice();
+		// Stepper slice
+		steppers::runSteppersSlice();
+		// Until the next timeout is due, spend the time decoding commands, for up to
+		// a tick of the wheel so that the host is still answered promptly
+		micros_t idle = wheel.untilNextDue();
+		if (idle > TIMER_WHEEL_TICK_MICROS) { idle = TIMER_WHEEL_TICK_MICROS; }
+		while (!command::isEmpty() && board.getCurrentMicros() - now < idle) {
+			command::runCommandSlice();
+		}
 		//Alert if SRAM/stack has been corrupted by running out of SRAM
 #if defined(STACK_PAINT) && defined(DEBUG_SRAM_MONITOR)
 		stackAlertCounter ++;
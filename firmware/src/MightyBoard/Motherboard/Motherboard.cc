@@ -21,12 +21,14 @@
 #include <util/atomic.h>
 #include "Motherboard.hh"
 #include "Configuration.hh"
+#include "Timebase.hh"
 #include "Steppers.hh"
 #include "Command.hh"
 #include "Interface.hh"
 #include "Commands.hh"
 #include "Eeprom.hh"
 #include "EepromMap.hh"
+#include "Settings.hh"
 #include "SoftI2cManager.hh"
 #include "Piezo.hh"
 #include "RGB_LED.hh"
@@ -68,7 +70,9 @@ Motherboard::Motherboard() :
 {
 }
 
- 
+/// Interval of the debug and interface LED blink state machines
+#define BLINK_INTERVAL_MICROS	16600
+
 #define ENABLE_TIMER_INTERRUPTS     TIMSK2 |= (1<<OCIE2A); \
                             TIMSK5 |= (1<<OCIE5A)
  
@@ -96,7 +100,6 @@ void Motherboard::init(){
 		
 #ifdef MODEL_REPLICATOR2 
 	therm_sensor.init();
-	therm_sensor_timeout.start(THERMOCOUPLE_UPDATE_RATE);
 #else
 	cutoff.init();
 	extruder_manage_timeout.start(SAMPLE_INTERVAL_MICROS_THERMOCOUPLE);
@@ -126,7 +129,13 @@ void Motherboard::initClocks(){
 	OCR5A = 0x2000; //INTERVAL_IN_MICROSECONDS * 16;
 	TIMSK5 = 0x02; // turn on OCR5A match interrupt
 	
-	// Reset and configure timer 2, the microsecond timer, advance_timer and debug LED flasher timer.
+	// Reset and configure the timebase timer, free running at 1/8 (2MHz), with
+	// an interrupt on overflow only
+	TIMEBASE_TCCRA = 0x00;
+	TIMEBASE_TCCRB = 0x02;
+	TIMEBASE_TIMSK = _BV(TIMEBASE_TOIE);
+
+	// Reset and configure timer 2, the advance_timer, thermocouple and endstop poll timer.
 	TCCR2A = 0x02; //CTC  //0x00;  
 	TCCR2B = 0x04; //prescaler at 1/64  //0x0A; /// prescaler at 1/8
 	OCR2A = 25; //Generate interrupts 16MHz / 64 / 25 = 10KHz  //INTERVAL_IN_MICROSECONDS;  // TODO: update PWM settings to make overflowtime adjustable if desired : currently interupting on overflow
@@ -188,7 +197,13 @@ void Motherboard::reset(bool hard_reset) {
 	UART::getHostUART().enable(true);
 	UART::getHostUART().in.reset();
 	
-	micros = 0;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		micros = 0;
+		TIMEBASE_TCNT = 0;
+		TIMEBASE_TIFR = _BV(TIMEBASE_TOV);
+	}
+	TimerWheel::getWheel().reset(getCurrentMicros());
+	blink_timeout.start(BLINK_INTERVAL_MICROS);
 
 	// get heater timeout from eeprom - the value is stored in minutes 
 	restart_timeout = (eeprom::getEeprom8(eeprom_offsets::HEATER_TIMEOUT_ON_CANCEL, 0) * ONE_MINUTE) + ONE_SECOND;
@@ -295,14 +310,23 @@ void Motherboard::state_reset(bool hard_reset) {
 
 }
 
+/// The timebase timer, for timebaseRead().  The count is read with interrupts
+/// off, as the button scan interrupts read it through the same TEMP register.
+struct TimebaseTimer {
+	static uint16_t count() {
+		uint16_t count;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			count = TIMEBASE_TCNT;
+		}
+		return count;
+	}
+	static bool	overflowPending()	{ return ( TIMEBASE_TIFR & _BV(TIMEBASE_TOV) ) != 0; }
+};
+
 /// Get the number of microseconds that have passed since
 /// the board was booted.
 micros_t Motherboard::getCurrentMicros() {
-	micros_t micros_snapshot;
-	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-		micros_snapshot = micros;
-	}
-	return micros_snapshot;
+	return timebaseRead<TimebaseTimer>(micros);
 }
 
 /// Run the motherboard interrupt
@@ -440,8 +464,8 @@ void Motherboard::HeatingAlerts(){
 			div_temp = setTemp;
 		}
              
-		if((div_temp != 0) && eeprom::getEeprom8(eeprom_offsets::LED_STRIP_SETTINGS + blink_eeprom_offsets::LED_HEAT_ON, 1)
-				&& (eeprom::getEeprom8(eeprom_offsets::LED_STRIP_SETTINGS, LED_DEFAULT_OFF) != LED_DEFAULT_OFF)){
+		if((div_temp != 0) && settings::valueOr(settings::values.led.led_heat_on, (uint8_t)1)
+				&& (settings::valueOr(settings::values.led.basic_color, (uint8_t)LED_DEFAULT_OFF) != LED_DEFAULT_OFF)){
 			int32_t mult = 255;
 			if(!heating_lights_active){
 #ifdef MODEL_REPLICATOR
@@ -520,10 +544,9 @@ void Motherboard::runMotherboardSlice() {
 	
 	bool interface_updated = false;
     
-	// check for user button press
-	// update interface screen as necessary
+	// update interface screen as necessary; the buttons are scanned by
+	// interrupt (see ButtonArray.cc)
 	if (hasInterfaceBoard) {
-		interfaceBoard.doInterrupt();
 		// stagger motherboard updates so that they do not all occur on the same loop
 		if (interface_update_timeout.hasElapsed()){
 			interfaceBoard.doUpdate();
@@ -532,11 +555,19 @@ void Motherboard::runMotherboardSlice() {
 		}
 	}
 			   
+	// write back changed settings
+	settings::update();
+
 	if(isUsingPlatform() && platform_timeout.hasElapsed()) {
 		// manage heating loops for the HBP
 		platform_heater.manage_temperature();
 		platform_timeout.start(SAMPLE_INTERVAL_MICROS_THERMISTOR);
 	}
+
+	if (blink_timeout.hasElapsed()) {
+		updateBlink();
+		blink_timeout.start(BLINK_INTERVAL_MICROS);
+	}
 	
 	// if waiting on button press
 	if(buttonWait)
@@ -654,21 +685,19 @@ void Motherboard::runMotherboardSlice() {
 	}
 	
 #ifdef MODEL_REPLICATOR2
-	if(therm_sensor_timeout.hasElapsed() && !interface_updated){
-		bool success = therm_sensor.update();
-		if (success){
-			therm_sensor_timeout.start(THERMOCOUPLE_UPDATE_RATE);
-			switch (therm_sensor.getLastUpdated()){
-				case ThermocoupleReader::CHANNEL_ONE:
-					Extruder_One.runExtruderSlice();
-					HeatingAlerts();
-					break;
-				case ThermocoupleReader::CHANNEL_TWO:
-					Extruder_Two.runExtruderSlice();
-					break;
-				default:
-					break;
-			}
+	// the thermocouple ADC is clocked from the timer interrupt at a fixed
+	// rate; we only need to convert and act on new reads here
+	if(therm_sensor.update()){
+		switch (therm_sensor.getLastUpdated()){
+			case ThermocoupleReader::CHANNEL_ONE:
+				Extruder_One.runExtruderSlice();
+				HeatingAlerts();
+				break;
+			case ThermocoupleReader::CHANNEL_TWO:
+				Extruder_Two.runExtruderSlice();
+				break;
+			default:
+				break;
 		}
 	}
 #else 
@@ -704,13 +733,13 @@ void Motherboard::abortHeatHoldTimeout(){
 	heat_hold_timeout.abort();
 }
 
-//Frequency of Timer 2
-//100 = (1.0 / ( 16MHz / 64 / 25 = 10KHz)) * 1000000
-#define MICROS_INTERVAL 100
-
 void Motherboard::UpdateMicros(){
-	micros += MICROS_INTERVAL;//_IN_MICROSECONDS;
+	micros += TIMEBASE_OVERFLOW_MICROS;
+}
 
+/// Timebase timer overflow interrupt
+ISR(TIMEBASE_OVF_vect) {
+	Motherboard::getBoard().UpdateMicros();
 }
 
 /// Timer three comparator match interrupt
@@ -776,11 +805,11 @@ uint8_t Motherboard::getCurrentError() {
 	return blink_count;
 }
 
-/// Timer2 overflow cycles that the LED remains on while blinking
+/// Blink intervals that the LED remains on while blinking
 #define OVFS_ON 18
-/// Timer2 overflow cycles that the LED remains off while blinking
+/// Blink intervals that the LED remains off while blinking
 #define OVFS_OFF 18
-/// Timer2 overflow cycles between flash cycles
+/// Blink intervals between flash cycles
 #define OVFS_PAUSE 80
 
 /// Number of overflows remaining on the current blink cycle
@@ -790,24 +819,27 @@ int blinked_so_far = 0;
 /// Number of overflows remaining on the current overflow blink cycle
 int interface_ovfs_remaining = 0;
 
-uint8_t blink_overflow_counter = 0;
-
 volatile micros_t m2;
 
 /// Timer 2 overflow interrupt
 ISR(TIMER2_COMPA_vect) {
-	
-	Motherboard::getBoard().UpdateMicros();
+
+#ifdef MODEL_REPLICATOR2
+	Motherboard::getBoard().getThermocoupleReader().doInterrupt();
+#endif
 
 #ifdef JKN_ADVANCE
   steppers::doExtruderInterrupt();
 #endif
-	
-	if(blink_overflow_counter++ <= 0xA4)
-			return;
-	
-	blink_overflow_counter = 0;
-			
+
+	steppers::pollEndstops();
+
+	// clock the digipots
+	SoftI2cManager::getI2cManager().doInterrupt();
+}
+
+/// Blink the debug and interface LEDs, every BLINK_INTERVAL_MICROS
+void Motherboard::updateBlink() {
 	/// Debug LEDS on Motherboard
 	if (blink_ovfs_remaining > 0) {
 		blink_ovfs_remaining--;
@@ -24,6 +24,7 @@
 #include "PSU.hh"
 #include "Configuration.hh"
 #include "Timeout.hh"
+#include "TimerWheel.hh"
 #include "Menu.hh"
 #include "InterfaceBoard.hh"
 #include "LiquidCrystalSerial.hh"
@@ -78,18 +79,19 @@ public:
 
 private:
 
-	/// Microseconds since board initialization
+	/// Microseconds since board initialization at the last overflow of the
+	/// timebase timer, see Timebase.hh
 	volatile micros_t micros;
 
 	/// Private constructor; use the singleton
 	Motherboard();
 
   // TODO: Move this to an interface board slice.
-	Timeout interface_update_timeout;
-	Timeout user_input_timeout;
-	Timeout heat_hold_timeout;
+	ScheduledTimeout interface_update_timeout;
+	ScheduledTimeout user_input_timeout;
+	ScheduledTimeout heat_hold_timeout;
+	ScheduledTimeout blink_timeout;
 #ifdef MODEL_REPLICATOR2
-	Timeout therm_sensor_timeout;
 	ThermocoupleReader therm_sensor;
 #else
   Cutoff cutoff; //we're not using the safety cutoff, but we need to disable the circuit
@@ -100,8 +102,8 @@ private:
 	
 	ExtruderBoard Extruder_One;
 	ExtruderBoard Extruder_Two;
-	Timeout extruder_manage_timeout;
-	Timeout platform_timeout;
+	ScheduledTimeout extruder_manage_timeout;
+	ScheduledTimeout platform_timeout;
 	
 	ButtonArray buttonArray;
 	LiquidCrystalSerial lcd;
@@ -155,7 +157,7 @@ public:
 	const int getStepperCount() const { return STEPPER_COUNT; }
 	
 	/// Get the number of microseconds that have passed since
-	/// the board was initialized.  This value will wrap after
+	/// the board was initialized, to the microsecond.  This value will wrap after
 	/// 2**32 microseconds (ca. 70 minutes); callers should compensate for this.
 	micros_t getCurrentMicros();
 
@@ -191,8 +193,11 @@ public:
 	void setBoardStatus(status_states state, bool on);
 	
 	
-	/// update microsecond counter
+	/// add an overflow of the timebase timer to the microsecond counter
 	void UpdateMicros();
+
+	/// step the debug and interface LED blinking
+	void updateBlink();
 	
 	uint8_t HeatProgressBar(uint8_t line, uint8_t start_char, uint8_t end_char, uint8_t lastHeatIndex);
 	void StartProgressBar(uint8_t line, uint8_t start_char, uint8_t end_char);
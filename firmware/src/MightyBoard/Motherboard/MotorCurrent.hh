@@ -0,0 +1,76 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef MOTOR_CURRENT_HH_
+#define MOTOR_CURRENT_HH_
+
+#include "Types.hh"
+
+/// Phases of motion, as st_motion_phase() gives them
+#define MOTION_IDLE	0	///< Nothing to step
+#define MOTION_CRUISE	1	///< Stepping at a steady rate
+#define MOTION_ACCEL	2	///< Accelerating or decelerating, or about to
+
+/// Motor currents, in percent of the pot value set for each axis.  The
+/// boost is capped at DIGI_POT_MAX.
+#define MOTOR_CURRENT_BOOST	115
+#define MOTOR_CURRENT_CRUISE	85
+#define MOTOR_CURRENT_IDLE	60
+
+/// The boost is kept this long after the acceleration, so that the pots are not
+/// rewritten for every short cruise between two accelerations
+#define MOTOR_CURRENT_HOLD_MICROS	150000L
+/// Time without motion before the current drops to idle
+#define MOTOR_CURRENT_IDLE_MICROS	2000000L
+
+/// Chooses the current of the motors from the phase of the motion: boosted while
+/// the motors accelerate or decelerate, when torque is needed to keep from skipping
+/// steps, lowered while cruising, and lowered further once the motors have stood
+/// still for a while, to keep the drivers and motors cool.  Raising the current is
+/// immediate, lowering it waits.
+/// \ingroup SoftwareLibraries
+class MotorCurrentPolicy {
+private:
+	uint8_t percent;
+	micros_t last_accel;		///< Time the motion last accelerated
+	micros_t last_motion;		///< Time the motion was last not idle
+public:
+	MotorCurrentPolicy() : percent(100), last_accel(0), last_motion(0) {}
+
+	/// \param [in] phase Phase of the motion now, MOTION_IDLE, MOTION_CRUISE or
+	/// MOTION_ACCEL.
+	/// \param [in] now Current time, from the system clock.
+	/// \return Motor current in percent of the pot value set.
+	uint8_t update(uint8_t phase, micros_t now) {
+		if ( phase == MOTION_ACCEL ) {
+			last_accel = now;
+			last_motion = now;
+			percent = MOTOR_CURRENT_BOOST;
+		} else if ( phase == MOTION_CRUISE ) {
+			last_motion = now;
+			if ( percent != MOTOR_CURRENT_BOOST || now - last_accel >= (micros_t)MOTOR_CURRENT_HOLD_MICROS )
+				percent = MOTOR_CURRENT_CRUISE;
+		} else if ( now - last_motion >= (micros_t)MOTOR_CURRENT_IDLE_MICROS ) {
+			percent = MOTOR_CURRENT_IDLE;
+		} else if ( percent == MOTOR_CURRENT_BOOST && now - last_accel >= (micros_t)MOTOR_CURRENT_HOLD_MICROS ) {
+			percent = MOTOR_CURRENT_CRUISE;
+		}
+		return percent;
+	}
+};
+
+#endif // MOTOR_CURRENT_HH_
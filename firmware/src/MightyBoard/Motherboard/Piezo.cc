@@ -20,6 +20,7 @@
  
 #include "Piezo.hh"
 #include "Configuration.hh"
+#include "TimerWheel.hh"
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
@@ -67,7 +68,7 @@ CircularBuffer32 tones(TONE_QUEUE_SIZE, tones_buf);
 
 static bool soundEnabled = false;
 static bool playing = false;
-static Timeout piezoTimeout;
+static ScheduledTimeout piezoTimeout;
 
 
 
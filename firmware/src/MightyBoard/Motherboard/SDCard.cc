@@ -221,7 +221,7 @@ bool isCapturing() {
 	return capturing;
 }
 
-SdErrorCode startCapture(char* filename)
+SdErrorCode startCapture(char* filename, uint32_t sizeHint)
 {
   reset();
   SdErrorCode result = initCard();
@@ -243,6 +243,15 @@ SdErrorCode startCapture(char* filename)
     return SD_ERR_GENERIC;
   }
 
+  // Allocating the whole file now keeps it in one run of clusters, and
+  // spares the FAT a scan each time the file grows by a cluster.  A card
+  // too full for the hint just allocates as the file grows.
+  if (sizeHint != 0) {
+    fat_reserve_file(file, sizeHint);
+  }
+  // the file is written front to back, so let the card take it as a stream
+  sd_raw_stream_enable(1);
+
   capturing = true;
   return SD_SUCCESS;
 }
@@ -251,7 +260,9 @@ void capturePacket(const Packet& packet)
 {
 	if (file == 0) return;
 	// Casting away volatile is OK in this instance; we know where the
-	// data is located and that fat_write_file isn't caching
+	// data is located and that fat_write_file isn't caching.  Packets
+	// are gathered into whole blocks in the sd_raw block buffer, and
+	// the directory entry is not written until the file is closed.
 	fat_write_file(file, (uint8_t*)packet.getData(), packet.getLength());
 	capturedBytes += packet.getLength();
 }
@@ -261,9 +272,12 @@ uint32_t finishCapture()
 {
   if (capturing) {
     if (file != 0) {
+    	// give back any space reserved beyond the end of the file
+    	fat_resize_file(file, fat_get_file_size(file));
     	fat_close_file(file);
     	sd_raw_sync();
     }
+    sd_raw_stream_enable(0);
     file = 0;
     capturing = false;
   }
@@ -315,6 +329,8 @@ SdErrorCode startPlayback(char* filename) {
   }
   open_fileSize = fat_get_file_size(file);
   playing = true;
+  // playback reads the file front to back, so let the card stream it
+  sd_raw_stream_enable(1);
   fetchNextByte();
   return SD_SUCCESS;
 }
@@ -324,8 +340,18 @@ void playbackRewind(uint8_t bytes) {
   fat_seek_file(file, &offset, FAT_SEEK_CUR);
 }
 
+bool playbackSeek(uint32_t offset) {
+  int32_t position = offset;
+  if (!fat_seek_file(file, &position, FAT_SEEK_SET)) {
+    return false;
+  }
+  fetchNextByte();
+  return has_more;
+}
+
 void finishPlayback() {
   playing = false;
+  sd_raw_stream_enable(0);
   if (file != 0) {
 	  fat_close_file(file);
 	  sd_raw_sync();
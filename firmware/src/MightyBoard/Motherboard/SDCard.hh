@@ -59,10 +59,12 @@ namespace sdcard {
 
 
     /// Begin capturing bufffered commands to a new file with the given filename.
-    /// Returns an SD card error/success code.
+    /// Returns an SD card error/success code.  If the host says how large the
+    /// file will be, space for it is allocated up front in one piece.
     /// \param[in] filename Name of file to write to
+    /// \param[in] sizeHint Expected size of the file in bytes, or 0 if unknown
     /// \return SD_SUCCESS if successful
-    SdErrorCode startCapture(char* filename);
+    SdErrorCode startCapture(char* filename, uint32_t sizeHint = 0);
 
 
     /// Capture the contents of a packet to the currently open file.
@@ -103,6 +105,12 @@ namespace sdcard {
     void playbackRewind(uint8_t bytes);
 
 
+    /// Move playback to a position in the file, as when resuming a build.
+    /// \param[in] offset Offset of the next byte to play back
+    /// \return True if there is data at the offset
+    bool playbackSeek(uint32_t offset);
+
+
     /// Halt playback.  Should be called at the end of playback, or on manual
     /// halt; frees up resources.
     void finishPlayback();
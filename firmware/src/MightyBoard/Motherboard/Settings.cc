@@ -0,0 +1,167 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "Settings.hh"
+#include <stddef.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+
+namespace settings {
+
+Settings values;
+
+/// Where each block is in the EEPROM and in #values
+struct Block {
+	uint16_t eeprom;
+	uint8_t ram;
+	uint8_t size;
+};
+
+static const Block blocks[] PROGMEM = {
+#define SETTINGS_BLOCK(type, name, offset) \
+	{ offset, offsetof(Settings, name), sizeof(type) },
+	SETTINGS_BLOCKS(SETTINGS_BLOCK)
+#undef SETTINGS_BLOCK
+};
+
+#define BLOCK_COUNT (sizeof(blocks) / sizeof(blocks[0]))
+
+/// Nothing is read from the settings until they have been loaded, as
+/// static constructors read the EEPROM before main() runs
+bool loaded = false;
+/// One bit per block with changes to write back
+uint16_t dirty = 0;
+/// Next byte of the lowest dirty block to compare with the EEPROM
+uint8_t cursor = 0;
+/// CRC of #values
+uint16_t crc;
+
+static uint16_t crcOf() {
+	const uint8_t* bytes = (const uint8_t*)&values;
+	uint16_t c = 0xFFFF;
+	for (uint8_t i = 0; i < sizeof(Settings); i++) {
+		c = _crc16_update(c, bytes[i]);
+	}
+	return c;
+}
+
+/// Find the block holding an EEPROM byte
+/// \return Index of the block, or BLOCK_COUNT if it is not held
+static uint8_t blockOf(uint16_t location, uint8_t& ram) {
+	for (uint8_t b = 0; b < BLOCK_COUNT; b++) {
+		uint16_t start = pgm_read_word(&blocks[b].eeprom);
+		if (location >= start && location - start < pgm_read_byte(&blocks[b].size)) {
+			ram = pgm_read_byte(&blocks[b].ram) + (location - start);
+			return b;
+		}
+	}
+	return BLOCK_COUNT;
+}
+
+void load() {
+	for (uint8_t b = 0; b < BLOCK_COUNT; b++) {
+		eeprom_read_block((uint8_t*)&values + pgm_read_byte(&blocks[b].ram),
+			(const void*)pgm_read_word(&blocks[b].eeprom),
+			pgm_read_byte(&blocks[b].size));
+	}
+	dirty = 0;
+	cursor = 0;
+	crc = crcOf();
+	loaded = true;
+}
+
+bool read(uint16_t location, uint8_t length, void* data) {
+	uint8_t ram;
+	uint8_t b = blockOf(location, ram);
+
+	if (!loaded || b == BLOCK_COUNT || (uint16_t)(location - pgm_read_word(&blocks[b].eeprom)) + length >
+			pgm_read_byte(&blocks[b].size)) {
+		return false;
+	}
+	memcpy(data, (const uint8_t*)&values + ram, length);
+	return true;
+}
+
+void write(uint16_t location, const void* data, uint8_t length) {
+	const uint8_t* bytes = (const uint8_t*)data;
+
+	if (!loaded || crc != crcOf()) {
+		load();
+	}
+	for (uint8_t i = 0; i < length; i++, location++) {
+		uint8_t ram;
+		uint8_t b = blockOf(location, ram);
+		if (b == BLOCK_COUNT) {
+			eeprom_busy_wait();
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+				eeprom_write_byte((uint8_t*)location, bytes[i]);
+			}
+		} else if (((uint8_t*)&values)[ram] != bytes[i]) {
+			((uint8_t*)&values)[ram] = bytes[i];
+			dirty |= 1 << b;
+		}
+	}
+	// the block being written back may have changed behind the cursor
+	cursor = 0;
+	crc = crcOf();
+}
+
+void update() {
+	if (dirty == 0 || !eeprom_is_ready()) {
+		return;
+	}
+	// something has written over the settings; better to lose the changes
+	// than to write it out
+	if (crc != crcOf()) {
+		load();
+		return;
+	}
+
+	uint8_t b = 0;
+	while ((dirty & (1 << b)) == 0) {
+		b++;
+	}
+	uint16_t location = pgm_read_word(&blocks[b].eeprom);
+	const uint8_t* ram = (const uint8_t*)&values + pgm_read_byte(&blocks[b].ram);
+	uint8_t size = pgm_read_byte(&blocks[b].size);
+
+	// one byte a call, so the caller never waits on the EEPROM
+	while (cursor < size && eeprom_read_byte((uint8_t*)(location + cursor)) == ram[cursor]) {
+		cursor++;
+	}
+	if (cursor == size) {
+		dirty &= ~(1 << b);
+		cursor = 0;
+		return;
+	}
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		eeprom_write_byte((uint8_t*)(location + cursor), ram[cursor]);
+	}
+	cursor++;
+}
+
+void flush() {
+	while (dirty != 0) {
+		eeprom_busy_wait();
+		update();
+	}
+}
+
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef SETTINGS_HH_
+#define SETTINGS_HH_
+
+#include <stdint.h>
+#include "EepromMap.hh"
+
+/// The settings module keeps the EEPROM settings that are used while
+/// building in SRAM, so that reading one is a plain load rather than an
+/// EEPROM access.  Each block below has the layout of its part of the
+/// EEPROM map byte for byte (simulator/settings_layout checks this), and
+/// unset bytes read as 0xFF, as they do in the EEPROM.
+///
+/// The blocks are loaded at reset, once eeprom::init() has brought the
+/// EEPROM up to date with the firmware version.  Changes made with
+/// #settings::write() are written back a byte at a time by
+/// #settings::update().  The copy in SRAM is covered by a CRC, which is
+/// checked before anything is written back, so a copy damaged by a stack
+/// overrun is reloaded rather than written over the EEPROM.
+///
+/// eeprom::getEeprom8() and the rest read from here when they can, so
+/// settings in the blocks are read from SRAM wherever they are used.
+/// Code which writes the EEPROM directly must call #settings::load()
+/// afterwards.
+namespace settings {
+
+/// eeprom_offsets::AXIS_INVERSION to AXIS_HOME_DIRECTION
+struct AxisSettings {
+	uint8_t axis_inversion;
+	uint8_t unused0;
+	uint8_t endstop_inversion;
+	uint8_t unused1;
+	uint8_t digi_pots[5];
+	uint8_t unused2;
+	uint8_t home_direction;
+} __attribute__ ((__packed__));
+
+/// pid_eeprom_offsets; fixed 16 values, whole part first
+struct PidSettings {
+	uint8_t p_term[2];
+	uint8_t i_term[2];
+	uint8_t d_term[2];
+} __attribute__ ((__packed__));
+
+/// blink_eeprom_offsets
+struct BlinkSettings {
+	uint8_t basic_color;
+	uint8_t unused0;
+	uint8_t led_heat_on;
+	uint8_t unused1;
+	uint8_t custom_color[3];
+	uint8_t unused2;
+} __attribute__ ((__packed__));
+
+/// acceleration_eeprom_offsets
+struct AccelerationSettings {
+	uint8_t acceleration_active;
+	uint8_t unused0;
+	uint16_t max_acceleration_normal_move;
+	uint16_t max_acceleration_axis[5];
+	uint16_t max_speed_change[5];
+	uint16_t max_acceleration_extruder_move;
+	uint8_t defaults_flag;
+} __attribute__ ((__packed__));
+
+/// acceleration2_eeprom_offsets, up to the bytes for future use
+struct Acceleration2Settings {
+	uint32_t jkn_advance_k;
+	uint32_t jkn_advance_k2;
+	uint16_t extruder_deprime_steps[2];
+	uint8_t slowdown_flag;
+} __attribute__ ((__packed__));
+
+/// eeprom_offsets::HEATER_CALIBRATION
+struct CalibrationSettings {
+	uint8_t heater[3];
+} __attribute__ ((__packed__));
+
+/// eeprom_offsets::TOOLHEAD_OFFSET_SETTINGS_MM
+struct ToolheadOffsetSettings {
+	int32_t offset_um[3];
+} __attribute__ ((__packed__));
+
+/// The blocks kept in SRAM: type, name and EEPROM offset.  At most 16.
+#define SETTINGS_BLOCKS(X) \
+	X(AxisSettings, axes, eeprom_offsets::AXIS_INVERSION) \
+	X(uint8_t, hbp_present, eeprom_offsets::HBP_PRESENT) \
+	X(PidSettings, t0_extruder_pid, eeprom_offsets::T0_DATA_BASE + toolhead_eeprom_offsets::EXTRUDER_PID_BASE) \
+	X(PidSettings, t0_hbp_pid, eeprom_offsets::T0_DATA_BASE + toolhead_eeprom_offsets::HBP_PID_BASE) \
+	X(PidSettings, t1_extruder_pid, eeprom_offsets::T1_DATA_BASE + toolhead_eeprom_offsets::EXTRUDER_PID_BASE) \
+	X(BlinkSettings, led, eeprom_offsets::LED_STRIP_SETTINGS) \
+	X(uint8_t, sound_on, eeprom_offsets::BUZZ_SETTINGS + buzz_eeprom_offsets::SOUND_ON) \
+	X(AccelerationSettings, acceleration, eeprom_offsets::ACCELERATION_SETTINGS) \
+	X(Acceleration2Settings, acceleration2, eeprom_offsets::ACCELERATION2_SETTINGS) \
+	X(CalibrationSettings, heater_calibration, eeprom_offsets::HEATER_CALIBRATION) \
+	X(ToolheadOffsetSettings, toolhead_offsets, eeprom_offsets::TOOLHEAD_OFFSET_SETTINGS_MM) \
+	X(uint8_t, heater_timeout, eeprom_offsets::HEATER_TIMEOUT_ON_CANCEL) \
+	X(uint8_t, stop_height, eeprom_offsets::STOP_HEIGHT_VALUE)
+
+struct Settings {
+#define SETTINGS_FIELD(type, name, offset) type name;
+	SETTINGS_BLOCKS(SETTINGS_FIELD)
+#undef SETTINGS_FIELD
+} __attribute__ ((__packed__));
+
+/// The settings.  Change them with #write(), never directly.
+extern Settings values;
+
+/// A setting, or a default if it has never been set
+inline uint8_t valueOr(uint8_t value, uint8_t default_value) {
+	return value == 0xFF ? default_value : value;
+}
+inline uint16_t valueOr(uint16_t value, uint16_t default_value) {
+	return value == 0xFFFF ? default_value : value;
+}
+inline uint32_t valueOr(uint32_t value, uint32_t default_value) {
+	return value == 0xFFFFFFFF ? default_value : value;
+}
+
+/// Load the settings from the EEPROM, dropping any changes not yet
+/// written back.
+void load();
+
+/// Copy bytes of the EEPROM from the settings, if they are all there.
+/// \param[in] location EEPROM offset
+/// \param[in] length Number of bytes
+/// \param[out] data Copy of the bytes
+/// \return True if the bytes were copied
+bool read(uint16_t location, uint8_t length, void* data);
+
+/// Change bytes of the EEPROM.  Bytes held in the settings are written
+/// back later, by #update(); the rest are written now.
+/// \param[in] location EEPROM offset
+/// \param[in] data New value of the bytes
+/// \param[in] length Number of bytes
+void write(uint16_t location, const void* data, uint8_t length);
+
+/// Write back a byte of changed settings, if there is one and the EEPROM
+/// is ready.  Call this periodically.
+void update();
+
+/// Write back all changed settings.
+void flush();
+
+}
+
+#endif // SETTINGS_HH_
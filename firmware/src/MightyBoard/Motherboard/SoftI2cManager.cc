@@ -19,9 +19,15 @@
  */
 
 #include "SoftI2cManager.hh"
-#include <util/delay.h>
 #include <util/atomic.h>
 
+/// Ticks of a transfer: the start, two bytes of 9 clocks each, two ticks a
+/// clock, and the stop
+#define I2C_START_TICK  1
+#define I2C_BITS_TICK   2
+#define I2C_STOP_TICK   (I2C_BITS_TICK + 2 * 18)
+#define I2C_DONE_TICK   (I2C_STOP_TICK + 3)
+
 // initiate static i2cManager instance
 SoftI2cManager SoftI2cManager::i2cManager;
 
@@ -42,89 +48,120 @@ SoftI2cManager::SoftI2cManager():
 // init pins and set bus high
 void SoftI2cManager::init()
 {
-    for (uint8_t i = 0; i < numPins; i++)
-    {
-        sdaPins[i].setDirection(true);
-        sdaPins[i].setValue(true);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (uint8_t i = 0; i < numPins; i++)
+        {
+            sdaPins[i].setDirection(true);
+            sdaPins[i].setValue(true);
+        }
+        sclPin.setDirection(true);
+        sclPin.setValue(true);
+        pending = 0;
+        sending = 0;
+        phase = 0;
+        errors = 0;
     }
-    sclPin.setDirection(true);
-    sclPin.setValue(true);
-    
 }
 
 //------------------------------------------------------------------------------
-// read a byte and send Ack if last is false else Nak to terminate read
-uint8_t SoftI2cManager::read(bool last, const Pin &sdaPin)
+// queue a value for the pot of an axis
+void SoftI2cManager::queueWrite(uint8_t index, uint8_t value)
 {
-  uint8_t b = 0;
-  // make sure pullup enabled
-  sdaPin.setValue(true);
-  sdaPin.setDirection(false);
-  // read byte
-  for (uint8_t i = 0; i < 8; i++) {
-    // don't change this loop unless you verify the change with a scope
-    b <<= 1;
-    _delay_us(I2C_DELAY_USEC);
-    sclPin.setValue(true);
-    if (sdaPin.getValue()) b |= 1;
-    sclPin.setValue(false);
+  if (index >= numPins)
+    return;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    pendingValues[index] = value;
+    pending |= (uint8_t)(1 << index);
   }
-  // send Ack or Nak
-  sdaPin.setDirection(true);
-  sdaPin.setValue(last);
-  sclPin.setValue(true);
-  _delay_us(I2C_DELAY_USEC);
-  sclPin.setValue(false);
-  sdaPin.setValue(true);
-    
-  return b;
 }
 //------------------------------------------------------------------------------
-// send new address and read/write without stop
-uint8_t SoftI2cManager::restart(uint8_t addressRW, const Pin &sdaPin)
+bool SoftI2cManager::isBusy()
 {
-  sclPin.setValue(true);
-  return start(addressRW, sdaPin);
+  return pending != 0 || phase != 0;
 }
 //------------------------------------------------------------------------------
-// issue a start condition for i2c address with read/write bit
-uint8_t SoftI2cManager::start(uint8_t addressRW, const Pin &sdaPin)
+uint16_t SoftI2cManager::getErrorCount()
 {
-    for(uint8_t i = 0; i < numPins; i++)
-        sdaPins[i].setValue(false);
-  _delay_us(I2C_DELAY_USEC);
-  sclPin.setValue(false);
-  return write(addressRW, sdaPin);
-}
-//------------------------------------------------------------------------------
-// issue a stop condition
-void SoftI2cManager::stop()
-{
-  _delay_us(I2C_DELAY_USEC);
-   sclPin.setValue(true);  
-  _delay_us(I2C_DELAY_USEC);
-    for(uint8_t i = 0; i < numPins; i++)
-        sdaPins[i].setValue(true);  
-  _delay_us(I2C_DELAY_USEC);
+  uint16_t count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    count = errors;
+  }
+  return count;
 }
 //------------------------------------------------------------------------------
-// write byte and return true for Ack or false for Nak
-bool SoftI2cManager::write(uint8_t b, const Pin &sdaPin)
+// one tick of a transfer to the pots of the sending axes.  Data changes only
+// while the clock is low, except for the start and stop.
+void SoftI2cManager::doInterrupt()
 {
-  // write byte
-  for (uint8_t m = 0X80; m != 0; m >>= 1) {
-    // don't change this loop unless you verivy the change with a scope
-     sdaPin.setValue((m & b) != 0);
-     sclPin.setValue(true);  
-    _delay_us(I2C_DELAY_USEC);
-     sclPin.setValue(false);  
+  if (phase == 0) {
+    if (pending == 0)
+      return;
+    sending = pending;
+    for (uint8_t i = 0; i < numPins; i++)
+      sendingValues[i] = pendingValues[i];
+    pending = 0;
+    phase = I2C_START_TICK;
   }
-  // get Ack or Nak
-   sdaPin.setValue(true);  
-   sdaPin.setDirection(false); 
-   sclPin.setValue(true);  
-   b = sdaPin.getValue();
-   sclPin.setValue(false); 
-   sdaPin.setDirection(true);
-   return b == 0;
+
+  if (phase == I2C_START_TICK) {
+    // start: data low while the clock is high
+    for (uint8_t i = 0; i < numPins; i++)
+      if (sending & (1 << i))
+        sdaPins[i].setValue(false);
+  } else if (phase < I2C_STOP_TICK) {
+    uint8_t clock = (phase - I2C_BITS_TICK) >> 1;
+    uint8_t bit = clock % 9;
+    bool address = clock < 9;
+
+    if (((phase - I2C_BITS_TICK) & 1) == 0) {
+      // clock low, then the next bit, or let the pot acknowledge
+      sclPin.setValue(false);
+      for (uint8_t i = 0; i < numPins; i++) {
+        if (!(sending & (1 << i)))
+          continue;
+        if (bit == 8) {
+          sdaPins[i].setValue(true);
+          sdaPins[i].setDirection(false);
+        } else {
+          uint8_t b = address ? (DIGI_POT_I2C_ADDRESS | I2C_WRITE) : sendingValues[i];
+          sdaPins[i].setDirection(true);
+          sdaPins[i].setValue((b & (0x80 >> bit)) != 0);
+        }
+      }
+    } else {
+      // clock high, and read the acknowledge
+      sclPin.setValue(true);
+      if (bit == 8) {
+        for (uint8_t i = 0; i < numPins; i++) {
+          if ((sending & (1 << i)) && sdaPins[i].getValue()) {
+            errors++;
+            // a pot which did not answer its address gets no stop
+            if (address) {
+              sdaPins[i].setDirection(true);
+              sdaPins[i].setValue(true);
+              sending &= (uint8_t)~(1 << i);
+            }
+          }
+        }
+      }
+    }
+  } else if (phase == I2C_STOP_TICK) {
+    sclPin.setValue(false);
+    for (uint8_t i = 0; i < numPins; i++) {
+      if (sending & (1 << i)) {
+        sdaPins[i].setDirection(true);
+        sdaPins[i].setValue(false);
+      }
+    }
+  } else if (phase == I2C_STOP_TICK + 1) {
+    sclPin.setValue(true);
+  } else {
+    // stop: data high while the clock is high
+    for (uint8_t i = 0; i < numPins; i++)
+      if (sending & (1 << i))
+        sdaPins[i].setValue(true);
+  }
+
+  if (++phase == I2C_DONE_TICK)
+    phase = 0;
 }
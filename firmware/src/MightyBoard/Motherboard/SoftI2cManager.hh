@@ -24,13 +24,18 @@
 #include "Pin.hh"
 #include "Configuration.hh"
 
-// delay used to tweek signals
-#define I2C_DELAY_USEC 4
-
 // R/W direction bit to OR with address for start or restart
 #define I2C_READ 1
 #define I2C_WRITE 0
 
+// address of the MCP4018 digipots, one on the data line of each axis
+#define DIGI_POT_I2C_ADDRESS 0b01011110
+
+/// Writes the digipots of the stepper axes, bit-banging i2c from the Timer 2
+/// tick so that nothing waits on the bus.  The pots share the clock line and
+/// each has its own data line, so every pot waiting for a value is written in
+/// the same transfer, a start, the address and the value and a stop: 40 ticks,
+/// 4ms.  Each tick of #doInterrupt() moves the bus on by half a clock.
 class SoftI2cManager {
 private:
     
@@ -43,25 +48,30 @@ public:
   
   /** init bus */
   void init();
-  
-  /** read a byte and send Ack if last is false else Nak to terminate read */
-  uint8_t read(bool last, const Pin &sdaPin);
-  
-  /** send new address and read/write bit without stop */
-  uint8_t restart(uint8_t addressRW, const Pin &sdaPin);
-  
-  /** issue a start condition for i2c address with read/write bit */
-  uint8_t start(uint8_t addressRW, const Pin &sdaPin);
-  
-  /** issue a stop condition */
-  void stop(void);
-  
-  /** write byte and return true for Ack or false for Nak */
-  bool write(uint8_t b, const Pin &sdaPin);
+
+  /** write value to the pot of an axis; a value queued before the last one
+      went out replaces it */
+  void queueWrite(uint8_t index, uint8_t value);
+
+  /** true while values are waiting or going out */
+  bool isBusy();
+
+  /** pot writes which the pot did not acknowledge */
+  uint16_t getErrorCount();
+
+  /** move the bus on by half a clock; call every Timer 2 tick */
+  void doInterrupt();
     
 private:
     Pin sdaPins[MAX_STEPPERS];
     Pin sclPin;
     uint8_t numPins;
+
+    volatile uint8_t pending;             ///< Axes with a value waiting
+    uint8_t pendingValues[MAX_STEPPERS];
+    uint8_t sending;                      ///< Axes being written
+    uint8_t sendingValues[MAX_STEPPERS];
+    uint8_t phase;                        ///< Tick of the transfer, 0 when idle
+    uint16_t errors;
 };
 #endif //SOFT_I2C_MANAGER
\ No newline at end of file
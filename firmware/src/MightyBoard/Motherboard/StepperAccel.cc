@@ -35,8 +35,11 @@
 #endif
 
 #include "Motherboard.hh"
+#include "MotorCurrent.hh"
+#include "Homing.hh"
 
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 #include <string.h>
 #include <math.h>
 #include "StepperAxis.hh"
@@ -68,6 +71,7 @@ float		extruder_only_max_feedrate[EXTRUDERS];
 #endif
 
 static unsigned char		out_bits;		// The next stepping-bits to be output
+static StepperAxisStepKernel	step_kernel = stepperAxis_dda_step_kernel_any;	// Step event for the axes of the current block
 volatile static uint32_t	step_events_completed;	// The number of step events executed in the current block
 
 static int32_t		acceleration_time, deceleration_time;
@@ -81,6 +85,9 @@ static bool		deprime_enabled;		//If true, depriming is On, if not, it's Off.  It
 							//But is switched off when loading/unloading the extruder 
 static uint8_t		last_active_toolhead = 0;
 
+static volatile uint8_t	homing_approach_endstops;	// Endstops the homing approach runs to, 0 if none
+static volatile uint8_t	homing_approach_triggered;	// Endstops which have triggered in the approach
+
 #if  defined(DEBUG_TIMER)
 	uint16_t debugTimer;
 #endif
@@ -334,6 +341,22 @@ FORCE_INLINE void setup_next_block() {
 	stepperAxis_dda_reset(B_AXIS, (current_block->dda_master_axis_index == B_AXIS), current_block->step_event_count, 
 				(out_bits & (1 << B_AXIS)), current_block->steps[B_AXIS]);
 
+	// Pick the step event for the axes which move, so that idle axes cost nothing per step.
+	// Only homing blocks read the endstops on every step.
+	uint8_t dda_axes = 0;
+	bool homing = false;
+	for ( uint8_t i = 0; i < STEPPER_COUNT; i ++ ) {
+		if ( stepperAxis[i].dda.enabled )	dda_axes |= _BV(i);
+		homing |= axis_homing[i];
+	}
+	step_kernel = stepperAxisSelectStepKernel(dda_axes, homing, homing_approach_endstops != 0);
+
+	// Start the block with the endstops which are triggered now, so that one which has
+	// been released no longer holds its axis
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		endstops_triggered = stepperAxisReadEndstops(ENDSTOPS_PRESENT);
+	}
+
 	#ifdef JKN_ADVANCE
 		advance_state = ADVANCE_STATE_ACCEL;
 	#endif
@@ -352,6 +375,32 @@ FORCE_INLINE void setup_next_block() {
 
 
 
+// The homing approach has reached an endstop: cut the block short, so that it
+// decelerates to a stop from here at its acceleration
+
+FORCE_INLINE void homing_approach_decelerate() {
+	// Without acceleration it can only stop here
+	if ( ! current_block->use_accel ) {
+		current_block->step_event_count = step_events_completed;
+		return;
+	}
+
+	// Already decelerating
+	if ( step_events_completed > (uint32_t)current_block->decelerate_after )	return;
+
+	if ( step_events_completed > (uint32_t)current_block->accelerate_until )
+		acc_step_rate = current_block->nominal_rate;
+	deceleration_time = 0;
+
+	uint32_t stop = step_events_completed +
+			homingStopSteps(acc_step_rate, current_block->final_rate, current_block->acceleration_st);
+	current_block->accelerate_until = (int32_t)step_events_completed - 1;
+	current_block->decelerate_after = (int32_t)step_events_completed - 1;
+	if ( stop < current_block->step_event_count )	current_block->step_event_count = stop;
+}
+
+
+
 // "The Stepper Driver Interrupt" - This timer interrupt is the workhorse.  
 // It pops blocks from the block_buffer and executes them by pulsing the stepper pins appropriately.
 // Returns true if we deleted an item in the pipeline buffer 
@@ -366,11 +415,7 @@ bool st_interrupt() {
 
 			if ( oversampledCount < (1 << OVERSAMPLED_DDA) ) {
 				//Step the dda for each axis
-				stepperAxis_dda_step(X_AXIS);
-				stepperAxis_dda_step(Y_AXIS);
-				stepperAxis_dda_step(Z_AXIS);
-				stepperAxis_dda_step(A_AXIS);
-				stepperAxis_dda_step(B_AXIS);
+				step_kernel();
 
 				return block_deleted;
 			}
@@ -441,11 +486,7 @@ bool st_interrupt() {
 			#endif
       
 			//Step the dda for each axis
-			stepperAxis_dda_step(X_AXIS);
-			stepperAxis_dda_step(Y_AXIS);
-			stepperAxis_dda_step(Z_AXIS);
-			stepperAxis_dda_step(A_AXIS);
-			stepperAxis_dda_step(B_AXIS);
+			step_kernel();
 
 			#ifdef OVERSAMPLED_DDA
 				oversampledCount = 0;
@@ -456,6 +497,16 @@ bool st_interrupt() {
 			if(step_events_completed >= current_block->step_event_count) break;
 		}
 
+		// The homing approach reads its endstops once per interrupt, and decelerates
+		// from the first which triggers
+		if ( homing_approach_endstops ) {
+			uint8_t triggered = stepperAxisReadEndstops(homing_approach_endstops);
+			if ( triggered ) {
+				if ( ! homing_approach_triggered )	homing_approach_decelerate();
+				homing_approach_triggered |= triggered;
+			}
+		}
+
 		// Calculate new timer value
 		uint16_t timer;
 		if (step_events_completed <= (uint32_t)current_block->accelerate_until) { // ACCELERATION PHASE
@@ -665,6 +716,46 @@ bool st_empty()
 }
 
 
+// The deceleration of a block counts from 1/2**MOTION_DECEL_LEAD_SHIFT seconds
+// before it starts, about the time the digipots take to change
+#define MOTION_DECEL_LEAD_SHIFT 6
+
+uint8_t st_motion_phase()
+{
+	uint8_t phase = MOTION_CRUISE;
+
+	CRITICAL_SECTION_START
+	if ( current_block == NULL ) {
+		// a block waiting will start from rest
+		phase = st_empty() ? MOTION_IDLE : MOTION_ACCEL;
+	} else if ( current_block->use_accel ) {
+		int32_t lead = (int32_t)(current_block->nominal_rate >> MOTION_DECEL_LEAD_SHIFT);
+		if ( step_events_completed <= (uint32_t)current_block->accelerate_until ||
+		     (int32_t)step_events_completed + lead > current_block->decelerate_after )
+			phase = MOTION_ACCEL;
+	}
+	CRITICAL_SECTION_END
+	return phase;
+}
+
+
+
+void st_homing_approach(uint8_t endstops)
+{
+	CRITICAL_SECTION_START
+	homing_approach_endstops = endstops;
+	homing_approach_triggered = 0;
+	CRITICAL_SECTION_END
+}
+
+
+
+uint8_t st_homing_triggered()
+{
+	return homing_approach_triggered;
+}
+
+
 
 void st_set_position(const int32_t &x, const int32_t &y, const int32_t &z, const int32_t &a, const int32_t &b)
 {
@@ -77,6 +77,18 @@ void st_init();
 // Returns true is there are no buffered steps to be executed
 bool st_empty();
 
+// Returns the phase of the motion, MOTION_IDLE, MOTION_CRUISE or MOTION_ACCEL
+// (see MotorCurrent.hh), for the motor current policy
+uint8_t st_motion_phase();
+
+// Makes the blocks which follow the fast approach of homing to the endstops in
+// endstops (ENDSTOP_MIN / ENDSTOP_MAX bits): the block decelerates to a stop once
+// one of them triggers, instead of the axis stopping dead.  0 ends the approach.
+void st_homing_approach(uint8_t endstops);
+
+// Returns the endstops which have triggered in the approach
+uint8_t st_homing_triggered();
+
 // Set current position in steps
 void st_set_position(const int32_t &x, const int32_t &y, const int32_t &z, const int32_t &a, const int32_t &b);
 void st_set_e_position(const int32_t &a, const int32_t &b);
@@ -71,6 +71,7 @@
 #include <string.h>
 #include "EepromMap.hh"
 #include "Eeprom.hh"
+#include "Settings.hh"
 #include <avr/eeprom.h>
 #include "Interface.hh"
 
@@ -1557,7 +1558,7 @@ void plan_buffer_line(FPTYPE feed_rate, const uint32_t &dda_rate, const uint8_t
 void plan_read_height_stop_position(bool height_stop_enable) {
 
 	stopHeightEnabled = height_stop_enable;
-	stopHeightValue = eeprom::getEeprom8(eeprom_offsets::STOP_HEIGHT_VALUE, 0);
+	stopHeightValue = settings::valueOr(settings::values.stop_height, (uint8_t)0);
 
 }
 
@@ -25,18 +25,7 @@
 #include "StepperAxis.hh"
 #include "EepromMap.hh"
 #include "Eeprom.hh"
-
-#ifndef SIMULATOR
-//Optimize this better, maybe load defaults from progmem, x_min/max could combine invert_endstop/invert_axis into 1
-//110 bytes
-struct StepperAxisPorts stepperAxisPorts[STEPPER_COUNT] = {
-	{ X_STEPPER_STEP, X_STEPPER_DIR, X_STEPPER_ENABLE, X_STEPPER_MIN, X_STEPPER_MAX },
-	{ Y_STEPPER_STEP, Y_STEPPER_DIR, Y_STEPPER_ENABLE, Y_STEPPER_MIN, Y_STEPPER_MAX },
-	{ Z_STEPPER_STEP, Z_STEPPER_DIR, Z_STEPPER_ENABLE, Z_STEPPER_MIN, Z_STEPPER_MAX },
-	{ A_STEPPER_STEP, A_STEPPER_DIR, A_STEPPER_ENABLE, STEPPER_NULL,  STEPPER_NULL	},
-	{ B_STEPPER_STEP, B_STEPPER_DIR, B_STEPPER_ENABLE, STEPPER_NULL,  STEPPER_NULL	}
-};
-#endif
+#include <avr/interrupt.h>
 
 struct StepperAxis stepperAxis[STEPPER_COUNT];
 
@@ -45,7 +34,38 @@ volatile bool    axis_homing[STEPPER_COUNT];
 volatile int16_t e_steps[EXTRUDERS];
 volatile uint8_t axesEnabled;			//Planner axis enabled
 volatile uint8_t axesHardwareEnabled;		//Hardware axis enabled
+volatile uint8_t endstops_triggered;		//Endstops seen triggered since the block started
+
+// When the buttons share the endstops' pin change interrupt, ButtonArray.cc has the
+// handler and latches the endstops from it
+#if defined(ENDSTOPS_PIN_CHANGE) && !(defined(BUTTONS_PIN_CHANGE) && BUTTONS_PIN_CHANGE == ENDSTOPS_PIN_CHANGE)
+
+/// An endstop with a pin change interrupt has changed, latch it if it is now triggered
+ISR(PIN_CHANGE_VECT(ENDSTOPS_PIN_CHANGE)) {
+	stepperAxisLatchEndstops();
+}
+
+#endif
+
+
+/// Setup the pins of an axis
+template <class Pins>
+static void stepperAxisInitPins(uint8_t endstop_xor) {
+	Pins::Dir::setOutput(true);
+	Pins::Step::setOutput(true);
 
+	//Enable is active low
+	Pins::Enable::write(true);
+	Pins::Enable::setOutput(true);
+
+	// Setup minimum and maximum ports for input
+	// Use pullup pins to avoid triggering when using inverted endstops
+	Pins::Maximum::setOutput(false);
+	Pins::Maximum::write(endstop_xor);
+
+	Pins::Minimum::setOutput(false);
+	Pins::Minimum::write(endstop_xor);
+}
 
 
 /// Initialize a stepper axis
@@ -73,7 +93,7 @@ void stepperAxisInit(bool hard_reset) {
 
 			// If endstops are not present, then we consider them inverted, since they will
 			// always register as high (pulled up).
-			stepperAxis[i].invert_endstop = !endstops_present || ((endstops_invert & (1<<i)) != 0);
+			stepperAxis[i].endstop_xor = ( !endstops_present || ((endstops_invert & (1<<i)) != 0) ) ? 0xFF : 0;
 			stepperAxis[i].invert_axis = (axes_invert & (1<<i)) != 0;
 
 			stepperAxis[i].steps_per_mm = (float)eeprom::getEeprom32(eeprom_offsets::AXIS_STEPS_PER_MM + i * sizeof(uint32_t),
@@ -112,24 +132,7 @@ void stepperAxisInit(bool hard_reset) {
       }
 
 			//Setup the pins
-			STEPPER_IOPORT_SET_DIRECTION(stepperAxisPorts[i].dir, true);
-			STEPPER_IOPORT_SET_DIRECTION(stepperAxisPorts[i].step, true);
-
-			//Enable is active low
-			STEPPER_IOPORT_WRITE(stepperAxisPorts[i].enable, true);
-			STEPPER_IOPORT_SET_DIRECTION(stepperAxisPorts[i].enable, true);
-
-			// Setup minimum and maximum ports for input
-			// Use pullup pins to avoid triggering when using inverted endstops
-			if ( ! STEPPER_IOPORT_NULL(stepperAxisPorts[i].maximum) ) {
-				STEPPER_IOPORT_SET_DIRECTION(stepperAxisPorts[i].maximum, false);
-				STEPPER_IOPORT_WRITE(stepperAxisPorts[i].maximum, stepperAxis[i].invert_endstop);
-			}
-
-			if ( ! STEPPER_IOPORT_NULL(stepperAxisPorts[i].minimum) ) {
-				STEPPER_IOPORT_SET_DIRECTION(stepperAxisPorts[i].minimum, false);
-				STEPPER_IOPORT_WRITE(stepperAxisPorts[i].minimum, stepperAxis[i].invert_endstop);
-			}
+			STEPPER_AXIS_SWITCH(i, Pins, stepperAxisInitPins<Pins>(stepperAxis[i].endstop_xor));
 
 			//We reset this here because we don't want an abort to lose track of positioning
 			dda_position[i]	= 0;
@@ -157,6 +160,13 @@ void stepperAxisInit(bool hard_reset) {
 
 	for (uint8_t i = 0; i < EXTRUDERS; i ++ )
 		e_steps[i] = 0;
+
+	endstops_triggered = 0;
+
+#ifdef ENDSTOPS_PIN_CHANGE
+	PIN_CHANGE_MASK(ENDSTOPS_PIN_CHANGE) |= ENDSTOPS_PCMSK;
+	PCICR |= _BV(PIN_CHANGE_ENABLE(ENDSTOPS_PIN_CHANGE));
+#endif
 }
 
 /// Returns the steps per mm for the given axis
@@ -38,59 +38,225 @@ enum AxisEnum {
         B_AXIS
 };
 
+/// Pins are given in the board's Configuration.hh as STEPPER_PORT(letter, number),
+/// which STEPPER_PIN_TRAITS below turns into a compile time description of the pin
+#define STEPPER_PORT(PLETTER, PNUMBER)	PLETTER, PNUMBER
+
+/// The port letters as numbers, so that pins can be compared by port at compile time
+#define STEPPER_PORT_ID_A	'A'
+#define STEPPER_PORT_ID_B	'B'
+#define STEPPER_PORT_ID_C	'C'
+#define STEPPER_PORT_ID_D	'D'
+#define STEPPER_PORT_ID_E	'E'
+#define STEPPER_PORT_ID_F	'F'
+#define STEPPER_PORT_ID_G	'G'
+#define STEPPER_PORT_ID_H	'H'
+#define STEPPER_PORT_ID_J	'J'
+#define STEPPER_PORT_ID_K	'K'
+#define STEPPER_PORT_ID_L	'L'
+
+#define STEPPER_PIN_TRAITS(NAME, PIN)	STEPPER_PIN_TRAITS_(NAME, PIN)
+
+/// Least time the step pins are held high, in microseconds; the A3982 and A4982
+/// drivers need 1us.  With the pins constant, the edges are only a few cycles apart
+/// without the delay of STEPPER_STEP_HIGH_DELAY() between them.
+#define STEPPER_STEP_HIGH_MICROS	1
+
 #ifndef SIMULATOR
 
 #define  FORCE_INLINE __attribute__((always_inline)) inline
 
+#include <util/delay.h>
 #include "Motherboard.hh"
 
-/// write a pin
-#define STEPPER_IOPORT_WRITE(IOPORT, v)		do {								\
-							if (v)	_SFR_MEM8(IOPORT.port) |=  _BV(IOPORT.pin);	\
-							else	_SFR_MEM8(IOPORT.port) &= ~_BV(IOPORT.pin);	\
-						} while(0)
+/// Declares NAME as a pin whose port and bit are constants, so that each access
+/// compiles to sbi / cbi / sbis (or a direct lds / sts for the ports above the
+/// I/O space) rather than an indirect access through a table of ports
+#define STEPPER_PIN_TRAITS_(NAME, PLETTER, PNUMBER)							\
+	struct NAME {											\
+		enum { port_id = STEPPER_PORT_ID_ ## PLETTER, bit = _BV(PNUMBER) };			\
+		static FORCE_INLINE void    write(bool v)	{ if (v) PORT ## PLETTER |= bit;	\
+								  else	 PORT ## PLETTER &= ~bit; }	\
+		static FORCE_INLINE void    setBits(uint8_t b)	{ PORT ## PLETTER |=  b; }		\
+		static FORCE_INLINE void    clearBits(uint8_t b){ PORT ## PLETTER &= ~b; }		\
+		static FORCE_INLINE uint8_t read()		{ return PIN ## PLETTER; }		\
+		static FORCE_INLINE void    setOutput(bool v)	{ if (v) DDR ## PLETTER |= bit;		\
+								  else	 DDR ## PLETTER &= ~bit; }	\
+	}
 
-/// read a pin
-#define STEPPER_IOPORT_READ(IOPORT)		((bool)(_SFR_MEM8(IOPORT.iport) & _BV(IOPORT.pin)))
+#define STEPPER_STEP_HIGH_DELAY()	_delay_us(STEPPER_STEP_HIGH_MICROS)
 
-/// set pin as input
-#define	STEPPER_IOPORT_SET_DIRECTION(IOPORT, v)	do {								\
-							if (v)	_SFR_MEM8(IOPORT.ddr) |=  _BV(IOPORT.pin);	\
-							else	_SFR_MEM8(IOPORT.ddr) &= ~_BV(IOPORT.pin);	\
-						} while(0)
+#else
 
-/// set pin as input
-#define	STEPPER_IOPORT_SET_INPUT(IOPORT)	do {							\
-							_SFR_MEM8(IOPORT.ddr) &= ~_BV(IOPORT.pin);	\
-						} while(0)
+#ifndef FORCE_INLINE
+#define FORCE_INLINE inline
+#endif
 
-/// set pin as output
-#define	STEPPER_IOPORT_SET_OUTPUT(IOPORT)	do {							\
-							_SFR_MEM8(IOPORT.ddr) |=  _BV(IOPORT.pin);	\
-						} while(0)
+#ifndef _BV
+#define _BV(bit) (1 << (bit))
+#endif
 
-/// True if port is not defined
-#define STEPPER_IOPORT_NULL(IOPORT)		(IOPORT.port == 0)
+/// There are no ports in the simulator.  A host test which wants to watch
+/// the pins defines STEPPER_SIM_WRITE(port_id, bits, set),
+/// STEPPER_SIM_READ(port_id) and STEPPER_SIM_DELAY_US(micros) before
+/// including this file, and the X_STEPPER_STEP etc. pins of the board it wants.
+#ifndef STEPPER_SIM_WRITE
+#define STEPPER_SIM_WRITE(PORT, BITS, SET)
+#endif
+#ifndef STEPPER_SIM_READ
+#define STEPPER_SIM_READ(PORT) 0
+#endif
+#ifndef STEPPER_SIM_DELAY_US
+#define STEPPER_SIM_DELAY_US(MICROS)
+#endif
 
-#else
+#define STEPPER_STEP_HIGH_DELAY()	STEPPER_SIM_DELAY_US(STEPPER_STEP_HIGH_MICROS)
+
+#define STEPPER_PIN_TRAITS_(NAME, PLETTER, PNUMBER)							\
+	struct NAME {											\
+		enum { port_id = STEPPER_PORT_ID_ ## PLETTER, bit = _BV(PNUMBER) };			\
+		static void    write(bool v)		{ STEPPER_SIM_WRITE(port_id, bit, v); }		\
+		static void    setBits(uint8_t b)	{ STEPPER_SIM_WRITE(port_id, b, true); }	\
+		static void    clearBits(uint8_t b)	{ STEPPER_SIM_WRITE(port_id, b, false); }	\
+		static uint8_t read()			{ return STEPPER_SIM_READ(port_id); }		\
+		static void    setOutput(bool)		{ }						\
+	}
+
+#endif
+
+/// For the axes which have no endstops
+struct StepperNullPin {
+	enum { port_id = 0, bit = 0 };
+	static FORCE_INLINE void    write(bool)		{ }
+	static FORCE_INLINE void    setBits(uint8_t)	{ }
+	static FORCE_INLINE void    clearBits(uint8_t)	{ }
+	static FORCE_INLINE uint8_t read()		{ return 0; }
+	static FORCE_INLINE void    setOutput(bool)	{ }
+};
+
+/// The pins of each axis, from the board's Configuration.hh
+template <uint8_t AXIS> struct StepperAxisPins;
+
+template <> struct StepperAxisPins<X_AXIS> {
+	STEPPER_PIN_TRAITS(Step,	X_STEPPER_STEP);
+	STEPPER_PIN_TRAITS(Dir,		X_STEPPER_DIR);
+	STEPPER_PIN_TRAITS(Enable,	X_STEPPER_ENABLE);
+	STEPPER_PIN_TRAITS(Minimum,	X_STEPPER_MIN);
+	STEPPER_PIN_TRAITS(Maximum,	X_STEPPER_MAX);
+};
+
+template <> struct StepperAxisPins<Y_AXIS> {
+	STEPPER_PIN_TRAITS(Step,	Y_STEPPER_STEP);
+	STEPPER_PIN_TRAITS(Dir,		Y_STEPPER_DIR);
+	STEPPER_PIN_TRAITS(Enable,	Y_STEPPER_ENABLE);
+	STEPPER_PIN_TRAITS(Minimum,	Y_STEPPER_MIN);
+	STEPPER_PIN_TRAITS(Maximum,	Y_STEPPER_MAX);
+};
+
+template <> struct StepperAxisPins<Z_AXIS> {
+	STEPPER_PIN_TRAITS(Step,	Z_STEPPER_STEP);
+	STEPPER_PIN_TRAITS(Dir,		Z_STEPPER_DIR);
+	STEPPER_PIN_TRAITS(Enable,	Z_STEPPER_ENABLE);
+	STEPPER_PIN_TRAITS(Minimum,	Z_STEPPER_MIN);
+	STEPPER_PIN_TRAITS(Maximum,	Z_STEPPER_MAX);
+};
 
-#define STEPPER_IOPORT_WRITE(IOPORT, v)
-#define STEPPER_IOPORT_READ(IOPORT) (uint8_t)0x00
-#define	STEPPER_IOPORT_SET_DIRECTION(IOPORT, v)
-#define	STEPPER_IOPORT_SET_INPUT(IOPORT)
-#define	STEPPER_IOPORT_SET_OUTPUT(IOPORT)
-#define STEPPER_IOPORT_NULL(IOPORT) (true)
+template <> struct StepperAxisPins<A_AXIS> {
+	STEPPER_PIN_TRAITS(Step,	A_STEPPER_STEP);
+	STEPPER_PIN_TRAITS(Dir,		A_STEPPER_DIR);
+	STEPPER_PIN_TRAITS(Enable,	A_STEPPER_ENABLE);
+	typedef StepperNullPin		Minimum;
+	typedef StepperNullPin		Maximum;
+};
+
+template <> struct StepperAxisPins<B_AXIS> {
+	STEPPER_PIN_TRAITS(Step,	B_STEPPER_STEP);
+	STEPPER_PIN_TRAITS(Dir,		B_STEPPER_DIR);
+	STEPPER_PIN_TRAITS(Enable,	B_STEPPER_ENABLE);
+	typedef StepperNullPin		Minimum;
+	typedef StepperNullPin		Maximum;
+};
+
+/// Runs STATEMENT with PINS as the StepperAxisPins of axis.  Where axis is a
+/// constant the switch folds away, leaving the direct pin access.
+#define STEPPER_AXIS_SWITCH(axis, PINS, STATEMENT)						\
+	switch ( axis ) {									\
+		case X_AXIS:	{ typedef StepperAxisPins<X_AXIS> PINS; STATEMENT; }	break;	\
+		case Y_AXIS:	{ typedef StepperAxisPins<Y_AXIS> PINS; STATEMENT; }	break;	\
+		case Z_AXIS:	{ typedef StepperAxisPins<Z_AXIS> PINS; STATEMENT; }	break;	\
+		case A_AXIS:	{ typedef StepperAxisPins<A_AXIS> PINS; STATEMENT; }	break;	\
+		case B_AXIS:	{ typedef StepperAxisPins<B_AXIS> PINS; STATEMENT; }	break;	\
+	}
+
+/// Axes whose step pins share a port are stepped together, with a single write to
+/// the port.  The group of an axis is named by its first axis.
+template <uint8_t AXIS, uint8_t OTHER = X_AXIS>
+struct StepperStepGroup {
+	enum { value = ((int)StepperAxisPins<OTHER>::Step::port_id == (int)StepperAxisPins<AXIS>::Step::port_id) ?
+			OTHER : (int)StepperStepGroup<AXIS, OTHER + 1>::value };
+};
+
+template <uint8_t AXIS>
+struct StepperStepGroup<AXIS, AXIS> {
+	enum { value = AXIS };
+};
+
+/// The axes in the group named by AXIS, none if AXIS does not name a group
+template <uint8_t AXIS>
+struct StepperStepGroupAxes {
+	enum { value = (((int)StepperStepGroup<X_AXIS>::value == AXIS) ? _BV(X_AXIS) : 0) |
+		       (((int)StepperStepGroup<Y_AXIS>::value == AXIS) ? _BV(Y_AXIS) : 0) |
+		       (((int)StepperStepGroup<Z_AXIS>::value == AXIS) ? _BV(Z_AXIS) : 0) |
+		       (((int)StepperStepGroup<A_AXIS>::value == AXIS) ? _BV(A_AXIS) : 0) |
+		       (((int)StepperStepGroup<B_AXIS>::value == AXIS) ? _BV(B_AXIS) : 0) };
+};
 
+/// Endstop bits, two per axis: the minimum at bit 2 * axis, the maximum above it
+#define ENDSTOP_MIN(axis)	_BV(2 * (axis))
+#define ENDSTOP_MAX(axis)	_BV(2 * (axis) + 1)
+
+/// The pin change interrupts of the ports: PCINT0 has port B, PCINT1 has PJ0..PJ6 one bit
+/// up in PCMSK1 (PCINT9..15), PCINT2 has port K.  The other ports have none.
+template <int PORT_ID> struct StepperPortPinChange	{ enum { group = -1, shift = 0 }; };
+template <> struct StepperPortPinChange<'B'>		{ enum { group = 0, shift = 0 }; };
+template <> struct StepperPortPinChange<'J'>		{ enum { group = 1, shift = 1 }; };
+template <> struct StepperPortPinChange<'K'>		{ enum { group = 2, shift = 0 }; };
+
+/// The board's Configuration.hh sets ENDSTOPS_PIN_CHANGE to the pin change interrupt its
+/// endstops are on, if they are on one.  Endstops which are not are polled.
+#ifdef ENDSTOPS_PIN_CHANGE
+#define ENDSTOPS_PIN_CHANGE_GROUP	ENDSTOPS_PIN_CHANGE
+#else
+#define ENDSTOPS_PIN_CHANGE_GROUP	-1
 #endif
 
-struct StepperIOPort {
-	uint16_t port;
-	uint16_t iport;
-	uint8_t pin;
-	uint16_t ddr;
+/// The bit of Pin in the PCMSK of ENDSTOPS_PIN_CHANGE, 0 if it is not in it
+template <class Pin>
+struct StepperEndstopPinChange {
+	enum { value = ( ENDSTOPS_PIN_CHANGE_GROUP >= 0 &&
+			 (int)StepperPortPinChange<Pin::port_id>::group == ENDSTOPS_PIN_CHANGE_GROUP ) ?
+			((Pin::bit << StepperPortPinChange<Pin::port_id>::shift) & 0xFF) : 0 };
+};
+
+/// The endstops of an axis, as endstop bits, and the PCMSK bits of those with a pin change interrupt
+template <uint8_t AXIS>
+struct StepperAxisEndstops {
+	typedef typename StepperAxisPins<AXIS>::Minimum	Minimum;
+	typedef typename StepperAxisPins<AXIS>::Maximum	Maximum;
+
+	enum {	present		= (Minimum::bit != 0 ? ENDSTOP_MIN(AXIS) : 0) | (Maximum::bit != 0 ? ENDSTOP_MAX(AXIS) : 0),
+		pin_change	= (StepperEndstopPinChange<Minimum>::value != 0 ? ENDSTOP_MIN(AXIS) : 0) |
+				  (StepperEndstopPinChange<Maximum>::value != 0 ? ENDSTOP_MAX(AXIS) : 0),
+		polled		= present & ~pin_change,
+		pcmsk		= StepperEndstopPinChange<Minimum>::value | StepperEndstopPinChange<Maximum>::value };
 };
 
-#define STEPPER_NULL	{ 0, 0, 0, 0 }
+#define ENDSTOPS_PRESENT	(StepperAxisEndstops<X_AXIS>::present | StepperAxisEndstops<Y_AXIS>::present | \
+				 StepperAxisEndstops<Z_AXIS>::present)
+#define ENDSTOPS_POLLED		(StepperAxisEndstops<X_AXIS>::polled | StepperAxisEndstops<Y_AXIS>::polled | \
+				 StepperAxisEndstops<Z_AXIS>::polled)
+#define ENDSTOPS_PCMSK		(StepperAxisEndstops<X_AXIS>::pcmsk | StepperAxisEndstops<Y_AXIS>::pcmsk | \
+				 StepperAxisEndstops<Z_AXIS>::pcmsk)
 
 struct dda {
         bool    master;         //True if this is the master steps axis
@@ -107,15 +273,8 @@ struct dda {
         int32_t steps;                  //Number of steps we need to execute for this axis
 };
 
-/// The reason we don't put StepperAxisPorts and StepperAxis in the same structure,
-/// is because we need to initialize the port information, but none of the rest,
-/// so we save space by using this approach
-struct StepperAxisPorts {
-	StepperIOPort step, dir, enable, minimum, maximum;
-};
-
 struct StepperAxis {
-	bool invert_endstop;
+	uint8_t endstop_xor;	//0xFF if the endstops are inverted, 0 if not, XORed with the endstop port
 	bool invert_axis;
 	float steps_per_mm;
 	float max_feedrate;
@@ -126,7 +285,6 @@ struct StepperAxis {
 	struct dda dda;
 };
 
-extern struct StepperAxisPorts	stepperAxisPorts[STEPPER_COUNT];
 extern struct StepperAxis 	stepperAxis[STEPPER_COUNT];
 
 
@@ -135,18 +293,20 @@ extern volatile int16_t e_steps[EXTRUDERS];
 extern volatile bool    axis_homing[STEPPER_COUNT];
 extern volatile uint8_t axesEnabled;			//Planner axis enabled
 extern volatile uint8_t axesHardwareEnabled;		//Hardware axis enabled
+extern volatile uint8_t endstops_triggered;		//Endstops seen triggered since the block started
 
 
 /// Set the direction of the next step
 FORCE_INLINE void stepperAxisSetDirection(uint8_t axis, bool forward) {
-	STEPPER_IOPORT_WRITE(stepperAxisPorts[axis].dir, (stepperAxis[axis].invert_axis) ? (! forward) : forward);
+	bool level = forward ^ stepperAxis[axis].invert_axis;
+	STEPPER_AXIS_SWITCH(axis, Pins, Pins::Dir::write(level));
 }
 	
 /// Step
 
 ///***** SHOULD THIS BE REALLY false, true
 FORCE_INLINE void stepperAxisStep(uint8_t axis, bool value) {
-	STEPPER_IOPORT_WRITE(stepperAxisPorts[axis].step, value);
+	STEPPER_AXIS_SWITCH(axis, Pins, Pins::Step::write(value));
 }
 
 /// The A3982 steper driver chip has an inverted enable
@@ -154,7 +314,7 @@ FORCE_INLINE void stepperAxisSetHardwareEnabled(uint8_t axis, bool enabled ) {
 	if (enabled)	axesHardwareEnabled |=  _BV(axis);
 	else		axesHardwareEnabled &= ~_BV(axis);
 
-	STEPPER_IOPORT_WRITE(stepperAxisPorts[axis].enable, (! enabled));
+	STEPPER_AXIS_SWITCH(axis, Pins, Pins::Enable::write(! enabled));
 }
 
 FORCE_INLINE void stepperAxisSetHardwareEnabledToMatch(uint8_t desiredAxesEnabled) {
@@ -178,21 +338,115 @@ FORCE_INLINE void stepperAxisSetEnabled(uint8_t axis, bool enabled) {
 
 /// Returns true if we're at a maximum endstop
 FORCE_INLINE bool stepperAxisIsAtMaximum(uint8_t axis) {
-	return (STEPPER_IOPORT_NULL(stepperAxisPorts[axis].maximum)) ? false : (STEPPER_IOPORT_READ(stepperAxisPorts[axis].maximum) ^ stepperAxis[axis].invert_endstop);
+	uint8_t level = 0;
+	STEPPER_AXIS_SWITCH(axis, Pins, level = (Pins::Maximum::read() ^ stepperAxis[axis].endstop_xor) & Pins::Maximum::bit);
+	return level != 0;
 }
 
 /// Returns true if we're at a minimum endstop
 FORCE_INLINE bool stepperAxisIsAtMinimum(uint8_t axis) {
-	return (STEPPER_IOPORT_NULL(stepperAxisPorts[axis].minimum)) ? false : (STEPPER_IOPORT_READ(stepperAxisPorts[axis].minimum) ^ stepperAxis[axis].invert_endstop);
+	uint8_t level = 0;
+	STEPPER_AXIS_SWITCH(axis, Pins, level = (Pins::Minimum::read() ^ stepperAxis[axis].endstop_xor) & Pins::Minimum::bit);
+	return level != 0;
+}
+
+/// Returns the endstop bits of AXIS, of those in endstops, which are triggered
+template <uint8_t AXIS>
+FORCE_INLINE uint8_t stepperAxisReadEndstops(uint8_t endstops) {
+	typedef StepperAxisPins<AXIS> Pins;
+	uint8_t triggered = 0;
+
+	if (( endstops & ENDSTOP_MIN(AXIS) ) &&
+	    (( Pins::Minimum::read() ^ stepperAxis[AXIS].endstop_xor ) & Pins::Minimum::bit ))
+		triggered |= ENDSTOP_MIN(AXIS);
+	if (( endstops & ENDSTOP_MAX(AXIS) ) &&
+	    (( Pins::Maximum::read() ^ stepperAxis[AXIS].endstop_xor ) & Pins::Maximum::bit ))
+		triggered |= ENDSTOP_MAX(AXIS);
+	return triggered;
+}
+
+/// Returns the endstop bits, of those in endstops, which are triggered.  With endstops a
+/// constant, only those pins are read.
+FORCE_INLINE uint8_t stepperAxisReadEndstops(uint8_t endstops) {
+	return	stepperAxisReadEndstops<X_AXIS>(endstops) |
+		stepperAxisReadEndstops<Y_AXIS>(endstops) |
+		stepperAxisReadEndstops<Z_AXIS>(endstops);
+}
+
+/// Latches the endstops without a pin change interrupt, from a timer interrupt
+FORCE_INLINE void stepperAxisPollEndstops() {
+	if ( ENDSTOPS_POLLED )	endstops_triggered |= stepperAxisReadEndstops(ENDSTOPS_POLLED);
 }
 
-/// Makes a step, but checks if an endstop is triggered first, if it is, the
-/// step is abandoned and "true" is returned.
-FORCE_INLINE void stepperAxisStepWithEndstopCheck(uint8_t axis, bool direction) {
-	if (( (direction)   && (! stepperAxisIsAtMaximum(axis))) ||
-	    ( (! direction) && (! stepperAxisIsAtMinimum(axis))))
-		stepperAxisStep(axis, true);
-	else	axis_homing[axis] = false;
+/// Latches the endstops with a pin change interrupt, from that interrupt
+FORCE_INLINE void stepperAxisLatchEndstops() {
+	endstops_triggered |= stepperAxisReadEndstops(ENDSTOPS_PRESENT & ~ENDSTOPS_POLLED);
+}
+
+/// Adds the step of an axis to the step bits of its group, but checks if an endstop
+/// is triggered first, if it is, the step is abandoned and homing ends for the axis.
+template <uint8_t AXIS>
+FORCE_INLINE void stepperAxisStepWithEndstopCheck(bool direction, uint8_t *step_bits) {
+	if (( (direction)   && (! stepperAxisIsAtMaximum(AXIS))) ||
+	    ( (! direction) && (! stepperAxisIsAtMinimum(AXIS))))
+		step_bits[StepperStepGroup<AXIS>::value] |= StepperAxisPins<AXIS>::Step::bit;
+	else	axis_homing[AXIS] = false;
+}
+
+/// Drops the step of AXIS if it is running into an endstop in triggered, and ends homing
+/// for the axis, as stepperAxisStepWithEndstopCheck() would have
+template <uint8_t AXES, uint8_t AXIS>
+FORCE_INLINE void stepperAxisDropEndstopStep(uint8_t triggered, uint8_t *step_bits) {
+	if (( AXES & _BV(AXIS) ) && ( StepperAxisEndstops<AXIS>::present ) && stepperAxis[AXIS].dda.enabled &&
+	    ( triggered & (stepperAxis[AXIS].dda.stepperDir ? ENDSTOP_MAX(AXIS) : ENDSTOP_MIN(AXIS)) )) {
+		step_bits[StepperStepGroup<AXIS>::value] &= ~StepperAxisPins<AXIS>::Step::bit;
+		axis_homing[AXIS] = false;
+	}
+}
+
+/// Outside homing the endstops are not read per step, but latched into endstops_triggered
+/// by the pin change interrupt and the poll.  Only once one is latched are the steps of
+/// the axes running into it dropped.
+template <uint8_t AXES>
+FORCE_INLINE void stepperAxisDropEndstopSteps(uint8_t *step_bits) {
+	uint8_t triggered = endstops_triggered;
+
+	if ( ! triggered )	return;
+	stepperAxisDropEndstopStep<AXES, X_AXIS>(triggered, step_bits);
+	stepperAxisDropEndstopStep<AXES, Y_AXIS>(triggered, step_bits);
+	stepperAxisDropEndstopStep<AXES, Z_AXIS>(triggered, step_bits);
+}
+
+/// Raises the step pins of the group named by GROUP, if any of AXES are in it
+template <uint8_t AXES, uint8_t GROUP>
+FORCE_INLINE void stepperAxisRaiseStepGroup(const uint8_t *step_bits) {
+	if (( AXES & StepperStepGroupAxes<GROUP>::value ) && step_bits[GROUP] )
+		StepperAxisPins<GROUP>::Step::setBits(step_bits[GROUP]);
+}
+
+template <uint8_t AXES, uint8_t GROUP>
+FORCE_INLINE void stepperAxisLowerStepGroup(const uint8_t *step_bits) {
+	if (( AXES & StepperStepGroupAxes<GROUP>::value ) && step_bits[GROUP] )
+		StepperAxisPins<GROUP>::Step::clearBits(step_bits[GROUP]);
+}
+
+/// Raises the step pins in step_bits, holds them high for STEPPER_STEP_HIGH_MICROS,
+/// then lowers them again, with one write to each port per edge
+template <uint8_t AXES>
+FORCE_INLINE void stepperAxisStepGroups(const uint8_t *step_bits) {
+	stepperAxisRaiseStepGroup<AXES, X_AXIS>(step_bits);
+	stepperAxisRaiseStepGroup<AXES, Y_AXIS>(step_bits);
+	stepperAxisRaiseStepGroup<AXES, Z_AXIS>(step_bits);
+	stepperAxisRaiseStepGroup<AXES, A_AXIS>(step_bits);
+	stepperAxisRaiseStepGroup<AXES, B_AXIS>(step_bits);
+
+	STEPPER_STEP_HIGH_DELAY();
+
+	stepperAxisLowerStepGroup<AXES, X_AXIS>(step_bits);
+	stepperAxisLowerStepGroup<AXES, Y_AXIS>(step_bits);
+	stepperAxisLowerStepGroup<AXES, Z_AXIS>(step_bits);
+	stepperAxisLowerStepGroup<AXES, A_AXIS>(step_bits);
+	stepperAxisLowerStepGroup<AXES, B_AXIS>(step_bits);
 }
 
 /// DDA
@@ -224,6 +478,13 @@ FORCE_INLINE void stepperAxis_dda_reset(uint8_t ind, bool master, int32_t master
         DDA_IND.stepperDir    = (direction) ? false : true;
 
         DDA_IND.steps_completed = 0;
+
+	//The direction is set once here for the whole block, rather than before every
+	//step.  With JKN_ADVANCE the extruder interrupt sets the extruder directions.
+#ifdef JKN_ADVANCE
+	if ( ! DDA_IND.eAxis )
+#endif
+		stepperAxisSetDirection(ind, DDA_IND.stepperDir);
 }
 
 FORCE_INLINE void stepperAxis_dda_shift_phase16(uint8_t ind, int16_t phase)
@@ -244,9 +505,12 @@ FORCE_INLINE void stepperAxis_dda_shift_phase32(uint8_t ind, int32_t phase)
 #endif
 }
 
-FORCE_INLINE void stepperAxis_dda_step(uint8_t ind)
+/// Steps the dda of an axis which is known to be enabled.  ENDSTOP_CHECK reads the endstop
+/// before each step, for homing.
+template <uint8_t AXIS, bool ENDSTOP_CHECK>
+FORCE_INLINE void stepperAxis_dda_step_enabled(uint8_t *step_bits)
 {
-	if ( ! DDA_IND.enabled )	return;
+	const uint8_t ind = AXIS;
 
 	DDA_IND.counter += DDA_IND.steps;
 	if (( DDA_IND.counter > 0 ) && ( DDA_IND.steps_completed < DDA_IND.steps ))
@@ -270,9 +534,9 @@ FORCE_INLINE void stepperAxis_dda_step(uint8_t ind)
 		else
 		{
 #endif
-			stepperAxisSetDirection(ind, DDA_IND.stepperDir );
-			stepperAxisStepWithEndstopCheck(ind, DDA_IND.stepperDir);
-			stepperAxisStep(ind, false);
+			if ( ENDSTOP_CHECK )
+				stepperAxisStepWithEndstopCheck<AXIS>(DDA_IND.stepperDir, step_bits);
+			else	step_bits[StepperStepGroup<AXIS>::value] |= StepperAxisPins<AXIS>::Step::bit;
 #ifdef JKN_ADVANCE
 		}
 #endif
@@ -282,6 +546,108 @@ FORCE_INLINE void stepperAxis_dda_step(uint8_t ind)
 	}
 }
 
+template <uint8_t AXIS, bool ENDSTOP_CHECK>
+FORCE_INLINE void stepperAxis_dda_step(uint8_t *step_bits)
+{
+	if ( stepperAxis[AXIS].dda.enabled )	stepperAxis_dda_step_enabled<AXIS, ENDSTOP_CHECK>(step_bits);
+}
+
+#define STEP_KERNEL_ALL		(_BV(X_AXIS) | _BV(Y_AXIS) | _BV(Z_AXIS) | _BV(A_AXIS) | _BV(B_AXIS))
+
+/// One step event: runs the dda of every axis, collecting the steps due into a
+/// mask for each port, then pulses the step pins of each port together.
+/// ENDSTOP_CHECK reads the endstops before every step, for homing; otherwise the steps
+/// into a latched endstop are dropped.
+template <bool ENDSTOP_CHECK>
+FORCE_INLINE void stepperAxis_dda_step_event()
+{
+	uint8_t step_bits[STEPPER_COUNT] = { 0 };
+
+	stepperAxis_dda_step<X_AXIS, ENDSTOP_CHECK>(step_bits);
+	stepperAxis_dda_step<Y_AXIS, ENDSTOP_CHECK>(step_bits);
+	stepperAxis_dda_step<Z_AXIS, ENDSTOP_CHECK>(step_bits);
+	stepperAxis_dda_step<A_AXIS, ENDSTOP_CHECK>(step_bits);
+	stepperAxis_dda_step<B_AXIS, ENDSTOP_CHECK>(step_bits);
+
+	if ( ! ENDSTOP_CHECK )	stepperAxisDropEndstopSteps<STEP_KERNEL_ALL>(step_bits);
+	stepperAxisStepGroups<STEP_KERNEL_ALL>(step_bits);
+}
+
+/// A step event for a block which moves exactly the axes in AXES.  The idle axes
+/// are left out at compile time, and the moving ones are not checked for being
+/// enabled.
+template <uint8_t AXES>
+void stepperAxis_dda_step_kernel()
+{
+	uint8_t step_bits[STEPPER_COUNT] = { 0 };
+
+	if ( AXES & _BV(X_AXIS) )	stepperAxis_dda_step_enabled<X_AXIS, false>(step_bits);
+	if ( AXES & _BV(Y_AXIS) )	stepperAxis_dda_step_enabled<Y_AXIS, false>(step_bits);
+	if ( AXES & _BV(Z_AXIS) )	stepperAxis_dda_step_enabled<Z_AXIS, false>(step_bits);
+	if ( AXES & _BV(A_AXIS) )	stepperAxis_dda_step_enabled<A_AXIS, false>(step_bits);
+	if ( AXES & _BV(B_AXIS) )	stepperAxis_dda_step_enabled<B_AXIS, false>(step_bits);
+
+	stepperAxisDropEndstopSteps<AXES>(step_bits);
+	stepperAxisStepGroups<AXES>(step_bits);
+}
+
+/// The fallback for the less common sets of axes
+inline void stepperAxis_dda_step_kernel_any()
+{
+	stepperAxis_dda_step_event<false>();
+}
+
+/// The step event of homing blocks, which checks the endstops before every step, so
+/// that an axis stops on the step its endstop triggers
+inline void stepperAxis_dda_step_kernel_homing()
+{
+	stepperAxis_dda_step_event<true>();
+}
+
+/// The step event of the fast approach of homing, which leaves the endstops alone: the
+/// block decelerates to a stop once one triggers (see st_homing_approach()), so the
+/// steps past it are not dropped
+inline void stepperAxis_dda_step_kernel_approach()
+{
+	uint8_t step_bits[STEPPER_COUNT] = { 0 };
+
+	stepperAxis_dda_step<X_AXIS, false>(step_bits);
+	stepperAxis_dda_step<Y_AXIS, false>(step_bits);
+	stepperAxis_dda_step<Z_AXIS, false>(step_bits);
+	stepperAxis_dda_step<A_AXIS, false>(step_bits);
+	stepperAxis_dda_step<B_AXIS, false>(step_bits);
+
+	stepperAxisStepGroups<STEP_KERNEL_ALL>(step_bits);
+}
+
+typedef void (*StepperAxisStepKernel)();
+
+#define STEP_KERNEL_XY		(_BV(X_AXIS) | _BV(Y_AXIS))
+#define STEP_KERNEL_XYA		(_BV(X_AXIS) | _BV(Y_AXIS) | _BV(A_AXIS))
+#define STEP_KERNEL_XYB		(_BV(X_AXIS) | _BV(Y_AXIS) | _BV(B_AXIS))
+#define STEP_KERNEL_Z		(_BV(Z_AXIS))
+#define STEP_KERNEL_A		(_BV(A_AXIS))
+#define STEP_KERNEL_B		(_BV(B_AXIS))
+
+/// Returns the step event for a block whose enabled dda's are those in axes:
+/// travel (XY), printing with either extruder (XYA, XYB), layer changes (Z)
+/// and retractions (A, B) have their own, everything else uses the fallback.
+/// Homing blocks use the homing step event whatever their axes, and the fast approach
+/// of homing its own.
+inline StepperAxisStepKernel stepperAxisSelectStepKernel(uint8_t axes, bool homing, bool approach = false) {
+	if ( homing )	return stepperAxis_dda_step_kernel_homing;
+	if ( approach )	return stepperAxis_dda_step_kernel_approach;
+	switch ( axes ) {
+		case STEP_KERNEL_XY:	return stepperAxis_dda_step_kernel<STEP_KERNEL_XY>;
+		case STEP_KERNEL_XYA:	return stepperAxis_dda_step_kernel<STEP_KERNEL_XYA>;
+		case STEP_KERNEL_XYB:	return stepperAxis_dda_step_kernel<STEP_KERNEL_XYB>;
+		case STEP_KERNEL_Z:	return stepperAxis_dda_step_kernel<STEP_KERNEL_Z>;
+		case STEP_KERNEL_A:	return stepperAxis_dda_step_kernel<STEP_KERNEL_A>;
+		case STEP_KERNEL_B:	return stepperAxis_dda_step_kernel<STEP_KERNEL_B>;
+		default:		return stepperAxis_dda_step_kernel_any;
+	}
+}
+
 /// Clips an axis to the minimum step limit.  It returns target if it doesn't require clipping,
 /// and min_axis_steps_limit if it does
 FORCE_INLINE int32_t stepperAxis_clip_to_min(uint8_t axis, int32_t target)
@@ -27,6 +27,8 @@
 #include "Eeprom.hh"
 #include "EepromMap.hh"
 #include "stdio.h"
+#include "MotorCurrent.hh"
+#include "Homing.hh"
 
 #else
 
@@ -35,6 +37,7 @@
 #include <stdint.h>
 #include "Eeprom.hh"
 #include "EepromMap.hh"
+#include "Homing.hh"
 
 #ifdef ATOMIC_BLOCK
 #undef ATOMIC_BLOCK
@@ -50,6 +53,9 @@
 #define st_interrupt() false
 #define st_extruder_interrupt()
 #define quickStop()
+#define st_empty() true
+#define st_homing_approach(x)
+#define st_homing_triggered() 0
 #define DEBUG_TIMER_TCTIMER_USI 0
 #define DEBUG_TIMER_START
 #define DEBUG_TIMER_FINISH
@@ -93,6 +99,10 @@ DigiPots digi_pots[STEPPER_COUNT] = {
 
 #endif
 
+#ifndef SIMULATOR
+static MotorCurrentPolicy current_policy;
+#endif
+
 void initPots(){
 	// set digi pots to stored default values
 	for ( int i = 0; i < STEPPER_COUNT; i++ ) {
@@ -114,6 +124,12 @@ bool holdZ = false;
 bool z_homing = false;
 uint8_t z_homed = 0;
 
+static HomingSequence homing_sequence;
+static bool homing_maximums;			// Homing to the maximum endstops
+static uint32_t homing_us_per_step;		// Speed homing was asked for
+static bool homing_phase_started;		// The move of the homing phase has been planned
+static volatile bool homing_probing;		// The axes are stepping onto their endstops, one step at a time
+
 Point tolerance_offset_T0;
 Point tolerance_offset_T1;
 Point *tool_offsets;
@@ -323,6 +339,9 @@ void abort() {
 
   is_running = false;
   is_homing = false;
+	homing_sequence.stop();
+	homing_probing = false;
+	st_homing_approach(0);
 	
 	stepperAxisInit(false);
 
@@ -588,29 +607,157 @@ void setTargetNewExt(const Point& target, int32_t dda_rate, uint8_t relative, fl
 #define POSITIVE_HOME_POSITION ((INT32_MAX - 1) >> 1)
 #define NEGATIVE_HOME_POSITION ((INT32_MIN + 1) >> 1)
 
+/// The endstops the axes in axes home to
+static uint8_t homingEndstops(uint8_t axes) {
+	uint8_t endstops = 0;
+
+	for (uint8_t i = 0; i <= Z_AXIS; i++) {
+		if ( axes & _BV(i) )
+			endstops |= homing_maximums ? ENDSTOP_MAX(i) : ENDSTOP_MIN(i);
+	}
+	return endstops;
+}
+
+/// Speed homing was asked for, in mm/s, along the first of axes, the master axis of
+/// its moves
+static float homingSpeed(uint8_t axes) {
+	uint8_t i = 0;
+
+	while (( i < STEPPER_COUNT - 1 ) && ! ( axes & _BV(i) ))	i++;
+	return 1000000.0 / ((float)homing_us_per_step * stepperAxisStepsPerMM(i));
+}
+
+/// The acceleration of the slowest of axes, in mm/s^2
+static float homingAcceleration(uint8_t axes) {
+	uint32_t acceleration = p_acceleration;
+
+	for (uint8_t i = 0; i < STEPPER_COUNT; i++) {
+		if (( axes & _BV(i) ) && ( max_acceleration_units_per_sq_second[i] < acceleration ))
+			acceleration = max_acceleration_units_per_sq_second[i];
+	}
+	return (float)acceleration;
+}
+
+/// Plans the move of a homing phase
+static void startHomingPhase(uint8_t phase) {
+	uint8_t axes = homing_sequence.moving();
+	int32_t direction = homing_maximums ? 1 : -1;
+	Point target;
+
+	homing_phase_started = true;
+
+	if (( phase == HOMING_SEEK ) || ( phase == HOMING_PROBE )) {
+		//Run towards the endstops until they trigger, each axis stopping on the step
+		//its endstop does
+		target = getStepperPosition();
+		for (uint8_t i = 0; i < STEPPER_COUNT; i++) {
+			axis_homing[i] = ( axes & _BV(i) ) != 0;
+			if ( axis_homing[i] )
+				target[i] = (homing_maximums) ? POSITIVE_HOME_POSITION : NEGATIVE_HOME_POSITION;
+		}
+		homing_probing = true;
+		st_homing_approach(0);
+		setTarget(target, ( phase == HOMING_PROBE ) ? homing_us_per_step * HOMING_PROBE_DIVISOR :
+							     homing_us_per_step);
+		return;
+	}
+
+	float distance = 0.0;
+	int32_t max_steps = 0;
+
+	for (uint8_t i = 0; i < STEPPER_COUNT; i++) {
+		int32_t steps = 0;
+
+		if ( axes & _BV(i) ) {
+			if ( phase == HOMING_APPROACH )
+				steps = homingApproachSteps(stepperAxis[i].max_axis_steps_limit - stepperAxis[i].min_axis_steps_limit);
+			else	steps = (int32_t)(HOMING_BACKOFF_MM * stepperAxisStepsPerMM(i));
+			float mm = (float)steps / stepperAxisStepsPerMM(i);
+			distance += mm * mm;
+		}
+		if ( steps > max_steps )	max_steps = steps;
+		target[i] = ( phase == HOMING_APPROACH ) ? direction * steps : - direction * steps;
+	}
+
+	if ( phase == HOMING_BACKOFF ) {
+		//Clear of the endstops, at the speed asked for
+		st_homing_approach(0);
+		setTargetNew(target, max_steps * (int32_t)homing_us_per_step, 0x1F);
+		return;
+	}
+
+	//Accelerate towards the endstops; the block decelerates once one triggers
+	distance = sqrt(distance);
+	float speed = homingApproachSpeed(homingSpeed(axes), homingAcceleration(axes));
+	st_homing_approach(homingEndstops(axes));
+	setSegmentAccelState(true);
+	setTargetNewExt(target, (int32_t)(speed * (float)max_steps / distance), 0x1F, distance,
+			(int16_t)(speed * 64.0));
+}
+
 /// Start homing
+/// The homing runs through the phases of HomingSequence from runSteppersSlice(),
+/// each once the move of the one before has finished
 
 void startHoming(const bool maximums, const uint8_t axes_enabled, const uint32_t us_per_step) {
 	setSegmentAccelState(false);
 
-	Point target = getStepperPosition();
+	uint8_t axes = 0;
 
     for (uint8_t i = 0; i < STEPPER_COUNT; i++) {
-      if ((axes_enabled & (1<<i)) == 0) {
-			  axis_homing[i] = false;
-		  } else {
-        target[i] = (maximums) ? POSITIVE_HOME_POSITION : NEGATIVE_HOME_POSITION;
-        axis_homing[i] = true;
+      axis_homing[i] = false;
+      if ((axes_enabled & (1<<i)) != 0) {
+        axes |= _BV(i);
         if(i == Z_AXIS) {z_homing = true;}
         stepperAxis[i].hasHomed = true;
       }
     }
 
-	setTarget(target, us_per_step);
+	homing_maximums = maximums;
+	homing_us_per_step = us_per_step;
+
+	//The approach is worth it only if it is faster than the speed asked for
+	bool accelerated = acceleration && ( homingApproachSpeed(homingSpeed(axes), homingAcceleration(axes)) >
+					       homingSpeed(axes) );
+	homing_sequence.start(axes, accelerated);
+	homing_phase_started = false;
+	homing_probing = false;
 
   is_homing = true;
 }
 
+/// Moves homing on to its next phase once the move of the one before has finished
+static void runHomingSlice() {
+	if (( ! is_homing ) || ( ! st_empty() ))	return;
+
+	uint8_t phase = homing_sequence.getPhase();
+
+	if ( homing_phase_started ) {
+		//The approach stops short of where the planner thinks it went, so sync
+		//the planner to where the steppers are
+		quickStop();
+
+		uint8_t triggered = 0, endstops = st_homing_triggered();
+		for (uint8_t i = 0; i <= Z_AXIS; i++) {
+			if ( endstops & (ENDSTOP_MIN(i) | ENDSTOP_MAX(i)) )	triggered |= _BV(i);
+		}
+		phase = homing_sequence.next(triggered);
+	}
+
+	if ( phase != HOMING_IDLE ) {
+		startHomingPhase(phase);
+		return;
+	}
+
+	st_homing_approach(0);
+	is_homing = false;
+	if(z_homing) {
+		z_homed++;
+		z_homing = false;
+	}
+	setSegmentAccelState(acceleration);
+}
+
 
 /// Enable/disable the given axis.
 void enableAxis(uint8_t index, bool enable) {
@@ -712,6 +859,19 @@ void runSteppersSlice() {
 #if defined(DEBUG_ONSCREEN) && defined(TIME_STEPPER_INTERRUPT)
         debug_onscreen2 = debugTimer;
 #endif
+
+	runHomingSlice();
+
+#ifndef SIMULATOR
+	// the motor current follows the motion; the pots are only written when
+	// it changes
+	uint8_t percent = current_policy.update(st_motion_phase(),
+			Motherboard::getBoard().getCurrentMicros());
+	for ( uint8_t i = 0; i < STEPPER_COUNT; i++ ) {
+		if ( MOTOR_CURRENT_AXES & (1 << i) )
+			digi_pots[i].setScale(percent);
+	}
+#endif
 }
 
 
@@ -725,31 +885,26 @@ void doStepperInterrupt() {
 	//and now be false, so we set it here
 	if ( st_interrupt() ) is_running = false;
 
-	//If we're homing, there's a few possibilities:
+	//While homing seeks or probes, there's a few possibilities:
 	//1. The homing is still running on one of the axis
 	//2. The homing on all axis has stopped running, in which case, the block
 	//is dead, so we delete it and sync up the planner position to the stepper position
 	//Homing blocks aren't automatically deleted by st_interrupt because they are set to
-	//positions of INT32_MAX/MIN.
-	if ( is_homing ) {
-		is_homing = false;
+	//positions of INT32_MAX/MIN.  runSteppersSlice() then moves homing on to its next phase.
+	if ( homing_probing ) {
+		bool probing = false;
 	
 		//Are we still homing on one of the axis?
 		for (uint8_t i = 0; i <= Z_AXIS; i++)
-			is_homing |= axis_homing[i];
+			probing |= axis_homing[i];
 
 		//If we've finished homing, stop the stepper subsystem
 		//and sync
-		if ( ! is_homing ) {
+		if ( ! probing ) {
 			//Delete all blocks (should only be 1 homing block) and sync
 			//planner position to stepper position
 			quickStop();
-      if(z_homing) {
-        z_homed++;
-        z_homing = false;
-      }
-
-			setSegmentAccelState(acceleration);
+			homing_probing = false;
 		}
 	}
 
@@ -764,6 +919,10 @@ void doExtruderInterrupt() {
 	st_extruder_interrupt();
 }
 
+void pollEndstops() {
+	stepperAxisPollEndstops();
+}
+
 uint8_t isZHomed(){
   return z_homed;
 }
@@ -111,7 +111,10 @@ namespace steppers {
     /// \param[in] feedrate of the move in mm's per second multiplied by 64
     void setTargetNewExt(const Point& target, int32_t dda_rate, uint8_t relative, float distance, int16_t feedrateMult64);
 
-    /// Home one or more axes
+    /// Home one or more axes.  With acceleration the axes approach their
+    /// endstops fast, back off and probe them slowly (see Homing.hh);
+    /// runSteppersSlice() runs the phases.  isRunning() is true until the
+    /// last is done.
     /// \param[in] maximums If true, home in the positive direction
     /// \param[in] axes_enabled Bitfield specifiying which axes to
     ///                         home
@@ -129,7 +132,8 @@ namespace steppers {
     /// Returns a bit mask for all axes enabled
     uint8_t allAxesEnabled(void);
     
-    /// Set digial potentiometer value for the axis
+    /// Set digial potentiometer value for the axis.  The axes of MOTOR_CURRENT_AXES
+    /// are written a percentage of it, as the motor current policy asks.
     /// \param[in] index Index of the axis 
     /// \param[in] value desired value for potentiometer (0-127 valid)
     void setAxisPotValue(uint8_t index, uint8_t value);
@@ -160,7 +164,8 @@ namespace steppers {
     /// Skeinforge
     void deprimeEnable(bool enable);
 
-    /// Run the stepper slice
+    /// Run the stepper slice, which moves homing on through its phases and
+    /// sets the motor current from the motion
     void runSteppersSlice();
 
     /// Handle the interrupt for the steppers (X/Y/Z/A/B axis)
@@ -169,6 +174,9 @@ namespace steppers {
     /// Handle the interrupt to extrude material
     void doExtruderInterrupt();
 
+    /// Latch the endstops which have no pin change interrupt
+    void pollEndstops();
+
     /// check is z axis has homed
     uint8_t isZHomed();
 
@@ -14,109 +14,196 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
- 
- #include <util/twi.h>
- 
- //TODO write proper error codes
-uint8_t TWI_write_data(uint8_t address, uint8_t * data, uint8_t length){
- 			
-  TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN); /* send start condition */
-  while ((TWCR & _BV(TWINT)) == 0) ; /* wait for transmission */
-  if((TWSR & 0xF8) != TW_START)
-	return 1;
 
+#include "TWI.hh"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <util/twi.h>
 
-  /* send address */
-  TWDR = address | TW_WRITE;
-  TWCR = _BV(TWINT) | _BV(TWEN); /* clear interrupt to start transmission */
-  while ((TWCR & _BV(TWINT)) == 0) ; /* wait for transmission */
-  if ((TWSR & 0xF8) != TW_MT_SLA_ACK)
-		return 2;
+/// A write waiting in the queue
+struct TWI_write {
+	uint8_t address;
+	uint8_t length;
+	uint8_t data[TWI_WRITE_MAX];
+	TWI_callback callback;
+};
 
+static TWI_write queue[TWI_QUEUE_SIZE];
+static volatile uint8_t queue_head;
+static volatile uint8_t queue_length;
+/// Next byte of the write at the head of the queue to send
+static uint8_t data_index;
+static TWI_counters counters;
 
-  for (int i = 0; i < length; i++)
-    {
-      TWDR = data[i];
-      TWCR = _BV(TWINT) | _BV(TWEN); /* start transmission */
-      while ((TWCR & _BV(TWINT)) == 0) ; /* wait for transmission */
-      if ((TWSR & 0xF8) != TW_MT_DATA_ACK)
-			return 3;
-    }
+#define TWI_NEXT	(_BV(TWINT) | _BV(TWEN) | _BV(TWIE))
 
-  TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN); /* send stop condition */
-  
-  return 0;
-  
- }
-  //TODO write proper error codes
-uint8_t TWI_write_byte(uint8_t address, uint8_t data){
- 
-  TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN); /* send start condition */
-  while ((TWCR & _BV(TWINT)) == 0) ; /* wait for transmission */
-  if((TWSR & 0xF8) != TW_START)
-	return 1;
+/// Ends the write at the head of the queue, and starts the next, if any.
+static void TWI_finish(uint8_t error) {
+	TWI_callback callback = queue[queue_head].callback;
 
-  /* send address */
-  TWDR = address | TW_WRITE;
-  TWCR = _BV(TWINT) | _BV(TWEN); /* clear interrupt to start transmission */
-  while ((TWCR & _BV(TWINT)) == 0) ; /* wait for transmission */
-  if ((TWSR & 0xF8) != TW_MT_SLA_ACK)
-		return 2;
+	switch (error) {
+	case TWI_OK:		counters.written++; break;
+	case TWI_ERROR_START:	counters.start_errors++; break;
+	case TWI_ERROR_ADDRESS:	counters.address_errors++; break;
+	default:		counters.data_errors++; break;
+	}
+	queue_head = (queue_head + 1) & (TWI_QUEUE_SIZE - 1);
+	queue_length--;
 
-  TWDR = data;
-  TWCR = _BV(TWINT) | _BV(TWEN); /* start transmission */
-  while ((TWCR & _BV(TWINT)) == 0) ; /* wait for transmission */
-  if ((TWSR & 0xF8) != TW_MT_DATA_ACK)
-		return 3;
+	if (queue_length != 0) {
+		/* send stop condition, then start condition */
+		TWCR = TWI_NEXT | _BV(TWSTO) | _BV(TWSTA);
+	} else {
+		TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO); /* send stop condition */
+	}
+	if (callback != 0) {
+		callback(error);
+	}
+}
 
-  TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN); /* send stop condition */
-  
-  return 0;
-  
- }
- 
- void TWI_init(){
+/// Takes the bus the next step through the write at the head of the queue, once
+/// TWINT is set.
+static void TWI_service() {
+	TWI_write& write = queue[queue_head];
+
+	switch (TW_STATUS) {
+	case TW_START:
+	case TW_REP_START:
+		/* send address */
+		TWDR = write.address | TW_WRITE;
+		data_index = 0;
+		TWCR = TWI_NEXT;
+		break;
+	case TW_MT_SLA_ACK:
+	case TW_MT_DATA_ACK:
+		if (data_index < write.length) {
+			TWDR = write.data[data_index++];
+			TWCR = TWI_NEXT;
+		} else {
+			TWI_finish(TWI_OK);
+		}
+		break;
+	case TW_MT_SLA_NACK:
+		TWI_finish(TWI_ERROR_ADDRESS);
+		break;
+	case TW_MT_DATA_NACK:
+		TWI_finish(TWI_ERROR_DATA);
+		break;
+	default:
+		TWI_finish(TWI_ERROR_START);
+		break;
+	}
+}
+
+ISR(TWI_vect) {
+	TWI_service();
+}
+
+/// Wait for the bus to move on, serving it here in case interrupts are off.
+static void TWI_wait() {
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (TWCR & _BV(TWINT)) {
+			TWI_service();
+		}
+	}
+}
+
+void TWI_queue_write(uint8_t address, const uint8_t * data, uint8_t length,
+		TWI_callback callback) {
+	if (length > TWI_WRITE_MAX) {
+		length = TWI_WRITE_MAX;
+	}
+	if (queue_length == TWI_QUEUE_SIZE) {
+		counters.waits++;
+		while (queue_length == TWI_QUEUE_SIZE) {
+			TWI_wait();
+		}
+	}
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		TWI_write& write = queue[(queue_head + queue_length) & (TWI_QUEUE_SIZE - 1)];
+		write.address = address;
+		write.length = length;
+		for (uint8_t i = 0; i < length; i++) {
+			write.data[i] = data[i];
+		}
+		write.callback = callback;
+
+		if (queue_length++ == 0) {
+			// the stop ending the last write may still be going out
+			while (TWCR & _BV(TWSTO)) ;
+			TWCR = TWI_NEXT | _BV(TWSTA); /* send start condition */
+		}
+	}
+}
+
+void TWI_flush() {
+	while (queue_length != 0) {
+		TWI_wait();
+	}
+	while (TWCR & _BV(TWSTO)) ;
+}
+
+TWI_counters TWI_get_counters() {
+	TWI_counters copy;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		copy = counters;
+	}
+	return copy;
+}
+
+void TWI_init(){
 
   /* initialize TWI clock: 100 kHz clock, TWPS = 0 => prescaler = 1 */
   TWSR = 0;
 
   uint32_t fCPU = 8000000;
   TWBR = (fCPU / 100000UL - 16) / 2;
- }
- 
- //TODO write proper error codes
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+	queue_head = 0;
+	queue_length = 0;
+	TWI_counters none = TWI_counters();
+	counters = none;
+  }
+}
+
  // read function is Totally untested
  uint8_t TWI_read_byte(uint8_t address, uint8_t * data, uint8_t length){
- 
+
+  // the queued writes have the bus until they are sent
+  TWI_flush();
+
   TWCR = _BV(TWINT) | _BV(TWSTA) | _BV(TWEN); /* send start condition */
   while ((TWCR & _BV(TWINT)) == 0) ; /* wait for transmission */
   if((TWSR & 0xF8) != TW_START)
-	return 1;
-	
+	return TWI_ERROR_START;
+
   /* send address */
    TWDR = address | TW_READ;
   TWCR = _BV(TWINT) | _BV(TWEN); /* clear interrupt to start transmission */
   while ((TWCR & _BV(TWINT)) == 0) ; /* wait for transmission */
    if((TWSR & 0xF8) != TW_MR_SLA_ACK)
-	return 2;
-    
+	return TWI_ERROR_ADDRESS;
+
     uint8_t twcr = _BV(TWINT) | _BV(TWEN) | _BV(TWEA);
     /* send data bytes */
     for (int i=0; i < length; i++){
 	 // if last byte send NAK
       if (i == length - 1)
 			twcr = _BV(TWINT) | _BV(TWEN); /* send NAK this time */
-      
+
       TWCR = twcr;		/* clear int to start transmission */
       while ((TWCR & _BV(TWINT)) == 0) ; /* wait for transmission */
       if((TWSR & 0xF8) != TW_MR_DATA_ACK)
-		return 3;
+		return TWI_ERROR_DATA;
 	  else
 		  data[i] = TWDR;
     }
- 
+
   TWCR = _BV(TWINT) | _BV(TWSTO) | _BV(TWEN); /* send stop condition */
 
-  return 0;
+  return TWI_OK;
 
  }
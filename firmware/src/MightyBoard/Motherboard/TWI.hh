@@ -14,14 +14,50 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>
  */
- 
- #ifndef TWI_HH
- #define TWI_HH
- 
- void TWI_init();
- 
- uint8_t TWI_write_data(uint8_t address, uint8_t * data, uint8_t length);
-  uint8_t TWI_read_byte(uint8_t address, uint8_t * data, uint8_t length);
-  uint8_t TWI_write_byte(uint8_t address, uint8_t data);
-  
-  #endif
+
+#ifndef TWI_HH
+#define TWI_HH
+
+#include <stdint.h>
+
+/// Writes to TWI (I2C) peripherals are queued, and sent from the TWI interrupt, so
+/// that the main loop does not wait on the bus.  The transfers of a queued write are
+/// started back to back, the stop of each followed by the start of the next.
+#define TWI_QUEUE_SIZE		16	///< Writes queued at once, a power of 2
+#define TWI_WRITE_MAX		4	///< Longest write, in bytes
+
+/// Results of a transfer, as TWI_read_byte() returns them and the callback of a
+/// queued write is given.
+#define TWI_OK			0
+#define TWI_ERROR_START		1	///< No start condition: bus error or arbitration lost
+#define TWI_ERROR_ADDRESS	2	///< The address was not acknowledged
+#define TWI_ERROR_DATA		3	///< A data byte was not acknowledged
+
+/// Called from the TWI interrupt once a queued write is sent, or has failed.
+typedef void (*TWI_callback)(uint8_t error);
+
+/// Counts of the queued writes, from TWI_init()
+struct TWI_counters {
+	uint16_t written;		///< Writes sent
+	uint16_t start_errors;
+	uint16_t address_errors;
+	uint16_t data_errors;
+	uint16_t waits;			///< Writes which waited for room in the queue
+};
+
+void TWI_init();
+
+/// Queue a write of up to TWI_WRITE_MAX bytes, which are copied.  If the queue is
+/// full, this waits until there is room.
+/// \param [in] callback Called when the write is done, or 0.
+void TWI_queue_write(uint8_t address, const uint8_t * data, uint8_t length,
+		TWI_callback callback = 0);
+
+/// Wait until the queued writes are sent.
+void TWI_flush();
+
+TWI_counters TWI_get_counters();
+
+uint8_t TWI_read_byte(uint8_t address, uint8_t * data, uint8_t length);
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef TIMEBASE_HH_
+#define TIMEBASE_HH_
+
+#include <stdint.h>
+#include "Types.hh"
+
+/// The system clock is a free running 16 bit timer (TIMEBASE_TIMER in the board's
+/// Configuration.hh) counting at clk/8, two counts a microsecond, and the
+/// microseconds at its last overflow, which its overflow interrupt adds to every
+/// 32.768ms.  There is no periodic interrupt for the clock, and reads of it have
+/// the resolution of the counter.
+#define TIMEBASE_COUNTS_PER_MICRO	2
+#define TIMEBASE_OVERFLOW_MICROS	(0x10000L / TIMEBASE_COUNTS_PER_MICRO)
+
+/// The registers of the timebase timer, TIMEBASE_TIMER from Configuration.hh.  The
+/// overflow is the clock's; compare B, which does not change the count, times the
+/// button scan (see ButtonArray.cc).
+#define TIMEBASE_PASTE_(A, B)		A ## B
+#define TIMEBASE_PASTE(A, B)		TIMEBASE_PASTE_(A, B)
+#define TIMEBASE_TCCRA			TIMEBASE_PASTE(TIMEBASE_PASTE(TCCR, TIMEBASE_TIMER), A)
+#define TIMEBASE_TCCRB			TIMEBASE_PASTE(TIMEBASE_PASTE(TCCR, TIMEBASE_TIMER), B)
+#define TIMEBASE_TCNT			TIMEBASE_PASTE(TCNT, TIMEBASE_TIMER)
+#define TIMEBASE_TIMSK			TIMEBASE_PASTE(TIMSK, TIMEBASE_TIMER)
+#define TIMEBASE_TIFR			TIMEBASE_PASTE(TIFR, TIMEBASE_TIMER)
+#define TIMEBASE_TOIE			TIMEBASE_PASTE(TOIE, TIMEBASE_TIMER)
+#define TIMEBASE_TOV			TIMEBASE_PASTE(TOV, TIMEBASE_TIMER)
+#define TIMEBASE_OVF_vect		TIMEBASE_PASTE(TIMEBASE_PASTE(TIMER, TIMEBASE_TIMER), _OVF_vect)
+#define TIMEBASE_OCRB			TIMEBASE_PASTE(TIMEBASE_PASTE(OCR, TIMEBASE_TIMER), B)
+#define TIMEBASE_OCIEB			TIMEBASE_PASTE(TIMEBASE_PASTE(OCIE, TIMEBASE_TIMER), B)
+#define TIMEBASE_OCFB			TIMEBASE_PASTE(TIMEBASE_PASTE(OCF, TIMEBASE_TIMER), B)
+#define TIMEBASE_COMPB_vect		TIMEBASE_PASTE(TIMEBASE_PASTE(TIMER, TIMEBASE_TIMER), _COMPB_vect)
+
+/// Microseconds from the microseconds at the last overflow and a reading of the
+/// counter.  An overflow whose interrupt has not run yet (interrupts are off, or
+/// it became due while reading) is counted if the counter reading is after it.
+inline micros_t timebaseMicros(micros_t overflow_micros, uint16_t count, bool overflow_pending) {
+	if ( overflow_pending && count < 0x8000 )	overflow_micros += TIMEBASE_OVERFLOW_MICROS;
+	return overflow_micros + count / TIMEBASE_COUNTS_PER_MICRO;
+}
+
+/// Reads the clock; Timer gives count() and overflowPending() for the timer.  If the
+/// overflow interrupt runs part way through the read, it is read again.  Timer::count()
+/// must read the 16 bit counter with interrupts off, as other interrupts read the
+/// timer through the same TEMP register.
+template <class Timer>
+inline micros_t timebaseRead(volatile micros_t &overflow_micros) {
+	micros_t overflow;
+	uint16_t count;
+	bool	 pending;
+
+	do {
+		overflow = overflow_micros;
+		count	 = Timer::count();
+		pending	 = Timer::overflowPending();
+	} while ( overflow != overflow_micros );
+
+	return timebaseMicros(overflow, count, pending);
+}
+
+#endif // TIMEBASE_HH_
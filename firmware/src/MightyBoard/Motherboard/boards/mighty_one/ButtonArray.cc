@@ -1,121 +1,103 @@
 #include "ButtonArray.hh"
 #include "Configuration.hh"
 #include "Pin.hh"
-#include <util/delay.h>
+#include "Timebase.hh"
+#include "ButtonDebounce.hh"
+#include "CircularBuffer.hh"
+#include <avr/interrupt.h>
 
-static uint8_t previousJ;
-//bool  center_holding = false;
-bool right_holding = false;
+static const uint8_t BUTTON_MAP = 0x1F;
 
-void ButtonArray::init() {
-    previousJ = 0;
+/// Timebase counts between scans, while a button is down or bouncing
+#define BUTTON_SCAN_COUNTS	(BUTTON_TICK_MICROS * TIMEBASE_COUNTS_PER_MICRO)
+
+#define BUTTON_QUEUE_SIZE	4
+
+static ButtonDebounce debounce(ButtonArray::RIGHT, ButtonArray::EGG,
+		ButtonArray::SlowDelay, ButtonArray::FastDelay, ButtonArray::HoldDelay);
 
-    ButtonDelay = SlowDelay;
+static uint8_t events_data[BUTTON_QUEUE_SIZE];
+static CircularBuffer events(BUTTON_QUEUE_SIZE, events_data);
 
-    // Set all of the known buttons to inputs (see above note)
-    DDRJ = DDRJ & 0xE0;
-    PORTJ = PORTJ & 0xE0;
+/// The buttons down, one bit each by ButtonName; they read low when pressed
+static inline uint8_t readButtons() {
+	return ~PINJ & BUTTON_MAP;
 }
 
-void ButtonArray::scanButtons() {
-        // Don't bother scanning if we already have a button 
-        if (buttonPressWaiting ){
-			return;
-		}	
-		
-		uint8_t newJ = PINJ;// & 0xFE;		
-			
-		uint8_t diff = newJ ^ previousJ;
-		// if the buttons have changed at all, set the button timeout to slow speed
-		if(diff){
-			ButtonDelay = SlowDelay;
-		// if buttons are the same and our timeout has not expired, come back later
-		} else if ((buttonTimeout.isActive() && !buttonTimeout.hasElapsed())){
-			return;
-		// if buttons are the same and our timeout has expired, set timeout to fast speed
-		}else{
-			ButtonDelay = FastDelay;
-		}
-			
-        buttonTimeout.clear();
-
-        
-        /// test for special holds
-        /// center hold
- /*       if(!(newJ & (1 << CENTER))){
-			if(!center_holding){
-				centerHold.start(ResetDelay);
-				center_holding = true;
-			}
-		}
-		else{
-			centerHold = Timeout();
-			center_holding = false;
-		}
-			
-		if(centerHold.hasElapsed()){
-			buttonPress = RESET;
-			buttonPressWaiting = true;
-			centerHold = Timeout();
-			return;
-		}
-*/
-		/// right hold
-		if(!(newJ & (1 << RIGHT))){
-			if(!right_holding){
-				rightHold.start(10000000);
-				right_holding = true;
-			}
-		}
-		else{
-			rightHold = Timeout();
-			right_holding = false;
-		}
-			
-		if(rightHold.hasElapsed()){
-			buttonPress = EGG;
-			buttonPressWaiting = true;
-			rightHold = Timeout();
-			return;
-		}
-		
-		for(uint8_t i = 0; i < 5; i++) {
-			if (!(newJ&(1<<i))) {
-				if (!buttonPressWaiting) {
-						buttonPress = i;
-						buttonPressWaiting = true;
-						buttonTimeout.start(ButtonDelay);
-				}
-			}
-		}
+void ButtonArray::init() {
+	// Set all of the known buttons to inputs (see above note)
+	DDRJ = DDRJ & 0xE0;
+	PORTJ = PORTJ & 0xE0;
+
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		debounce.reset();
+		events.reset();
 
-        previousJ = newJ;
+		// a pin change starts the scan, compare B runs it
+		TIMEBASE_TIMSK &= ~_BV(TIMEBASE_OCIEB);
+		PIN_CHANGE_MASK(BUTTONS_PIN_CHANGE) |= BUTTON_MAP << 1;
+		PCICR |= _BV(PIN_CHANGE_ENABLE(BUTTONS_PIN_CHANGE));
+	}
 }
 
 bool ButtonArray::getButton(ButtonName& button) {
-    bool buttonValid;
-    uint8_t buttonNumber;
+	bool buttonValid;
+	uint8_t buttonNumber = 0;
 
-    ATOMIC_BLOCK(ATOMIC_FORCEON)
-    {
-            buttonValid =  buttonPressWaiting;
-            buttonNumber = buttonPress;        
-            buttonPressWaiting = false;             
-    }
+	ATOMIC_BLOCK(ATOMIC_FORCEON)
+	{
+		buttonValid = !events.isEmpty();
+		if (buttonValid) {
+			buttonNumber = events.pop();
+		}
+	}
 
-    if (buttonValid) {
-            button = (ButtonName)(buttonNumber);
-    }
+	if (buttonValid) {
+		button = (ButtonName)(buttonNumber);
+	}
 
-    return buttonValid;
+	return buttonValid;
 }
 
 void ButtonArray::clearButtonPress(){
-
-		previousJ = 0x1F;
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		events.reset();
+		debounce.clear();
+	}
 }
 
 void ButtonArray::setButtonDelay(uint32_t delay){
-  ButtonDelay = delay;
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		debounce.delayRepeat(delay);
+	}
+}
+
+/// Scans the buttons.  A press is queued if there is room, but a repeat only if
+/// the last has been taken, so that held buttons do not run ahead of the screen.
+/// Once the buttons are up and settled the scan stops until the next pin change.
+ISR(TIMEBASE_COMPB_vect) {
+	uint8_t event = debounce.tick(readButtons());
+
+	if (event != BUTTON_NONE) {
+		if (!(event & BUTTON_REPEAT)) {
+			events.push(event);
+		} else if (events.isEmpty()) {
+			events.push(event & ~BUTTON_REPEAT);
+		}
+	}
+
+	if (debounce.isIdle()) {
+		TIMEBASE_TIMSK &= ~_BV(TIMEBASE_OCIEB);
+	} else {
+		TIMEBASE_OCRB += BUTTON_SCAN_COUNTS;
+	}
+}
 
+/// A button changed: scan from the next tick, if not scanning already.
+ISR(PIN_CHANGE_VECT(BUTTONS_PIN_CHANGE)) {
+	if (!(TIMEBASE_TIMSK & _BV(TIMEBASE_OCIEB))) {
+		TIMEBASE_OCRB = TIMEBASE_TCNT + BUTTON_SCAN_COUNTS;
+		TIMEBASE_TIFR = _BV(TIMEBASE_OCFB);
+		TIMEBASE_TIMSK |= _BV(TIMEBASE_OCIEB);
+	}
 }
@@ -3,15 +3,16 @@
 
 #include <util/atomic.h>
 #include "Types.hh"
-#include "Timeout.hh"
 
 // TODO: Make this an interface?
 
 /// The button array modules manages an array of buttons, and maintains
-/// a buffer of the last pressed button. It has two entry points: a fast
-/// #scanButtons, which is a fast button scanning routine that should be
-/// called from an interrupt, and #getButton, which should be called by a
-/// slow loop that has time to respond to the button.
+/// a queue of the buttons pressed. The buttons are read from interrupts: a
+/// pin change on the button pins starts a scan, every BUTTON_TICK_MICROS
+/// from compare B of the timebase timer, which debounces the buttons and
+/// repeats those held (see ButtonDebounce.hh) and stops once none are down.
+/// #getButton, which should be called by a slow loop that has time to
+/// respond to the button, takes presses from the queue.
 ///
 /// Porting Notes:
 /// This modules uses low-level port registers, and must be re-written for
@@ -22,13 +23,6 @@
 #define RESET_MASK  0x06
 
 class ButtonArray {
-private:
-        uint8_t buttonPress;
-        bool buttonPressWaiting;
-        Timeout buttonTimeout;
-//        Timeout centerHold;
-        Timeout rightHold;
-
 public:
         /// Representation of the different buttons available on the keypad
         enum ButtonName {
@@ -40,21 +34,22 @@ public:
                 RESET			= 5,
                 EGG				= 6
         };
-        uint32_t ButtonDelay;
         const static uint32_t FastDelay = 100000;
-		    const static uint32_t SlowDelay = 500000;
-//        const static uint32_t ResetDelay = 10000000;
+        const static uint32_t SlowDelay = 500000;
+        /// Holding RIGHT this long gives EGG
+        const static uint32_t HoldDelay = 10000000;
 
         void init();
 
-        // Returns true if any of the button states have changed.
-        void scanButtons();
-
+        /// Takes the next button pressed from the queue.
+        /// \return True if there was one, in button.
         bool getButton(ButtonName& button);
-        
+
+        /// Drops the queued presses; buttons still down are pressed again.
         void clearButtonPress();
 
-        void setButtonDelay(uint32_t);
+        /// Wait at least the given time before the button held repeats.
+        void setButtonDelay(uint32_t delay);
 };
 
 
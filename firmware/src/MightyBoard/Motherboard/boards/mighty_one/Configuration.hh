@@ -91,6 +91,10 @@
 // if they are based on the H21LOI, they are not.
 #define DEFAULT_INVERTED_ENDSTOPS 1
 
+// 16 bit timer free running as the system clock, see Timebase.hh.
+// Timer 3 is not otherwise used on this board; 1 and 4 drive the extruders
+#define TIMEBASE_TIMER 3
+
 //Stepper Ports
 #define X_STEPPER_STEP          STEPPER_PORT(F,1)   //active rising edge
 #define X_STEPPER_DIR           STEPPER_PORT(F,0)   //forward on high
@@ -109,6 +113,9 @@
 #define Z_STEPPER_ENABLE        STEPPER_PORT(K,2)   //active low
 #define Z_STEPPER_MIN           STEPPER_PORT(L,6)   //active high
 #define Z_STEPPER_MAX           STEPPER_PORT(L,7)   //active high
+
+// Port L has no pin change interrupt, so the endstops are polled from the
+// 10KHz timer (no ENDSTOPS_PIN_CHANGE)
  
 #define A_STEPPER_STEP          STEPPER_PORT(A,3)   //active rising edge
 #define A_STEPPER_DIR           STEPPER_PORT(A,2)   //forward on high
@@ -134,6 +141,9 @@
 #define POTS_SCL        Pin(PortJ,5)
 // default value for pots (0-127 valid)
 #define POTS_DEFAULT_VAL 50
+// axes whose motor current follows the motion (see MotorCurrent.hh): X, Y, A
+// and B.  Z keeps its current, to hold the platform.
+#define MOTOR_CURRENT_AXES 0b11011
 
 // --- Debugging configuration ---
 // The pin which controls the debug LED (active high)
@@ -163,13 +173,16 @@
 /// This is the pin mapping for the interface board. Because of the relatively
 /// high cost of using the pins in a direct manner, we will instead read the
 /// buttons directly by scanning their ports. If any of these definitions are
-/// modified, the #scanButtons() function _must_ be updated to reflect this.
+/// modified, ButtonArray.cc _must_ be updated to reflect this.
 #define INTERFACE_UP		Pin(PORTJ,4)
 #define INTERFACE_DOWN		Pin(PortJ,3) 
 #define INTERFACE_RIGHT		Pin(PortJ,1) 
 #define INTERFACE_LEFT		Pin(PortJ,2) 
 #define INTERFACE_CENTER	Pin(PortJ,0) 
 
+// The buttons have a pin change interrupt, PCINT1
+#define BUTTONS_PIN_CHANGE	1
+
 #define INTERFACE_LED_ONE		Pin(PortC, 5)
 #define INTERFACE_LED_TWO		Pin(PortC, 6)
 
@@ -221,6 +234,15 @@
 #define SAMPLE_INTERVAL_MICROS_THERMISTOR (50L * 1000L)
 #define SAMPLE_INTERVAL_MICROS_THERMOCOUPLE (500L * 1000L)
 
+// Nominal heater power, for the heat planner.  The heaters that are running
+// full on at the same time must fit in the budget, which is what the 24 V,
+// 221 W supply of the Replicator can spare for heat with the motors and
+// electronics running.  The platform and the 40 W extruder cartridges are
+// at their rated power.
+#define PLATFORM_HEATER_WATTS		110
+#define EXTRUDER_HEATER_WATTS		40
+#define HEATER_BUDGET_WATTS		180
+
 // Safety Cutoff circuit
 #ifndef CUTOFF_PRESENT
   #define CUTOFF_PRESENT			0
@@ -18,7 +18,6 @@
  
  #include "RGB_LED.hh"
  #include "TWI.hh"
- #include <util/delay.h>
  #include "Configuration.hh"
  #include "Pin.hh"
  #include "EepromMap.hh"
@@ -66,11 +65,8 @@ void init(){
  		return;
  	}
  	
-  // we have to delay between writes to give the chip time to respond
- 	TWI_write_data(LEDAddress, data1, 2);
-   _delay_us(1);
-  TWI_write_data(LEDAddress, data2, 2);
-   _delay_us(1);
+ 	TWI_queue_write(LEDAddress, data1, 2);
+  TWI_queue_write(LEDAddress, data2, 2);
 
    LEDSelect = data1[1];
  		
@@ -100,11 +96,8 @@ void init(){
  	else
  		return;
  	
-  // we need to delay between writes to give the chip time to process
-   TWI_write_data(LEDAddress, data1, 2);
-   _delay_us(1);
-   TWI_write_data(LEDAddress, data2, 2);
-   _delay_us(1);
+   TWI_queue_write(LEDAddress, data1, 2);
+   TWI_queue_write(LEDAddress, data2, 2);
      
  	LEDSelect = data1[1];	
  }
@@ -123,7 +116,7 @@ void init(){
  	// clear past select data and turn LEDs full off
  		data[1] = (LEDSelect & ~LEDs) | (LED_OFF & LEDs); 
  		
- 	uint8_t error = TWI_write_data(LEDAddress, data, 2);
+ 	TWI_queue_write(LEDAddress, data, 2);
  	
      LEDSelect = data[1];
  }
@@ -1,137 +1,116 @@
 #include "ButtonArray.hh"
 #include "Configuration.hh"
 #include "Pin.hh"
-#include <util/delay.h>
-
-static uint8_t previousJ;
-static uint8_t previousG;
-//bool  center_holding = false;
-bool right_holding = false;
+#include "Timebase.hh"
+#include "ButtonDebounce.hh"
+#include "CircularBuffer.hh"
+#include "StepperAxis.hh"
+#include <avr/interrupt.h>
 
 static const uint8_t ARROW_BUTTON_MAP = 0x78;
 static const uint8_t CENTER_BUTTON_MAP = 0x04;
 
-void ButtonArray::init() {
-        previousJ = 0;
-        previousG = 0;
-        
-        ButtonDelay = SlowDelay;
-
-        // Set all of the known buttons to inputs 
-        DDRJ  &= ~( ARROW_BUTTON_MAP );
-        PORTJ &= ~( ARROW_BUTTON_MAP );
-        
-        INTERFACE_CENTER.setDirection(false);
+/// Timebase counts between scans while a button is down or bouncing, and
+/// between the samples of the center button otherwise: port G has no pin
+/// change interrupt, so a press of it is only seen by sampling.
+#define BUTTON_SCAN_COUNTS	(BUTTON_TICK_MICROS * TIMEBASE_COUNTS_PER_MICRO)
+#define BUTTON_IDLE_COUNTS	(4 * BUTTON_SCAN_COUNTS)
+
+#define BUTTON_QUEUE_SIZE	4
+
+static ButtonDebounce debounce(ButtonArray::RIGHT, ButtonArray::EGG,
+		ButtonArray::SlowDelay, ButtonArray::FastDelay, ButtonArray::HoldDelay);
+
+static uint8_t events_data[BUTTON_QUEUE_SIZE];
+static CircularBuffer events(BUTTON_QUEUE_SIZE, events_data);
+
+/// True while the buttons are scanned every BUTTON_SCAN_COUNTS
+static bool scanning;
+
+/// The buttons down, one bit each by ButtonName; they read low when pressed
+static inline uint8_t readButtons() {
+	return (~PINJ & ARROW_BUTTON_MAP) | (~PING & CENTER_BUTTON_MAP);
 }
 
-void ButtonArray::scanButtons() {
-	
-         // Don't bother scanning if we already have a button 
-        if (buttonPressWaiting ){
-			return;
-		}	
-		
-		uint8_t newJ = PINJ & ARROW_BUTTON_MAP;// & 0xFE;	
-		uint8_t newG = PING & CENTER_BUTTON_MAP;	
-			
-		uint8_t diffJ = newJ ^ previousJ;
-		uint8_t diffG = newG ^ previousG;
-		// if the buttons have changed at all, set the button timeout to slow speed
-		if(diffJ | diffG){
-			ButtonDelay = SlowDelay;
-		// if buttons are the same and our timeout has not expired, come back later
-		} else if ((buttonTimeout.isActive() && !buttonTimeout.hasElapsed())){
-			return;
-		// if buttons are the same and our timeout has expired, set timeout to fast speed
-		}else{
-			ButtonDelay = FastDelay;
-		}
-			
-    buttonTimeout.clear();
-        
-        /// test for special holds
-        /// center hold
-  /*      if(!(newG & (1 << CENTER))){
-			if(!center_holding){
-				centerHold.start(10000000);
-				center_holding = true;
-			}
-		}
-		else{
-			centerHold = Timeout();
-			center_holding = false;
-		}
-			
-		if(centerHold.hasElapsed()){
-			buttonPress = RESET;
-			buttonPressWaiting = true;
-			centerHold = Timeout();
-			return;
-		}
-*/
-		/// right hold
-		if(!(newJ & (1 << RIGHT))){
-			if(!right_holding){
-				rightHold.start(10000000);
-				right_holding = true;
-			}
-		}
-		else{
-			rightHold = Timeout();
-			right_holding = false;
-		}
-			
-		if(rightHold.hasElapsed()){
-			buttonPress = EGG;
-			buttonPressWaiting = true;
-			rightHold = Timeout();
-			return;
-		}
-		
-		if(!(newG&(1<<CENTER))){
-			buttonPress = CENTER;
-			buttonPressWaiting = true;
-			buttonTimeout.start(ButtonDelay);
-		}
-		      
-		for(uint8_t i = 3; i < 7; i++) {
-			if (!(newJ&(1<<i))) {
-				if (!buttonPressWaiting) {
-						buttonPress = i;
-						buttonPressWaiting = true;
-						buttonTimeout.start(ButtonDelay);
-				}
-			}
-		}
+void ButtonArray::init() {
+	// Set all of the known buttons to inputs
+	DDRJ  &= ~( ARROW_BUTTON_MAP );
+	PORTJ &= ~( ARROW_BUTTON_MAP );
+
+	INTERFACE_CENTER.setDirection(false);
 
-		previousG = newG;
-        previousJ = newJ;
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		debounce.reset();
+		events.reset();
+		scanning = false;
+
+		// the arrows' pin changes start a scan; compare B samples the center
+		PIN_CHANGE_MASK(BUTTONS_PIN_CHANGE) |= ARROW_BUTTON_MAP << 1;
+		PCICR |= _BV(PIN_CHANGE_ENABLE(BUTTONS_PIN_CHANGE));
+		TIMEBASE_OCRB = TIMEBASE_TCNT + BUTTON_IDLE_COUNTS;
+		TIMEBASE_TIFR = _BV(TIMEBASE_OCFB);
+		TIMEBASE_TIMSK |= _BV(TIMEBASE_OCIEB);
+	}
 }
 
 bool ButtonArray::getButton(ButtonName& button) {
-        bool buttonValid;
-        uint8_t buttonNumber;
+	bool buttonValid;
+	uint8_t buttonNumber = 0;
 
-        ATOMIC_BLOCK(ATOMIC_FORCEON)
-        {
-                buttonValid =  buttonPressWaiting;
-                buttonNumber = buttonPress;        
-                buttonPressWaiting = false;             
-        }
+	ATOMIC_BLOCK(ATOMIC_FORCEON)
+	{
+		buttonValid = !events.isEmpty();
+		if (buttonValid) {
+			buttonNumber = events.pop();
+		}
+	}
 
-        if (buttonValid) {
-                button = (ButtonName)(buttonNumber);
-        }
+	if (buttonValid) {
+		button = (ButtonName)(buttonNumber);
+	}
 
-        return buttonValid;
+	return buttonValid;
 }
 
 void ButtonArray::clearButtonPress(){
-
-		previousJ = ARROW_BUTTON_MAP; 
-		previousG = CENTER_BUTTON_MAP;
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		events.reset();
+		debounce.clear();
+	}
 }
 
 void ButtonArray::setButtonDelay(uint32_t delay){
-  ButtonDelay = delay;
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		debounce.delayRepeat(delay);
+	}
+}
+
+/// Scans the buttons.  A press is queued if there is room, but a repeat only if
+/// the last has been taken, so that held buttons do not run ahead of the screen.
+ISR(TIMEBASE_COMPB_vect) {
+	uint8_t event = debounce.tick(readButtons());
+
+	if (event != BUTTON_NONE) {
+		if (!(event & BUTTON_REPEAT)) {
+			events.push(event);
+		} else if (events.isEmpty()) {
+			events.push(event & ~BUTTON_REPEAT);
+		}
+	}
+
+	scanning = !debounce.isIdle();
+	TIMEBASE_OCRB += scanning ? BUTTON_SCAN_COUNTS : BUTTON_IDLE_COUNTS;
+}
+
+/// An arrow changed: scan from the next tick.  The endstops share this
+/// interrupt, and are latched first.
+ISR(PIN_CHANGE_VECT(BUTTONS_PIN_CHANGE)) {
+#if defined(ENDSTOPS_PIN_CHANGE) && ENDSTOPS_PIN_CHANGE == BUTTONS_PIN_CHANGE
+	stepperAxisLatchEndstops();
+#endif
+	if (!scanning) {
+		scanning = true;
+		TIMEBASE_OCRB = TIMEBASE_TCNT + BUTTON_SCAN_COUNTS;
+		TIMEBASE_TIFR = _BV(TIMEBASE_OCFB);
+	}
 }
@@ -91,6 +91,10 @@
 // if they are based on the H21LOI, they are not.
 #define DEFAULT_INVERTED_ENDSTOPS 1
 
+// 16 bit timer free running as the system clock, see Timebase.hh.
+// Timer 1 is not otherwise used on this board
+#define TIMEBASE_TIMER 1
+
 // compare register used by stepper timer
 #define STEPPER_COMP_REGISTER OCR1A
 
@@ -114,6 +118,10 @@
 #define Z_STEPPER_MIN           STEPPER_PORT(C,5)   //active high
 #define Z_STEPPER_MAX           STEPPER_PORT(J,0)   //active high
 
+// The endstops on port J have a pin change interrupt, PCINT1.  Those on port C
+// have none, and are polled from the 10KHz timer instead.
+#define ENDSTOPS_PIN_CHANGE     1
+
 #define A_STEPPER_STEP          STEPPER_PORT(A,3)   //active rising edge
 #define A_STEPPER_DIR           STEPPER_PORT(A,2)   //forward on high
 #define A_STEPPER_ENABLE        STEPPER_PORT(A,5)   //active low
@@ -137,6 +145,9 @@
 #define POTS_SCL        Pin(PortA,6)
 // default value for pots (0-127 valid)
 #define POTS_DEFAULT_VAL 50
+// axes whose motor current follows the motion (see MotorCurrent.hh): X, Y, A
+// and B.  Z keeps its current, to hold the platform.
+#define MOTOR_CURRENT_AXES 0b11011
 
 // --- Debugging configuration ---
 // The pin which controls the debug LED (active high)
@@ -175,13 +186,17 @@
 /// This is the pin mapping for the interface board. Because of the relatively
 /// high cost of using the pins in a direct manner, we will instead read the
 /// buttons directly by scanning their ports. If any of these definitions are
-/// modified, the #scanButtons() function _must_ be updated to reflect this.
+/// modified, ButtonArray.cc _must_ be updated to reflect this.
 #define INTERFACE_UP		Pin(PortJ,5)
 #define INTERFACE_DOWN		Pin(PortJ,4) 
 #define INTERFACE_RIGHT		Pin(PortJ,3) 
 #define INTERFACE_LEFT		Pin(PortJ,6) 
 #define INTERFACE_CENTER	Pin(PortG,2) 
 
+// The arrows have a pin change interrupt, PCINT1, shared with the endstops;
+// port G has none, so the center button is sampled by the button scan tick
+#define BUTTONS_PIN_CHANGE	1
+
 #ifdef REVG
 #define INTERFACE_POWER		Pin(PortA, 7)
 #define INTERFACE_LED_ONE	Pin(PortC, 2)
@@ -228,6 +243,15 @@
 #define SAMPLE_INTERVAL_MICROS_THERMISTOR (500L * 1000L)
 #define SAMPLE_INTERVAL_MICROS_THERMOCOUPLE (250L * 1000L)
 
+// Nominal heater power, for the heat planner.  The heaters that are running
+// full on at the same time must fit in the budget, which is what the 24 V
+// supply of the Replicator 2X can spare for heat with the motors and
+// electronics running.  The platform and the 40 W extruder cartridges are
+// at their rated power; without a heated platform it is never turned on.
+#define PLATFORM_HEATER_WATTS		150
+#define EXTRUDER_HEATER_WATTS		40
+#define HEATER_BUDGET_WATTS		240
+
 // bot shuts down printers after a defined timeout 
 #define USER_INPUT_TIMEOUT		1800000000 // 30 minutes
 #define USER_FILAMENT_INPUT_TIMEOUT	900000000  // 15 minutes
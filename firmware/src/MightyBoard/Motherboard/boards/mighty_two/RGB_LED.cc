@@ -18,7 +18,6 @@
  
  #include "RGB_LED.hh"
  #include "TWI.hh"
- #include <util/delay.h>
  #include "Configuration.hh"
  #include "Pin.hh"
  #include "EepromMap.hh"
@@ -41,25 +40,18 @@ void init(){
 	 // make sure out drive is correct
 	 // verify pin out - RGB, i2c pins
 	 
-	 int error;
 	 // set operation modes
 	 uint8_t data1[2] = {LED_REG_MODE1, LED_ALL_CALL_ADDR};
-	 error = TWI_write_data(LEDAddress, data1, 2);
-	 
-	 _delay_us(50);
+	 TWI_queue_write(LEDAddress, data1, 2);
 	 
 	 // output logic state inverted
 	 // leds are configured with a totem pole structure
 	 uint8_t data[2] = {LED_REG_MODE2, LED_OUT_INVERTED | LED_OUT_DRIVE};
-	 error = TWI_write_data(LEDAddress, data, 2);
-
-	_delay_us(50);
+	 TWI_queue_write(LEDAddress, data, 2);
 	 
 	 
 	 uint8_t data2[2] = {LED_REG_LEDOUT, LED_INDIVIDUAL};// & ( LED_RED | LED_GREEN | LED_BLUE)};
-	 error = TWI_write_data(LEDAddress, data2, 2);
-	 
-	 _delay_us(50);
+	 TWI_queue_write(LEDAddress, data2, 2);
 	 
 	 	 
 	 setDefaultColor();
@@ -119,48 +111,34 @@ void setLEDBlink(uint8_t rate){
 	
 	 // turn group blink on
 	 uint8_t data[2] = {LED_REG_MODE2, LED_OUT_INVERTED | LED_OUT_DRIVE | LED_GROUP_BLINK};
-	 TWI_write_data(LEDAddress, data, 2);
-	 
-	 _delay_us(50);
+	 TWI_queue_write(LEDAddress, data, 2);
 	 
 	 uint8_t data2[2] = {LED_REG_LEDOUT, LED_GROUP & ( LED_RED | LED_GREEN | LED_BLUE)};
-	 TWI_write_data(LEDAddress, data2, 2);
-	 
-	 _delay_us(50);
+	 TWI_queue_write(LEDAddress, data2, 2);
 	 
 	 // set group blink rate
 	 uint8_t data1[2] = {LED_REG_GRPPWM, 128};
-	 TWI_write_data(LEDAddress, data1, 2);
-	 
-	 _delay_us(50);
+	 TWI_queue_write(LEDAddress, data1, 2);
 	 
 	 //set dimming frequency to zero
 	 uint8_t data3[2] = {LED_REG_GRPFREQ, rate};
-	 TWI_write_data(LEDAddress, data3, 2);
+	 TWI_queue_write(LEDAddress, data3, 2);
 	}
 	else{ 
 	// turn group blink off
 	 uint8_t data[2] = {LED_REG_MODE2, LED_OUT_INVERTED | LED_OUT_DRIVE };
-	 TWI_write_data(LEDAddress, data, 2);
-	 
-	  _delay_us(50);
+	 TWI_queue_write(LEDAddress, data, 2);
 	 
 	 uint8_t data2[2] = {LED_REG_LEDOUT, LED_INDIVIDUAL & ( LED_RED | LED_GREEN | LED_BLUE)};
-	 TWI_write_data(LEDAddress, data2, 2);
-	 
-	  _delay_us(50);
+	 TWI_queue_write(LEDAddress, data2, 2);
 	  
 	 // set blink rate to zero
 	 uint8_t data1[2] = {LED_REG_GRPPWM, rate};
-	 TWI_write_data(LEDAddress, data1, 2);
-	 
-	  _delay_us(50);
+	 TWI_queue_write(LEDAddress, data1, 2);
 	 
 	 //set dimming frequency to zero
 	 uint8_t data3[2] = {LED_REG_GRPFREQ, rate};
-	 TWI_write_data(LEDAddress, data3, 2);
-	 
-	  _delay_us(50);
+	 TWI_queue_write(LEDAddress, data3, 2);
 	 
 	 setDefaultColor();
 	}
@@ -179,18 +157,14 @@ void setColor(uint8_t red, uint8_t green, uint8_t blue, bool clearOld){
 		
 	 // set red
 	 uint8_t data[2] = {LED_REG_PWM_RED, red};
-	 TWI_write_data(LEDAddress, data, 2);
-	 
-	 _delay_us(50);
+	 TWI_queue_write(LEDAddress, data, 2);
 	 
 	 // set red
 	 uint8_t data1[2] = {LED_REG_PWM_GREEN, green};
-	 TWI_write_data(LEDAddress, data1, 2);
-	 
-	 _delay_us(50);
+	 TWI_queue_write(LEDAddress, data1, 2);
 	 
 	 // set red
 	 uint8_t data2[2] = {LED_REG_PWM_BLUE, blue};
-	 TWI_write_data(LEDAddress, data2, 2);
+	 TWI_queue_write(LEDAddress, data2, 2);
 }
 }
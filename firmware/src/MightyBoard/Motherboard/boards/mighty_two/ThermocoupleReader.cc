@@ -26,6 +26,7 @@
 #include "stdio.h"
 #include "Configuration.hh"
 #include "TemperatureTable.hh"
+#include <util/atomic.h>
 
 
 /*
@@ -41,7 +42,8 @@ ThermocoupleReader::ThermocoupleReader(const Pin& do_p,const Pin& sck_p,const Pi
         do_pin(do_p),
         sck_pin(sck_p),
         di_pin(di_p),
-        cs_pin(cs_p)
+        cs_pin(cs_p),
+        xfer_byte(XFER_DISABLED)
 {
 	
 }
@@ -106,52 +108,25 @@ void ThermocoupleReader::init() {
 }
 
 /*
- * Send initial config value to the ADS1118
+ * Reset the read sequence.  The first transfer clocked out by the interrupt
+ * state machine writes the channel one config register; its data is discarded
+ * because it was converted with whatever configuration the ADC held before.
  * 
  */
 void ThermocoupleReader::initConfig(){
 
 	sck_pin.setValue(false);
 	
-	
-	config_state = CHANNEL_ONE;
-	read_state = CHANNEL_ONE;
-	temp_check_counter = TEMP_CHECK_COUNT;
-	
-	uint16_t config = channel_one_config;
-  last_config = config;
-	
-	uint16_t config_reg = 0;
-	
-	// send the config register 
-	for (int i = 0; i < 16; i++) {
-		
-		// shift out config register data
-		do_pin.setValue((config & 0b01) != 0);
-		config >>= 1;
-		
-		sck_pin.setValue(true);
-		// we don't care about the slave data here
-		sck_pin.setValue(false);
-	}
-	
-	// read back the config reg
-	for (int i = 0; i < 16; i++) {
-		
-		// shift out dummy data
-		do_pin.setValue(false);
-		
-		sck_pin.setValue(true);
-		config_reg = config_reg << 1;
-		if (di_pin.getValue()) { config_reg = config_reg | 0x01; }
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		config_state = CHANNEL_ONE;
+		read_state = CONFIG_ONLY;
+		temp_check_counter = TEMP_CHECK_COUNT;
+		last_config = channel_one_config;
 
-		sck_pin.setValue(false);
+		xfer_byte = XFER_IDLE;
+		tick_countdown = 0;
+		result_ready = false;
 	}
-	
-	/// we could check here to make sure the config data has been read correctly
-	
-	sck_pin.setValue(false);
-
 }
 
 
@@ -174,76 +149,134 @@ TemperatureSensor::SensorState ThermocoupleReader::GetChannelTemperature(uint8_t
 }
 
 /*
- * Get a new read from the ADC.  This function is called by the motherboard slice at regular intervals
- * and cycles between channel 1 channel 2 and cold junction temperature, reading one value each fucntion call
+ * Clock the ADS1118 from the timer interrupt.  Called every timer 2 tick; it
+ * waits THERMOCOUPLE_UPDATE_TICKS between transfers and then shifts one byte
+ * of the 32 bit transfer per tick, so no single call holds the interrupt for
+ * long.  Channel and cold junction sequencing happen here as well, so the
+ * main loop only has to convert the published raw value.
  * 
  */
-bool ThermocoupleReader::update() {
+void ThermocoupleReader::doInterrupt() {
 
-	sck_pin.setValue(false);
-	
-	// check that data ready flag is low
-	// if it is high, return false so the calling function knows to try again
-	if(di_pin.getValue())
-		return false;
-		
-	uint16_t config = 0;
-		
-	// the config register determines the output for the next read
-	switch ( config_state){
-		case CHANNEL_ONE : 
-			config = channel_one_config; 
-			break;
-		case CHANNEL_TWO : 
-			config = channel_two_config; 
-			break;
-		case COLD_TEMP : 
-			config = cold_temp_config; 
-			break;
+	// pins are not set up until init() has been called
+	if (xfer_byte == XFER_DISABLED)
+		return;
+
+	if (xfer_byte == XFER_IDLE) {
+		if (tick_countdown > 0) {
+			tick_countdown--;
+			return;
+		}
+		// wait for the data ready flag to go low, unless this is the
+		// initial config write (the ADC may not be converting yet)
+		if ((read_state != CONFIG_ONLY) && di_pin.getValue())
+			return;
+
+		// the config register determines the output for the next read
+		switch ( config_state){
+			case CHANNEL_ONE : 
+				last_config = channel_one_config; 
+				break;
+			case CHANNEL_TWO : 
+				last_config = channel_two_config; 
+				break;
+			case COLD_TEMP : 
+				last_config = cold_temp_config; 
+				break;
+		}
+		shift_out = last_config;
+		shift_in = 0;
+		xfer_byte = 0;
 	}
-	
-  uint16_t config_out = config;
-	uint16_t config_reg = 0;
-	uint16_t raw = 0;
-	
+
 	/// the ADS1118 uses bidirection SPI communication
 	/// the sensor returns 4 bytes of data per read.  the first two bytes are the 
 	/// ADC bits.  the second two bytes are the config register bits
 	/// the mightyboard (master) sends the desired configuration register in the first 
 	/// two bytes and sends dummy data for the second two bytes
-	
-	// read the temperature register
-	for (int i = 0; i < 16; i++) {
-		
-		// shift out config register data
-		do_pin.setValue((config_out & 0b01) != 0);
-		config_out >>= 1;
-		
+	for (uint8_t i = 0; i < 8; i++) {
+		do_pin.setValue((shift_out & 0b01) != 0);
+		shift_out >>= 1;
+
 		sck_pin.setValue(true);
-		raw = raw << 1;
-		if (di_pin.getValue()) {raw = raw | 0x01; }
+		shift_in = shift_in << 1;
+		if (di_pin.getValue()) { shift_in = shift_in | 0x01; }
 
 		sck_pin.setValue(false);
 	}
-	
-	// read back the config reg
-	for (int i = 0; i < 16; i++) {
-		
-		// shift out dummy data
-		do_pin.setValue(false);
-		
-		sck_pin.setValue(true);
-		config_reg = config_reg << 1;
-		if (di_pin.getValue()) { config_reg = config_reg | 0x01; }
+	xfer_byte++;
 
-		sck_pin.setValue(false);
+	if (xfer_byte == 2) {
+		// the ADC result is complete; the rest is the config readback
+		raw_result = shift_in;
+		return;
 	}
-	
-	sck_pin.setValue(false);
+	if (xfer_byte < 4) {
+		return;
+	}
+
+	/// publish the read unless it was the initial config write
+	if (read_state != CONFIG_ONLY) {
+		raw_value = raw_result;
+		raw_channel = read_state;
+		result_ready = true;
+	}
+	/// the temperature read next cycle is determined by the config bytes we just sent
+	read_state = config_state;
+
+	/// update the config register
+	/// we switch back and forth between channel one and channel two
+	/// every TEMP_CHECK_COUNT cycles, we read the cold_junction_temperature
+	switch ( config_state){
+		case CHANNEL_ONE : 
+			config_state = CHANNEL_TWO; 
+			break;
+		case CHANNEL_TWO : 
+			// we don't need to read the cold temp every time
+			// read it ~once per minute
+			temp_check_counter++;
+			if(temp_check_counter >= TEMP_CHECK_COUNT){
+				temp_check_counter = 0;
+				config_state = COLD_TEMP;  
+			}else{
+				config_state = CHANNEL_ONE;
+				}
+			break;
+		case COLD_TEMP : 
+			config_state = CHANNEL_ONE; 
+			break;
+	}	
+
+	xfer_byte = XFER_IDLE;
+	tick_countdown = THERMOCOUPLE_UPDATE_TICKS;
+}
+
+/*
+ * Convert the newest read published by the interrupt state machine.  This
+ * is called from the motherboard slice and does no SPI traffic itself.
+ *
+ * @return true if a new read was converted
+ * 
+ */
+bool ThermocoupleReader::update() {
+
+	uint16_t raw;
+	uint8_t channel;
+	bool ready;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		ready = result_ready;
+		raw = raw_value;
+		channel = raw_channel;
+		result_ready = false;
+	}
+
+	if (!ready)
+		return false;
 
   int16_t temp;
   /// store read to the temperature variable
-  switch(read_state){
+  switch(channel){
     case COLD_TEMP:
       cold_temp = TemperatureTable::TempReadtoCelsius((int16_t)(raw >> 2), TemperatureTable::table_cold_junction, MAX_TEMP);
       break;
@@ -282,33 +315,7 @@ bool ThermocoupleReader::update() {
   }
 	
 	/// track last update temperature, so that this value can be queried.
-	last_temp_updated = read_state;
-	/// the temperature read next cycle is determined by the config bytes we just sent
-	read_state = config_state;
-  last_config = config;
-	
-	/// update the config register
-	/// we switch back and forth between channel one and channel two
-	/// every TEMP_CHECK_COUNT cycles, we read the cold_junction_temperature
-	switch ( config_state){
-		case CHANNEL_ONE : 
-			config_state = CHANNEL_TWO; 
-			break;
-		case CHANNEL_TWO : 
-			// we don't need to read the cold temp every time
-			// read it ~once per minute
-			temp_check_counter++;
-			if(temp_check_counter >= TEMP_CHECK_COUNT){
-				temp_check_counter = 0;
-				config_state = COLD_TEMP;  
-			}else{
-				config_state = CHANNEL_ONE;
-				}
-			break;
-		case COLD_TEMP : 
-			config_state = CHANNEL_ONE; 
-			break;
-	}	
+	last_temp_updated = channel;
 	
 	// return true when temperature update is successful
 	return true;
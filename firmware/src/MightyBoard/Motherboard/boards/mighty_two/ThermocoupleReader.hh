@@ -63,8 +63,14 @@
 /// because we don't expect it to change much
 #define TEMP_CHECK_COUNT 120
 
+/// number of timer 2 ticks (100us each) between ADC transfers
+/// 250ms - read 4 times per second (2 per channel)
+#define THERMOCOUPLE_UPDATE_TICKS 2500
+
 /// The thermocouple module provides a bitbanging driver that can read the
 /// temperature from the ADS1118 sensor, and also report on any error conditions.
+/// SPI transfers are clocked from the timer interrupt by #doInterrupt(), one
+/// byte per tick; #update() only converts the result on the main loop.
 /// \ingroup SoftwareLibraries
 class ThermocoupleReader {
 	
@@ -72,7 +78,8 @@ public:
 	enum therm_states{
 		CHANNEL_ONE = 0,
 		CHANNEL_TWO = 1,
-		COLD_TEMP = 2
+		COLD_TEMP = 2,
+		CONFIG_ONLY = 3   ///< initial config write, result is discarded
 	};
 
 private:
@@ -98,6 +105,21 @@ private:
 
   uint16_t last_temp_updated;
   uint16_t last_config;
+
+  /// marks the interrupt state machine as waiting for the next transfer
+  const static uint8_t XFER_IDLE = 0xFF;
+  /// marks the interrupt state machine as not yet initialized
+  const static uint8_t XFER_DISABLED = 0xFE;
+
+  volatile uint8_t xfer_byte;       ///< byte of the 4 byte transfer being clocked, or XFER_IDLE
+  volatile uint16_t tick_countdown; ///< timer ticks remaining until the next transfer
+  uint16_t shift_out;               ///< config bits remaining to be shifted out
+  uint16_t shift_in;                ///< bits shifted in so far
+  uint16_t raw_result;              ///< ADC bits of the transfer in progress
+
+  volatile uint16_t raw_value;      ///< last completed ADC read
+  volatile uint8_t raw_channel;     ///< channel raw_value was read from
+  volatile bool result_ready;       ///< set when raw_value has not been converted yet
         
         
 public:
@@ -111,7 +133,12 @@ public:
 	void init();
 	void initConfig();
 	
+	/// Convert the last read clocked in by #doInterrupt()
+	/// \return true if a new read was available
 	bool update();
+
+	/// Run the SPI state machine; called from the timer 2 interrupt
+	void doInterrupt();
 	
 	uint8_t getLastUpdated(){ return last_temp_updated;}
 	
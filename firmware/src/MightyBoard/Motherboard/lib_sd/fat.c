@@ -159,6 +159,18 @@ struct fat_fs_struct
     struct partition_struct* partition;
     struct fat_header_struct header;
     cluster_t cluster_free;
+#if FAT_CACHE_SIZE
+    /* a window of the FAT, kept apart from the device's block cache */
+    offset_t fat_cache_offset;
+    uint8_t fat_cache[FAT_CACHE_SIZE];
+#endif
+};
+
+/* a run of consecutive clusters of a file */
+struct fat_extent_struct
+{
+    cluster_t cluster;
+    cluster_t count;
 };
 
 struct fat_file_struct
@@ -170,6 +182,13 @@ struct fat_file_struct
 #ifdef FAT_DELAY_DIRENTRY_UPDATE
     uint8_t needs_write;
 #endif
+#if FAT_EXTENT_COUNT
+    /* the cluster chain of the file as runs, from the first cluster on */
+    struct fat_extent_struct extents[FAT_EXTENT_COUNT];
+    uint8_t extent_count;
+    /* set if the runs cover the whole chain */
+    uint8_t extents_complete;
+#endif
 };
 
 struct fat_dir_struct
@@ -203,7 +222,14 @@ static struct fat_dir_struct fat_dir_handles[FAT_DIR_COUNT];
 #endif
 
 static uint8_t fat_read_header(struct fat_fs_struct* fs);
-static cluster_t fat_get_next_cluster(const struct fat_fs_struct* fs, cluster_t cluster_num);
+static cluster_t fat_get_next_cluster(struct fat_fs_struct* fs, cluster_t cluster_num);
+static uint8_t fat_read_fat_entry(struct fat_fs_struct* fs, offset_t offset, uint8_t* entry, uint8_t entry_size);
+static void fat_invalidate_fat_cache(struct fat_fs_struct* fs);
+static cluster_t fat_file_cluster(struct fat_file_struct* fd, offset_t pos, cluster_t cluster_prev);
+#if FAT_EXTENT_COUNT
+static void fat_map_file(struct fat_file_struct* fd);
+static void fat_map_append(struct fat_file_struct* fd, cluster_t cluster_num);
+#endif
 static offset_t fat_cluster_offset(const struct fat_fs_struct* fs, cluster_t cluster_num);
 static uint8_t fat_dir_entry_read_callback(uint8_t* buffer, offset_t offset, void* p);
 #if FAT_LFN_SUPPORT
@@ -217,6 +243,7 @@ static uint8_t fat_get_fs_free_32_callback(uint8_t* buffer, offset_t offset, voi
 
 #if FAT_WRITE_SUPPORT
 static cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, cluster_t count);
+static cluster_t fat_find_free_run(struct fat_fs_struct* fs, cluster_t cluster_num, cluster_t count);
 static uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num);
 static uint8_t fat_terminate_clusters(struct fat_fs_struct* fs, cluster_t cluster_num);
 static uint8_t fat_clear_cluster(const struct fat_fs_struct* fs, cluster_t cluster_num);
@@ -267,6 +294,7 @@ struct fat_fs_struct* fat_open(struct partition_struct* partition)
 #endif
 
     memset(fs, 0, sizeof(*fs));
+    fat_invalidate_fat_cache(fs);
 
     fs->partition = partition;
     if(!fat_read_header(fs))
@@ -438,7 +466,7 @@ uint8_t fat_read_header(struct fat_fs_struct* fs)
  * \param[in] cluster_num The number of the cluster for which to determine its successor.
  * \returns The wanted cluster number, or 0 on error.
  */
-cluster_t fat_get_next_cluster(const struct fat_fs_struct* fs, cluster_t cluster_num)
+cluster_t fat_get_next_cluster(struct fat_fs_struct* fs, cluster_t cluster_num)
 {
     if(!fs || cluster_num < 2)
         return 0;
@@ -448,7 +476,7 @@ cluster_t fat_get_next_cluster(const struct fat_fs_struct* fs, cluster_t cluster
     {
         /* read appropriate fat entry */
         uint32_t fat_entry;
-        if(!fs->partition->device_read(fs->header.fat_offset + cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry)))
+        if(!fat_read_fat_entry(fs, fs->header.fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry)))
             return 0;
 
         /* determine next cluster from fat */
@@ -465,7 +493,7 @@ cluster_t fat_get_next_cluster(const struct fat_fs_struct* fs, cluster_t cluster
     {
         /* read appropriate fat entry */
         uint16_t fat_entry;
-        if(!fs->partition->device_read(fs->header.fat_offset + cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry)))
+        if(!fat_read_fat_entry(fs, fs->header.fat_offset + (offset_t) cluster_num * sizeof(fat_entry), (uint8_t*) &fat_entry, sizeof(fat_entry)))
             return 0;
 
         /* determine next cluster from fat */
@@ -481,6 +509,56 @@ cluster_t fat_get_next_cluster(const struct fat_fs_struct* fs, cluster_t cluster
     return cluster_num;
 }
 
+/**
+ * \ingroup fat_fs
+ * Reads an entry of the file allocation table.
+ *
+ * Entries are read through a cache holding a window of the table, which
+ * is filled without touching the device's block cache.  Walking a
+ * cluster chain so costs a device read per window rather than per
+ * cluster, and does not evict the file data being read.
+ *
+ * \param[in] fs The filesystem whose table to read.
+ * \param[in] offset The device offset of the entry.
+ * \param[out] entry The buffer into which to write the entry.
+ * \param[in] entry_size The size of the entry, 2 or 4 bytes.
+ * \returns 0 on failure, 1 on success.
+ */
+uint8_t fat_read_fat_entry(struct fat_fs_struct* fs, offset_t offset, uint8_t* entry, uint8_t entry_size)
+{
+#if FAT_CACHE_SIZE
+    offset_t window = offset & ~((offset_t) FAT_CACHE_SIZE - 1);
+    if(window != fs->fat_cache_offset)
+    {
+        if(!fat_read_table(window, fs->fat_cache, FAT_CACHE_SIZE))
+        {
+            fat_invalidate_fat_cache(fs);
+            return 0;
+        }
+        fs->fat_cache_offset = window;
+    }
+    memcpy(entry, fs->fat_cache + (uint16_t) (offset - window), entry_size);
+    return 1;
+#else
+    return fs->partition->device_read(offset, entry, entry_size);
+#endif
+}
+
+/**
+ * \ingroup fat_fs
+ * Drops the cached window of the file allocation table.
+ *
+ * Must be called before the table is written.
+ *
+ * \param[in] fs The filesystem whose cache to drop.
+ */
+void fat_invalidate_fat_cache(struct fat_fs_struct* fs)
+{
+#if FAT_CACHE_SIZE
+    fs->fat_cache_offset = (offset_t) -1;
+#endif
+}
+
 #if DOXYGEN || FAT_WRITE_SUPPORT
 /**
  * \ingroup fat_fs
@@ -488,6 +566,10 @@ cluster_t fat_get_next_cluster(const struct fat_fs_struct* fs, cluster_t cluster
  *
  * Set cluster_num to zero to create a completely new one.
  *
+ * The chain runs in ascending cluster order, and a chain of more than one
+ * cluster is placed in the first run of free clusters long enough to hold
+ * it if there is one, so that its data lies in consecutive blocks.
+ *
  * \param[in] fs The file system on which to operate.
  * \param[in] cluster_num The cluster to which to append the new chain.
  * \param[in] count The number of clusters to allocate.
@@ -503,7 +585,8 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
     offset_t fat_offset = fs->header.fat_offset;
     cluster_t count_left = count;
     cluster_t cluster_current = fs->cluster_free;
-    cluster_t cluster_next = 0;
+    cluster_t cluster_first = 0;
+    cluster_t cluster_prev = 0;
     cluster_t cluster_count;
     uint16_t fat_entry16;
 #if FAT_FAT32_SUPPORT
@@ -516,6 +599,15 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
 #endif
         cluster_count = fs->header.fat_size / sizeof(fat_entry16);
 
+    if(count > 1)
+    {
+        cluster_t cluster_run = fat_find_free_run(fs, cluster_current, count);
+        if(cluster_run)
+            cluster_current = cluster_run;
+    }
+
+    fat_invalidate_fat_cache(fs);
+
     fs->cluster_free = 0;
     for(cluster_t cluster_left = cluster_count; cluster_left > 0; --cluster_left, ++cluster_current)
     {
@@ -552,14 +644,19 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
                 break;
             }
 
-            /* allocate cluster */
-            if(cluster_next == 0)
-                fat_entry32 = HTOL32(FAT32_CLUSTER_LAST_MAX);
-            else
-                fat_entry32 = htol32(cluster_next);
-
+            /* allocate cluster as the end of the chain */
+            fat_entry32 = HTOL32(FAT32_CLUSTER_LAST_MAX);
             if(!device_write(fat_offset + cluster_current * sizeof(fat_entry32), (uint8_t*) &fat_entry32, sizeof(fat_entry32)))
                 break;
+
+            /* and link the previous end to it */
+            fat_entry32 = htol32(cluster_current);
+            if(cluster_prev &&
+               !device_write(fat_offset + cluster_prev * sizeof(fat_entry32), (uint8_t*) &fat_entry32, sizeof(fat_entry32)))
+            {
+                fat_free_clusters(fs, cluster_current);
+                break;
+            }
         }
         else
 #endif
@@ -578,17 +675,24 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
                 break;
             }
 
-            /* allocate cluster */
-            if(cluster_next == 0)
-                fat_entry16 = HTOL16(FAT16_CLUSTER_LAST_MAX);
-            else
-                fat_entry16 = htol16((uint16_t) cluster_next);
-
+            /* allocate cluster as the end of the chain */
+            fat_entry16 = HTOL16(FAT16_CLUSTER_LAST_MAX);
             if(!device_write(fat_offset + cluster_current * sizeof(fat_entry16), (uint8_t*) &fat_entry16, sizeof(fat_entry16)))
                 break;
+
+            /* and link the previous end to it */
+            fat_entry16 = htol16((uint16_t) cluster_current);
+            if(cluster_prev &&
+               !device_write(fat_offset + cluster_prev * sizeof(fat_entry16), (uint8_t*) &fat_entry16, sizeof(fat_entry16)))
+            {
+                fat_free_clusters(fs, cluster_current);
+                break;
+            }
         }
 
-        cluster_next = cluster_current;
+        if(!cluster_first)
+            cluster_first = cluster_current;
+        cluster_prev = cluster_current;
         --count_left;
     }
 
@@ -605,7 +709,7 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
 #if FAT_FAT32_SUPPORT
             if(is_fat32)
             {
-                fat_entry32 = htol32(cluster_next);
+                fat_entry32 = htol32(cluster_first);
 
                 if(!device_write(fat_offset + cluster_num * sizeof(fat_entry32), (uint8_t*) &fat_entry32, sizeof(fat_entry32)))
                     break;
@@ -613,21 +717,72 @@ cluster_t fat_append_clusters(struct fat_fs_struct* fs, cluster_t cluster_num, c
             else
 #endif
             {
-                fat_entry16 = htol16((uint16_t) cluster_next);
+                fat_entry16 = htol16((uint16_t) cluster_first);
 
                 if(!device_write(fat_offset + cluster_num * sizeof(fat_entry16), (uint8_t*) &fat_entry16, sizeof(fat_entry16)))
                     break;
             }
         }
 
-        return cluster_next;
+        return cluster_first;
 
     } while(0);
 
     /* No space left on device or writing error.
      * Free up all clusters already allocated.
      */
-    fat_free_clusters(fs, cluster_next);
+    fat_free_clusters(fs, cluster_first);
+
+    return 0;
+}
+#endif
+
+#if DOXYGEN || FAT_WRITE_SUPPORT
+/**
+ * \ingroup fat_fs
+ * Looks for a run of consecutive free clusters.
+ *
+ * \param[in] fs The file system on which to operate.
+ * \param[in] cluster_num The cluster from which to start looking.
+ * \param[in] count The length of the run wanted.
+ * \returns The first cluster of the first run found, or 0 if there is none.
+ */
+cluster_t fat_find_free_run(struct fat_fs_struct* fs, cluster_t cluster_num, cluster_t count)
+{
+    offset_t fat_offset = fs->header.fat_offset;
+    uint8_t entry_size = sizeof(uint16_t);
+#if FAT_FAT32_SUPPORT
+    if(fs->partition->type == PARTITION_TYPE_FAT32)
+        entry_size = sizeof(uint32_t);
+#endif
+    cluster_t cluster_count = fs->header.fat_size / entry_size;
+    cluster_t run_start = 0;
+    cluster_t run_length = 0;
+
+    for(cluster_t cluster_left = cluster_count; cluster_left > 0; --cluster_left, ++cluster_num)
+    {
+        if(cluster_num < 2 || cluster_num >= cluster_count)
+        {
+            /* a run does not wrap around the end of the table */
+            cluster_num = 2;
+            run_length = 0;
+        }
+
+        /* a free entry is zero whatever the byte order */
+        uint32_t entry = 0;
+        if(!fat_read_fat_entry(fs, fat_offset + (offset_t) cluster_num * entry_size, (uint8_t*) &entry, entry_size))
+            return 0;
+        if(entry)
+        {
+            run_length = 0;
+            continue;
+        }
+
+        if(run_length == 0)
+            run_start = cluster_num;
+        if(++run_length >= count)
+            return run_start;
+    }
 
     return 0;
 }
@@ -656,6 +811,8 @@ uint8_t fat_free_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
     if(!fs || cluster_num < 2)
         return 0;
 
+    fat_invalidate_fat_cache(fs);
+
     offset_t fat_offset = fs->header.fat_offset;
 #if FAT_FAT32_SUPPORT
     if(fs->partition->type == PARTITION_TYPE_FAT32)
@@ -756,6 +913,7 @@ uint8_t fat_terminate_clusters(struct fat_fs_struct* fs, cluster_t cluster_num)
 
     /* fetch next cluster before overwriting the cluster entry */
     cluster_t cluster_num_next = fat_get_next_cluster(fs, cluster_num);
+    fat_invalidate_fat_cache(fs);
 
     /* mark cluster as the last one */
 #if FAT_FAT32_SUPPORT
@@ -955,10 +1113,128 @@ struct fat_file_struct* fat_open_file(struct fat_fs_struct* fs, const struct fat
 #ifdef FAT_DELAY_DIRENTRY_UPDATE
 	fd->needs_write = 0;
 #endif
+#if FAT_EXTENT_COUNT
+    fat_map_file(fd);
+#endif
 
     return fd;
 }
 
+#if FAT_EXTENT_COUNT
+/**
+ * \ingroup fat_file
+ * Records the cluster chain of a file as runs of consecutive clusters.
+ *
+ * The chain is walked once, up to the first FAT_EXTENT_COUNT runs, so
+ * that later lookups of the cluster at a given file position need not
+ * read the FAT at all.
+ *
+ * \param[in] fd The file whose chain to record.
+ */
+void fat_map_file(struct fat_file_struct* fd)
+{
+    fd->extent_count = 0;
+    fd->extents_complete = 0;
+
+    cluster_t cluster_num = fd->dir_entry.cluster;
+    while(cluster_num)
+    {
+        fat_map_append(fd, cluster_num);
+        if(!fd->extents_complete)
+            return;
+        cluster_num = fat_get_next_cluster(fd->fs, cluster_num);
+    }
+    fd->extents_complete = 1;
+}
+
+/**
+ * \ingroup fat_file
+ * Adds a cluster to the end of the recorded chain of a file.
+ *
+ * If the cluster does not extend the last run and there is no room
+ * for another, the record is marked as incomplete.
+ *
+ * \param[in] fd The file whose record to extend.
+ * \param[in] cluster_num The cluster now following the end of the chain.
+ */
+void fat_map_append(struct fat_file_struct* fd, cluster_t cluster_num)
+{
+    if(fd->extent_count == 0)
+    {
+        fd->extents[0].cluster = cluster_num;
+        fd->extents[0].count = 1;
+        fd->extent_count = 1;
+        fd->extents_complete = 1;
+        return;
+    }
+    if(!fd->extents_complete)
+        return;
+
+    struct fat_extent_struct* extent = &fd->extents[fd->extent_count - 1];
+    if(extent->cluster + extent->count == cluster_num)
+    {
+        ++extent->count;
+    }
+    else if(fd->extent_count < FAT_EXTENT_COUNT)
+    {
+        ++extent;
+        extent->cluster = cluster_num;
+        extent->count = 1;
+        ++fd->extent_count;
+    }
+    else
+    {
+        fd->extents_complete = 0;
+    }
+}
+#endif
+
+/**
+ * \ingroup fat_file
+ * Finds the cluster holding a position within a file.
+ *
+ * Positions within the recorded runs are looked up directly.  Beyond
+ * them the FAT is followed, from \c cluster_prev if the caller knows
+ * the cluster before the wanted one, or else from the last recorded
+ * cluster.
+ *
+ * \param[in] fd The file in which to look.
+ * \param[in] pos The position within the file.
+ * \param[in] cluster_prev The cluster preceding the one wanted, or 0 if unknown.
+ * \returns The cluster number, or 0 if the chain ends before \c pos.
+ */
+cluster_t fat_file_cluster(struct fat_file_struct* fd, offset_t pos, cluster_t cluster_prev)
+{
+    uint32_t index = pos / fd->fs->header.cluster_size;
+    cluster_t cluster_num = fd->dir_entry.cluster;
+
+#if FAT_EXTENT_COUNT
+    const struct fat_extent_struct* extent = fd->extents;
+    for(uint8_t i = fd->extent_count; i > 0; --i, ++extent)
+    {
+        if(index < extent->count)
+            return extent->cluster + (cluster_t) index;
+        index -= extent->count;
+        cluster_num = extent->cluster + extent->count - 1;
+    }
+    if(fd->extents_complete)
+        return 0;
+    /* cluster_num is now the one before index 0 */
+    if(fd->extent_count)
+        ++index;
+#endif
+
+    if(cluster_prev)
+        return fat_get_next_cluster(fd->fs, cluster_prev);
+
+    while(index > 0 && cluster_num)
+    {
+        cluster_num = fat_get_next_cluster(fd->fs, cluster_num);
+        --index;
+    }
+    return cluster_num;
+}
+
 /**
  * \ingroup fat_file
  * Closes a file.
@@ -1016,9 +1292,7 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
     /* find cluster in which to start reading */
     if(!cluster_num)
     {
-        cluster_num = fd->dir_entry.cluster;
-        
-        if(!cluster_num)
+        if(!fd->dir_entry.cluster)
         {
             if(!fd->pos)
                 return 0;
@@ -1026,17 +1300,9 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
                 return -1;
         }
 
-        if(fd->pos)
-        {
-            uint32_t pos = fd->pos;
-            while(pos >= cluster_size)
-            {
-                pos -= cluster_size;
-                cluster_num = fat_get_next_cluster(fd->fs, cluster_num);
-                if(!cluster_num)
-                    return -1;
-            }
-        }
+        cluster_num = fat_file_cluster(fd, fd->pos, 0);
+        if(!cluster_num)
+            return -1;
     }
     
     /* read data */
@@ -1060,7 +1326,7 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
         if(first_cluster_offset + copy_length >= cluster_size)
         {
             /* we are on a cluster boundary, so get the next cluster */
-            if((cluster_num = fat_get_next_cluster(fd->fs, cluster_num)))
+            if((cluster_num = fat_file_cluster(fd, fd->pos, cluster_num)))
             {
                 first_cluster_offset = 0;
             }
@@ -1117,6 +1383,9 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
                 fd->dir_entry.cluster = cluster_num = fat_append_clusters(fd->fs, 0, 1);
                 if(!cluster_num)
                     return -1;
+#if FAT_EXTENT_COUNT
+                fat_map_append(fd, cluster_num);
+#endif
             }
             else
             {
@@ -1133,8 +1402,14 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
                 pos -= cluster_size;
                 cluster_num_next = fat_get_next_cluster(fd->fs, cluster_num);
                 if(!cluster_num_next && pos == 0)
+                {
                     /* the file exactly ends on a cluster boundary, and we append to it */
                     cluster_num_next = fat_append_clusters(fd->fs, cluster_num, 1);
+#if FAT_EXTENT_COUNT
+                    if(cluster_num_next)
+                        fat_map_append(fd, cluster_num_next);
+#endif
+                }
                 if(!cluster_num_next)
                     return -1;
 
@@ -1152,6 +1427,10 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
         if(write_length > buffer_left)
             write_length = buffer_left;
 
+        /* space past the end of the file holds nothing to merge with */
+        if(fd->pos >= fd->dir_entry.file_size)
+            fat_write_fresh(cluster_offset);
+
         /* write data which fits into the current cluster */
         if(!fd->fs->partition->device_write(cluster_offset, buffer, write_length))
             break;
@@ -1164,10 +1443,16 @@ intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintp
         if(first_cluster_offset + write_length >= cluster_size)
         {
             /* we are on a cluster boundary, so get the next cluster */
-            cluster_t cluster_num_next = fat_get_next_cluster(fd->fs, cluster_num);
+            cluster_t cluster_num_next = fat_file_cluster(fd, fd->pos, cluster_num);
             if(!cluster_num_next && buffer_left > 0)
+            {
                 /* we reached the last cluster, append a new one */
                 cluster_num_next = fat_append_clusters(fd->fs, cluster_num, 1);
+#if FAT_EXTENT_COUNT
+                if(cluster_num_next)
+                    fat_map_append(fd, cluster_num_next);
+#endif
+            }
             if(!cluster_num_next)
             {
                 fd->pos_cluster = 0;
@@ -1362,6 +1647,11 @@ uint8_t fat_resize_file(struct fat_file_struct* fd, uint32_t size)
 
     } while(0);
 
+#if FAT_EXTENT_COUNT
+    /* the chain may have grown or shrunk */
+    fat_map_file(fd);
+#endif
+
     /* correct file position */
     if(size < fd->pos)
     {
@@ -1373,6 +1663,66 @@ uint8_t fat_resize_file(struct fat_file_struct* fd, uint32_t size)
 }
 #endif
 
+#if DOXYGEN || FAT_WRITE_SUPPORT
+/**
+ * \ingroup fat_file
+ * Allocates space for a file to grow into, leaving its size alone.
+ *
+ * Clusters are added to the end of the file's chain until it can hold
+ * \c size bytes, in one run of consecutive clusters if there is room.
+ * Writing the file up to that size then needs no further allocation.
+ * Space left unused should be given back by fat_resize_file() once
+ * the final size is known.
+ *
+ * \param[in] fd The file decriptor of the file for which to allocate.
+ * \param[in] size The size the file is expected to grow to.
+ * \returns 0 on failure, 1 on success.
+ * \see fat_resize_file
+ */
+uint8_t fat_reserve_file(struct fat_file_struct* fd, uint32_t size)
+{
+    if(!fd)
+        return 0;
+
+    uint16_t cluster_size = fd->fs->header.cluster_size;
+    cluster_t count = (size + cluster_size - 1) / cluster_size;
+
+    /* skip the clusters the file has already */
+    cluster_t cluster_last = 0;
+    cluster_t cluster_num = fd->dir_entry.cluster;
+    while(cluster_num && count > 0)
+    {
+        cluster_last = cluster_num;
+        cluster_num = fat_get_next_cluster(fd->fs, cluster_num);
+        --count;
+    }
+    if(count == 0)
+        return 1;
+
+    cluster_num = fat_append_clusters(fd->fs, cluster_last, count);
+    if(!cluster_num)
+        return 0;
+
+    if(!cluster_last)
+    {
+        /* the file had no clusters yet */
+        fd->dir_entry.cluster = cluster_num;
+#if FAT_DELAY_DIRENTRY_UPDATE
+        fd->needs_write = 1;
+#else
+        if(!fat_write_dir_entry(fd->fs, &fd->dir_entry))
+            return 0;
+#endif
+    }
+
+#if FAT_EXTENT_COUNT
+    fat_map_file(fd);
+#endif
+
+    return 1;
+}
+#endif
+
 /**
  * \ingroup fat_dir
  * Opens a directory.
@@ -98,6 +98,7 @@ intptr_t fat_read_file(struct fat_file_struct* fd, uint8_t* buffer, uintptr_t bu
 intptr_t fat_write_file(struct fat_file_struct* fd, const uint8_t* buffer, uintptr_t buffer_len);
 uint8_t fat_seek_file(struct fat_file_struct* fd, int32_t* offset, uint8_t whence);
 uint8_t fat_resize_file(struct fat_file_struct* fd, uint32_t size);
+uint8_t fat_reserve_file(struct fat_file_struct* fd, uint32_t size);
 
 struct fat_dir_struct* fat_open_dir(struct fat_fs_struct* fs, const struct fat_dir_entry_struct* dir_entry);
 void fat_close_dir(struct fat_dir_struct* dd);
@@ -92,6 +92,54 @@ extern "C"
 /* forward declaration for the above */
 void get_datetime(uint16_t* year, uint8_t* month, uint8_t* day, uint8_t* hour, uint8_t* min, uint8_t* sec);
 
+/**
+ * \ingroup fat_config
+ * Size in bytes of the cache of the file allocation table.
+ *
+ * FAT entries are read through a window of this many bytes kept apart
+ * from the block cache of sd_raw.  Must be a power of two no larger
+ * than 512; set to 0 to read entries through the block cache.
+ */
+#define FAT_CACHE_SIZE 128
+
+/**
+ * \ingroup fat_config
+ * Reads a window of the file allocation table into the FAT cache.
+ *
+ * Define this to a device read which leaves the device's own block
+ * cache alone.
+ *
+ * \note Used only when FAT_CACHE_SIZE is not 0.
+ */
+#define fat_read_table(offset, buffer, length) \
+    sd_raw_read_uncached(offset, buffer, length)
+/* forward declaration for the above */
+uint8_t sd_raw_read_uncached(offset_t offset, uint8_t* buffer, uintptr_t length);
+
+/**
+ * \ingroup fat_config
+ * Tells the device that a write appends data past the end of a file.
+ *
+ * Define this to a call which lets the device's next write fill blocks
+ * from \c offset on without reading them in first, or to nothing.
+ */
+#define fat_write_fresh(offset) \
+    sd_raw_write_fresh(offset)
+/* forward declaration for the above */
+void sd_raw_write_fresh(offset_t offset);
+
+/**
+ * \ingroup fat_config
+ * Maximum number of runs of consecutive clusters recorded per open file.
+ *
+ * The cluster chain of a file is recorded when it is opened, so that
+ * the cluster holding any position within it can be found without
+ * reading the FAT.  Each run takes 4 bytes per file handle (8 with
+ * FAT32); files in more runs than this fall back to walking the FAT
+ * beyond the last recorded run.  Set to 0 to disable.
+ */
+#define FAT_EXTENT_COUNT 16
+
 /**
  * \ingroup fat_config
  * Maximum number of filesystem handles.
@@ -10,6 +10,7 @@
 
 #include <string.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include "sd_raw.h"
 #include "avr/delay.h"
 #include "Configuration.hh"
@@ -151,9 +152,6 @@
 #if !SD_RAW_SAVE_RAM
 /* static data buffer for acceleration */
 static uint8_t raw_block[512];
-#ifdef STABILITY_MODE
-static uint8_t stability_block[512];
-#endif
 /* offset where the data within raw_block lies on the card */
 static offset_t raw_block_address;
 #if SD_RAW_WRITE_BUFFERING
@@ -165,10 +163,78 @@ static uint8_t raw_block_written;
 /* card type state */
 static uint8_t sd_raw_card_type;
 
+/* kinds of open stream */
+#define STREAM_CLOSED 0
+#define STREAM_READ 1
+#define STREAM_WRITE 2
+
+/* streaming transfer state */
+static uint8_t stream_enabled;
+/* multiple block transfer holding the card addressed, if any */
+static uint8_t stream_open;
+/* block following the last one of the current or last stream */
+static offset_t stream_address;
+/* block read most recently */
+static offset_t last_read_address;
+#if SD_RAW_WRITE_SUPPORT
+/* first block of the next write which need not be read in first */
+static offset_t fresh_address = (offset_t) -1;
+#endif
+
+#if SD_RAW_VERIFY_CRC
+/* CRC16-CCITT (polynomial 0x1021) of each byte value, for data blocks */
+static const uint16_t crc16_table[256] PROGMEM = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+    0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+    0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+    0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+    0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+    0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+    0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+    0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+    0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+    0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+    0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+    0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+    0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+    0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+    0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+    0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+    0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+    0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+    0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+    0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+    0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+    0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+};
+
+#define crc16_update(crc, b) \
+    (((crc) << 8) ^ pgm_read_word(&crc16_table[(uint8_t) ((crc) >> 8) ^ (b)]))
+#endif
+
 /* private helper functions */
 static void sd_raw_send_byte(uint8_t b);
 static uint8_t sd_raw_rec_byte();
 static uint8_t sd_raw_send_command(uint8_t command, uint32_t arg);
+static void sd_raw_send_command_frame(uint8_t command, uint32_t arg);
+static uint8_t sd_raw_receive_block(uint8_t* buffer, uint16_t block_offset, uint16_t length, uint8_t compare);
+static uint8_t sd_raw_read_block(offset_t block_address, uint16_t block_offset, uint8_t* buffer, uint16_t length);
+static uint8_t sd_raw_read_block_once(offset_t block_address, uint16_t block_offset, uint8_t* buffer, uint16_t length);
+#if SD_RAW_WRITE_SUPPORT
+static uint8_t sd_raw_write_block(offset_t block_address);
+#endif
+static void sd_raw_negotiate_clock();
+static uint8_t sd_raw_wait_ready();
 
 /**
  * \ingroup sd_raw
@@ -203,6 +269,11 @@ uint8_t sd_raw_init()
 
     /* initialization procedure */
     sd_raw_card_type = 0;
+
+    /* a reset card has no stream open */
+    stream_open = STREAM_CLOSED;
+    stream_address = (offset_t) -1;
+    last_read_address = (offset_t) -1;
     
     if(!sd_raw_available())
         return 0;
@@ -309,7 +380,15 @@ uint8_t sd_raw_init()
         sd_raw_rec_byte();
     }
 #endif
-	
+
+#if SD_RAW_VERIFY_CRC
+    /* have the card check the crc of commands and written blocks */
+    if(sd_raw_send_command(CMD_CRC_ON_OFF, 1))
+    {
+        unselect_card();
+        return 0;
+    }
+#endif
 
     /* set block size to 512 bytes */
     if(sd_raw_send_command(CMD_SET_BLOCKLEN, 512))
@@ -336,11 +415,62 @@ uint8_t sd_raw_init()
     if(!sd_raw_read(0, raw_block, sizeof(raw_block))){
         return 0;
 	}
+
+    /* now that we have a known block, find the fastest clock the card reads it back at */
+    sd_raw_negotiate_clock();
 #endif
 
     return 1;
 }
 
+#if !SD_RAW_SAVE_RAM
+/* SPI clock settings to try, fastest first: SPCR clock rate bits and SPSR SPI2X bit */
+static const uint8_t spi_clock_settings[][2] = {
+    { 0,           (1 << SPI2X) }, /* f_OSC / 2 */
+    { 0,           0            }, /* f_OSC / 4 */
+    { (1 << SPR0), (1 << SPI2X) }  /* f_OSC / 8 */
+};
+
+/* number of times a block must read back correctly to accept a clock setting */
+#define SPI_CLOCK_VERIFY_READS 4
+
+/**
+ * \ingroup sd_raw
+ * Switches to the fastest SPI clock the card can be read at reliably.
+ *
+ * Every card supports at least 20MHz, faster than any rate we can
+ * generate, so the limit is the signal quality of the connection.
+ * Each rate is tried by reading block 0, which is in raw_block,
+ * back a few times.  If none verifies, the clock stays at f_OSC / 16.
+ */
+void sd_raw_negotiate_clock()
+{
+    for(uint8_t setting = 0; setting < sizeof(spi_clock_settings) / sizeof(spi_clock_settings[0]); ++setting)
+    {
+        SPCR = (SPCR & ~((1 << SPR1) | (1 << SPR0))) | spi_clock_settings[setting][0];
+        SPSR = (SPSR & ~(1 << SPI2X)) | spi_clock_settings[setting][1];
+
+        uint8_t verified = 1;
+        for(uint8_t i = 0; i < SPI_CLOCK_VERIFY_READS && verified; ++i)
+        {
+            select_card();
+            if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, 0) ||
+               !sd_raw_receive_block(raw_block, 0, 512, 1))
+                verified = 0;
+            unselect_card();
+            sd_raw_rec_byte();
+        }
+        if(verified)
+            return;
+    }
+
+    /* fall back to the rate we started with */
+    SPCR |= (1 << SPR0);
+    SPCR &= ~(1 << SPR1); /* Clock Frequency: f_OSC / 16 */
+    SPSR &= ~(1 << SPI2X); /* Do not Double Clock Frequency */
+}
+#endif
+
 /**
  * \ingroup sd_raw
  * Checks wether a memory card is located in the slot.
@@ -425,24 +555,8 @@ uint8_t sd_raw_send_command(uint8_t command, uint32_t arg)
     sd_raw_rec_byte();
 
     /* send command via SPI */
-    sd_raw_send_byte(0x40 | command);
-    sd_raw_send_byte((arg >> 24) & 0xff);
-    sd_raw_send_byte((arg >> 16) & 0xff);
-    sd_raw_send_byte((arg >> 8) & 0xff);
-    sd_raw_send_byte((arg >> 0) & 0xff);
-    switch(command)
-    {
-        case CMD_GO_IDLE_STATE:
-           sd_raw_send_byte(0x95);
-           break;
-        case CMD_SEND_IF_COND:
-           sd_raw_send_byte(0x87);
-           break;
-        default:
-           sd_raw_send_byte(0xff);
-           break;
-    }
-    
+    sd_raw_send_command_frame(command, arg);
+
     /* receive response */
     for(uint8_t i = 0; i < 10; ++i)
     {
@@ -455,72 +569,305 @@ uint8_t sd_raw_send_command(uint8_t command, uint32_t arg)
 }
 
 /**
- * \ingroup sd_raw_read_block
- * Reads block of raw data from the card.
+ * \ingroup sd_raw
+ * Sends the six bytes of a command, with its crc7.
+ *
+ * The crc is needed for CMD0 and CMD8 always, and for every command
+ * once crc checking is turned on with CMD59.
+ *
+ * \param[in] command The command to send.
+ * \param[in] arg The argument for command.
+ */
+void sd_raw_send_command_frame(uint8_t command, uint32_t arg)
+{
+    uint8_t frame[5];
+    frame[0] = 0x40 | command;
+    frame[1] = (arg >> 24) & 0xff;
+    frame[2] = (arg >> 16) & 0xff;
+    frame[3] = (arg >> 8) & 0xff;
+    frame[4] = (arg >> 0) & 0xff;
+
+    uint8_t crc = 0;
+    for(uint8_t i = 0; i < sizeof(frame); ++i)
+    {
+        uint8_t b = frame[i];
+        sd_raw_send_byte(b);
+        for(uint8_t bit = 0; bit < 8; ++bit)
+        {
+            crc <<= 1;
+            if((b ^ crc) & 0x80)
+                crc ^= 0x09;
+            b <<= 1;
+        }
+    }
+    sd_raw_send_byte((crc << 1) | 1);
+}
+
+/**
+ * \ingroup sd_raw
+ * Receives one data block from the card, after a read command.
+ *
+ * Waits for the start token, then clocks in the 512 bytes of the
+ * block and the trailing crc16.  Only the \c length bytes from
+ * \c block_offset on are kept; the rest are clocked in and dropped.
+ *
+ * With SD_RAW_VERIFY_CRC, the crc16 of the block is computed while
+ * the next byte is being clocked in, and checked against the card's.
+ *
+ * \param[out] buffer The buffer into which to write the data, or the data to compare against.
+ * \param[in] block_offset The offset within the block of the first byte to keep.
+ * \param[in] length The number of bytes to keep.
+ * \param[in] compare If set, the data is compared with \c buffer instead of stored.
+ * \returns 0 on failure, crc error or mismatch, 1 on success.
+ */
+uint8_t sd_raw_receive_block(uint8_t* buffer, uint16_t block_offset, uint16_t length, uint8_t compare)
+{
+    uint16_t tries = 0;
+    uint8_t token;
+
+    /* wait for data block (start byte 0xfe) */
+    while((token = sd_raw_rec_byte()) == 0xff){
+        if(tries >= 0x7FFF)
+            return 0;
+        tries++;
+    }
+    /* anything else is an error token */
+    if(token != 0xfe)
+        return 0;
+
+    uint8_t match = 1;
+    uint16_t read_to = block_offset + length;
+#if SD_RAW_VERIFY_CRC
+    uint16_t crc = 0;
+#endif
+
+    /* each byte is handled while the next one is on its way */
+    SPDR = 0xff;
+    for(uint16_t i = 0; i < 512; ++i)
+    {
+        while(!(SPSR & (1 << SPIF)));
+        uint8_t b = SPDR;
+        SPDR = 0xff;
+
+#if SD_RAW_VERIFY_CRC
+        crc = crc16_update(crc, b);
+#endif
+        if(i < block_offset || i >= read_to)
+            continue;
+        if(!compare)
+            *buffer = b;
+        else if(b != *buffer)
+            match = 0;
+        ++buffer;
+    }
+
+    /* read crc16, the first byte of which is already in */
+    while(!(SPSR & (1 << SPIF)));
+    uint16_t block_crc = (uint16_t) SPDR << 8;
+    SPSR &= ~(1 << SPIF);
+    block_crc |= sd_raw_rec_byte();
+
+#if SD_RAW_VERIFY_CRC
+    if(block_crc != crc)
+        return 0;
+#else
+    (void) block_crc;
+#endif
+
+    return match;
+}
+
+/**
+ * \ingroup sd_raw
+ * Ends a multiple block transfer, if one is open.
+ *
+ * The card keeps sending blocks of a read until told to stop, so CMD12
+ * is sent while data is still being clocked in; the card answers
+ * after one stuff byte and may then signal busy for a while.  A write
+ * is ended with a stop token once the card has taken the last block,
+ * after which the card is busy until everything is programmed.
+ */
+void sd_raw_stream_stop()
+{
+    if(stream_open == STREAM_CLOSED)
+        return;
+
+#if SD_RAW_WRITE_SUPPORT
+    if(stream_open == STREAM_WRITE)
+    {
+        stream_open = STREAM_CLOSED;
+        sd_raw_wait_ready();
+
+        /* send stop token */
+        sd_raw_send_byte(0xfd);
+    }
+    else
+#endif
+    {
+        stream_open = STREAM_CLOSED;
+        sd_raw_send_command_frame(CMD_STOP_TRANSMISSION, 0);
+
+        /* skip stuff byte */
+        sd_raw_rec_byte();
+
+        /* receive response */
+        for(uint8_t i = 0; i < 10; ++i)
+        {
+            if(sd_raw_rec_byte() != 0xff)
+                break;
+        }
+    }
+
+    /* skip stuff byte and wait while card is busy */
+    sd_raw_rec_byte();
+    sd_raw_wait_ready();
+
+    /* deaddress card */
+    unselect_card();
+
+    /* let card some time to finish */
+    sd_raw_rec_byte();
+}
+
+/**
+ * \ingroup sd_raw
+ * Waits while the card signals busy.
+ *
+ * \returns 0 if the card stayed busy too long, 1 once it is ready.
+ */
+uint8_t sd_raw_wait_ready()
+{
+    uint16_t tries = 0;
+    while(sd_raw_rec_byte() != 0xff){
+        if(tries >= 0x7FFF)
+            return 0;
+        tries++;
+    }
+    return 1;
+}
+
+/**
+ * \ingroup sd_raw
+ * Enables or disables streaming transfers.
+ *
+ * While enabled, a read of the block following the previous one
+ * opens a multiple block read (CMD18) which is kept open for as
+ * long as reads stay sequential, so each further block costs no
+ * command round trip.  Likewise blocks written are sent in a
+ * multiple block write (CMD25) for as long as they follow on from
+ * one another, which also lets the card program them as a run.
+ * Any other card access closes the stream.  Disabling closes an
+ * open stream.
+ *
+ * \param[in] enable 1 to enable streaming, 0 to disable it.
+ */
+void sd_raw_stream_enable(uint8_t enable)
+{
+    stream_enabled = enable;
+    if(!enable)
+        sd_raw_stream_stop();
+}
+
+/**
+ * \ingroup sd_raw
+ * Reads a block of raw data from the card.
+ *
+ * A block which fails to arrive intact, which with SD_RAW_VERIFY_CRC
+ * includes one failing its crc check, is read again up to
+ * SD_RAW_READ_RETRIES times.
  *
  * \param[in] block_address the address of the block to read
- * \param[in] block_offset The offset from which to read.
- * \param[out] raw_buffer The buffer into which to write the data.
- * \param[in] read_length The number of bytes to read.
+ * \param[in] block_offset The offset within the block from which to read.
+ * \param[out] buffer The buffer into which to write the data.
+ * \param[in] length The number of bytes to read.
  * \returns 0 on failure, 1 on success.
- * \see sd_raw_read_interval, sd_raw_write, sd_raw_write_interval
+ * \see sd_raw_read, sd_raw_read_uncached
  */
-uint8_t sd_raw_read_block(offset_t block_address, offset_t block_offset, uint8_t* raw_buffer, uintptr_t read_length) {
+uint8_t sd_raw_read_block(offset_t block_address, uint16_t block_offset, uint8_t* buffer, uint16_t length)
+{
+    for(uint8_t tries = 0; ; ++tries)
+    {
+        if(sd_raw_read_block_once(block_address, block_offset, buffer, length))
+            return 1;
+        if(tries >= SD_RAW_READ_RETRIES)
+            return 0;
+    }
+}
 
+/**
+ * \ingroup sd_raw
+ * Makes one attempt at reading a block of raw data from the card.
+ *
+ * \param[in] block_address the address of the block to read
+ * \param[in] block_offset The offset within the block from which to read.
+ * \param[out] buffer The buffer into which to write the data.
+ * \param[in] length The number of bytes to read.
+ * \returns 0 on failure, 1 on success.
+ * \see sd_raw_read_block
+ */
+uint8_t sd_raw_read_block_once(offset_t block_address, uint16_t block_offset, uint8_t* buffer, uint16_t length) {
 
+            /* the next block of an open stream is already on its way */
+            if(stream_open == STREAM_READ && block_address == stream_address)
+            {
+                if(!sd_raw_receive_block(buffer, block_offset, length, 0))
+                {
+                    sd_raw_stream_stop();
+                    return 0;
+                }
+                stream_address += 512;
+                last_read_address = block_address;
+                return 1;
+            }
 #if SD_RAW_WRITE_BUFFERING
             if(!sd_raw_sync())
                 return 0;
 #endif
 
+            /* closes a read stream, or the write stream the sync used */
+            sd_raw_stream_stop();
+
+            /* reads that continue on from the last one are likely to go on */
+            uint8_t stream = stream_enabled &&
+                             (block_address == last_read_address + 512 || block_address == stream_address);
+            last_read_address = block_address;
+
             /* address card */
             select_card();
-           
 
-            /* send single block request */
+            /* send single or multiple block request */
+            uint8_t command = stream ? CMD_READ_MULTIPLE_BLOCK : CMD_READ_SINGLE_BLOCK;
 #if SD_RAW_SDHC
-            if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+            if(sd_raw_send_command(command, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
 #else
-            if(sd_raw_send_command(CMD_READ_SINGLE_BLOCK, block_address))
+            if(sd_raw_send_command(command, block_address))
 #endif
             {
                 unselect_card();
                 return 0;
             }
-            
-            uint16_t tries = 0;
 
-            /* wait for data block (start byte 0xfe) */
-            while((sd_raw_rec_byte() != 0xfe)){
-				if(tries >= 0x7FFF){
-					unselect_card();
-					return 0;
-				}
-				tries++;
-			}
-            
+            if(stream)
+            {
+                stream_open = STREAM_READ;
+                stream_address = block_address + 512;
+            }
 
-#if SD_RAW_SAVE_RAM
-            /* read byte block */
-            uint16_t read_to = block_offset + read_length;
-            for(uint16_t i = 0; i < 512; ++i)
+            if(!sd_raw_receive_block(buffer, block_offset, length, 0))
             {
-                uint8_t b = sd_raw_rec_byte();
-                if(i >= block_offset && i < read_to)
-                    *buffer++ = b;
+                if(stream)
+                {
+                    sd_raw_stream_stop();
+                    return 0;
+                }
+                unselect_card();
+                return 0;
             }
-#else
-            /* read byte block */
-          //  uint8_t* cache = raw_block;
-            uint8_t* cache = raw_buffer;
-            for(uint16_t i = 0; i < 512; ++i)
-                *cache++ = sd_raw_rec_byte();
-#endif
-      
-            /* read crc16 */
-            sd_raw_rec_byte();
-            sd_raw_rec_byte();
-            
+
+            /* a stream keeps the card addressed */
+            if(stream)
+                return 1;
+
             /* deaddress card */
             unselect_card();
 
@@ -560,30 +907,12 @@ uint8_t sd_raw_read(offset_t offset, uint8_t* buffer, uintptr_t length)
         /* check if the requested data is cached */
         if(block_address != raw_block_address){
 #endif
-			bool read_fail = true;
-			/// we quit out of the while loop if we have two read fails in a row
-			while(read_fail){
-				read_fail = false;
-				if(!sd_raw_read_block(block_address, block_offset, raw_block, read_length)){
-					return 0;
-				}
-	#ifdef STABILITY_MODE
-				if (!sd_raw_read_block(block_address, block_offset, stability_block, read_length)){
-					return 0;
-				}
-				
-				for (int16_t i = 0; i < 512; i++){
-					if(stability_block[i] != raw_block[i]){
-						/// if this is the second read fail, report an error
-						if(read_fail){
-							return 0;
-						}else{
-							read_fail = true;
-							break;
-						}
-					}
-				}
+			if(!sd_raw_read_block(block_address, 0, raw_block, 512)){
+#if !SD_RAW_SAVE_RAM
+				/* what is left in raw_block is not the cached block any more */
+				raw_block_address = (offset_t) -1;
 #endif
+				return 0;
 			}
 
 #if !SD_RAW_SAVE_RAM
@@ -605,6 +934,51 @@ uint8_t sd_raw_read(offset_t offset, uint8_t* buffer, uintptr_t length)
     return 1;
 }
 
+/**
+ * \ingroup sd_raw
+ * Reads raw data from the card, leaving the block cache alone.
+ *
+ * Data in the cached block is taken from the cache; anything else is
+ * read from the card directly into \c buffer.  This is for small
+ * lookups, like FAT entries, made in between reads of a larger piece
+ * of data which would otherwise evict that data's block each time.
+ *
+ * \param[in] offset The offset from which to read.
+ * \param[out] buffer The buffer into which to write the data.
+ * \param[in] length The number of bytes to read.
+ * \returns 0 on failure, 1 on success.
+ * \see sd_raw_read
+ */
+uint8_t sd_raw_read_uncached(offset_t offset, uint8_t* buffer, uintptr_t length)
+{
+    offset_t block_address;
+    uint16_t block_offset;
+    uint16_t read_length;
+    while(length > 0)
+    {
+        /* determine byte count to read at once */
+        block_offset = offset & 0x01ff;
+        block_address = offset - block_offset;
+        read_length = 512 - block_offset; /* read up to block border */
+        if(read_length > length)
+            read_length = length;
+
+#if !SD_RAW_SAVE_RAM
+        if(block_address == raw_block_address)
+            memcpy(buffer, raw_block + block_offset, read_length);
+        else
+#endif
+        if(!sd_raw_read_block(block_address, block_offset, buffer, read_length))
+            return 0;
+
+        buffer += read_length;
+        length -= read_length;
+        offset += read_length;
+    }
+
+    return 1;
+}
+
 /**
  * \ingroup sd_raw
  * Continuously reads units of \c interval bytes and calls a callback function.
@@ -756,6 +1130,14 @@ uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length)
     if(sd_raw_locked())
         return 0;
 
+    /* a stream would be read into raw_block over data waiting to be written */
+    if(stream_open == STREAM_READ)
+        sd_raw_stream_stop();
+
+    /* blocks from here on to the end of this write are not read in */
+    offset_t fresh = fresh_address;
+    fresh_address = (offset_t) -1;
+
     offset_t block_address;
     uint16_t block_offset;
     uint16_t write_length;
@@ -778,7 +1160,13 @@ uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length)
                 return 0;
 #endif
 
-            if(block_offset || write_length < 512)
+            if(block_address >= fresh)
+            {
+                /* nothing in the block is worth keeping */
+                if(write_length < 512)
+                    memset(raw_block, 0, sizeof(raw_block));
+            }
+            else if(block_offset || write_length < 512)
             {
                 if(!sd_raw_read(block_address, raw_block, sizeof(raw_block)))
                     return 0;
@@ -798,57 +1186,132 @@ uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length)
 #endif
         }
 
+        /* a block the card receives corrupted is sent again */
+        for(uint8_t attempt = 0; ; ++attempt)
+        {
+            uint8_t status = sd_raw_write_block(block_address);
+            if(status == DR_STATUS_ACCEPTED)
+                break;
+            if(status != DR_STATUS_CRC_ERR || attempt >= SD_RAW_READ_RETRIES)
+                return 0;
+        }
+
+        buffer += write_length;
+        offset += write_length;
+        length -= write_length;
+
+#if SD_RAW_WRITE_BUFFERING
+        raw_block_written = 1;
+#endif
+    }
+
+    return 1;
+}
+#endif
+
+#if DOXYGEN || SD_RAW_WRITE_SUPPORT
+/**
+ * \ingroup sd_raw
+ * Writes the content of raw_block to a block of the card.
+ *
+ * With streaming enabled the block is sent as part of a multiple block
+ * write, which is left open with the card programming the block; the
+ * card is waited for when the next block is sent or the stream closed.
+ *
+ * \param[in] block_address The address of the block to write.
+ * \returns DR_STATUS_ACCEPTED on success, DR_STATUS_CRC_ERR if the card
+ *          received the block corrupted, 0 on any other failure.
+ */
+uint8_t sd_raw_write_block(offset_t block_address)
+{
+    if(stream_open == STREAM_WRITE && block_address == stream_address)
+    {
+        /* the card must be done with the previous block */
+        if(!sd_raw_wait_ready())
+        {
+            stream_open = STREAM_CLOSED;
+            unselect_card();
+            return 0;
+        }
+    }
+    else
+    {
+        sd_raw_stream_stop();
+
         /* address card */
         select_card();
 
-        /* send single block request */
+        /* send single or multiple block request */
+        uint8_t command = stream_enabled ? CMD_WRITE_MULTIPLE_BLOCK : CMD_WRITE_SINGLE_BLOCK;
 #if SD_RAW_SDHC
-        if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
+        if(sd_raw_send_command(command, (sd_raw_card_type & (1 << SD_RAW_SPEC_SDHC) ? block_address / 512 : block_address)))
 #else
-        if(sd_raw_send_command(CMD_WRITE_SINGLE_BLOCK, block_address))
+        if(sd_raw_send_command(command, block_address))
 #endif
         {
             unselect_card();
             return 0;
         }
 
-        /* send start byte */
-        sd_raw_send_byte(0xfe);
+        if(stream_enabled)
+            stream_open = STREAM_WRITE;
+    }
+
+    /* send start byte */
+    sd_raw_send_byte(stream_open == STREAM_WRITE ? 0xfc : 0xfe);
 
-        /* write byte block */
-        uint8_t* cache = raw_block;
-        for(uint16_t i = 0; i < 512; ++i)
-            sd_raw_send_byte(*cache++);
+    /* write byte block */
+    uint8_t* cache = raw_block;
+#if SD_RAW_VERIFY_CRC
+    uint16_t crc = 0;
+    for(uint16_t i = 0; i < 512; ++i)
+    {
+        uint8_t b = *cache++;
+        sd_raw_send_byte(b);
+        crc = crc16_update(crc, b);
+    }
 
-        /* write dummy crc16 */
-        sd_raw_send_byte(0xff);
-        sd_raw_send_byte(0xff);
+    /* write crc16 */
+    sd_raw_send_byte(crc >> 8);
+    sd_raw_send_byte(crc & 0xff);
+#else
+    for(uint16_t i = 0; i < 512; ++i)
+        sd_raw_send_byte(*cache++);
 
-		uint16_t tries = 0;
-		
-        /* wait while card is busy */
-        while(sd_raw_rec_byte() != 0xff){
-			if(tries >= 0x7FFF){
-				unselect_card();
-				return 0;
-			}
-			tries++;
-		 }
-        sd_raw_rec_byte();
+    /* write dummy crc16 */
+    sd_raw_send_byte(0xff);
+    sd_raw_send_byte(0xff);
+#endif
 
-        /* deaddress card */
-        unselect_card();
+    /* the card answers with a data response token, xxx0sss1 */
+    uint8_t status = sd_raw_rec_byte() & DR_STATUS_MASK;
+    if(status == (DR_STATUS_ACCEPTED & DR_STATUS_MASK))
+        status = DR_STATUS_ACCEPTED;
+    else if(status != DR_STATUS_CRC_ERR)
+        status = 0;
 
-        buffer += write_length;
-        offset += write_length;
-        length -= write_length;
+    if(stream_open == STREAM_WRITE)
+    {
+        /* a rejected block ends the stream; a retry starts a new one */
+        if(status == DR_STATUS_ACCEPTED)
+            stream_address = block_address + 512;
+        else
+            sd_raw_stream_stop();
+        return status;
+    }
 
-#if SD_RAW_WRITE_BUFFERING
-        raw_block_written = 1;
-#endif
+    /* wait while card is busy */
+    if(!sd_raw_wait_ready())
+    {
+        unselect_card();
+        return 0;
     }
+    sd_raw_rec_byte();
 
-    return 1;
+    /* deaddress card */
+    unselect_card();
+
+    return status;
 }
 #endif
 
@@ -929,6 +1392,26 @@ uint8_t sd_raw_sync()
 }
 #endif
 
+#if DOXYGEN || SD_RAW_WRITE_SUPPORT
+/**
+ * \ingroup sd_raw
+ * Marks the space the next write goes to as holding nothing of value.
+ *
+ * Blocks of the next call to sd_raw_write() which start at or after
+ * \c offset are filled from scratch rather than read in first and
+ * merged with the data written.  This suits data appended past the end
+ * of a file, and saves a block read each time such data crosses into
+ * a new block.
+ *
+ * \param[in] offset The offset from which on the next write may discard.
+ * \see sd_raw_write
+ */
+void sd_raw_write_fresh(offset_t offset)
+{
+    fresh_address = offset;
+}
+#endif
+
 /**
  * \ingroup sd_raw
  * Reads informational data from the card.
@@ -951,6 +1434,7 @@ uint8_t sd_raw_get_info(struct sd_raw_info* info)
 
     memset(info, 0, sizeof(*info));
 
+    sd_raw_stream_stop();
     select_card();
 
     /* read cid register */
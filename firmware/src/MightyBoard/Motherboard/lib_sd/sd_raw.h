@@ -131,10 +131,15 @@ uint8_t sd_raw_available();
 uint8_t sd_raw_locked();
 
 uint8_t sd_raw_read(offset_t offset, uint8_t* buffer, uintptr_t length);
+uint8_t sd_raw_read_uncached(offset_t offset, uint8_t* buffer, uintptr_t length);
 uint8_t sd_raw_read_interval(offset_t offset, uint8_t* buffer, uintptr_t interval, uintptr_t length, sd_raw_read_interval_handler_t callback, void* p);
 uint8_t sd_raw_write(offset_t offset, const uint8_t* buffer, uintptr_t length);
 uint8_t sd_raw_write_interval(offset_t offset, uint8_t* buffer, uintptr_t length, sd_raw_write_interval_handler_t callback, void* p);
 uint8_t sd_raw_sync();
+void sd_raw_write_fresh(offset_t offset);
+
+void sd_raw_stream_enable(uint8_t enable);
+void sd_raw_stream_stop();
 
 uint8_t sd_raw_get_info(struct sd_raw_info* info);
 
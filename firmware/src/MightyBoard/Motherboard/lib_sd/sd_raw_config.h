@@ -71,6 +71,23 @@ extern "C"
  */
 #define SD_RAW_SDHC 0
 
+/**
+ * \ingroup sd_raw_config
+ * Controls crc checking of transfers to and from the card.
+ *
+ * Set to 1 to check the crc16 of each block read and read it again if
+ * it arrived corrupted, and to have the card check the crc of commands
+ * and of blocks written (CMD59).  The crc is computed while the block
+ * is clocked in, so this costs no read bandwidth.
+ */
+#define SD_RAW_VERIFY_CRC 1
+
+/**
+ * \ingroup sd_raw_config
+ * Number of times a block that failed to transfer is tried again.
+ */
+#define SD_RAW_READ_RETRIES 3
+
 /**
  * @}
  */
@@ -129,11 +146,6 @@ extern "C"
     typedef uint32_t offset_t;
 #endif
 
-/// we define a stable mode that will read each block twice and check that they are the same
-/// this is to avoid intermittent read errors (which are expected very rarely, but not never)
-/// WARNING: STABILITY_MODE requires a 512 byte array, which gets us into dangerous territory in SRAM usage
-//#define STABILITY_MODE
-
 /* configuration checks */
 #if SD_RAW_WRITE_SUPPORT
 #undef SD_RAW_SAVE_RAM
@@ -21,9 +21,21 @@
 #include <util/atomic.h>
 
 
-volatile int16_t* adc_destination; //< Address to write the sampled data to
+/// Per-channel state for the ADC scheduler.  The ISR writes each new result
+/// into the buffer that is not currently published, then bumps the sequence
+/// number, so a reader that sees the same sequence number before and after
+/// reading a sample knows that sample was not torn.
+struct AnalogChannel {
+        uint8_t pin;                    ///< Analog input number
+        volatile uint8_t sequence;      ///< Incremented after every conversion
+        volatile int16_t samples[2];    ///< Published sample is samples[sequence & 1]
+};
 
-volatile bool* adc_finished; //< Flag to set once the data is sampled
+AnalogChannel adc_channels[ANALOG_CHANNEL_COUNT];
+
+uint8_t adc_channel_count = 0; //< Number of registered channels
+
+volatile uint8_t adc_current = 0; //< Channel currently being converted
 
 #if defined (__AVR_ATmega168__) || defined (__AVR_ATmega328__)
 
@@ -31,56 +43,19 @@ volatile bool* adc_finished; //< Flag to set once the data is sampled
     // to ground on the AREF pin.
     const uint8_t ANALOG_REF = 0x01;
 
-    void initAnalogPin(uint8_t pin) {
+    inline void configureAnalogPin(uint8_t pin) {
             // Only analog pins 0-5 need to be initialized, 6 and 7 are dedicated purpose.
             if (pin < 6) {
                     DDRC &= ~(_BV(pin));
                     PORTC &= ~(_BV(pin));
             }
-
-            // enable a2d conversions, interrupt on completion
-            ADCSRA |= _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0) |
-                            _BV(ADEN) | _BV(ADIE);
-    }
-
-    bool startAnalogRead(uint8_t pin,
-                         volatile int16_t* destination,
-                         volatile bool* finished) {
-            // ADSC is cleared when the conversion finishes.
-            // We should not start a new read while an existing one is in progress.
-            if ((ADCSRA & _BV(ADSC)) != 0) {
-                    return false;
-            }
-            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-                    adc_destination = destination;
-                    adc_finished = finished;
-                    *adc_finished = false;
-
-                    // set the analog reference (high two bits of ADMUX) and select the
-                    // channel (low 4 bits).  this also sets ADLAR (left-adjust result)
-                    // to 0 (the default).
-                    ADMUX = (ANALOG_REF << 6) | (pin & 0x0f);
-
-                    // start the conversion.
-                    ADCSRA |= _BV(ADSC);
-            }
-            // An interrupt will signal conversion completion.
-            return true;
     }
 
-    ISR(ADC_vect)
-    {
-            uint8_t low_byte, high_byte;
-            // we have to read ADCL first; doing so locks both ADCL
-            // and ADCH until ADCH is read.  reading ADCL second would
-            // cause the results of each conversion to be discarded,
-            // as ADCL and ADCH would be locked when it completed.
-            low_byte = ADCL;
-            high_byte = ADCH;
-
-            // combine the two bytes
-            *adc_destination = (high_byte << 8) | low_byte;
-            *adc_finished = true;
+    inline void selectAnalogChannel(uint8_t pin) {
+            // set the analog reference (high two bits of ADMUX) and select the
+            // channel (low 4 bits).  this also sets ADLAR (left-adjust result)
+            // to 0 (the default).
+            ADMUX = (ANALOG_REF << 6) | (pin & 0x0f);
     }
 
 #else
@@ -88,76 +63,108 @@ volatile bool* adc_finished; //< Flag to set once the data is sampled
     // to ground on the AREF pin.
     const uint8_t ANALOG_REF = 0x01;
 
-    void initAnalogPin(uint8_t pin) {
+    inline void configureAnalogPin(uint8_t pin) {
             // Analog pins are on ports F and K
             if (pin < 8) {
                     DDRF &= ~(_BV(pin));
                     PORTF &= ~(_BV(pin));
-                    // clear ADC Channel bit selecting upper 8 ADCs
-					ADCSRB &= ~0b01000;
             }
             else{
-				pin -= 8;
-				DDRK &= ~(_BV(pin));
-				PORTK &= ~(_BV(pin));
-				// set ADC Channel bit selecting upper 8 ADCs
-				ADCSRB |= 0b01000;
-			}
-			
-			// select ADC Channel and connect AREF to AVCC
-			ADMUX = 0b01000000 + pin;
-            // enable a2d conversions, interrupt on completion
-            ADCSRA |= _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0) |
-                            _BV(ADEN) | _BV(ADIE);
+                    DDRK &= ~(_BV(pin - 8));
+                    PORTK &= ~(_BV(pin - 8));
+            }
     }
 
-    bool startAnalogRead(uint8_t pin,
-                         volatile int16_t* destination,
-                         volatile bool* finished) {
-            // ADSC is cleared when the conversion finishes.
-            // We should not start a new read while an existing one is in progress.
-            if ((ADCSRA & _BV(ADSC)) != 0) {
-                    return false;
+    inline void selectAnalogChannel(uint8_t pin) {
+            if (pin < 8) {
+                    // clear ADC Channel bit selecting upper 8 ADCs
+                    ADCSRB &= ~0b01000;
             }
-            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-                    adc_destination = destination;
-                    adc_finished = finished;
-                    *adc_finished = false;
-
-                    if (pin < 8) {
-						// clear ADC Channel bit selecting upper 8 ADCs
-						ADCSRB &= ~0b01000;
-					}
-					else{
-						pin -= 8;
-						// set ADC Channel bit selecting upper 8 ADCs
-						ADCSRB |= 0b01000;
-					}
-			
-					// select ADC Channel and connect AREF to AVCC
-					ADMUX = 0b01000000 + pin;
-
-                    // start the conversion.
-                    ADCSRA |= _BV(ADSC);
+            else{
+                    pin -= 8;
+                    // set ADC Channel bit selecting upper 8 ADCs
+                    ADCSRB |= 0b01000;
             }
-            // An interrupt will signal conversion completion.
-            return true;
-    }
 
-    ISR(ADC_vect)
-    {
-            uint8_t low_byte, high_byte;
-            // we have to read ADCL first; doing so locks both ADCL
-            // and ADCH until ADCH is read.  reading ADCL second would
-            // cause the results of each conversion to be discarded,
-            // as ADCL and ADCH would be locked when it completed.
-            low_byte = ADCL;
-            high_byte = ADCH;
-
-            // combine the two bytes
-            *adc_destination = (high_byte << 8) | low_byte;
-            *adc_finished = true;
+            // select ADC Channel and connect AREF to AVCC
+            ADMUX = (ANALOG_REF << 6) | pin;
     }
 
 #endif
 
+uint8_t initAnalogPin(uint8_t pin) {
+        // A pin that is already scheduled keeps its existing slot.
+        for (uint8_t i = 0; i < adc_channel_count; i++) {
+                if (adc_channels[i].pin == pin) {
+                        return i;
+                }
+        }
+        if (adc_channel_count >= ANALOG_CHANNEL_COUNT) {
+                return ANALOG_CHANNEL_INVALID;
+        }
+
+        configureAnalogPin(pin);
+
+        uint8_t slot;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                slot = adc_channel_count;
+                adc_channels[slot].pin = pin;
+                adc_channels[slot].sequence = 0;
+                adc_channels[slot].samples[0] = 0;
+                adc_channels[slot].samples[1] = 0;
+                adc_channel_count++;
+
+                // The first registered pin kicks off the scheduler; after that
+                // the ISR keeps conversions running on its own.
+                if (slot == 0) {
+                        adc_current = 0;
+                        selectAnalogChannel(pin);
+                        // enable a2d conversions, interrupt on completion
+                        ADCSRA |= _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0) |
+                                        _BV(ADEN) | _BV(ADIE);
+                        // start the conversion.
+                        ADCSRA |= _BV(ADSC);
+                }
+        }
+        return slot;
+}
+
+bool getAnalogSample(uint8_t slot, int16_t& value, uint8_t& sequence) {
+        AnalogChannel& channel = adc_channels[slot];
+        uint8_t seq;
+        // Retry if a conversion was published while we were reading.
+        do {
+                seq = channel.sequence;
+                value = channel.samples[seq & 1];
+        } while (seq != channel.sequence);
+
+        bool fresh = (seq != sequence);
+        sequence = seq;
+        return fresh;
+}
+
+ISR(ADC_vect)
+{
+        uint8_t low_byte, high_byte;
+        // we have to read ADCL first; doing so locks both ADCL
+        // and ADCH until ADCH is read.  reading ADCL second would
+        // cause the results of each conversion to be discarded,
+        // as ADCL and ADCH would be locked when it completed.
+        low_byte = ADCL;
+        high_byte = ADCH;
+
+        // combine the two bytes into the unpublished buffer, then publish it
+        AnalogChannel& channel = adc_channels[adc_current];
+        uint8_t next = channel.sequence + 1;
+        channel.samples[next & 1] = (high_byte << 8) | low_byte;
+        channel.sequence = next;
+
+        // move on to the next registered channel and start its conversion
+        uint8_t current = adc_current + 1;
+        if (current >= adc_channel_count) {
+                current = 0;
+        }
+        adc_current = current;
+        selectAnalogChannel(adc_channels[current].pin);
+        ADCSRA |= _BV(ADSC);
+}
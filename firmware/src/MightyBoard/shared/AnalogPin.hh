@@ -22,19 +22,32 @@
 
 /// Porting notes:
 /// This needs to be ported to each processor architecture.
+///
+/// The ADC is run as a round-robin scheduler: every analog input registered
+/// with #initAnalogPin() is sampled in turn from the ADC conversion complete
+/// interrupt, and each result is published into a per-channel double buffer
+/// along with a sequence counter.  Readers never start or wait on conversions.
 
-/// Initialize a hardware pin to work in analog mode.
-/// \param [in] Analog input number (0-7 on the Atmega168).
-void initAnalogPin(uint8_t pin);
+/// Maximum number of analog inputs that can be registered with the scheduler.
+#define ANALOG_CHANNEL_COUNT 4
 
+/// Returned by #initAnalogPin() when the scheduler has no free channel slots.
+#define ANALOG_CHANNEL_INVALID 0xFF
 
-/// Initialize an asynchronous analog read from the specified input. The pin must first be
-/// placed into analog input mode by a call to #initAnalogPin(). The ADC will be set to
-/// interrupt mode,
-/// \param [in] pin Analog input number that should be read (processor-specific)
-/// \param [out] destination Address to store the result of the analog read.
-/// \param [out] finished This flag will be set to true once the analog read has been
-///              completed, and the output is stored in destination.
-bool startAnalogRead(uint8_t pin, volatile int16_t* destination, volatile bool* finished);
+/// Initialize a hardware pin to work in analog mode and add it to the ADC
+/// scheduler.  Conversions start as soon as the first pin is registered.
+/// \param [in] pin Analog input number (processor-specific).
+/// \return Scheduler slot to pass to #getAnalogSample(), or
+///         #ANALOG_CHANNEL_INVALID if all slots are in use.
+uint8_t initAnalogPin(uint8_t pin);
+
+/// Fetch the most recent conversion result for a scheduler slot.  This is safe
+/// to call with interrupts enabled.
+/// \param [in] slot Scheduler slot returned by #initAnalogPin().
+/// \param [out] value Most recent conversion result.
+/// \param [in,out] sequence Sequence number of the last sample the caller has
+///                 seen; updated to the sequence number of the returned sample.
+/// \return True if the sample is newer than the one identified by sequence.
+bool getAnalogSample(uint8_t slot, int16_t& value, uint8_t& sequence);
 
 #endif /* ANALOG_PIN_HH_ */
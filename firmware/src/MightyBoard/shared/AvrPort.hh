@@ -104,13 +104,5 @@ extern const AvrPort PortL;
 
 extern const AvrPort NullPort;
 
-//Macro to expand steppers into Port, Pin, PinNumber and DDR
-#define STEPPER_PORT(PLETTER, PNUMBER)  {       _SFR_MEM_ADDR(PORT ## PLETTER), \
-                                                _SFR_MEM_ADDR(PIN ## PLETTER),  \
-                                                PIN ## PLETTER ## PNUMBER,      \
-                                                _SFR_MEM_ADDR(DDR ## PLETTER)   \
-                                        }
- 
-
 #endif // SHARED_AVR_PORT_HH_
 
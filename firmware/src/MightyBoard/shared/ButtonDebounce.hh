@@ -0,0 +1,137 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef BUTTON_DEBOUNCE_HH_
+#define BUTTON_DEBOUNCE_HH_
+
+#include <stdint.h>
+
+/// The keypad is sampled every BUTTON_TICK_MICROS while a button is down or
+/// bouncing, and a change counts once the buttons read the same for
+/// BUTTON_DEBOUNCE_TICKS more samples.
+#define BUTTON_TICK_MICROS	4000
+#define BUTTON_DEBOUNCE_TICKS	2
+
+/// Microseconds as button ticks
+#define BUTTON_TICKS(MICROS)	((uint16_t)((MICROS) / BUTTON_TICK_MICROS))
+
+/// Returned by ButtonDebounce::tick() for no button; a button repeating because it is
+/// held has BUTTON_REPEAT set as well.
+#define BUTTON_NONE		0xFF
+#define BUTTON_REPEAT		0x80
+
+/// Debouncing and auto repeat for a keypad, run from a timer interrupt.  Each tick is
+/// given the buttons which are down, one bit each, and returns the button pressed, if
+/// any.  A press is reported once the buttons have settled, a button held is reported
+/// again after the slow delay and then after every fast delay, and holding the hold
+/// button for the hold delay reports the hold event.  With more than one button down,
+/// the lowest is reported.
+/// \ingroup SoftwareLibraries
+class ButtonDebounce {
+private:
+	uint8_t sample;			///< Buttons down at the last tick
+	uint8_t settled;		///< Ticks the sample has been the same, up to
+					///< BUTTON_DEBOUNCE_TICKS
+	uint8_t down;			///< Buttons down, once settled
+	uint16_t repeat_ticks;		///< Ticks until the button held is reported again
+	uint16_t hold_ticks;		///< Ticks the hold button has been down
+
+	const uint8_t hold_button;
+	const uint8_t hold_event;
+	const uint16_t slow_ticks;
+	const uint16_t fast_ticks;
+	const uint16_t hold_delay_ticks;
+
+	static uint8_t lowest(uint8_t buttons) {
+		uint8_t button = 0;
+		while ( !(buttons & 1) ) {
+			buttons >>= 1;
+			button++;
+		}
+		return button;
+	}
+
+public:
+	/// \param [in] hold_button_in Button which reports hold_event_in after it is held
+	/// for hold_micros.
+	ButtonDebounce(uint8_t hold_button_in, uint8_t hold_event_in, uint32_t slow_micros,
+		       uint32_t fast_micros, uint32_t hold_micros) :
+		hold_button(hold_button_in), hold_event(hold_event_in),
+		slow_ticks(BUTTON_TICKS(slow_micros)), fast_ticks(BUTTON_TICKS(fast_micros)),
+		hold_delay_ticks(BUTTON_TICKS(hold_micros)) {
+		reset();
+	}
+
+	/// Forget the buttons, as if none are down.
+	void reset() {
+		sample = 0;
+		settled = BUTTON_DEBOUNCE_TICKS;
+		down = 0;
+		repeat_ticks = 0;
+		hold_ticks = 0;
+	}
+
+	/// Take a sample of the buttons.
+	/// \param [in] buttons Buttons down, one bit per button.
+	/// \return Button pressed, with BUTTON_REPEAT if it is held, or BUTTON_NONE.
+	uint8_t tick(uint8_t buttons) {
+		if ( buttons != sample ) {
+			sample = buttons;
+			settled = 0;
+			return BUTTON_NONE;
+		}
+		if ( settled < BUTTON_DEBOUNCE_TICKS && ++settled < BUTTON_DEBOUNCE_TICKS ) {
+			return BUTTON_NONE;
+		}
+
+		uint8_t event = BUTTON_NONE;
+		if ( sample != down ) {
+			down = sample;
+			repeat_ticks = slow_ticks;
+			if ( down )	event = lowest(down);
+		} else if ( down && --repeat_ticks == 0 ) {
+			repeat_ticks = fast_ticks;
+			event = lowest(down) | BUTTON_REPEAT;
+		}
+
+		if ( down & (1 << hold_button) ) {
+			if ( hold_ticks < hold_delay_ticks && ++hold_ticks == hold_delay_ticks )
+				event = hold_event;
+		} else {
+			hold_ticks = 0;
+		}
+		return event;
+	}
+
+	/// True when no button is down or bouncing, so there is no need to tick until one
+	/// changes.
+	bool isIdle() const {
+		return down == 0 && sample == 0 && settled == BUTTON_DEBOUNCE_TICKS;
+	}
+
+	/// Buttons which are down are reported as pressed again, once they have settled.
+	void clear() {
+		down = 0;
+	}
+
+	/// Wait at least the given time before the button held is reported again.
+	void delayRepeat(uint32_t micros) {
+		if ( repeat_ticks < BUTTON_TICKS(micros) )	repeat_ticks = BUTTON_TICKS(micros);
+	}
+};
+
+#endif // BUTTON_DEBOUNCE_HH_
@@ -79,7 +79,76 @@
 #define HOST_CMD_EXTENDED_STOP     22
 #define HOST_CMD_BOARD_STATUS	     23
 #define HOST_CMD_GET_BUILD_STATS   24
+// Start or stop telemetry.  The payload is the interval between frames
+// as a uint16 in ms, or 0 to stop; a reset also stops it.  Frames are sent
+// with TELEMETRY_START_BYTE between responses, never in the middle of one.
+#define HOST_CMD_SET_TELEMETRY     26
 #define HOST_CMD_ADVANCED_VERSION  27
+// Negotiate the link protocol.  The payload is the highest LINK_VERSION_*
+// the host speaks and, optionally, the longest payload it wants to send;
+// the reply is RC_OK, the version the bot will speak, the window size, the
+// free space in the command buffer (uint16) and the longest payload the
+// bot will take, from MAX_PACKET_PAYLOAD up to MAX_IN_PACKET_PAYLOAD.
+// Windowed packets (see WINDOW_START_BYTE) start again from sequence
+// number 0.  A host reset goes back to MAX_PACKET_PAYLOAD.
+// Not HOST_CMD_STREAM_VERSION: that stamps the x3g version of a build and
+// is an action command, buffered and run with the build, too late to
+// change how the packets carrying it are framed.
+#define HOST_CMD_LINK_VERSION      28
+// Change the speed of the link.  The payload is the rate in baud (uint32);
+// the reply, sent at the old rate, is RC_OK and the rate the bot will
+// speak from then on, which is the old rate if the new one is not
+// supported.  The host then changes its own rate, which the USB to serial
+// bridge follows.  If no packet comes in at the new rate within a second,
+// the bot goes back to HOST_DEFAULT_BAUD_RATE.
+#define HOST_CMD_SET_BAUD_RATE     29
+// Retrieve a snapshot of the machine status in one packet.  The payload is
+// a mask of STATUS_GROUP_* bits; the reply is RC_OK, the mask of the groups
+// included and then each group in bit order.  Groups that do not fit in a
+// packet are left out of the reply mask, for the host to ask for again.
+// (25, next to the other polls, is GET_COMMUNICATION_STATS in the s3g
+// protocol, which hosts such as ReplicatorG send.)
+#define HOST_CMD_GET_STATUS        30
+
+// Groups of HOST_CMD_GET_STATUS
+/// Current and set temperatures, uint16: tool 0, tool 1, platform (12 bytes)
+#define STATUS_GROUP_TEMPERATURES  0x01
+/// SLAVE_CMD_GET_TOOL_STATUS byte of each tool (2 bytes)
+#define STATUS_GROUP_TOOL_STATUS   0x02
+/// As HOST_CMD_GET_POSITION_EXT (22 bytes)
+#define STATUS_GROUP_POSITION      0x04
+/// As HOST_CMD_GET_BUFFER_SIZE (4 bytes)
+#define STATUS_GROUP_BUFFER_SIZE   0x08
+/// As HOST_CMD_BOARD_STATUS (1 byte)
+#define STATUS_GROUP_BOARD_STATUS  0x10
+/// As HOST_CMD_GET_BUILD_STATS, without the filament word (7 bytes)
+#define STATUS_GROUP_BUILD_STATS   0x20
+#define STATUS_GROUP_COUNT         6
+
+// Link protocol versions
+/// Stop and wait: one packet, one response
+#define LINK_VERSION_BASIC         0
+/// Windowed packets with sequence numbers, acks and command buffer credit
+#define LINK_VERSION_WINDOWED      1
+
+// Telemetry frame types, the first byte of a telemetry frame
+/// Payload, little endian (30 bytes):
+///  0 uint8  frame type
+///  1 uint8  sequence number, counting frames sent
+///  2 int16  tool 0 temperature
+///  4 int16  tool 1 temperature
+///  6 int16  platform temperature
+///  8 uint8  tool 0 heater output, 0-255
+///  9 uint8  tool 1 heater output
+/// 10 uint8  platform heater output
+/// 11 uint16 free space in the command buffer, bytes
+/// 13 uint8  planner blocks queued
+/// 14 uint32 line number of the build
+/// 18 int32  X, Y and Z position, steps
+#define TELEMETRY_FRAME_STATUS     1
+#define TELEMETRY_STATUS_LENGTH    30
+/// Shortest interval between telemetry frames, ms
+#define TELEMETRY_MIN_INTERVAL     20
 
 // These are our bufferable commands from the host
 
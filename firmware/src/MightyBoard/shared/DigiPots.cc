@@ -31,36 +31,42 @@ DigiPots::DigiPots(const Pin& pot,
 void DigiPots::init(const uint8_t idx) {
 	
 	eeprom_pot_offset = idx;
+	scale = 100;
     resetPots();
  
 }
 
 void DigiPots::resetPots()
 {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Winline"
-    SoftI2cManager i2cPots = SoftI2cManager::getI2cManager();
-#pragma GCC diagnostic pop
-    i2cPots.start(0b01011110 | I2C_WRITE, pot_pin);
     potValue = eeprom::getEeprom8(eeprom_base + eeprom_pot_offset, 0);
-    i2cPots.write(potValue, pot_pin);
-    i2cPots.stop();
+    write();
 }
 
 void DigiPots::setPotValue(const uint8_t val)
 {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Winline"
-    SoftI2cManager i2cPots = SoftI2cManager::getI2cManager();
-#pragma GCC diagnostic pop
-    i2cPots.start(0b01011110 | I2C_WRITE, pot_pin);
     potValue = val > DIGI_POT_MAX ? DIGI_POT_MAX : val;
-    i2cPots.write(potValue, pot_pin);
-    i2cPots.stop(); 
+    write();
+}
+
+void DigiPots::setScale(const uint8_t percent)
+{
+    if (percent != scale) {
+        scale = percent;
+        write();
+    }
+}
+
+void DigiPots::write()
+{
+    uint16_t value = ((uint16_t)potValue * scale) / 100;
+    // a boost stops at DIGI_POT_MAX, or at the pot value if that is higher
+    if (value > potValue && value > DIGI_POT_MAX) {
+        value = potValue > DIGI_POT_MAX ? potValue : DIGI_POT_MAX;
+    }
+    SoftI2cManager::getI2cManager().queueWrite(eeprom_pot_offset, (uint8_t)value);
 }
 
 /// returns the last pot value set
 uint8_t DigiPots::getPotValue() {
     return potValue;
 }
-
@@ -54,8 +54,18 @@ public:
 	/// returns the last pot value set
 	uint8_t getPotValue();
 
+	/// Scale the current from the pot value set, as the motor current policy
+	/// asks; the pot is written only if the scale changes.
+	/// \param[in] percent Percent of the pot value to write; more than 100 stops
+	/// at DIGI_POT_MAX
+	void setScale(const uint8_t percent);
+
 private:
+	/// Queue the scaled pot value, to be written from the timer interrupt
+	void write();
+
 	uint8_t potValue;
+	uint8_t scale;	///< Percent of potValue written
 };
 
 #endif // DIGIPOTS_HH_
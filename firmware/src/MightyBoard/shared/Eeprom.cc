@@ -1,6 +1,7 @@
 #include "Eeprom.hh"
 #include "EepromMap.hh"
 #include "StepperAxis.hh"
+#include "Settings.hh"
 
 #include "Version.hh"
 #include <avr/eeprom.h>
@@ -103,6 +104,7 @@ bool restoreFromSDFile(const prog_char *filename) {
 	}
 
     	sdcard::finishPlayback();
+	settings::load();
 
 	return true;
 }
@@ -112,9 +114,11 @@ bool restoreFromSDFile(const prog_char *filename) {
 uint8_t getEeprom8(const uint16_t location, const uint8_t default_value) {
     uint8_t data;
     /// TODO: why not just use eeprom_read_byte?
-		ATOMIC_BLOCK(ATOMIC_RESTORESTATE){  
-        eeprom_read_block(&data,(const uint8_t*)location,1);
-		}
+    if (!settings::read(location, 1, &data)) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+            eeprom_read_block(&data,(const uint8_t*)location,1);
+        }
+    }
     if (data == 0xff) data = default_value;
         return data;
 }
@@ -122,9 +126,11 @@ uint8_t getEeprom8(const uint16_t location, const uint8_t default_value) {
 uint16_t getEeprom16(const uint16_t location, const uint16_t default_value) {
     uint16_t data;
     /// TODO: why not just use eeprom_read_word?
-    ATOMIC_BLOCK(ATOMIC_RESTORESTATE){  
-        eeprom_read_block(&data,(const uint8_t*)location,2);
-		}
+    if (!settings::read(location, 2, &data)) {
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+            eeprom_read_block(&data,(const uint8_t*)location,2);
+        }
+    }
     if (data == 0xffff) data = default_value;
       return data;
 }
@@ -132,8 +138,10 @@ uint16_t getEeprom16(const uint16_t location, const uint16_t default_value) {
 uint32_t getEeprom32(const uint16_t location, const uint32_t default_value) {
 		
 		uint32_t data;
-		ATOMIC_BLOCK(ATOMIC_RESTORESTATE){  
-		data = eeprom_read_dword((const uint32_t*)location);
+		if (!settings::read(location, 4, &data)) {
+			ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
+				data = eeprom_read_dword((const uint32_t*)location);
+			}
 		}
         if (data == 0xffffffff) return default_value;
         return data;
@@ -155,9 +163,11 @@ float getEepromFixed32(const uint16_t location, const float default_value) {
 /// Fetch a fixed 16 value from eeprom
 float getEepromFixed16(const uint16_t location, const float default_value) {
     uint8_t data[2];
+    if (!settings::read(location, 2, data)) {
     ATOMIC_BLOCK(ATOMIC_RESTORESTATE){  
         eeprom_read_block(data,(const uint8_t*)location,2);
 		}
+    }
     if (data[0] == 0xff && data[1] == 0xff) return default_value;
       return ((float)data[0]) + ((float)data[1])/256.0;
 }
@@ -30,6 +30,10 @@
 ///             current temperature, bypass the PID loop altogether.
 #define PID_BYPASS_DELTA 10
 
+/// Early release: never report a heater as about to reach its target while it
+/// is more than this many degrees away, whatever the model says.
+#define MODEL_LEAD_BAND 8
+
 /// Number of bad sensor readings we need to get in a row before shutting off the heater
 const uint8_t SENSOR_MAX_BAD_READINGS = 15;
 
@@ -87,8 +91,10 @@ void Heater::reset() {
 	fail_mode = HEATER_FAIL_NONE;
 	value_fail_count = 0;
 
-	heatingUpTimer = Timeout();
-	heatProgressTimer = Timeout();
+	heatingUpTimer.abort();
+	heatingUpTimer.clear();
+	heatProgressTimer.abort();
+	heatProgressTimer.clear();
 	progressChecked = false;
 	newTargetReached = false;
 	is_paused = false;
@@ -109,6 +115,10 @@ void Heater::reset() {
 	next_pid_timeout.start(UPDATE_INTERVAL_MICROS);
 	//next_sense_timeout.start(sample_interval_micros);
   calibration_offset = eeprom::getEeprom8(eeprom_offsets::HEATER_CALIBRATION + calibration_eeprom_offset, 0);
+
+	model.reset();
+	last_model_micros = 0;
+	last_output = 0;
 }
 
 void Heater::abort() {
@@ -118,8 +128,10 @@ void Heater::abort() {
 	fail_mode = HEATER_FAIL_NONE;
 	value_fail_count = 0;
 
-	heatingUpTimer = Timeout();
-	heatProgressTimer = Timeout();
+	heatingUpTimer.abort();
+	heatingUpTimer.clear();
+	heatProgressTimer.abort();
+	heatProgressTimer.clear();
 	progressChecked = false;
 	newTargetReached = false;
 	is_paused = false;
@@ -195,8 +207,10 @@ void Heater::set_target_temperature(int16_t target_temp)
 			heatingUpTimer.start(HEAT_UP_TIME);
 		}
 		else{
-			heatingUpTimer = Timeout();
-			heatProgressTimer = Timeout();
+			heatingUpTimer.abort();
+			heatingUpTimer.clear();
+			heatProgressTimer.abort();
+			heatProgressTimer.clear();
 		}
 	}
 	pid.setTarget(target_temp);
@@ -227,6 +241,29 @@ bool Heater::has_reached_target_temperature()
 	return newTargetReached; 
 }
 
+bool Heater::will_reach_target_within(uint8_t seconds)
+{
+	if(is_paused || fail_state || !model.isValid()){
+		return false;
+	}
+	int16_t target = pid.getTarget() - TARGET_HYSTERESIS;
+	int16_t temp = current_temperature;
+	if((pid.getTarget() == 0) || (temp >= target) || (temp < target - MODEL_LEAD_BAND)){
+		return false;
+	}
+	return model.secondsToTarget(temp, target) < seconds;
+}
+
+uint16_t Heater::get_seconds_to_target()
+{
+	int16_t target = is_paused ? paused_set_temperature : pid.getTarget();
+	target -= TARGET_HYSTERESIS;
+	if(current_temperature >= target){
+		return 0;
+	}
+	return model.secondsToTarget(current_temperature, target);
+}
+
 int Heater::get_set_temperature() {
 	return pid.getTarget();
 }
@@ -272,8 +309,7 @@ void Heater::manage_temperature() {
 		switch (sensor.update()) {
 		case TemperatureSensor::SS_ADC_BUSY:
 		case TemperatureSensor::SS_ADC_WAITING:
-			// We're waiting for the ADC, so don't update the temperature yet.
-			current_temperature = 2;
+			// No new sample since the last pass; keep the last known temperature.
 			return;
 		case TemperatureSensor::SS_OK:
 			// Result was ok, so reset the fail counter, and continue.
@@ -301,6 +337,13 @@ void Heater::manage_temperature() {
 		}
 
 		current_temperature = sensor.getTemperature() + calibration_offset;
+
+		// feed the model the output that produced this reading
+		{
+			micros_t now = Motherboard::getBoard().getCurrentMicros();
+			model.update(current_temperature, last_output, (float)(now - last_model_micros) / 1000000.0);
+			last_model_micros = now;
+		}
 		
 		if (!is_paused){
 			uint8_t old_value_count = value_fail_count;
@@ -371,6 +414,9 @@ void Heater::manage_temperature() {
 		// There are probably more elegant ways to do this,
 		// but this works pretty well.
 		mv += HEATER_OFFSET_ADJUSTMENT;
+		// feed forward the output the model says holds the setpoint, so the
+		// integral term only has to make up the model error
+		mv += model.feedForward(pid.getTarget());
 		// clamp value
 		if (mv < 0) { mv = 0; }
 		if (mv >255) { mv = 255; }
@@ -402,8 +448,10 @@ void Heater::Pause(bool on){
 		paused_set_temperature = get_set_temperature();
 		set_target_temperature(get_current_temperature());
 		// clear heatup timers
-		heatingUpTimer = Timeout();
-		heatProgressTimer = Timeout();
+		heatingUpTimer.abort();
+		heatingUpTimer.clear();
+		heatProgressTimer.abort();
+		heatProgressTimer.clear();
 		// clear reached target temperature
 		newTargetReached = false;
 		
@@ -415,6 +463,7 @@ void Heater::Pause(bool on){
 
 void Heater::set_output(uint8_t value)
 {
+	last_output = value;
 	element.setHeatingElement(value);
 }
 
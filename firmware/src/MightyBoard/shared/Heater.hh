@@ -22,8 +22,10 @@
 #include "HeatingElement.hh"
 #include "Pin.hh"
 #include "PID.hh"
+#include "ThermalModel.hh"
 #include "Types.hh"
 #include "Timeout.hh"
+#include "TimerWheel.hh"
 
 #define DEFAULT_P 9.0
 #define DEFAULT_I 0.250
@@ -67,6 +69,10 @@ class Heater
     PID pid;                            ///< PID controller instance
     bool bypassing_PID;                 ///< True if the heater is in full on
 
+    ThermalModel model;                 ///< Model of the heater, fitted as it runs
+    micros_t last_model_micros;         ///< Time of the last sample given to the model
+    uint8_t last_output;                ///< Output applied since the last sample
+
     bool fail_state;                    ///< True if the heater has detected a hardware
                                         ///< failure and is shut down.
     uint8_t fail_count;                 ///< Count of the number of hardware failures that
@@ -76,8 +82,8 @@ class Heater
     uint8_t value_fail_count;			///< a second failure counter for valid temp reads that are out of range (eg too hot)
     HeaterFailMode fail_mode;			///< queryable state to indicate WHY the heater fails
 
-    Timeout heatingUpTimer;				///< timeout indicating how long heater has been heating
-    Timeout heatProgressTimer;			///< timeout to flag if heater is not heating up from start
+    ScheduledTimeout heatingUpTimer;				///< timeout indicating how long heater has been heating
+    ScheduledTimeout heatProgressTimer;			///< timeout to flag if heater is not heating up from start
     bool progressChecked;				///< flag that heating up progress has been checked.
     const bool heat_timing_check;       ///< allow disabling of heat progress timing for heated build platform. 
     bool is_paused;						///< set to true when we wish to pause the heater from heating up 
@@ -128,6 +134,21 @@ class Heater
     ///         of the setpoint temperature.
     bool has_reached_target_temperature();
 
+    /// Check if the heater is expected to reach its setpoint soon.  This uses
+    /// the fitted thermal model, and is always false until the model is valid.
+    /// \param[in] seconds Lead time, in seconds
+    /// \return True if the heater is heating and the model predicts it will be
+    ///         within #TARGET_HYSTERESIS degrees of the setpoint in less than
+    ///         the given time.
+    bool will_reach_target_within(uint8_t seconds);
+
+    /// Predict how long the heater will take to heat to its setpoint, running
+    /// full on from the current temperature.  For a paused heater this is the
+    /// setpoint it will return to when unpaused.
+    /// \return Seconds to target, 0 if already there, or #MODEL_TIME_UNKNOWN
+    ///         if the model is not valid yet
+    uint16_t get_seconds_to_target();
+
     /// Check if the heater is in a failure state
     /// \return true if the heater has failed.
     bool has_failed();
@@ -56,10 +56,6 @@ void queueScreen(InterfaceBoard::ScreenType screen){
   board->queueScreen(screen);
 }
 
-void doInterrupt() {
-  board->doInterrupt();
-}
-
 micros_t getUpdateRate() {
   return board->getUpdateRate();
 }
@@ -44,11 +44,6 @@ void pushScreen(Screen* newScreen);
 void popScreen();
 
 
-/// Screen update interrupt. This scans the keypad to look for any changes. To
-/// ensure a consistant user response, it should be called from a medium frequency
-/// interrupt.
-void doInterrupt();
-
 /// Update the display. This function is where the current display screen
 /// should handle button presses, redraw it's screen, etc. It is run from the
 /// motherboard slice, not an interrupt, because it may take a relatively long
@@ -44,10 +44,6 @@ void InterfaceBoard::resetLCD() {
 	lcd.begin(LCD_SCREEN_WIDTH, LCD_SCREEN_HEIGHT);
 }
 
-void InterfaceBoard::doInterrupt() {
-	buttons.scanButtons();
-}
-
 micros_t InterfaceBoard::getUpdateRate() {
 	return screenStack[screenIndex]->getUpdateRate();
 }
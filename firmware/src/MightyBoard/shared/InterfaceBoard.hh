@@ -96,10 +96,6 @@ public:
         /// at system startup (or reset).
         void init();
 
-        /// This should be called periodically by a high-speed interrupt to
-        /// service the button input pad.
-        void doInterrupt();
-
         /// Add a new screen to the stack. This automatically calls reset()
         /// and then update() on the screen, to ensure that it displays
         /// properly. If there are more than SCREEN_STACK_DEPTH screens already
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef SHARED_LINK_WINDOW_HH_
+#define SHARED_LINK_WINDOW_HH_
+
+#include <stdint.h>
+#include "Packet.hh"
+
+/// Tracks the sequence numbers of windowed packets from the host, so that
+/// each packet is acted on once and in order however often the host sends
+/// it.  The host sends up to #LINK_WINDOW_SIZE packets ahead of the last
+/// one acknowledged; if a packet or its response is lost it sends again
+/// from the first one it has no response to.
+class LinkWindow {
+public:
+	typedef enum {
+		NEW,            ///< The next packet; act on it
+		REPEAT,         ///< Acted on already, but the response was lost
+		OUT_OF_WINDOW   ///< A packet before it was lost; drop it
+	} Verdict;
+
+private:
+	uint8_t expected;   ///< Sequence number of the next packet
+
+public:
+	LinkWindow() : expected(0) {}
+
+	/// Start again from sequence number 0
+	void reset() { expected = 0; }
+
+	Verdict classify(uint8_t sequence) const {
+		if (sequence == expected) {
+			return NEW;
+		}
+		uint8_t behind = expected - sequence;
+		return behind <= LINK_WINDOW_SIZE ? REPEAT : OUT_OF_WINDOW;
+	}
+
+	/// The next packet has been acted on
+	void accept() { expected++; }
+
+	/// Sequence number to acknowledge in the response to a packet
+	uint8_t ackFor(Verdict verdict, uint8_t sequence) const {
+		return verdict == REPEAT ? sequence : (uint8_t)(expected - 1);
+	}
+};
+
+#endif // SHARED_LINK_WINDOW_HH_
@@ -18,6 +18,7 @@
 #include "Version.hh"
 #include "EepromMap.hh"
 #include "Eeprom.hh"
+#include "Settings.hh"
 #include <avr/eeprom.h>
 #include "RGB_LED.hh"
 #include "stdio.h"
@@ -27,6 +28,7 @@
 #include "StepperAccelPlanner.hh"
 
 CancelBuildMenu cancel_build_menu;
+ResumeBuildMenu resume_build_menu;
 BuildStats build_stats_screen;
 FilamentScreen filamentScreen;
 SDMenu sdmenu;
@@ -54,6 +56,8 @@ InfoMenu info;
 //#define HOST_TOOL_RESPONSE_TIMEOUT_MICROS (1000L*HOST_TOOL_RESPONSE_TIMEOUT_MS)
 
 
+static void startSDBuild(bool resume);
+
 bool ready_fail = false;
 bool cancel_process = false;
 
@@ -652,17 +656,13 @@ void SelectAlignmentMenu::handleSelect(uint8_t index) {
       // update toolhead offset (tool tolerance setting) 
       // this is summed with previous offset setting
       offset = (int32_t)(eeprom::getEeprom32(eeprom_offsets::TOOLHEAD_OFFSET_SETTINGS_MM, 0)) - (int32_t)((xCounter-7)*0.1f * 1000);
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-        eeprom_write_block((uint8_t*)&offset, (uint8_t*)eeprom_offsets::TOOLHEAD_OFFSET_SETTINGS_MM, 4);
-      }
+      settings::write(eeprom_offsets::TOOLHEAD_OFFSET_SETTINGS_MM, &offset, 4);
       lineUpdate = 1;
       break;
     case 2:
       // update toolhead offset (tool tolerance setting)
       offset = (int32_t)(eeprom::getEeprom32(eeprom_offsets::TOOLHEAD_OFFSET_SETTINGS_MM + 4, 0)) - (int32_t)((yCounter-7)*0.1f * 1000);
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-        eeprom_write_block((uint8_t*)&offset, (uint8_t*)eeprom_offsets::TOOLHEAD_OFFSET_SETTINGS_MM + 4, 4);
-      }
+      settings::write(eeprom_offsets::TOOLHEAD_OFFSET_SETTINGS_MM + 4, &offset, 4);
       lineUpdate = 1;
       break;
     case 3:
@@ -2394,9 +2394,7 @@ void ActiveBuildMenu::handleCounterUpdate(uint8_t index, bool up){
       else if(LEDColor < 0)
       LEDColor = 7;
       
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-        eeprom_write_byte((uint8_t*)eeprom_offsets::LED_STRIP_SETTINGS, LEDColor);
-      }
+      settings::write(eeprom_offsets::LED_STRIP_SETTINGS, &LEDColor, 1);
       RGB_LED::setDefaultColor(); 
 
       break;
@@ -3046,9 +3044,7 @@ void StopHeightMenu::handleSelect(uint8_t index) {
   switch (index) {
     case 1:
       // update height stop value preferences
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-        eeprom_write_byte((uint8_t*)eeprom_offsets::STOP_HEIGHT_VALUE, stopHeightValue);
-      }
+      settings::write(eeprom_offsets::STOP_HEIGHT_VALUE, &stopHeightValue, 1);
       plan_read_height_stop_position(stopHeightEnabled);
       lineUpdate = 1;
       break;
@@ -3210,9 +3206,7 @@ void SettingsMenu::handleCounterUpdate(uint8_t index, bool up){
         else if(LEDColor < 0)
         LEDColor = 7;
       
-        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-          eeprom_write_byte((uint8_t*)eeprom_offsets::LED_STRIP_SETTINGS, LEDColor);
-        }
+        settings::write(eeprom_offsets::LED_STRIP_SETTINGS, &LEDColor, 1);
         RGB_LED::setDefaultColor(); 
         break;
       case 3:
@@ -3227,9 +3221,7 @@ void SettingsMenu::handleCounterUpdate(uint8_t index, bool up){
         else if(heaterTimeout < 0)
             heaterTimeout = 30;
       
-        ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-          eeprom_write_byte((uint8_t*)eeprom_offsets::HEATER_TIMEOUT_ON_CANCEL, heaterTimeout);
-        }
+        settings::write(eeprom_offsets::HEATER_TIMEOUT_ON_CANCEL, &heaterTimeout, 1);
         break;
     }
     
@@ -3241,24 +3233,18 @@ void SettingsMenu::handleSelect(uint8_t index) {
     case 0:
       // update sound preferences
       soundOn = !soundOn;
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-        eeprom_write_byte((uint8_t*)eeprom_offsets::BUZZ_SETTINGS, soundOn);
-      }
+      settings::write(eeprom_offsets::BUZZ_SETTINGS, &soundOn, 1);
       lineUpdate = 1;
       break;
     case 1:
       // update LED preferences
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-        eeprom_write_byte((uint8_t*)eeprom_offsets::LED_STRIP_SETTINGS, LEDColor);
-      }
+      settings::write(eeprom_offsets::LED_STRIP_SETTINGS, &LEDColor, 1);
       RGB_LED::setDefaultColor();
       lineUpdate = 1;
       break;
     case 3:
       // update LED preferences
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-        eeprom_write_byte((uint8_t*)eeprom_offsets::HEATER_TIMEOUT_ON_CANCEL, heaterTimeout);
-      }
+      settings::write(eeprom_offsets::HEATER_TIMEOUT_ON_CANCEL, &heaterTimeout, 1);
       lineUpdate = 1;
       break;
     case 6:
@@ -3281,9 +3267,7 @@ void SettingsMenu::handleSelect(uint8_t index) {
     case 5:
       heatingLEDOn = !heatingLEDOn;
       // update LEDHeatingflag
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-        eeprom_write_byte((uint8_t*)eeprom_offsets::LED_STRIP_SETTINGS + blink_eeprom_offsets::LED_HEAT_ON, heatingLEDOn);
-      }
+      settings::write(eeprom_offsets::LED_STRIP_SETTINGS + blink_eeprom_offsets::LED_HEAT_ON, &heatingLEDOn, 1);
       lineUpdate = 1;
       break;
     case 4:
@@ -3295,17 +3279,13 @@ void SettingsMenu::handleSelect(uint8_t index) {
       break;
     case 2:
       accelerationOn = !accelerationOn;
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-        eeprom_write_byte((uint8_t*)eeprom_offsets::ACCELERATION_SETTINGS + acceleration_eeprom_offsets::ACCELERATION_ACTIVE, accelerationOn);
-      }
+      settings::write(eeprom_offsets::ACCELERATION_SETTINGS + acceleration_eeprom_offsets::ACCELERATION_ACTIVE, &accelerationOn, 1);
       lineUpdate = 1;
       break;
     case 7:
       // update hbp setting
       HBPPresent = !HBPPresent;
-      ATOMIC_BLOCK(ATOMIC_RESTORESTATE){
-        eeprom_write_byte((uint8_t*)eeprom_offsets::HBP_PRESENT, HBPPresent);
-      }
+      settings::write(eeprom_offsets::HBP_PRESENT, &HBPPresent, 1);
       Motherboard::getBoard().setUsingPlatform(HBPPresent);
       Motherboard::getBoard().getPlatformHeater().disable(!HBPPresent);
       lineUpdate = 1;
@@ -3508,10 +3488,23 @@ void SDMenu::handleSelect(uint8_t index) {
       Motherboard::getBoard().errorResponse(ERROR_SD_CARD_GENERIC);
       return;
   }
- 
+
+  if (host::canResumeBuild()) {
+      interface::pushScreen(&resume_build_menu);
+      return;
+  }
+
+  startSDBuild(false);
+}
+
+/// Start the build of the file named by host::getBuildName(), or resume it
+/// from its last checkpoint
+static void startSDBuild(bool resume) {
+
   sdcard::SdErrorCode e;
-  e = host::startBuildFromSD();
+  e = resume ? host::resumeBuildFromSD() : host::startBuildFromSD();
   
+  char* buildName = host::getBuildName();
   uint8_t name_length = strlen(buildName);
   if(buildName[name_length-3] == 's') {Motherboard::getBoard().errorResponse(ERROR_STREAM_INCOMPATIBLE_REP1);}
 
@@ -3523,5 +3516,46 @@ void SDMenu::handleSelect(uint8_t index) {
   }
 }
 
+ResumeBuildMenu::ResumeBuildMenu() {
+  itemCount = 4;
+  reset();
+}
+
+void ResumeBuildMenu::resetState() {
+
+  itemIndex = 2;
+  firstItemIndex = 2;
+  
+}
+
+void ResumeBuildMenu::drawItem(uint8_t index, LiquidCrystalSerial& lcd, uint8_t line_number) {
+
+  switch (index) {
+    case 0:
+        lcd.writeFromPgmspace(RESUME_MSG);
+        break;
+    case 2:
+        lcd.writeFromPgmspace(NO_MSG);
+        break;
+    case 3:
+        lcd.writeFromPgmspace(YES_MSG);
+        break;
+  }
+}
+
+void ResumeBuildMenu::handleSelect(uint8_t index) {
+
+  switch (index) {
+    case 2:
+      interface::popScreen();
+      startSDBuild(false);
+      break;
+    case 3:
+      interface::popScreen();
+      startSDBuild(true);
+      break;
+  }
+}
+
 #pragma GCC diagnostic pop
 #endif
@@ -226,6 +226,19 @@ protected:
   bool paused;
 };
 
+/// Offer to resume a build of the selected file that was stopped part way
+class ResumeBuildMenu: public Menu {
+public:
+	ResumeBuildMenu();
+    
+	void resetState();
+    
+protected:
+	void drawItem(uint8_t index, LiquidCrystalSerial& lcd, uint8_t line_number);
+    
+	void handleSelect(uint8_t index);
+};
+
 class BuildStats: public Screen {
 
 private:
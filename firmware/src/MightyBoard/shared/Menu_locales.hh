@@ -353,6 +353,7 @@ static PROGMEM unsigned char RESET1_MSG[] =				" Reset Settings to  ";       //
 static PROGMEM unsigned char RESET2_MSG[] =				" Default values?";
 static PROGMEM unsigned char CANCEL_MSG[] =				"Cancel this build?";
 static PROGMEM unsigned char CANCEL_PROCESS_MSG[] =			"Quit this process?";
+static PROGMEM unsigned char RESUME_MSG[] =				"Resume last build?";
 
 static PROGMEM unsigned char PAUSE_MSG[] =				"Pause              ";
 static PROGMEM unsigned char UNPAUSE_MSG[] =				"UnPause            ";
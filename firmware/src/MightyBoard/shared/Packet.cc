@@ -20,7 +20,7 @@
 
 /// Append a byte and update the CRC
 void Packet::appendByte(uint8_t data) {
-	if (length < MAX_PACKET_PAYLOAD) {
+	if (length < capacity) {
 		crc = _crc_ibutton_update(crc, data);
 		payload[length] = data;
 		length++;
@@ -31,7 +31,7 @@ void Packet::reset() {
 	crc = 0;
 	length = 0;
 #ifdef PARANOID
-	for (uint8_t i = 0; i < MAX_PACKET_PAYLOAD; i++) {
+	for (uint8_t i = 0; i < capacity; i++) {
 		payload[i] = 0;
 	}
 #endif // PARANOID
@@ -39,40 +39,72 @@ void Packet::reset() {
 	state = PS_START;
 }
 
-InPacket::InPacket() {
+InPacket::InPacket() : Packet(buffer, MAX_IN_PACKET_PAYLOAD),
+		max_length(MAX_PACKET_PAYLOAD) {
 	reset();
 }
 
 /// Reset the entire packet reception.
 void InPacket::reset() {
 	Packet::reset();
+	windowed = false;
+}
+
+void InPacket::updateCrc(uint8_t b) {
+	if (windowed) {
+		crc = _crc16_update(crc, b);
+	} else {
+		crc = _crc_ibutton_update(crc, b);
+	}
 }
 
 //process a byte for our packet.
 void InPacket::processByte(uint8_t b) {
 	if (state == PS_START) {
 		if (b == START_BYTE) {
+			windowed = false;
 			state = PS_LEN;
+		} else if (b == WINDOW_START_BYTE) {
+			windowed = true;
+			crc = 0xFFFF;
+			state = PS_SEQ;
 		} else {
 			error(PacketError::NOISE_BYTE);
 		}
+	} else if (state == PS_SEQ) {
+		sequence = b;
+		updateCrc(b);
+		state = PS_LEN;
 	} else if (state == PS_LEN) {
-		if (b <= MAX_PACKET_PAYLOAD) {
+		if (b <= max_length) {
+			// the basic protocol leaves the length out of the CRC
+			if (windowed) {
+				updateCrc(b);
+			}
 			expected_length = b;
 			state = (expected_length == 0) ? PS_CRC : PS_PAYLOAD;
 		} else {
 			error(PacketError::EXCEEDED_MAX_LENGTH);
 		}
 	} else if (state == PS_PAYLOAD) {
-		appendByte(b);
+		if (length < capacity) {
+			updateCrc(b);
+			payload[length++] = b;
+		}
 		if (length >= expected_length) {
 			state = PS_CRC;
 		}
 	} else if (state == PS_CRC) {
-		if (crc == b) {
-			state = PS_LAST;
+		if ((uint8_t)crc != b) {
+			error(PacketError::BAD_CRC);
 		} else {
+			state = windowed ? PS_CRC_HIGH : PS_LAST;
+		}
+	} else if (state == PS_CRC_HIGH) {
+		if ((uint8_t)(crc >> 8) != b) {
 			error(PacketError::BAD_CRC);
+		} else {
+			state = PS_LAST;
 		}
 	}
 }
@@ -100,7 +132,7 @@ uint32_t Packet::read32(uint8_t index) const {
 	return shared.a;
 }
 
-OutPacket::OutPacket() {
+OutPacket::OutPacket() : Packet(buffer, MAX_PACKET_PAYLOAD) {
 	reset();
 }
 
@@ -108,18 +140,45 @@ OutPacket::OutPacket() {
 void OutPacket::reset() {
 	Packet::reset();
 	send_payload_index = 0;
+	start_byte = START_BYTE;
+	header_length = 0;
+	send_header_index = 0;
+}
+
+void OutPacket::setAck(uint8_t ack, uint16_t credit) {
+	start_byte = WINDOW_START_BYTE;
+	header[0] = ack;
+	header[1] = credit & 0xff;
+	header[2] = credit >> 8;
+	header_length = 3;
+
+	// the header and the length go first, so the CRC starts over from them
+	crc = 0xFFFF;
+	for (uint8_t i = 0; i < header_length; i++) {
+		crc = _crc16_update(crc, header[i]);
+	}
+	crc = _crc16_update(crc, length);
+	for (uint8_t i = 0; i < length; i++) {
+		crc = _crc16_update(crc, payload[i]);
+	}
 }
 
 void OutPacket::prepareForResend() {
 	error_code = PacketError::NO_ERROR;
 	state = PS_START;
 	send_payload_index = 0;
+	send_header_index = 0;
 }
 uint8_t OutPacket::getNextByteToSend() {
 	uint8_t next_byte = 0;
 	if (state == PS_START) {
-		next_byte = START_BYTE;
-		state = PS_LEN;
+		next_byte = start_byte;
+		state = (header_length == 0) ? PS_LEN : PS_HEADER;
+	} else if (state == PS_HEADER) {
+		next_byte = header[send_header_index++];
+		if (send_header_index >= header_length) {
+			state = PS_LEN;
+		}
 	} else if (state == PS_LEN) {
 		next_byte = length;
 		state = (length==0)?PS_CRC:PS_PAYLOAD;
@@ -130,6 +189,9 @@ uint8_t OutPacket::getNextByteToSend() {
 		}
 	} else if (state == PS_CRC) {
 		next_byte = crc;
+		state = (start_byte == WINDOW_START_BYTE) ? PS_CRC_HIGH : PS_LAST;
+	} else if (state == PS_CRC_HIGH) {
+		next_byte = crc >> 8;
 		state = PS_LAST;
 	}
 	return next_byte;
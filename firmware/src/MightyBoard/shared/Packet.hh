@@ -21,7 +21,29 @@
 #include <stdint.h>
 
 #define START_BYTE 0xD5
+/// Start byte of frames the bot sends unasked, such as telemetry; a host
+/// reading responses can tell them apart by it
+#define TELEMETRY_START_BYTE 0xD6
+/// Start byte of packets with a sequence number, and of their responses,
+/// once a host has negotiated windowed mode with HOST_CMD_LINK_VERSION:
+///   host: WINDOW_START_BYTE, sequence, length, payload, CRC (uint16)
+///   bot:  WINDOW_START_BYTE, ack, credit (uint16), length, payload, CRC (uint16)
+/// The CRC is _crc16_update() from 0xFFFF over everything after the start
+/// byte.  The 8 bit CRC of the other packets passes about one in 256
+/// misframed ones, which a windowed packet would have acted on.  The ack is the
+/// sequence number of the packet answered; it and every packet before it
+/// are done with.  The credit is the free space in the command buffer once
+/// that packet has been handled.
+#define WINDOW_START_BYTE 0xD7
+/// Most packets a host may have unacknowledged in windowed mode
+#define LINK_WINDOW_SIZE 4
+/// Longest payload of a response, and of a packet from a host which has
+/// not asked for more
 #define MAX_PACKET_PAYLOAD 32
+/// Longest payload a host may send once it has asked for it with
+/// HOST_CMD_LINK_VERSION.  A packet may hold several action commands,
+/// which are queued together.
+#define MAX_IN_PACKET_PAYLOAD 128
 
 #define SLAVE_ID_BROADCAST 127
 
@@ -67,18 +89,25 @@ protected:
 	// packet states
 	typedef enum {
 		PS_START,
+		PS_SEQ,
+		PS_HEADER,
 		PS_LEN,
 		PS_PAYLOAD,
 		PS_CRC,
+		PS_CRC_HIGH,
 		PS_LAST
 	} PacketState;
 
     volatile uint8_t length; /// The current length of the payload (data[0] if raw packets)
-    volatile uint8_t crc; /// The CRC of the current contents of the payload (data[-1] of raw packets)
-    volatile uint8_t payload[MAX_PACKET_PAYLOAD]; /// Data payload (starts at data[2] of raw packet)
+    volatile uint16_t crc; /// The CRC of the current contents of the payload (data[-1] of raw packets); 16 bits for windowed packets
+    volatile uint8_t* const payload; /// Data payload (starts at data[2] of raw packet), in the subclass
+	const uint8_t capacity; /// Size of the payload buffer
 	volatile uint8_t error_code; // Have any errors cropped up during processing?
 	volatile PacketState state;
 
+	Packet(volatile uint8_t* buffer, uint8_t buffer_size) :
+		payload(buffer), capacity(buffer_size) {}
+
 
 	/// Append a byte and update the CRC
 	void appendByte(uint8_t data);
@@ -111,7 +140,14 @@ public:
 /// Input Packet.
 class InPacket: public Packet {
 private:
+	volatile uint8_t buffer[MAX_IN_PACKET_PAYLOAD];
+	volatile uint8_t max_length; ///< Longest payload accepted
 	volatile uint8_t expected_length;
+	volatile bool windowed;
+	volatile uint8_t sequence;
+
+	/// Add a byte to the CRC: 16 bits for windowed packets, 8 for the others
+	void updateCrc(uint8_t b);
 public:
 	InPacket();
 
@@ -129,6 +165,20 @@ public:
 		return state != PS_START;
 	}
 
+	/// Check whether the packet was sent in windowed mode
+	bool isWindowed() const { return windowed; }
+
+	/// Sequence number of a windowed packet
+	uint8_t getSequence() const { return sequence; }
+
+	/// Set the longest payload to accept, up to #MAX_IN_PACKET_PAYLOAD.
+	/// Longer packets are dropped as errors.  Reset does not change it.
+	void setMaxLength(uint8_t value) {
+		max_length = value < capacity ? value : capacity;
+	}
+
+	uint8_t getMaxLength() const { return max_length; }
+
 	/// Indicate that this packet has timed out.  This means:
 	/// * setting the PACKET_TIMEOUT error on the packet
 	/// * the packet gets reset
@@ -140,13 +190,28 @@ public:
 /// Output Packet.
 class OutPacket: public Packet {
 private:
+	volatile uint8_t buffer[MAX_PACKET_PAYLOAD];
 	uint8_t send_payload_index;
+	uint8_t start_byte;
+	uint8_t header[3];
+	uint8_t header_length;
+	uint8_t send_header_index;
 public:
 	OutPacket();
 
 	/// Reset the entire packet transmission.
 	void reset();
 
+	/// Send this packet with another start byte, such as
+	/// #TELEMETRY_START_BYTE.  Reset sets it back to #START_BYTE.
+	void setStartByte(uint8_t value) { start_byte = value; }
+
+	/// Send this packet as the response to a windowed packet, with its 16
+	/// bit CRC.  Call this once the payload is complete.
+	/// \param[in] ack Sequence number of the packet answered
+	/// \param[in] credit Free space in the command buffer
+	void setAck(uint8_t ack, uint16_t credit);
+
 	bool isFinished() const {
 		return state == PS_LAST;
 	}
@@ -26,4 +26,13 @@ public:
 
 static const Pin NullPin(NullPort, 0);
 
+/// The registers and vector of pin change interrupt group GROUP (0 is port B, 1 is
+/// PE0 and PJ0-6, 2 is port K)
+#define PIN_CHANGE_MASK_(GROUP)		PCMSK ## GROUP
+#define PIN_CHANGE_ENABLE_(GROUP)	PCIE ## GROUP
+#define PIN_CHANGE_VECT_(GROUP)		PCINT ## GROUP ## _vect
+#define PIN_CHANGE_MASK(GROUP)		PIN_CHANGE_MASK_(GROUP)
+#define PIN_CHANGE_ENABLE(GROUP)	PIN_CHANGE_ENABLE_(GROUP)
+#define PIN_CHANGE_VECT(GROUP)		PIN_CHANGE_VECT_(GROUP)
+
 #endif // PIN_HH
@@ -0,0 +1,233 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "ThermalModel.hh"
+#include <math.h>
+
+/// Model used until measurements are available.  This is deliberately
+/// loose; it only has to keep the fit sane until real data arrives.
+#define DEFAULT_GAIN 250.0
+#define DEFAULT_TAU 120.0
+#define DEFAULT_AMBIENT 25.0
+
+/// Bounds on the fitted parameters
+#define MIN_GAIN 20.0
+#define MAX_GAIN 600.0
+#define MIN_TAU 5.0
+#define MAX_TAU 2000.0
+
+/// A first reading in this range with the heater off is taken as ambient
+#define MIN_AMBIENT 5
+#define MAX_AMBIENT 40
+
+/// Temperature samples are quantized to a degree, so the rate is measured
+/// over spans rather than sample to sample.  A span closes once it is at
+/// least MIN_SPAN_SECONDS long and the temperature has moved SPAN_DEGREES,
+/// or once it reaches MAX_SPAN_SECONDS, whichever comes first.  Slow heaters
+/// (the platform) get long spans; fast ones get short spans.
+#define MIN_SPAN_SECONDS 2.0
+#define MAX_SPAN_SECONDS 20.0
+#define SPAN_DEGREES 3
+
+/// A gap between samples longer than this means we missed samples; start a new span.
+#define MAX_SAMPLE_SECONDS 10.0
+
+/// A change in average output larger than this between spans (0-1) starts
+/// a settling period of SETTLE_SECONDS during which spans are not fitted.
+#define OUTPUT_STEP 0.25
+#define SETTLE_SECONDS 10.0
+
+/// Weight given to each older span when a new one is fitted (~50 spans of memory)
+#define FORGET_FACTOR 0.98
+
+/// Strength of the pull towards the default model, in spans.  This is only
+/// there to keep the fit defined before the data spans a range of outputs
+/// and temperatures; any real data should outweigh it.  The rate term is
+/// scaled by a typical rise of 100C so both terms are weighted alike.
+#define PRIOR_WEIGHT 0.01
+#define PRIOR_RISE_SCALE 100.0
+
+/// Number of spans that must be fitted before the model is used
+#define MIN_FIT_COUNT 10
+
+ThermalModel::ThermalModel() {
+	reset();
+}
+
+void ThermalModel::reset() {
+	gain = DEFAULT_GAIN;
+	tau = DEFAULT_TAU;
+	ambient = DEFAULT_AMBIENT;
+
+	s_uu = s_ux = s_xx = s_uy = s_xy = 0;
+	fit_count = 0;
+
+	have_start = false;
+	span_start_temp = 0;
+	span_time = 0;
+	span_output = 0;
+	last_span_output = 0;
+	settle_time = 0;
+}
+
+void ThermalModel::update(int16_t temp, uint8_t output, float dt) {
+	if (!have_start || dt > MAX_SAMPLE_SECONDS) {
+		// The first reading taken with the heater off tells us the ambient temperature
+		if (fit_count == 0 && !have_start && output == 0 &&
+				temp >= MIN_AMBIENT && temp <= MAX_AMBIENT) {
+			ambient = temp;
+		}
+		have_start = true;
+		span_start_temp = temp;
+		span_time = 0;
+		span_output = 0;
+		return;
+	}
+
+	span_time += dt;
+	span_output += ((float)output / 255.0) * dt;
+
+	int16_t moved = temp - span_start_temp;
+	if (moved < 0) { moved = -moved; }
+	if (span_time < MIN_SPAN_SECONDS ||
+			(moved < SPAN_DEGREES && span_time < MAX_SPAN_SECONDS)) {
+		return;
+	}
+
+	float rate = (float)(temp - span_start_temp) / span_time;
+	float u = span_output / span_time;
+	// use the rise at the middle of the span
+	float rise = ((float)(temp + span_start_temp) / 2.0) - ambient;
+
+	// The sensor lags the heater, so the rate measured just after a large
+	// change in output does not reflect the new output yet; skip those spans.
+	float step = u - last_span_output;
+	last_span_output = u;
+	if (step > OUTPUT_STEP || step < -OUTPUT_STEP) {
+		settle_time = SETTLE_SECONDS;
+	}
+	if (settle_time > 0) {
+		settle_time -= span_time;
+		span_start_temp = temp;
+		span_time = 0;
+		span_output = 0;
+		return;
+	}
+	fit(rate, u, rise);
+
+	span_start_temp = temp;
+	span_time = 0;
+	span_output = 0;
+}
+
+void ThermalModel::fit(float rate, float u, float rise) {
+	// Fit rate = a * u + c * rise, where a = gain / tau and c = -1 / tau
+	s_uu = s_uu * FORGET_FACTOR + u * u;
+	s_ux = s_ux * FORGET_FACTOR + u * rise;
+	s_xx = s_xx * FORGET_FACTOR + rise * rise;
+	s_uy = s_uy * FORGET_FACTOR + u * rate;
+	s_xy = s_xy * FORGET_FACTOR + rise * rate;
+
+	// Solve the normal equations with a ridge term pulling towards the default model
+	const float r_a = PRIOR_WEIGHT;
+	const float r_c = PRIOR_WEIGHT * PRIOR_RISE_SCALE * PRIOR_RISE_SCALE;
+	const float a0 = DEFAULT_GAIN / DEFAULT_TAU;
+	const float c0 = -1.0 / DEFAULT_TAU;
+
+	float m11 = s_uu + r_a;
+	float m12 = s_ux;
+	float m22 = s_xx + r_c;
+	float v1 = s_uy + r_a * a0;
+	float v2 = s_xy + r_c * c0;
+
+	float det = m11 * m22 - m12 * m12;
+	if (det <= 0) {
+		return;
+	}
+	float a = (v1 * m22 - v2 * m12) / det;
+	float c = (v2 * m11 - v1 * m12) / det;
+
+	// a heater that does not lose heat, or that cools when powered, is not physical
+	if (c >= 0 || a <= 0) {
+		return;
+	}
+
+	float new_tau = -1.0 / c;
+	if (new_tau < MIN_TAU) { new_tau = MIN_TAU; }
+	if (new_tau > MAX_TAU) { new_tau = MAX_TAU; }
+	float new_gain = a * new_tau;
+	if (new_gain < MIN_GAIN) { new_gain = MIN_GAIN; }
+	if (new_gain > MAX_GAIN) { new_gain = MAX_GAIN; }
+
+	tau = new_tau;
+	gain = new_gain;
+	if (fit_count < 255) {
+		fit_count++;
+	}
+}
+
+bool ThermalModel::isValid() const {
+	return fit_count >= MIN_FIT_COUNT;
+}
+
+uint8_t ThermalModel::feedForward(int16_t target) const {
+	if (!isValid() || target <= 0) {
+		return 0;
+	}
+	float u = ((float)target - ambient) / gain;
+	if (u <= 0) { return 0; }
+	if (u >= 1) { return 255; }
+	return (uint8_t)(u * 255.0);
+}
+
+uint16_t ThermalModel::secondsToTarget(int16_t temp, int16_t target) const {
+	if (!isValid()) {
+		return MODEL_TIME_UNKNOWN;
+	}
+	if (temp == target) {
+		return 0;
+	}
+
+	float ratio;
+	if (target > temp) {
+		// heating full on approaches ambient + gain
+		float limit = ambient + gain;
+		if (target >= limit - 1) {
+			return MODEL_TIME_UNKNOWN;
+		}
+		ratio = (limit - temp) / (limit - target);
+	} else {
+		// cooling with the heater off approaches ambient
+		if (target <= ambient + 1) {
+			return MODEL_TIME_UNKNOWN;
+		}
+		ratio = ((float)temp - ambient) / ((float)target - ambient);
+	}
+	if (ratio <= 1) {
+		return 0;
+	}
+
+	float seconds = tau * log(ratio);
+	if (seconds >= MODEL_TIME_UNKNOWN) {
+		return MODEL_TIME_UNKNOWN;
+	}
+	return (uint16_t)(seconds + 0.5);
+}
+
+float ThermalModel::heatingRate(int16_t temp) const {
+	return (ambient + gain - (float)temp) / tau;
+}
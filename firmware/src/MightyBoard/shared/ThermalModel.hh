@@ -0,0 +1,106 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef THERMAL_MODEL_HH_
+#define THERMAL_MODEL_HH_
+
+#include <stdint.h>
+
+/// Returned by #ThermalModel::secondsToTarget() when no estimate is available.
+#define MODEL_TIME_UNKNOWN 0xFFFF
+
+/// The thermal model module fits a first order model to a heater:
+///
+///     tau * dT/dt = gain * u - (T - ambient)
+///
+/// where u is the heater output (0-1).  The gain is the temperature rise above
+/// ambient the heater settles at when held full on, and tau is the time
+/// constant in seconds.  The model is fitted online from the temperature
+/// history by least squares, regularised towards a default model so that it
+/// stays well defined while the heater holds a steady temperature.
+/// \ingroup SoftwareLibraries
+class ThermalModel {
+private:
+    float gain;                 ///< Steady state rise at full output, in degrees C
+    float tau;                  ///< Time constant, in seconds
+    float ambient;              ///< Ambient temperature, in degrees C
+
+    /// Least squares sums for dT/dt = a * u - b * (T - ambient),
+    /// where a = gain / tau and b = 1 / tau.
+    float s_uu, s_ux, s_xx, s_uy, s_xy;
+    uint8_t fit_count;          ///< Number of fitted spans, saturates at 255
+
+    /// Data for the span currently being accumulated.
+    bool have_start;            ///< True once a span start temperature is known
+    int16_t span_start_temp;    ///< Temperature at the start of the span
+    float span_time;            ///< Seconds accumulated in the span
+    float span_output;          ///< Output integrated over the span (output * seconds)
+    float last_span_output;     ///< Average output (0-1) over the previous span
+    float settle_time;          ///< Seconds left before spans are fitted again
+
+    /// Fold a completed span into the fit and recompute gain and tau.
+    void fit(float rate, float output, float rise);
+
+public:
+    /// Initialize the model with default parameters
+    ThermalModel();
+
+    /// Forget all history and return to the default model
+    void reset();
+
+    /// Add a temperature sample to the model.
+    /// \param[in] temp Measured temperature, in degrees C
+    /// \param[in] output Heater output (0-255) applied since the previous sample
+    /// \param[in] dt Seconds since the previous sample
+    void update(int16_t temp, uint8_t output, float dt);
+
+    /// Check if enough data has been seen for the model to be trusted
+    /// \return True if the model has been fitted from measurements
+    bool isValid() const;
+
+    /// Get the heater output needed to hold a temperature
+    /// \param[in] target Temperature to hold, in degrees C
+    /// \return Steady state output (0-255), or 0 if the model is not valid
+    uint8_t feedForward(int16_t target) const;
+
+    /// Predict the time needed to move from one temperature to another, with
+    /// the heater full on when heating or off when cooling.
+    /// \param[in] temp Current temperature, in degrees C
+    /// \param[in] target Target temperature, in degrees C
+    /// \return Seconds to target, or #MODEL_TIME_UNKNOWN if the model is not
+    ///         valid or the target is out of reach
+    uint16_t secondsToTarget(int16_t temp, int16_t target) const;
+
+    /// Predict the heating rate with the heater full on
+    /// \param[in] temp Current temperature, in degrees C
+    /// \return Heating rate in degrees C per second
+    float heatingRate(int16_t temp) const;
+
+    /// Get the fitted steady state rise at full output
+    /// \return Gain, in degrees C
+    float getGain() const { return gain; }
+
+    /// Get the fitted time constant
+    /// \return Time constant, in seconds
+    float getTau() const { return tau; }
+
+    /// Get the ambient temperature used by the model
+    /// \return Ambient temperature, in degrees C
+    float getAmbient() const { return ambient; }
+};
+
+#endif /* THERMAL_MODEL_HH_ */
@@ -18,7 +18,6 @@
 #include "Thermistor.hh"
 #include "TemperatureTable.hh"
 #include "AnalogPin.hh"
-#include <util/atomic.h>
 
 
 struct ThermTableEntry {
@@ -29,9 +28,10 @@ struct ThermTableEntry {
 
 Thermistor::Thermistor(uint8_t analog_pin_in, uint8_t table_index_in) :
     analog_pin(analog_pin_in),
+    adc_slot(ANALOG_CHANNEL_INVALID),
+    adc_sequence(0),
     next_sample(0),
-    table_index(table_index_in),
-    raw_valid(false)
+    table_index(table_index_in)
 {
         for (int i = 0; i < SAMPLE_COUNT; i++) {
             sample_buffer[i] = 0;
@@ -40,28 +40,15 @@ Thermistor::Thermistor(uint8_t analog_pin_in, uint8_t table_index_in) :
 
 void Thermistor::init() {
   current_temp = 0;
-	initAnalogPin(analog_pin);
+	adc_slot = initAnalogPin(analog_pin);
 }
 
 Thermistor::SensorState Thermistor::update() {
 	int16_t temp;
-	bool valid;
 
-	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
-		valid = raw_valid;
-		temp = raw_value;
-
-		// Invalidate the result now that we have read it
-		if (raw_valid) {
-			raw_valid = false;
-                }
-	}
-
-	// initiate next read
-	if (!startAnalogRead(analog_pin,&raw_value, &raw_valid)) return SS_ADC_BUSY;
-
-	// If we haven't gotten data yet, return.
-	if (!valid) return SS_ADC_WAITING;
+	// The ADC scheduler samples continuously; just pick up the newest result.
+	if (adc_slot == ANALOG_CHANNEL_INVALID) return SS_ERROR_UNPLUGGED;
+	if (!getAnalogSample(adc_slot, temp, adc_sequence)) return SS_ADC_WAITING;
 
 	sample_buffer[next_sample] = temp;
 	next_sample = (next_sample+1) % SAMPLE_COUNT;
@@ -29,8 +29,8 @@
 class Thermistor : public TemperatureSensor {
 private:
         uint8_t analog_pin;                 ///< index of analog pin
-        volatile int16_t raw_value;         ///< raw storage for asynchronous analog read
-        volatile bool raw_valid;            ///< flag to state if raw_value contains valid data
+        uint8_t adc_slot;                   ///< ADC scheduler slot for the analog pin
+        uint8_t adc_sequence;               ///< sequence number of the last sample consumed
         // TODO: This should come from the ADC!
         const static int ADC_RANGE = 1024;  ///< Maximum ADC value
         const static int MAX_TEMP = 255;
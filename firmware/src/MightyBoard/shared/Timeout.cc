@@ -22,6 +22,11 @@
     #include "ExtruderBoard.hh"
 
 	inline micros_t getMicros() { return ExtruderBoard::getBoard().getCurrentMicros(); }
+#elif defined SIMULATOR
+	// the host tests keep the clock
+	micros_t simulatorMicros();
+
+	inline micros_t getMicros() { return simulatorMicros(); }
 #else
     #include "Motherboard.hh"
 
@@ -26,18 +26,21 @@
 /// the minimum number of microseconds to wait before
 ///
 /// Timeout objects maintain timestamps and check the universal clock to figure out when they've
-/// elapsed.  Resolution is at best that of the system interval.  Maximum timeout length is
+/// elapsed.  The clock is read from a hardware counter (see Timebase.hh), so resolution is a
+/// microsecond and checking a timeout needs no atomic block.  Maximum timeout length is
 /// 4294967295 microseconds.
 /// Timeouts must be checked before the maximum timeout length to remain valid 
 /// After a timeout has elapsed, it can not go back to a valid state without being explicitly reset.
+/// Timeouts checked from the main loop can go on the #TimerWheel instead, as a #ScheduledTimeout.
 /// \ingroup SoftwareLibraries
 class Timeout {
-private:
+protected:
         bool active;                    ///< True if the timeout object is actively counting down.
         bool elapsed;                   ///< True if the timeout object has elapsed.
         bool is_paused;					///< True if the timeout object is paused
 
-        //TODO: Instead of storing start and duration, precompute and store the elapse time.
+	// Start and duration rather than the time to elapse at, so that timeouts of more than
+	// 2**31 microseconds (print_time's hour) still compare correctly across the wrap
 	micros_t start_stamp_micros;
 	micros_t duration_micros;
 	micros_t pause_micros;
@@ -0,0 +1,216 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "TimerWheel.hh"
+
+/// Values of ScheduledTimeout::slot for a timeout on no slot: not on the wheel, or taken
+/// off it because it is due.  The slots are numbered level * TIMER_WHEEL_SLOTS + slot.
+#define TIMER_WHEEL_NONE	0xFF
+#define TIMER_WHEEL_DUE		0xFE
+
+#define TIMER_WHEEL_SLOT_MASK	(TIMER_WHEEL_SLOTS - 1)
+
+/// Ticks the wheel reaches ahead; a timeout further off is placed this far ahead
+#define TIMER_WHEEL_REACH	((1 << (TIMER_WHEEL_SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+ScheduledTimeout::ScheduledTimeout() : next(0), slot(TIMER_WHEEL_NONE) {}
+
+void ScheduledTimeout::start(micros_t duration_micros_in) {
+	Timeout::start(duration_micros_in);
+	TimerWheel::getWheel().schedule(*this);
+}
+
+bool ScheduledTimeout::hasElapsed() {
+	if (slot == TIMER_WHEEL_DUE) {
+		slot = TIMER_WHEEL_NONE;
+		active = false;
+		elapsed = true;
+	}
+	return elapsed;
+}
+
+void ScheduledTimeout::abort() {
+	Timeout::abort();
+	TimerWheel::getWheel().cancel(*this);
+}
+
+TimerWheel TimerWheel::wheel;
+
+TimerWheel& TimerWheel::getWheel() {
+	return wheel;
+}
+
+TimerWheel::TimerWheel() {
+	reset(0);
+}
+
+/// Microseconds from the given time until a timeout ends, or 0 if it has ended.  The
+/// timeout must have started by then.
+static micros_t remaining(micros_t start, micros_t duration, micros_t now) {
+	micros_t run = now - start;
+	return run >= duration ? 0 : duration - run;
+}
+
+void TimerWheel::reset(micros_t now) {
+	for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		for (uint8_t slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+			for (ScheduledTimeout *t = slots[level][slot]; t != 0; t = t->next) {
+				t->slot = TIMER_WHEEL_DUE;
+			}
+			slots[level][slot] = 0;
+		}
+	}
+	tick_micros = now;
+	now_micros = now;
+	ticks = 0;
+}
+
+void TimerWheel::place(ScheduledTimeout& timeout) {
+	micros_t left = remaining(timeout.start_stamp_micros, timeout.duration_micros, now_micros);
+	micros_t since_tick = now_micros - tick_micros;
+	left = left + since_tick < left ? (micros_t)0xFFFFFFFF : left + since_tick;
+	micros_t ahead = left >> TIMER_WHEEL_TICK_SHIFT;
+	if (ahead > TIMER_WHEEL_REACH) { ahead = TIMER_WHEEL_REACH; }
+
+	// the lowest level whose turn reaches the tick the timeout ends in
+	uint16_t end = ticks + (uint16_t)ahead;
+	uint8_t level = 0;
+	uint8_t shift = 0;
+	while ((uint16_t)(ahead >> shift) >= TIMER_WHEEL_SLOTS && level < TIMER_WHEEL_LEVELS - 1) {
+		level++;
+		shift += TIMER_WHEEL_SLOT_BITS;
+	}
+	uint8_t slot = (end >> shift) & TIMER_WHEEL_SLOT_MASK;
+
+	timeout.next = slots[level][slot];
+	timeout.slot = level * TIMER_WHEEL_SLOTS + slot;
+	slots[level][slot] = &timeout;
+}
+
+void TimerWheel::unlink(ScheduledTimeout& timeout) {
+	ScheduledTimeout **link = &slots[timeout.slot / TIMER_WHEEL_SLOTS][timeout.slot & TIMER_WHEEL_SLOT_MASK];
+
+	while (*link != 0) {
+		if (*link == &timeout) {
+			*link = timeout.next;
+			break;
+		}
+		link = &(*link)->next;
+	}
+	timeout.slot = TIMER_WHEEL_NONE;
+}
+
+void TimerWheel::replace(uint8_t level, uint8_t slot) {
+	ScheduledTimeout *t = slots[level][slot];
+
+	slots[level][slot] = 0;
+	while (t != 0) {
+		ScheduledTimeout *next = t->next;
+		place(*t);
+		t = next;
+	}
+}
+
+void TimerWheel::schedule(ScheduledTimeout& timeout) {
+	if (timeout.slot < TIMER_WHEEL_DUE) { unlink(timeout); }
+
+	// It started after the last advance, so its start is the latest time known
+	if ((int32_t)(timeout.start_stamp_micros - now_micros) > 0) {
+		now_micros = timeout.start_stamp_micros;
+	}
+
+	// A timeout of no time elapses on its first check, as a #Timeout does
+	if (timeout.duration_micros == 0) {
+		timeout.slot = TIMER_WHEEL_DUE;
+	} else {
+		place(timeout);
+	}
+}
+
+void TimerWheel::cancel(ScheduledTimeout& timeout) {
+	if (timeout.slot < TIMER_WHEEL_DUE) { unlink(timeout); }
+	timeout.slot = TIMER_WHEEL_NONE;
+}
+
+void TimerWheel::advance(micros_t now) {
+	now_micros = now;
+	while (true) {
+		uint8_t current = ticks & TIMER_WHEEL_SLOT_MASK;
+
+		// the timeouts ending in this tick are checked against the clock
+		ScheduledTimeout **link = &slots[0][current];
+		while (*link != 0) {
+			ScheduledTimeout *t = *link;
+			if (now - t->start_stamp_micros >= t->duration_micros) {
+				*link = t->next;
+				t->slot = TIMER_WHEEL_DUE;
+			} else {
+				link = &t->next;
+			}
+		}
+
+		if (now - tick_micros < (micros_t)TIMER_WHEEL_TICK_MICROS) { break; }
+
+		// On to the next tick.  At the start of a turn of a level, the slot of the
+		// level above for that turn moves down, from the top level first.  Timeouts
+		// left in the slot of the tick just passed end later than it, and are placed
+		// again.
+		ScheduledTimeout *left = slots[0][current];
+		slots[0][current] = 0;
+		tick_micros += TIMER_WHEEL_TICK_MICROS;
+		ticks++;
+		for (uint8_t level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+			uint8_t shift = level * TIMER_WHEEL_SLOT_BITS;
+			if ((ticks & ((1 << shift) - 1)) == 0) {
+				replace(level, (ticks >> shift) & TIMER_WHEEL_SLOT_MASK);
+			}
+		}
+		while (left != 0) {
+			ScheduledTimeout *next = left->next;
+			place(*left);
+			left = next;
+		}
+	}
+}
+
+micros_t TimerWheel::untilNextDue() const {
+	micros_t until = 0xFFFFFFFF;
+
+	for (ScheduledTimeout *t = slots[0][ticks & TIMER_WHEEL_SLOT_MASK]; t != 0; t = t->next) {
+		micros_t left = remaining(t->start_stamp_micros, t->duration_micros, now_micros);
+		if (left < until) { until = left; }
+	}
+
+	// the start of the nearest turn of each level with a slot in use; a slot of a
+	// level above 0 may be a whole turn of that level ahead
+	for (uint8_t level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		uint8_t shift = level * TIMER_WHEEL_SLOT_BITS;
+		for (uint8_t k = 1; k <= TIMER_WHEEL_SLOTS; k++) {
+			uint16_t turn = (uint16_t)((ticks >> shift) + k);
+			if (level == 0 && k == TIMER_WHEEL_SLOTS) { break; }
+			if (slots[level][turn & TIMER_WHEEL_SLOT_MASK] != 0) {
+				uint16_t ahead = (uint16_t)(turn << shift) - ticks;
+				micros_t at = (micros_t)ahead << TIMER_WHEEL_TICK_SHIFT;
+				micros_t since_tick = now_micros - tick_micros;
+				micros_t left = at > since_tick ? at - since_tick : 0;
+				if (left < until) { until = left; }
+				break;
+			}
+		}
+	}
+	return until;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2010 by Adam Mayer	 <adam@makerbot.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef TIMER_WHEEL_HH_
+#define TIMER_WHEEL_HH_
+
+#include <stdint.h>
+#include "Types.hh"
+#include "Timeout.hh"
+
+/// The wheel turns in ticks of 2**TIMER_WHEEL_TICK_SHIFT microseconds (1.024ms).  It
+/// has TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots; a slot of level 0 is a
+/// tick, and a slot of each level above is a turn of the level below, so the four
+/// levels reach 4096 ticks (4.2s) ahead.  Timeouts further off wait in the last
+/// slot of the top level and are placed again when it comes round.
+#define TIMER_WHEEL_TICK_SHIFT	10
+#define TIMER_WHEEL_TICK_MICROS	(1L << TIMER_WHEEL_TICK_SHIFT)
+#define TIMER_WHEEL_SLOT_BITS	3
+#define TIMER_WHEEL_SLOTS	(1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_LEVELS	4
+
+class TimerWheel;
+
+/// A #Timeout kept on the #TimerWheel, for timeouts checked from the main loop.  While
+/// it runs it waits in a slot of the wheel, and #TimerWheel::advance() marks it due
+/// when its time comes; #hasElapsed() then only looks at that mark, instead of reading
+/// the clock.  It elapses on the first check after the main loop has advanced the wheel
+/// past the end of the timeout, and active and elapsed change when it is checked, the
+/// same as for a #Timeout.
+///
+/// A scheduled timeout can not be paused, and must not be copied or checked from an
+/// interrupt, or busy waited on: nothing advances the wheel while the main loop waits.
+/// \ingroup SoftwareLibraries
+class ScheduledTimeout : private Timeout {
+	friend class TimerWheel;
+private:
+	ScheduledTimeout *next;		///< Next timeout in the same slot
+	uint8_t slot;			///< Slot of the wheel it waits in, or one of
+					///< TIMER_WHEEL_NONE and TIMER_WHEEL_DUE
+
+	ScheduledTimeout(const ScheduledTimeout&);
+	void operator=(const ScheduledTimeout&);
+public:
+	ScheduledTimeout();
+
+	/// Start a new timeout cycle that will elapse after the given amount of time.
+	/// \param [in] duration_micros Microseconds until the timeout cycle should elapse.
+	void start(micros_t duration_micros);
+
+	/// Test whether the current timeout cycle has elapsed, as for a #Timeout, from
+	/// whether the wheel has found it due.
+	/// \return True if the timeout has elapsed.
+	bool hasElapsed();
+
+	/// Stop the current timeout, and take it off the wheel.
+	void abort();
+
+	using Timeout::isActive;
+	using Timeout::clear;
+	using Timeout::getCurrentElapsed;
+};
+
+/// Keeps the running #ScheduledTimeout's in a hierarchical timer wheel, so that the main
+/// loop reads the clock once a pass to find the timeouts which are due, and knows how
+/// long it is until the next one.  Each timeout is placed by the tick it ends in: up to
+/// 8 ticks ahead in a slot of level 0, up to 64 in a slot of level 1, and so on.  When
+/// level 0 comes round to a slot of level 1, that slot's timeouts move down to level 0,
+/// and likewise up the levels, so each timeout is moved at most once a level.  The
+/// timeouts in the slot of the current tick are checked against the clock on every
+/// #advance().
+/// \ingroup SoftwareLibraries
+class TimerWheel {
+private:
+	ScheduledTimeout *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	micros_t tick_micros;		///< Clock at the start of the current tick
+	micros_t now_micros;		///< Clock at the last #advance()
+	uint16_t ticks;			///< Ticks since the wheel was reset
+
+	static TimerWheel wheel;
+
+	/// Puts a timeout in the slot for the tick it ends in, or marks it due.
+	void place(ScheduledTimeout& timeout);
+
+	/// Takes a timeout out of its slot.
+	void unlink(ScheduledTimeout& timeout);
+
+	/// Takes the timeouts out of a slot, and places each again.
+	void replace(uint8_t level, uint8_t slot);
+
+	TimerWheel();
+public:
+	/// The wheel of the main loop.
+	static TimerWheel& getWheel();
+
+	/// Starts the wheel turning from the given time, for when the clock is reset.  The
+	/// timeouts on it are marked due, as a #Timeout started before the clock went back
+	/// would elapse on its next check.
+	/// \param [in] now Current time, from the system clock.
+	void reset(micros_t now);
+
+	/// Adds a timeout which has just been started, taking it off the wheel first if it
+	/// was on it.
+	void schedule(ScheduledTimeout& timeout);
+
+	/// Takes a timeout off the wheel.
+	void cancel(ScheduledTimeout& timeout);
+
+	/// Turns the wheel to the given time, marking the timeouts which have elapsed by
+	/// then as due.  Called once a pass of the main loop.
+	/// \param [in] now Current time, from the system clock.
+	void advance(micros_t now);
+
+	/// Time until the next timeout on the wheel is due, from the last #advance().  It is
+	/// exact for the timeouts of the current tick and otherwise the start of the tick the
+	/// next timeout ends in, so it is never later than the timeout.
+	/// \return Microseconds until the next timeout is due, or 0xFFFFFFFF if there are
+	/// none.
+	micros_t untilNextDue() const;
+};
+
+#endif // TIMER_WHEEL_HH_
@@ -23,6 +23,7 @@
 #include <avr/interrupt.h>
 #include <avr/io.h>
 #include <util/delay.h>
+#include <util/atomic.h>
 #include <avr/io.h>
 
 
@@ -39,6 +40,23 @@ const Pin RX_Enable = RX_ENABLE_PIN;
 // them from our receive buffer later.This is only used for RS485 mode.
 volatile uint8_t loopback_bytes = 0;
 
+// Bytes from the host which came in while the host packet held a finished
+// packet.  A host in windowed mode sends packets back to back, so up to
+// LINK_WINDOW_SIZE - 1 of them, each of a payload and its framing, can
+// arrive before the first is handled.  The size is a power of two.
+#define HOST_PENDING_SIZE 512
+#define HOST_PENDING_MASK (HOST_PENDING_SIZE - 1)
+typedef char host_pending_check[((HOST_PENDING_SIZE & HOST_PENDING_MASK) == 0 &&
+        HOST_PENDING_SIZE > (LINK_WINDOW_SIZE - 1) * (MAX_IN_PACKET_PAYLOAD + 5)) ? 1 : -1];
+uint8_t host_pending[HOST_PENDING_SIZE];
+volatile uint16_t host_pending_head = 0;
+volatile uint16_t host_pending_tail = 0;
+
+// Speed of the host UART, and the UBRR value to change to once the packet
+// being sent has gone (0 for none)
+uint32_t host_baud_rate = HOST_DEFAULT_BAUD_RATE;
+volatile uint8_t host_pending_ubrr = 0;
+
 // We support three platforms: Atmega168 (1 UART), Atmega644, and Atmega1280/2560
 #if defined (__AVR_ATmega168__)     \
     || defined (__AVR_ATmega328__)  \
@@ -85,7 +103,8 @@ volatile uint8_t loopback_bytes = 0;
 #elif defined (__AVR_ATmega1280__) || defined (__AVR_ATmega2560__)
 
     // Use double-speed mode for more accurate baud rate?
-    #define UBRR0_VALUE 16 // 115200 baud
+    #define UBRR0_VALUE 16 // 115200 baud, HOST_DEFAULT_BAUD_RATE
+    #define UBRR_2X(baud_) (F_CPU / 8 / (baud_) - 1)
     #define UBRR1_VALUE 51 // 38400 baud
     #define UCSRA_VALUE(uart_) _BV(U2X##uart_)
 
@@ -186,6 +205,55 @@ void UART::beginSend() {
         send_byte(out.getNextByteToSend());
 }
 
+bool UART::setBaudRate(uint32_t baud, bool after_send) {
+#if defined (__AVR_ATmega1280__) || defined (__AVR_ATmega2560__)
+        uint8_t ubrr;
+        // the rates which double speed mode divides the clock down to
+        // exactly, as the USB to serial bridge does
+        switch (baud) {
+        case HOST_DEFAULT_BAUD_RATE:
+                ubrr = UBRR0_VALUE;
+                break;
+        case 250000:
+        case 500000:
+        case 1000000:
+                ubrr = UBRR_2X(baud);
+                break;
+        default:
+                return false;
+        }
+        host_baud_rate = baud;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                if (after_send) {
+                        host_pending_ubrr = ubrr;
+                } else {
+                        UBRR0H = 0;
+                        UBRR0L = ubrr;
+                        host_pending_ubrr = 0;
+                }
+        }
+        return true;
+#else
+        return baud == HOST_DEFAULT_BAUD_RATE;
+#endif
+}
+
+uint32_t UART::getBaudRate() const {
+        return host_baud_rate;
+}
+
+void UART::processPending() {
+        while (!in.isFinished() && !in.hasError()) {
+                ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                        if (host_pending_tail == host_pending_head) {
+                                return;
+                        }
+                        in.processByte(host_pending[host_pending_tail]);
+                        host_pending_tail = (host_pending_tail + 1) & HOST_PENDING_MASK;
+                }
+        }
+}
+
 void UART::enable(bool enabled) {
         enabled_ = enabled;
         if (index_ == 0) {
@@ -258,13 +326,29 @@ void UART::reset() {
     // Send and receive interrupts
     ISR(USART0_RX_vect)
     {
-            UART::getHostUART().in.processByte( UDR0 );
+            uint8_t byte_in = UDR0;
+
+            // keep the order of the bytes behind a packet waiting to be handled
+            if (UART::getHostUART().in.isFinished() || host_pending_head != host_pending_tail) {
+                    uint16_t next = (host_pending_head + 1) & HOST_PENDING_MASK;
+                    if (next != host_pending_tail) {
+                            host_pending[host_pending_head] = byte_in;
+                            host_pending_head = next;
+                    }
+            } else {
+                    UART::getHostUART().in.processByte( byte_in );
+            }
     }
 
     ISR(USART0_TX_vect)
     {
             if (UART::getHostUART().out.isSending()) {
                     UDR0 = UART::getHostUART().out.getNextByteToSend();
+            } else if (host_pending_ubrr != 0) {
+                    // the last byte has left the shift register
+                    UBRR0H = 0;
+                    UBRR0L = host_pending_ubrr;
+                    host_pending_ubrr = 0;
             }
     }
 
@@ -22,6 +22,10 @@
 #include "Configuration.hh"
 #include <stdint.h>
 
+/// Speed of the host UART at reset, and of the USB to serial bridge until
+/// the host sets it
+#define HOST_DEFAULT_BAUD_RATE 115200
+
 // TODO: Move to UART class
 /// Communication mode selection
 enum communication_mode {
@@ -86,6 +90,22 @@ public:
         /// Begin sending the data located in the #out packet.
         void beginSend();
 
+        /// Change the speed of the host UART.  Host UART only.
+        /// \param[in] baud #HOST_DEFAULT_BAUD_RATE, 250000, 500000 or
+        /// 1000000; other rates are refused.
+        /// \param[in] after_send True to change once the packet in #out,
+        /// which must be about to be sent, has gone; false to change now.
+        /// \return True if the rate is one the UART can run at.
+        bool setBaudRate(uint32_t baud, bool after_send);
+
+        /// Current speed of the host UART
+        uint32_t getBaudRate() const;
+
+        /// Feed #in the bytes that came in while it held a finished
+        /// packet, up to the end of the next packet.  Call this after
+        /// resetting #in.  Host UART only.
+        void processPending();
+
         /// Enable or disable the serial port.
         /// \param[in] true to enable the serial port, false to disable it.
 	void enable(bool enabled);
@@ -330,6 +330,7 @@ static PROGMEM unsigned char RESET1_MSG[] =           "Reinitialiser aux   ";
 static PROGMEM unsigned char RESET2_MSG[] =           "parametres d'usine ?";
 static PROGMEM unsigned char CANCEL_MSG[] =           "Annuler impression?";
 static PROGMEM unsigned char CANCEL_PROCESS_MSG[] =   "Quitter processus ? ";
+static PROGMEM unsigned char RESUME_MSG[] =           "Reprendre la fab. ?";
 
 static PROGMEM unsigned char PAUSE_MSG[] =        "Mettre en pause  ";
 static PROGMEM unsigned char UNPAUSE_MSG[] =      "Reprendre        ";
@@ -166,6 +166,7 @@ static PROGMEM unsigned char RESET1_MSG[]           = "Resetto i parametri ";
 static PROGMEM unsigned char RESET2_MSG[]           = "ai Valori di        " "Default?            ";
 static PROGMEM unsigned char CANCEL_MSG[]           = "Cancella stampa?    ";
 static PROGMEM unsigned char CANCEL_PROCESS_MSG[]   = "Chiudi processo?    ";
+static PROGMEM unsigned char RESUME_MSG[]           = "Riprendi stampa?    ";
 
 static PROGMEM unsigned char PAUSE_MSG[]            = "Pausa               ";
 static PROGMEM unsigned char UNPAUSE_MSG[]          = "Riprendi            ";